@@ -0,0 +1,262 @@
+/*
+
+  ESP-IDF Benchmark
+
+  This example measures the performance of the DMX and RDM hot paths so that
+  performance regressions can be tracked across releases. Two DMX ports are
+  looped back onto the same DMX bus: DMX_NUM_1 acts as the DMX and RDM
+  controller and DMX_NUM_2 acts as the receiver and RDM responder. Connect the
+  A and B lines of the two DMX transceivers to each other.
+
+  The example measures the maximum sustained frame rate at several packet
+  sizes, the round-trip time of RDM requests, the time taken by RDM discovery
+  with and without a responder on the bus, the throughput of RDM parameter
+  encoding, and the CPU load of the DMX driver. Results are printed one per
+  line in the following comma-separated format so that they can be parsed by a
+  script:
+
+    BENCH,<benchmark>,<parameter>,<value>,<unit>
+
+  Note: this example is for use with the ESP-IDF. It will not work on Arduino!
+
+  https://github.com/someweisguy/esp_dmx
+
+*/
+#include <stdio.h>
+
+#include "esp_dmx.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "rdm/controller.h"
+#include "rdm/include/driver.h"
+#include "rdm/responder.h"
+
+#define TX_PIN 17  // The DMX transmit pin of the controller port.
+#define RX_PIN 16  // The DMX receive pin of the controller port.
+#define EN_PIN 21  // The DMX transmit enable pin of the controller port.
+
+#define RESPONDER_TX_PIN 4   // The DMX transmit pin of the responder port.
+#define RESPONDER_RX_PIN 5   // The DMX receive pin of the responder port.
+#define RESPONDER_EN_PIN 19  // The DMX transmit enable pin of the responder.
+
+#define FRAME_COUNT 200      // The number of frames sent for each frame size.
+#define REQUEST_COUNT 100    // The number of RDM requests to time.
+#define DISCOVERY_COUNT 5    // The number of times to run RDM discovery.
+#define ENCODE_COUNT 10000   // The number of RDM packets to encode.
+#define LOAD_WINDOW_MS 1000  // The length of the CPU load baseline window.
+
+static const char *TAG = "main";
+
+static const dmx_port_t controller_num = DMX_NUM_1;
+static const dmx_port_t responder_num = DMX_NUM_2;
+
+static volatile bool responder_is_enabled = false;
+static volatile uint32_t rx_frames = 0;
+static volatile uint32_t idle_count = 0;
+
+static void print_result(const char *benchmark, const char *parameter,
+                         int64_t value, const char *unit) {
+  printf("BENCH,%s,%s,%lli,%s\n", benchmark, parameter, value, unit);
+}
+
+static void idle_task(void *arg) {
+  // Runs at the idle priority so that it only counts otherwise unused time
+  while (true) {
+    ++idle_count;
+  }
+}
+
+static void responder_task(void *arg) {
+  dmx_packet_t packet;
+  while (true) {
+    if (dmx_receive(responder_num, &packet, pdMS_TO_TICKS(100))) {
+      if (packet.err == DMX_OK) {
+        ++rx_frames;
+      }
+      if (packet.is_rdm && responder_is_enabled) {
+        rdm_send_response(responder_num);
+      }
+    }
+  }
+}
+
+static uint32_t measure_idle_count(int64_t *elapsed) {
+  const uint32_t start_count = idle_count;
+  const int64_t start = esp_timer_get_time();
+  vTaskDelay(pdMS_TO_TICKS(LOAD_WINDOW_MS));
+  *elapsed = esp_timer_get_time() - start;
+  return idle_count - start_count;
+}
+
+static int cpu_load_percent(uint32_t baseline, int64_t baseline_elapsed,
+                            uint32_t count, int64_t elapsed) {
+  // Scale the idle count to the length of the baseline window
+  const int64_t expected = (int64_t)baseline * elapsed / baseline_elapsed;
+  if (expected == 0 || count >= expected) {
+    return 0;
+  }
+  return 100 - (int)(count * 100 / expected);
+}
+
+static void benchmark_frame_rate(uint32_t baseline, int64_t baseline_elapsed) {
+  const size_t sizes[] = {24, 128, 256, DMX_PACKET_SIZE_MAX};
+  uint8_t data[DMX_PACKET_SIZE_MAX] = {};
+  responder_is_enabled = false;
+  for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    const size_t size = sizes[i];
+    char parameter[16];
+    snprintf(parameter, sizeof(parameter), "size_%u", (unsigned)size);
+    dmx_write(controller_num, data, size);
+
+    // Send packets back-to-back and count the packets that were received
+    rx_frames = 0;
+    const uint32_t start_count = idle_count;
+    const int64_t start = esp_timer_get_time();
+    for (int j = 0; j < FRAME_COUNT; ++j) {
+      dmx_send_num(controller_num, size);
+      dmx_wait_sent(controller_num, DMX_TIMEOUT_TICK);
+    }
+    const int64_t elapsed = esp_timer_get_time() - start;
+    const uint32_t count = idle_count - start_count;
+    vTaskDelay(pdMS_TO_TICKS(50));  // Let the receiver finish
+
+    print_result("frame_rate", parameter, FRAME_COUNT * 1000000 / elapsed,
+                 "fps");
+    print_result("frame_loss", parameter, FRAME_COUNT - rx_frames, "frames");
+    print_result("cpu_load", parameter,
+                 cpu_load_percent(baseline, baseline_elapsed, count, elapsed),
+                 "percent");
+  }
+}
+
+static void benchmark_rdm_request(const rdm_uid_t *dest_uid) {
+  responder_is_enabled = true;
+  int64_t total = 0;
+  int64_t min = INT64_MAX;
+  int64_t max = 0;
+  int failures = 0;
+  for (int i = 0; i < REQUEST_COUNT; ++i) {
+    bool identify;
+    rdm_ack_t ack;
+    const int64_t start = esp_timer_get_time();
+    rdm_send_get_identify_device(controller_num, dest_uid, RDM_SUB_DEVICE_ROOT,
+                                 &identify, &ack);
+    const int64_t elapsed = esp_timer_get_time() - start;
+    if (ack.type != RDM_RESPONSE_TYPE_ACK) {
+      ++failures;
+      continue;
+    }
+    total += elapsed;
+    if (elapsed < min) min = elapsed;
+    if (elapsed > max) max = elapsed;
+  }
+  const int successes = REQUEST_COUNT - failures;
+  print_result("rdm_request", "avg", successes ? total / successes : 0, "us");
+  print_result("rdm_request", "min", successes ? min : 0, "us");
+  print_result("rdm_request", "max", max, "us");
+  print_result("rdm_request", "failures", failures, "requests");
+}
+
+static void on_found(dmx_port_t dmx_num, rdm_uid_t uid, int num_found,
+                     const rdm_disc_mute_t *mute, void *context) {
+  // The number of devices found is returned by rdm_discover_with_callback()
+}
+
+static void benchmark_discovery(int responder_count) {
+  responder_is_enabled = responder_count > 0;
+  char parameter[16];
+  snprintf(parameter, sizeof(parameter), "responders_%i", responder_count);
+  int64_t total = 0;
+  int found = 0;
+  for (int i = 0; i < DISCOVERY_COUNT; ++i) {
+    const int64_t start = esp_timer_get_time();
+    found = rdm_discover_with_callback(controller_num, on_found, NULL);
+    total += esp_timer_get_time() - start;
+  }
+  print_result("discovery", parameter, total / DISCOVERY_COUNT, "us");
+  print_result("discovery_found", parameter, found, "devices");
+}
+
+static void benchmark_encode() {
+  // Encode a typical RDM_PID_DEVICE_INFO response into the driver buffer
+  const rdm_device_info_t device_info = {.model_id = 1,
+                                         .product_category = 0x0100,
+                                         .software_version_id = 1,
+                                         .footprint = 1,
+                                         .personality = {1, 1},
+                                         .dmx_start_address = 1,
+                                         .sub_device_count = 0,
+                                         .sensor_count = 0};
+  const size_t pdl = 19;
+  const rdm_header_t header = {.message_len = 24 + pdl,
+                               .dest_uid = {0x05e0, 1},
+                               .src_uid = *rdm_uid_get(controller_num),
+                               .tn = 0,
+                               .response_type = RDM_RESPONSE_TYPE_ACK,
+                               .message_count = 0,
+                               .sub_device = RDM_SUB_DEVICE_ROOT,
+                               .cc = RDM_CC_GET_COMMAND_RESPONSE,
+                               .pid = RDM_PID_DEVICE_INFO,
+                               .pdl = pdl};
+  const char *format = "x01x00wwdwbbwwb$";
+  size_t written = 0;
+  const int64_t start = esp_timer_get_time();
+  for (int i = 0; i < ENCODE_COUNT; ++i) {
+    written += rdm_write(controller_num, &header, format, &device_info);
+  }
+  const int64_t elapsed = esp_timer_get_time() - start;
+  print_result("rdm_encode", "device_info", elapsed * 1000 / ENCODE_COUNT,
+               "ns");
+  print_result("rdm_encode", "throughput", written * 1000000 / elapsed,
+               "bytes_per_second");
+}
+
+static void print_stats(dmx_port_t dmx_num, const char *name) {
+  dmx_stats_t stats;
+  if (!dmx_get_stats(dmx_num, &stats)) {
+    return;
+  }
+  char parameter[32];
+  snprintf(parameter, sizeof(parameter), "%s_rx_packets", name);
+  print_result("stats", parameter, stats.rx_packets, "packets");
+  snprintf(parameter, sizeof(parameter), "%s_tx_packets", name);
+  print_result("stats", parameter, stats.tx_packets, "packets");
+  snprintf(parameter, sizeof(parameter), "%s_uart_isr_max", name);
+  print_result("stats", parameter, stats.uart_isr_max_us, "us");
+  snprintf(parameter, sizeof(parameter), "%s_timer_isr_max", name);
+  print_result("stats", parameter, stats.timer_isr_max_us, "us");
+  snprintf(parameter, sizeof(parameter), "%s_turnaround_min", name);
+  print_result("stats", parameter, stats.turnaround.min_us, "us");
+  snprintf(parameter, sizeof(parameter), "%s_turnaround_max", name);
+  print_result("stats", parameter, stats.turnaround.max_us, "us");
+}
+
+void app_main() {
+  dmx_config_t config = DMX_CONFIG_DEFAULT;
+  dmx_driver_install(controller_num, &config, NULL, 0);
+  dmx_set_pin(controller_num, TX_PIN, RX_PIN, EN_PIN);
+  dmx_personality_t personalities[] = {{1, "Default Personality"}};
+  dmx_driver_install(responder_num, &config, personalities, 1);
+  dmx_set_pin(responder_num, RESPONDER_TX_PIN, RESPONDER_RX_PIN,
+              RESPONDER_EN_PIN);
+
+  // Measure the idle time of this core before the DMX driver is busy
+  const BaseType_t core_id = xPortGetCoreID();
+  xTaskCreatePinnedToCore(idle_task, "idle_count", 2048, NULL,
+                          tskIDLE_PRIORITY, NULL, core_id);
+  xTaskCreatePinnedToCore(responder_task, "responder", 4096, NULL,
+                          uxTaskPriorityGet(NULL), NULL, core_id);
+  int64_t baseline_elapsed;
+  const uint32_t baseline = measure_idle_count(&baseline_elapsed);
+
+  ESP_LOGI(TAG, "Starting benchmarks");
+  benchmark_frame_rate(baseline, baseline_elapsed);
+  benchmark_rdm_request(rdm_uid_get(responder_num));
+  benchmark_discovery(0);
+  benchmark_discovery(1);
+  benchmark_encode();
+  print_stats(controller_num, "controller");
+  print_stats(responder_num, "responder");
+  ESP_LOGI(TAG, "Benchmarks complete");
+}
@@ -15,6 +15,7 @@
   https://github.com/someweisguy/esp_dmx
 
 */
+#include "dmx/trace.h"
 #include "esp_dmx.h"
 #include "esp_log.h"
 #include "esp_system.h"
@@ -61,6 +62,17 @@ void app_main() {
         ESP_LOGI(TAG, "Start code: %02x, Size: %i, Packets/second: %i",
                  packet.sc, packet.size, packet_count);
         ESP_LOG_BUFFER_HEX(TAG, data, 16);  // Log first 16 bytes
+#ifdef CONFIG_DMX_TRACE_ENABLE
+        // Log how long it took the driver to hand over recent packets
+        dmx_trace_latency_t latency;
+        if (dmx_trace_get_latency(dmx_num, DMX_TRACE_STAGE_BREAK,
+                                  DMX_TRACE_STAGE_LATCHED, &latency) &&
+            latency.count > 0) {
+          ESP_LOGI(TAG, "Break to dmx_receive() us: p50 %lu, p99 %lu, max %lu",
+                   (unsigned long)latency.p50, (unsigned long)latency.p99,
+                   (unsigned long)latency.max);
+        }
+#endif
         last_update = now;
         packet_count = 0;
       }
@@ -0,0 +1,327 @@
+/*
+
+  ESP-IDF Virtual Bus
+
+  This example emulates a DMX bus with many RDM responders so that RDM
+  discovery and polling can be measured at a realistic scale without wiring
+  hundreds of fixtures. Two DMX ports are looped back onto the same DMX bus:
+  DMX_NUM_1 runs the RDM controller and DMX_NUM_2 answers on behalf of every
+  virtual responder. Connect the A and B lines of the two DMX transceivers to
+  each other.
+
+  Each virtual responder has its own UID, mute flag, and identify parameter.
+  When more than one unmuted virtual responder falls within the bounds of an
+  RDM_PID_DISC_UNIQUE_BRANCH request, the responses collide. A collision is
+  modeled as the bitwise OR of the colliding responses, including their
+  checksums, so the RDM controller receives a response with an invalid
+  checksum and must continue branching, the same as it would on a physical
+  bus.
+
+  The example measures the time taken by RDM discovery, the number of devices
+  found, and the throughput of polling every discovered device. Results are
+  printed in the same comma-separated format as the ESP-IDF Benchmark example:
+
+    BENCH,<benchmark>,<parameter>,<value>,<unit>
+
+  CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR must be disabled so that DMX_NUM_2
+  does not answer RDM discovery with its own UID.
+
+  Note: this example is for use with the ESP-IDF. It will not work on Arduino!
+
+  https://github.com/someweisguy/esp_dmx
+
+*/
+#include <stdio.h>
+
+#include "esp_dmx.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/task.h"
+#include "rdm/controller.h"
+#include "rdm/include/driver.h"
+#include "rdm/include/uid.h"
+
+#define TX_PIN 17  // The DMX transmit pin of the controller port.
+#define RX_PIN 16  // The DMX receive pin of the controller port.
+#define EN_PIN 21  // The DMX transmit enable pin of the controller port.
+
+#define RESPONDER_TX_PIN 4   // The DMX transmit pin of the responder port.
+#define RESPONDER_RX_PIN 5   // The DMX receive pin of the responder port.
+#define RESPONDER_EN_PIN 19  // The DMX transmit enable pin of the responder.
+
+#define VIRTUAL_RESPONDER_COUNT 100  // The number of emulated responders.
+#define VIRTUAL_UID_SEED 0x12345678  // The seed used to generate device IDs.
+#define DISCOVERY_COUNT 3            // The number of times to run discovery.
+#define POLL_ROUNDS 5                // The number of times to poll each device.
+
+static const char *TAG = "main";
+
+static const dmx_port_t controller_num = DMX_NUM_1;
+static const dmx_port_t responder_num = DMX_NUM_2;
+
+static struct virtual_responder_t {
+  rdm_uid_t uid;     // The UID of the virtual responder.
+  bool is_muted;     // True if the responder has been muted by discovery.
+  uint8_t identify;  // The value of RDM_PID_IDENTIFY_DEVICE.
+  bool is_found;     // True if discovery has found this responder.
+} responders[VIRTUAL_RESPONDER_COUNT];
+
+static volatile uint32_t collisions = 0;
+
+static void print_result(const char *benchmark, const char *parameter,
+                         int64_t value, const char *unit) {
+  printf("BENCH,%s,%s,%lli,%s\n", benchmark, parameter, value, unit);
+}
+
+static void virtual_bus_init() {
+  // Use a fixed pseudo-random sequence so that results are repeatable
+  uint32_t seed = VIRTUAL_UID_SEED;
+  const uint16_t man_id = rdm_uid_get(responder_num)->man_id;
+  for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+    bool is_unique;
+    do {
+      seed = seed * 1664525 + 1013904223;
+      responders[i].uid = (rdm_uid_t){man_id, seed};
+      is_unique = true;
+      for (int j = 0; j < i; ++j) {
+        if (rdm_uid_is_eq(&responders[i].uid, &responders[j].uid)) {
+          is_unique = false;
+          break;
+        }
+      }
+    } while (!is_unique);
+    responders[i].is_muted = false;
+    responders[i].identify = 0;
+  }
+}
+
+static bool virtual_write(const rdm_header_t *request, const rdm_uid_t *uid,
+                          const char *format, const void *pd, size_t pdl) {
+  const rdm_header_t header = {.message_len = 24 + pdl,
+                               .dest_uid = request->src_uid,
+                               .src_uid = *uid,
+                               .tn = request->tn,
+                               .response_type = RDM_RESPONSE_TYPE_ACK,
+                               .message_count = 0,
+                               .sub_device = request->sub_device,
+                               .cc = request->cc + 1,
+                               .pid = request->pid,
+                               .pdl = pdl};
+  return rdm_write(responder_num, &header, format, pd) > 0;
+}
+
+static void virtual_respond(const rdm_header_t *request, const rdm_uid_t *uid,
+                            const char *format, const void *pd, size_t pdl) {
+  if (virtual_write(request, uid, format, pd, pdl)) {
+    dmx_send(responder_num);
+  }
+}
+
+static uint16_t virtual_disc_checksum(const rdm_uid_t *uid) {
+  // Each byte of the UID is encoded as (byte | 0xaa) and (byte | 0x55)
+  const uint8_t bytes[6] = {uid->man_id >> 8, uid->man_id,
+                            uid->dev_id >> 24, uid->dev_id >> 16,
+                            uid->dev_id >> 8, uid->dev_id};
+  uint16_t checksum = 0;
+  for (int i = 0; i < 6; ++i) {
+    checksum += bytes[i] + (0xaa | 0x55);
+  }
+  return checksum;
+}
+
+static void virtual_disc_unique_branch(const rdm_header_t *request) {
+  rdm_disc_unique_branch_t branch;
+  if (rdm_read_pd(responder_num, "uu$", &branch, sizeof(branch)) !=
+      sizeof(branch)) {
+    return;
+  }
+
+  // Combine the UIDs and checksums of every unmuted responder in the branch
+  rdm_uid_t uid = {0, 0};
+  uint16_t checksum = 0;
+  int count = 0;
+  for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+    const rdm_uid_t *responder_uid = &responders[i].uid;
+    if (!responders[i].is_muted &&
+        rdm_uid_is_ge(responder_uid, &branch.lower_bound) &&
+        rdm_uid_is_le(responder_uid, &branch.upper_bound)) {
+      uid.man_id |= responder_uid->man_id;
+      uid.dev_id |= responder_uid->dev_id;
+      checksum |= virtual_disc_checksum(responder_uid);
+      ++count;
+    }
+  }
+  if (count == 0) {
+    return;  // No responders are in this branch
+  } else if (!virtual_write(request, &uid, NULL, NULL, 0)) {
+    return;
+  }
+
+  if (count > 1) {
+    // Ensure that the combined checksum does not match the combined UID
+    if (checksum == virtual_disc_checksum(&uid)) {
+      checksum ^= 0x0001;
+    }
+
+    // Overwrite the encoded checksum which follows the preamble and EUID
+    const uint8_t encoded[4] = {(checksum >> 8) | 0xaa, (checksum >> 8) | 0x55,
+                                (checksum & 0xff) | 0xaa,
+                                (checksum & 0xff) | 0x55};
+    dmx_write_offset(responder_num, 7 + 1 + 12, encoded, sizeof(encoded));
+    ++collisions;
+  }
+
+  // Send with the discovery response size so that no DMX break is sent
+  dmx_send_num(responder_num, RDM_DISC_RESPONSE_SIZE_MAX);
+}
+
+static void virtual_disc_mute(const rdm_header_t *request, bool mute) {
+  for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+    if (!rdm_uid_is_target(&responders[i].uid, &request->dest_uid)) {
+      continue;
+    }
+    responders[i].is_muted = mute;
+    if (!rdm_uid_is_broadcast(&request->dest_uid)) {
+      const rdm_disc_mute_t params = {};
+      virtual_respond(request, &responders[i].uid, "wv", &params,
+                      sizeof(uint16_t));
+      return;
+    }
+  }
+}
+
+static void virtual_identify_device(const rdm_header_t *request) {
+  for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+    if (!rdm_uid_is_target(&responders[i].uid, &request->dest_uid)) {
+      continue;
+    }
+    if (request->cc == RDM_CC_SET_COMMAND) {
+      rdm_read_pd(responder_num, "b$", &responders[i].identify,
+                  sizeof(uint8_t));
+    }
+    if (!rdm_uid_is_broadcast(&request->dest_uid)) {
+      const uint8_t *pd = &responders[i].identify;
+      const size_t pdl = request->cc == RDM_CC_GET_COMMAND ? 1 : 0;
+      virtual_respond(request, &responders[i].uid, "b$", pd, pdl);
+      return;
+    }
+  }
+}
+
+static void virtual_bus_task(void *arg) {
+  dmx_packet_t packet;
+  while (true) {
+    rdm_header_t header;
+    if (!dmx_receive(responder_num, &packet, DMX_TIMEOUT_TICK) ||
+        !packet.is_rdm || !rdm_read_header(responder_num, &header) ||
+        !rdm_cc_is_request(header.cc)) {
+      continue;
+    }
+
+    if (header.cc == RDM_CC_DISC_COMMAND) {
+      if (header.pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+        virtual_disc_unique_branch(&header);
+      } else if (header.pid == RDM_PID_DISC_MUTE) {
+        virtual_disc_mute(&header, true);
+      } else if (header.pid == RDM_PID_DISC_UN_MUTE) {
+        virtual_disc_mute(&header, false);
+      }
+    } else if (header.pid == RDM_PID_IDENTIFY_DEVICE) {
+      virtual_identify_device(&header);
+    }
+  }
+}
+
+static void on_found(dmx_port_t dmx_num, rdm_uid_t uid, int num_found,
+                     const rdm_disc_mute_t *mute, void *context) {
+  for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+    if (rdm_uid_is_eq(&responders[i].uid, &uid)) {
+      responders[i].is_found = true;
+      break;
+    }
+  }
+}
+
+static void benchmark_discovery() {
+  char parameter[16];
+  snprintf(parameter, sizeof(parameter), "responders_%i",
+           VIRTUAL_RESPONDER_COUNT);
+  for (int n = 0; n < DISCOVERY_COUNT; ++n) {
+    for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+      responders[i].is_found = false;
+    }
+    collisions = 0;
+    dmx_reset_stats(controller_num);
+
+    const int64_t start = esp_timer_get_time();
+    const int found = rdm_discover_with_callback(controller_num, on_found,
+                                                 NULL);
+    const int64_t elapsed = esp_timer_get_time() - start;
+
+    int missing = 0;
+    for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+      if (!responders[i].is_found) {
+        ++missing;
+      }
+    }
+    dmx_stats_t stats;
+    dmx_get_stats(controller_num, &stats);
+
+    print_result("virtual_discovery", parameter, elapsed, "us");
+    print_result("virtual_discovery_found", parameter, found, "devices");
+    print_result("virtual_discovery_missing", parameter, missing, "devices");
+    print_result("virtual_discovery_collisions", parameter, collisions,
+                 "responses");
+    print_result("virtual_discovery_requests", parameter, stats.tx_packets,
+                 "packets");
+  }
+}
+
+static void benchmark_polling() {
+  int polls = 0;
+  int failures = 0;
+  const int64_t start = esp_timer_get_time();
+  for (int n = 0; n < POLL_ROUNDS; ++n) {
+    for (int i = 0; i < VIRTUAL_RESPONDER_COUNT; ++i) {
+      if (!responders[i].is_found) {
+        continue;
+      }
+      bool identify;
+      rdm_ack_t ack;
+      rdm_send_get_identify_device(controller_num, &responders[i].uid,
+                                   RDM_SUB_DEVICE_ROOT, &identify, &ack);
+      if (ack.type != RDM_RESPONSE_TYPE_ACK) {
+        ++failures;
+      }
+      ++polls;
+    }
+  }
+  const int64_t elapsed = esp_timer_get_time() - start;
+
+  print_result("virtual_polling", "requests", polls, "requests");
+  print_result("virtual_polling", "failures", failures, "requests");
+  print_result("virtual_polling", "throughput",
+               elapsed > 0 ? polls * 1000000LL / elapsed : 0,
+               "requests_per_second");
+}
+
+void app_main() {
+  dmx_config_t config = DMX_CONFIG_DEFAULT;
+  dmx_driver_install(controller_num, &config, NULL, 0);
+  dmx_set_pin(controller_num, TX_PIN, RX_PIN, EN_PIN);
+  dmx_personality_t personalities[] = {{1, "Default Personality"}};
+  dmx_driver_install(responder_num, &config, personalities, 1);
+  dmx_set_pin(responder_num, RESPONDER_TX_PIN, RESPONDER_RX_PIN,
+              RESPONDER_EN_PIN);
+
+  // The virtual bus must respond faster than the controller sends requests
+  virtual_bus_init();
+  xTaskCreatePinnedToCore(virtual_bus_task, "virtual_bus", 4096, NULL,
+                          uxTaskPriorityGet(NULL) + 1, NULL, xPortGetCoreID());
+
+  ESP_LOGI(TAG, "Starting virtual bus with %i responders",
+           VIRTUAL_RESPONDER_COUNT);
+  benchmark_discovery();
+  benchmark_polling();
+  ESP_LOGI(TAG, "Virtual bus complete");
+}
@@ -0,0 +1,423 @@
+#include "dmx/bridge.h"
+
+#include <string.h>
+
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "lwip/api.h"
+#include "lwip/pbuf.h"
+
+enum {
+  DMX_BRIDGE_TASK_STACK_SIZE = 3584,  // The bridge task stack in bytes.
+  DMX_BRIDGE_RECV_TIMEOUT_MS = 100,  // Polls whether the bridge should stop.
+  DMX_BRIDGE_HEADER_SIZE_MAX = 126,  // The largest header which is parsed.
+};
+
+// Art-Net packet layout
+enum {
+  DMX_ARTNET_OP_DMX = 0x5000,   // The OpCode of ArtDmx packets.
+  DMX_ARTNET_OP_SYNC = 0x5200,  // The OpCode of ArtSync packets.
+  DMX_ARTNET_SYNC_SIZE = 14,    // The size of an ArtSync packet.
+  DMX_ARTNET_DMX_HEADER_SIZE = 18,  // The size of the ArtDmx header.
+};
+
+// sACN packet layout
+enum {
+  DMX_SACN_VECTOR_ROOT_DATA = 0x00000004,      // E1.31 data packets.
+  DMX_SACN_VECTOR_ROOT_EXTENDED = 0x00000008,  // E1.31 extended packets.
+  DMX_SACN_VECTOR_FRAME_DATA = 0x00000002,     // E1.31 data framing layer.
+  DMX_SACN_VECTOR_FRAME_SYNC = 0x00000001,     // E1.31 sync framing layer.
+  DMX_SACN_OPTION_PREVIEW = 0x80,     // Data is not intended for live output.
+  DMX_SACN_OPTION_TERMINATED = 0x40,  // The source has stopped sending data.
+  DMX_SACN_SYNC_SIZE = 49,            // The size of a synchronization packet.
+  DMX_SACN_DATA_HEADER_SIZE = 126,    // The size of the data packet header.
+};
+
+static const uint8_t dmx_artnet_id[8] = "Art-Net";
+static const uint8_t dmx_sacn_id[12] = "ASC-E1.17";
+
+typedef struct dmx_bridge_t {
+  SemaphoreHandle_t stopped;  // Is given by the bridge task when it stops.
+  portMUX_TYPE spinlock;      // Guards the statistics of the bridge.
+  struct netconn *conn;       // The UDP connection which receives packets.
+  dmx_bridge_protocol_t protocol;  // The network protocol which is received.
+  bool is_grouped;  // True if the DMX ports are sent by the DMX sync group.
+  volatile bool is_running;  // False when the bridge task should stop.
+  int64_t last_sync_ts;  // The timestamp of the last sync packet, or 0.
+  uint16_t sync_address;  // The sACN sync universe which has been joined.
+  dmx_bridge_stats_t stats;  // The statistics of the received packets.
+  int num_universes;         // The number of mapped universes.
+  struct dmx_bridge_port_t {
+    dmx_port_t dmx_num;  // The DMX port on which the universe is sent.
+    uint16_t universe;   // The network universe of the DMX port.
+    bool has_sequence;   // True if a sequenced packet has been received.
+    uint8_t sequence;    // The sequence number of the last packet.
+  } ports[DMX_NUM_MAX];
+} dmx_bridge_t;
+
+static dmx_bridge_t *dmx_bridge_context = NULL;
+
+static inline uint16_t dmx_bridge_get_u16(const uint8_t *data) {
+  return (data[0] << 8) | data[1];
+}
+
+static inline uint32_t dmx_bridge_get_u32(const uint8_t *data) {
+  return ((uint32_t)dmx_bridge_get_u16(data) << 16) |
+         dmx_bridge_get_u16(data + 2);
+}
+
+static void dmx_bridge_count(dmx_bridge_t *bridge, uint32_t *counter) {
+  taskENTER_CRITICAL(&bridge->spinlock);
+  ++*counter;
+  taskEXIT_CRITICAL(&bridge->spinlock);
+}
+
+static struct dmx_bridge_port_t *dmx_bridge_find(dmx_bridge_t *bridge,
+                                                 uint16_t universe) {
+  for (int i = 0; i < bridge->num_universes; ++i) {
+    if (bridge->ports[i].universe == universe) {
+      return &bridge->ports[i];
+    }
+  }
+  return NULL;
+}
+
+static bool dmx_bridge_is_synced(dmx_bridge_t *bridge, int64_t now) {
+  // Return to latching data packets immediately once sync packets stop
+  if (bridge->last_sync_ts > 0 &&
+      now - bridge->last_sync_ts > DMX_BRIDGE_SYNC_TIMEOUT_US) {
+    bridge->last_sync_ts = 0;
+  }
+  return bridge->is_grouped && bridge->last_sync_ts > 0;
+}
+
+static void dmx_bridge_sync(dmx_bridge_t *bridge, int64_t now) {
+  bridge->last_sync_ts = now;
+  if (bridge->is_grouped) {
+    dmx_sync_group_commit();
+  }
+  dmx_bridge_count(bridge, &bridge->stats.syncs);
+}
+
+static bool dmx_bridge_write(dmx_bridge_t *bridge,
+                             struct dmx_bridge_port_t *port, struct pbuf *p,
+                             uint16_t offset, uint16_t size, int sequence) {
+  if (!dmx_driver_is_installed(port->dmx_num)) {
+    return false;
+  }
+
+  // Discard packets which arrive out of order, as detailed in ANSI E1.31
+  if (sequence >= 0) {
+    const int8_t diff = (int8_t)(sequence - port->sequence);
+    if (port->has_sequence && diff <= 0 && diff > -20) {
+      return false;
+    }
+    port->sequence = sequence;
+    port->has_sequence = true;
+  }
+  if (size > DMX_PACKET_SIZE_MAX - 1) {
+    size = DMX_PACKET_SIZE_MAX - 1;
+  }
+
+  // Gather the slots from the packet buffer before entering the spinlock
+  uint8_t slots[DMX_PACKET_SIZE_MAX];
+  slots[0] = DMX_SC;
+  size = pbuf_copy_partial(p, slots + 1, size, offset);
+
+  uint8_t *const data = dmx_write_begin(port->dmx_num);
+  if (data == NULL) {
+    return false;
+  }
+  memcpy(data, slots, size + 1);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(port->dmx_num));
+  dmx_bridge_count(bridge, &bridge->stats.packets);
+
+  return true;
+}
+
+static bool dmx_bridge_handle_artnet(dmx_bridge_t *bridge, struct pbuf *p,
+                                     const uint8_t *header, size_t size,
+                                     int64_t now) {
+  if (size < DMX_ARTNET_SYNC_SIZE ||
+      memcmp(header, dmx_artnet_id, sizeof(dmx_artnet_id)) != 0) {
+    return false;
+  }
+
+  const uint16_t op_code = header[8] | (header[9] << 8);
+  if (op_code == DMX_ARTNET_OP_SYNC) {
+    dmx_bridge_sync(bridge, now);
+    return true;
+  } else if (op_code != DMX_ARTNET_OP_DMX ||
+             size < DMX_ARTNET_DMX_HEADER_SIZE) {
+    return false;
+  }
+
+  // Find the DMX port of the port-address
+  const uint16_t universe = ((header[15] & 0x7f) << 8) | header[14];
+  struct dmx_bridge_port_t *const port = dmx_bridge_find(bridge, universe);
+  if (port == NULL) {
+    return false;
+  }
+  const uint16_t length = dmx_bridge_get_u16(&header[16]);
+  if (length > p->tot_len - DMX_ARTNET_DMX_HEADER_SIZE) {
+    return false;
+  }
+
+  // A sequence number of 0 disables sequencing
+  const int sequence = header[12] != 0 ? header[12] : -1;
+  if (!dmx_bridge_write(bridge, port, p, DMX_ARTNET_DMX_HEADER_SIZE, length,
+                        sequence)) {
+    return false;
+  }
+  if (bridge->is_grouped && !dmx_bridge_is_synced(bridge, now)) {
+    dmx_sync_group_commit();
+  }
+
+  return true;
+}
+
+static bool dmx_bridge_handle_sacn(dmx_bridge_t *bridge, struct pbuf *p,
+                                   const uint8_t *header, size_t size,
+                                   int64_t now) {
+  if (size < DMX_SACN_SYNC_SIZE || dmx_bridge_get_u16(&header[0]) != 0x0010 ||
+      memcmp(&header[4], dmx_sacn_id, sizeof(dmx_sacn_id)) != 0) {
+    return false;
+  }
+
+  const uint32_t root_vector = dmx_bridge_get_u32(&header[18]);
+  const uint32_t frame_vector = dmx_bridge_get_u32(&header[40]);
+  if (root_vector == DMX_SACN_VECTOR_ROOT_EXTENDED &&
+      frame_vector == DMX_SACN_VECTOR_FRAME_SYNC) {
+    if (dmx_bridge_get_u16(&header[45]) != bridge->sync_address) {
+      return false;
+    }
+    dmx_bridge_sync(bridge, now);
+    return true;
+  } else if (root_vector != DMX_SACN_VECTOR_ROOT_DATA ||
+             frame_vector != DMX_SACN_VECTOR_FRAME_DATA ||
+             size < DMX_SACN_DATA_HEADER_SIZE) {
+    return false;
+  }
+
+  // Only accept live null start code packets with a single range of slots
+  const uint8_t options = header[112];
+  if ((options & (DMX_SACN_OPTION_PREVIEW | DMX_SACN_OPTION_TERMINATED)) ||
+      header[117] != 0x02 || header[118] != 0xa1 ||
+      dmx_bridge_get_u16(&header[119]) != 0 ||
+      dmx_bridge_get_u16(&header[121]) != 1 || header[125] != DMX_SC) {
+    return false;
+  }
+  const uint16_t universe = dmx_bridge_get_u16(&header[113]);
+  struct dmx_bridge_port_t *const port = dmx_bridge_find(bridge, universe);
+  if (port == NULL) {
+    return false;
+  }
+  const uint16_t count = dmx_bridge_get_u16(&header[123]);
+  if (count == 0 || count > p->tot_len - DMX_SACN_DATA_HEADER_SIZE + 1) {
+    return false;
+  }
+
+  // Join the multicast group of the sync universe of the source
+  const uint16_t sync_address = dmx_bridge_get_u16(&header[109]);
+  if (sync_address != 0 && sync_address != bridge->sync_address) {
+    ip_addr_t group;
+    IP_ADDR4(&group, 239, 255, sync_address >> 8, sync_address & 0xff);
+    netconn_join_leave_group(bridge->conn, &group, IP4_ADDR_ANY, NETCONN_JOIN);
+    bridge->sync_address = sync_address;
+  }
+
+  if (!dmx_bridge_write(bridge, port, p, DMX_SACN_DATA_HEADER_SIZE, count - 1,
+                        header[111])) {
+    return false;
+  }
+  if (bridge->is_grouped &&
+      (sync_address == 0 || !dmx_bridge_is_synced(bridge, now))) {
+    dmx_sync_group_commit();
+  }
+
+  return true;
+}
+
+static void dmx_bridge_task(void *arg) {
+  dmx_bridge_t *const bridge = arg;
+
+  while (bridge->is_running) {
+    struct netbuf *buf;
+    if (netconn_recv(bridge->conn, &buf) != ERR_OK) {
+      continue;  // Timed out, check if the bridge should stop
+    }
+
+    // Copy only the header so that it may be parsed contiguously
+    struct pbuf *const p = buf->p;
+    uint8_t header[DMX_BRIDGE_HEADER_SIZE_MAX];
+    const size_t size = pbuf_copy_partial(p, header, sizeof(header), 0);
+    const int64_t now = esp_timer_get_time();
+    const bool is_handled =
+        bridge->protocol == DMX_BRIDGE_ARTNET
+            ? dmx_bridge_handle_artnet(bridge, p, header, size, now)
+            : dmx_bridge_handle_sacn(bridge, p, header, size, now);
+    netbuf_delete(buf);
+
+    if (!is_handled) {
+      dmx_bridge_count(bridge, &bridge->stats.dropped);
+    }
+  }
+
+  xSemaphoreGive(bridge->stopped);
+  vTaskDelete(NULL);
+}
+
+static void dmx_bridge_output_stop(dmx_bridge_t *bridge) {
+  if (bridge->is_grouped) {
+    dmx_sync_group_disable();
+  } else {
+    dmx_auto_refresh_disable(bridge->ports[0].dmx_num);
+  }
+}
+
+bool dmx_bridge_start(dmx_bridge_protocol_t protocol,
+                      const dmx_bridge_universe_t *universes,
+                      int num_universes, uint32_t refresh_rate) {
+  DMX_CHECK(protocol == DMX_BRIDGE_ARTNET || protocol == DMX_BRIDGE_SACN,
+            false, "protocol error");
+  DMX_CHECK(universes != NULL, false, "universes is null");
+  DMX_CHECK(num_universes > 0 && num_universes <= DMX_NUM_MAX, false,
+            "num_universes error");
+  DMX_CHECK(refresh_rate > 0, false, "refresh_rate error");
+  DMX_CHECK(!dmx_bridge_is_running(), false, "bridge is already running");
+  for (int i = 0; i < num_universes; ++i) {
+    const uint16_t universe = universes[i].universe;
+    DMX_CHECK(universes[i].dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+    DMX_CHECK(dmx_driver_is_installed(universes[i].dmx_num), false,
+              "driver is not installed");
+    DMX_CHECK(protocol == DMX_BRIDGE_ARTNET ? universe <= 0x7fff
+                                            : universe > 0 && universe < 64000,
+              false, "universe error");
+    for (int j = 0; j < i; ++j) {
+      DMX_CHECK(universes[i].dmx_num != universes[j].dmx_num, false,
+                "dmx_num is repeated");
+    }
+  }
+
+  // Allocate the bridge
+  dmx_bridge_t *const bridge =
+      heap_caps_malloc(sizeof(*bridge), MALLOC_CAP_8BIT);
+  DMX_CHECK(bridge != NULL, false, "bridge malloc error");
+  memset(bridge, 0, sizeof(*bridge));
+  bridge->stopped = xSemaphoreCreateBinary();
+  if (bridge->stopped == NULL) {
+    heap_caps_free(bridge);
+    DMX_CHECK(false, false, "bridge semaphore malloc error");
+  }
+  portMUX_INITIALIZE(&bridge->spinlock);
+  bridge->protocol = protocol;
+  bridge->is_grouped = num_universes > 1;
+  bridge->is_running = true;
+  bridge->num_universes = num_universes;
+  dmx_port_t dmx_nums[DMX_NUM_MAX];
+  for (int i = 0; i < num_universes; ++i) {
+    bridge->ports[i].dmx_num = universes[i].dmx_num;
+    bridge->ports[i].universe = universes[i].universe;
+    dmx_nums[i] = universes[i].dmx_num;
+  }
+
+  // Send a single DMX port with auto-refresh and several with the sync group
+  const bool is_started =
+      bridge->is_grouped
+          ? dmx_sync_group_enable(dmx_nums, num_universes, refresh_rate,
+                                  DMX_PACKET_SIZE_MAX)
+          : dmx_auto_refresh_enable(dmx_nums[0], refresh_rate,
+                                    DMX_PACKET_SIZE_MAX);
+  if (!is_started) {
+    vSemaphoreDelete(bridge->stopped);
+    heap_caps_free(bridge);
+    return false;
+  }
+
+  // Open the UDP connection and join the multicast group of each universe
+  const uint16_t udp_port = protocol == DMX_BRIDGE_ARTNET
+                                ? DMX_BRIDGE_ARTNET_PORT
+                                : DMX_BRIDGE_SACN_PORT;
+  bridge->conn = netconn_new(NETCONN_UDP);
+  if (bridge->conn == NULL ||
+      netconn_bind(bridge->conn, IP4_ADDR_ANY, udp_port) != ERR_OK) {
+    if (bridge->conn != NULL) {
+      netconn_delete(bridge->conn);
+    }
+    dmx_bridge_output_stop(bridge);
+    vSemaphoreDelete(bridge->stopped);
+    heap_caps_free(bridge);
+    DMX_CHECK(false, false, "bridge connection error");
+  }
+  netconn_set_recvtimeout(bridge->conn, DMX_BRIDGE_RECV_TIMEOUT_MS);
+  if (protocol == DMX_BRIDGE_SACN) {
+    for (int i = 0; i < num_universes; ++i) {
+      const uint16_t universe = universes[i].universe;
+      ip_addr_t group;
+      IP_ADDR4(&group, 239, 255, universe >> 8, universe & 0xff);
+      netconn_join_leave_group(bridge->conn, &group, IP4_ADDR_ANY,
+                               NETCONN_JOIN);
+    }
+  }
+
+  dmx_bridge_context = bridge;
+  if (!xTaskCreate(dmx_bridge_task, "dmx_bridge", DMX_BRIDGE_TASK_STACK_SIZE,
+                   bridge, uxTaskPriorityGet(NULL), NULL)) {
+    dmx_bridge_context = NULL;
+    netconn_delete(bridge->conn);
+    dmx_bridge_output_stop(bridge);
+    vSemaphoreDelete(bridge->stopped);
+    heap_caps_free(bridge);
+    DMX_CHECK(false, false, "bridge task create error");
+  }
+
+  return true;
+}
+
+bool dmx_bridge_stop() {
+  DMX_CHECK(dmx_bridge_is_running(), false, "bridge is not running");
+
+  dmx_bridge_t *const bridge = dmx_bridge_context;
+  dmx_bridge_context = NULL;
+
+  // Wait for the bridge task to finish handling its current packet
+  bridge->is_running = false;
+  xSemaphoreTake(bridge->stopped, portMAX_DELAY);
+
+  netconn_delete(bridge->conn);
+  dmx_bridge_output_stop(bridge);
+  vSemaphoreDelete(bridge->stopped);
+  heap_caps_free(bridge);
+
+  return true;
+}
+
+bool dmx_bridge_is_running() { return dmx_bridge_context != NULL; }
+
+bool dmx_bridge_has_port(dmx_port_t dmx_num) {
+  const dmx_bridge_t *const bridge = dmx_bridge_context;
+  if (bridge == NULL) {
+    return false;
+  }
+  for (int i = 0; i < bridge->num_universes; ++i) {
+    if (bridge->ports[i].dmx_num == dmx_num) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool dmx_bridge_get_stats(dmx_bridge_stats_t *stats) {
+  DMX_CHECK(stats != NULL, false, "stats is null");
+  DMX_CHECK(dmx_bridge_is_running(), false, "bridge is not running");
+
+  dmx_bridge_t *const bridge = dmx_bridge_context;
+  taskENTER_CRITICAL(&bridge->spinlock);
+  *stats = bridge->stats;
+  taskEXIT_CRITICAL(&bridge->spinlock);
+
+  return true;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file dmx/bridge.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the DMX network bridge. The bridge receives
+ * Art-Net or sACN (ANSI E1.31) packets with lwIP and sends their slots on the
+ * DMX ports to which their universes are mapped. The slots are copied from the
+ * lwIP packet buffers directly into the shadow buffers of the DMX ports, so no
+ * intermediate copies of the DMX data are made. The bridge is only available
+ * when CONFIG_DMX_BRIDGE_ENABLE is set.
+ */
+#pragma once
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The UDP port on which Art-Net packets are received.*/
+#define DMX_BRIDGE_ARTNET_PORT (6454)
+
+/** @brief The UDP port on which sACN packets are received.*/
+#define DMX_BRIDGE_SACN_PORT (5568)
+
+/** @brief The length of time in microseconds after the last synchronization
+ * packet after which data packets are latched as soon as they are received.*/
+#define DMX_BRIDGE_SYNC_TIMEOUT_US (4000000)
+
+/** @brief The network protocols which may be received by the DMX network
+ * bridge.*/
+typedef enum dmx_bridge_protocol_t {
+  /** @brief Art-Net. Universes are 15-bit Art-Net port-addresses. ArtDmx and
+     ArtSync packets are received.*/
+  DMX_BRIDGE_ARTNET = 0,
+  /** @brief sACN (ANSI E1.31). Universes are 1 to 63999. The multicast group
+     of each universe is joined, and E1.31 data and synchronization packets are
+     received.*/
+  DMX_BRIDGE_SACN,
+} dmx_bridge_protocol_t;
+
+/** @brief Maps a network universe to a DMX port.*/
+typedef struct dmx_bridge_universe_t {
+  /** @brief The DMX port on which the universe is sent.*/
+  dmx_port_t dmx_num;
+  /** @brief The Art-Net port-address or sACN universe number.*/
+  uint16_t universe;
+} dmx_bridge_universe_t;
+
+/** @brief Statistics of the packets received by the DMX network bridge.*/
+typedef struct dmx_bridge_stats_t {
+  /** @brief The number of data packets which were written to a DMX port.*/
+  uint32_t packets;
+  /** @brief The number of synchronization packets which were received.*/
+  uint32_t syncs;
+  /** @brief The number of packets which were discarded because they were
+     malformed, out of sequence, or of a universe which is not mapped.*/
+  uint32_t dropped;
+} dmx_bridge_stats_t;
+
+/**
+ * @brief Starts the DMX network bridge. A single DMX port is sent with DMX
+ * auto-refresh, so that received slots are latched at the start of the next
+ * DMX packet. Several DMX ports are sent with the DMX sync group, so that a new
+ * frame is sent on every port at once. A task is created which receives the
+ * packets of the protocol and writes their slots into the shadow buffers of
+ * the DMX ports.
+ *
+ * @note Once a synchronization packet has been received, data packets of the
+ * DMX sync group are only latched by synchronization packets until none have
+ * been received for DMX_BRIDGE_SYNC_TIMEOUT_US. sACN data packets with a
+ * synchronization address of 0 are always latched immediately. A single DMX
+ * port is always latched at the start of its next DMX packet. sACN priorities
+ * are not merged, so each universe should be sent by a single source.
+ *
+ * @note The bridge task is created with the priority of the calling task. The
+ * DMX ports must not be written by other tasks while the bridge is running.
+ *
+ * @param protocol The network protocol to receive, one of
+ * dmx_bridge_protocol_t.
+ * @param[in] universes An array mapping each universe to a DMX port. Each DMX
+ * port may only be mapped once.
+ * @param num_universes The number of universes in the array.
+ * @param refresh_rate The refresh rate of the DMX ports in packets per second.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_bridge_start(dmx_bridge_protocol_t protocol,
+                      const dmx_bridge_universe_t *universes,
+                      int num_universes, uint32_t refresh_rate);
+
+/**
+ * @brief Stops the DMX network bridge. This function blocks until the bridge
+ * task has stopped. Auto-refresh or the DMX sync group is then disabled on the
+ * DMX ports of the bridge.
+ *
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_bridge_stop();
+
+/**
+ * @brief Checks if the DMX network bridge is running.
+ *
+ * @return true if the DMX network bridge is running.
+ * @return false if it is not.
+ */
+bool dmx_bridge_is_running();
+
+/**
+ * @brief Checks if a DMX port is one of the DMX ports of the DMX network
+ * bridge.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the DMX network bridge is running and sends on the DMX port.
+ * @return false if it does not.
+ */
+bool dmx_bridge_has_port(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the statistics of the packets received by the DMX network bridge
+ * since it was started.
+ *
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false if the DMX network bridge is not running.
+ */
+bool dmx_bridge_get_stats(dmx_bridge_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
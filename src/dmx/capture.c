@@ -0,0 +1,230 @@
+#include "dmx/capture.h"
+
+#include <string.h>
+
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+
+enum {
+  DMX_CAPTURE_TASK_STACK_SIZE = 3072,  // The capture task stack in bytes.
+  DMX_CAPTURE_DRAIN_PERIOD_MS = 10,  // The time between drains of the buffer.
+};
+
+typedef struct dmx_capture_t {
+  SemaphoreHandle_t stopped;  // Is given by the capture task when it stops.
+  dmx_port_t dmx_num;         // The DMX port whose packets are captured.
+  dmx_capture_write_t write;  // The function which writes the stream.
+  void *context;              // Context for the write function.
+  uint8_t *buffer;            // The ring buffer which is drained by the task.
+  uint32_t size;              // The size of the ring buffer in bytes.
+  volatile bool is_running;   // False when the capture task should stop.
+} dmx_capture_t;
+
+static dmx_capture_t *dmx_capture_context[DMX_NUM_MAX] = {};
+
+static void DMX_ISR_ATTR dmx_capture_copy(struct dmx_driver_capture_t *capture,
+                                          uint32_t head, const void *source,
+                                          size_t size) {
+  // Split the copy where it wraps around the end of the ring buffer
+  const uint32_t offset = head & (capture->size - 1);
+  const size_t first = size < capture->size - offset ? size
+                                                     : capture->size - offset;
+  memcpy(&capture->buffer[offset], source, first);
+  memcpy(capture->buffer, (const uint8_t *)source + first, size - first);
+}
+
+void DMX_ISR_ATTR dmx_capture_record(dmx_driver_t *driver, int size,
+                                     dmx_err_t err, int64_t now) {
+  struct dmx_driver_capture_t *const capture = &driver->capture;
+  if (capture->buffer == NULL) {
+    return;
+  }
+  if (size < 0) {
+    size = 0;
+  } else if (size > DMX_PACKET_SIZE_MAX) {
+    size = DMX_PACKET_SIZE_MAX;
+  }
+
+  // Drop the packet if the capture task has not made enough space for it
+  const uint32_t head = capture->head;
+  const uint32_t tail = DMX_LOAD(capture->tail);
+  const uint32_t record_size = sizeof(dmx_capture_record_t) + size;
+  if (capture->size - (head - tail) < record_size) {
+    ++capture->dropped;
+    return;
+  }
+
+  const bool is_measured =
+      driver->sniffer.is_enabled && driver->sniffer.is_measured;
+  const dmx_metadata_t *const metadata =
+      &driver->sniffer.metadata[driver->sniffer.buffer_index];
+  const dmx_capture_record_t record = {
+      .timestamp = now,
+      .break_len = is_measured ? metadata->break_len : 0,
+      .mab_len = is_measured ? metadata->mab_len : 0,
+      .size = size,
+      .dmx_num = driver->dmx_num,
+      .err = err};
+  dmx_capture_copy(capture, head, &record, sizeof(record));
+  dmx_capture_copy(capture, head + sizeof(record), driver->dmx.rx_data, size);
+
+  // Publish the record to the capture task after it has been written
+  __atomic_store_n(&capture->head, head + record_size, __ATOMIC_RELEASE);
+  ++capture->records;
+}
+
+static void dmx_capture_drain(dmx_capture_t *task) {
+  struct dmx_driver_capture_t *const capture =
+      &dmx_driver[task->dmx_num]->capture;
+
+  const uint32_t head = DMX_LOAD(capture->head);
+  uint32_t tail = capture->tail;
+  while (tail != head) {
+    // Write the contiguous bytes up to the end of the ring buffer at once
+    const uint32_t offset = tail & (task->size - 1);
+    size_t size = head - tail;
+    if (size > task->size - offset) {
+      size = task->size - offset;
+    }
+    const size_t written =
+        task->write(&task->buffer[offset], size, task->context);
+    if (written == 0) {
+      break;  // Try again on the next drain
+    }
+    tail += written < size ? written : size;
+    __atomic_store_n(&capture->tail, tail, __ATOMIC_RELEASE);
+  }
+}
+
+static void dmx_capture_task(void *arg) {
+  dmx_capture_t *const task = arg;
+
+  // Begin the stream with the file header
+  const dmx_capture_file_header_t header = {
+      .magic = DMX_CAPTURE_MAGIC,
+      .version = DMX_CAPTURE_VERSION,
+      .record_size = sizeof(dmx_capture_record_t)};
+  size_t written = 0;
+  while (written < sizeof(header) && task->is_running) {
+    const size_t n = task->write((const uint8_t *)&header + written,
+                                 sizeof(header) - written, task->context);
+    if (n == 0) {
+      vTaskDelay(dmx_ms_to_ticks(DMX_CAPTURE_DRAIN_PERIOD_MS));
+    }
+    written += n;
+  }
+
+  // Drain the ring buffer periodically so the DMX ISR never wakes this task
+  while (task->is_running) {
+    vTaskDelay(dmx_ms_to_ticks(DMX_CAPTURE_DRAIN_PERIOD_MS));
+    dmx_capture_drain(task);
+  }
+  dmx_capture_drain(task);
+
+  xSemaphoreGive(task->stopped);
+  vTaskDelete(NULL);
+}
+
+bool dmx_capture_start(dmx_port_t dmx_num, size_t buffer_size,
+                       dmx_capture_write_t write, void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(write != NULL, false, "write is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_capture_is_enabled(dmx_num), false,
+            "capture is already enabled");
+
+  // Round the ring buffer up to a power of two so that it can be masked
+  uint32_t size = DMX_CAPTURE_BUFFER_SIZE_MIN;
+  while (size < buffer_size) {
+    size <<= 1;
+  }
+
+  // Allocate the capture task context and the ring buffer
+  dmx_capture_t *const task = heap_caps_malloc(sizeof(*task), MALLOC_CAP_8BIT);
+  DMX_CHECK(task != NULL, false, "capture malloc error");
+  uint8_t *const buffer =
+      heap_caps_malloc(size, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+  task->stopped = xSemaphoreCreateBinary();
+  if (buffer == NULL || task->stopped == NULL) {
+    if (task->stopped != NULL) {
+      vSemaphoreDelete(task->stopped);
+    }
+    heap_caps_free(buffer);
+    heap_caps_free(task);
+    DMX_CHECK(false, false, "capture buffer malloc error");
+  }
+  task->dmx_num = dmx_num;
+  task->write = write;
+  task->context = context;
+  task->buffer = buffer;
+  task->size = size;
+  task->is_running = true;
+
+  // Let the DMX ISR write into the ring buffer
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->capture.size = size;
+  driver->capture.head = 0;
+  driver->capture.tail = 0;
+  driver->capture.records = 0;
+  driver->capture.dropped = 0;
+  driver->capture.buffer = buffer;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  if (!xTaskCreate(dmx_capture_task, "dmx_capture",
+                   DMX_CAPTURE_TASK_STACK_SIZE, task, uxTaskPriorityGet(NULL),
+                   NULL)) {
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    driver->capture.buffer = NULL;
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    vSemaphoreDelete(task->stopped);
+    heap_caps_free(buffer);
+    heap_caps_free(task);
+    DMX_CHECK(false, false, "capture task create error");
+  }
+  dmx_capture_context[dmx_num] = task;
+
+  return true;
+}
+
+bool dmx_capture_stop(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_capture_is_enabled(dmx_num), false, "capture is not enabled");
+
+  dmx_capture_t *const task = dmx_capture_context[dmx_num];
+  dmx_capture_context[dmx_num] = NULL;
+
+  // Stop the DMX ISR from writing into the ring buffer
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->capture.buffer = NULL;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Wait for the capture task to write the remaining packets
+  task->is_running = false;
+  xSemaphoreTake(task->stopped, portMAX_DELAY);
+  vSemaphoreDelete(task->stopped);
+  heap_caps_free(task->buffer);
+  heap_caps_free(task);
+
+  return true;
+}
+
+bool dmx_capture_is_enabled(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && dmx_capture_context[dmx_num] != NULL;
+}
+
+bool dmx_capture_get_stats(dmx_port_t dmx_num, dmx_capture_stats_t *stats) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  const dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  stats->records = driver->capture.records;
+  stats->dropped = driver->capture.dropped;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
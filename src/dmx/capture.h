@@ -0,0 +1,131 @@
+/**
+ * @file dmx/capture.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains functions which capture every packet received on
+ * a DMX port for offline analysis. The DMX ISR writes each packet into a
+ * lock-free ring buffer, and a task drains the ring buffer to a user callback
+ * which may write it to an SD card, a UART, or a TCP socket. The captured
+ * stream begins with a dmx_capture_file_header_t, which is followed by one
+ * dmx_capture_record_t and its slots for each packet. Every field is
+ * little-endian.
+ */
+#pragma once
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The magic number at the start of a packet capture stream. It is the
+ * ASCII string "DMXC".*/
+#define DMX_CAPTURE_MAGIC 0x43584d44
+
+/** @brief The version of the packet capture stream format.*/
+#define DMX_CAPTURE_VERSION 1
+
+/** @brief The minimum size in bytes of a packet capture ring buffer.*/
+#define DMX_CAPTURE_BUFFER_SIZE_MIN 1024
+
+/** @brief The header at the start of a packet capture stream.*/
+typedef struct __attribute__((packed)) dmx_capture_file_header_t {
+  /** @brief The magic number of the stream, DMX_CAPTURE_MAGIC.*/
+  uint32_t magic;
+  /** @brief The version of the stream format, DMX_CAPTURE_VERSION.*/
+  uint16_t version;
+  /** @brief The size in bytes of each dmx_capture_record_t in the stream.*/
+  uint16_t record_size;
+} dmx_capture_file_header_t;
+
+/** @brief The header of a single captured packet. It is immediately followed
+ * by the slots of the packet, starting with the start code.*/
+typedef struct __attribute__((packed)) dmx_capture_record_t {
+  /** @brief The time in microseconds since boot at which the DMX driver
+     received the end of the packet.*/
+  int64_t timestamp;
+  /** @brief Length in microseconds of the DMX break of the packet, or 0 if it
+     was not measured by the DMX sniffer.*/
+  uint32_t break_len;
+  /** @brief Length in microseconds of the DMX mark-after-break of the packet,
+     or 0 if it was not measured by the DMX sniffer.*/
+  uint32_t mab_len;
+  /** @brief The number of slots which follow this record.*/
+  uint16_t size;
+  /** @brief The DMX port number on which the packet was received.*/
+  uint8_t dmx_num;
+  /** @brief The error of the packet, one of dmx_err_t.*/
+  uint8_t err;
+} dmx_capture_record_t;
+
+/** @brief Statistics of a packet capture.*/
+typedef struct dmx_capture_stats_t {
+  /** @brief The number of packets which were captured.*/
+  uint32_t records;
+  /** @brief The number of packets which were dropped because the ring buffer
+     was full.*/
+  uint32_t dropped;
+} dmx_capture_stats_t;
+
+/**
+ * @brief The function which is called by the packet capture task to write the
+ * captured stream.
+ *
+ * @param[in] data A pointer to the bytes to write.
+ * @param size The number of bytes to write.
+ * @param[inout] context The context which was passed to dmx_capture_start().
+ * @return The number of bytes which were written. Bytes which were not written
+ * are passed to the function again later.
+ */
+typedef size_t (*dmx_capture_write_t)(const void *data, size_t size,
+                                      void *context);
+
+/**
+ * @brief Starts capturing every packet received on a DMX port. A ring buffer is
+ * allocated into which the DMX ISR writes each completed packet, and a task is
+ * created which periodically drains the ring buffer to the write function. If
+ * the DMX sniffer is enabled, the DMX break and mark-after-break of each
+ * packet are also captured.
+ *
+ * @param dmx_num The DMX port number.
+ * @param buffer_size The size of the ring buffer in bytes. It is rounded up to
+ * a power of two of at least DMX_CAPTURE_BUFFER_SIZE_MIN.
+ * @param write The function which writes the captured stream.
+ * @param[inout] context Context which is passed to the write function.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_capture_start(dmx_port_t dmx_num, size_t buffer_size,
+                       dmx_capture_write_t write, void *context);
+
+/**
+ * @brief Stops capturing packets on a DMX port. This function blocks until the
+ * packets in the ring buffer have been passed to the write function.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_capture_stop(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if packets are being captured on a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if packets are being captured.
+ * @return false if they are not.
+ */
+bool dmx_capture_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the statistics of the packet capture of a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_capture_get_stats(dmx_port_t dmx_num, dmx_capture_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,192 @@
+#include "dmx/curve.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "dmx/include/device.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+
+static uint16_t dmx_curve_linear[DMX_CURVE_TABLE_SIZE];
+
+static void dmx_curve_map_8bit(uint16_t *values, const uint8_t *slots,
+                               int count, const uint16_t *table, int shift) {
+  // Map four slots for each 32-bit load from the DMX buffer
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    uint32_t word;
+    memcpy(&word, &slots[i], sizeof(word));
+    values[i] = table[word & 0xff] >> shift;
+    values[i + 1] = table[(word >> 8) & 0xff] >> shift;
+    values[i + 2] = table[(word >> 16) & 0xff] >> shift;
+    values[i + 3] = table[word >> 24] >> shift;
+  }
+  for (; i < count; ++i) {
+    values[i] = table[slots[i]] >> shift;
+  }
+}
+
+static uint16_t dmx_curve_interpolate(const uint16_t *table, uint32_t input) {
+  // Entry i is the output of the 16-bit input i * 257
+  const uint32_t i = input / 257;
+  const int32_t remainder = input - i * 257;
+  if (remainder == 0) {
+    return table[i];  // Also avoids reading beyond the last entry
+  }
+  const int32_t delta = (int32_t)table[i + 1] - table[i];
+  return table[i] + delta * remainder / 257;
+}
+
+static void dmx_curve_map_16bit(uint16_t *values, const uint8_t *slots,
+                                int count, const uint16_t *table) {
+  // Map two coarse and fine slot pairs for each 32-bit load
+  int i = 0;
+  for (; i + 2 <= count; i += 2) {
+    uint32_t word;
+    memcpy(&word, &slots[i * 2], sizeof(word));
+    values[i] = dmx_curve_interpolate(
+        table, ((word & 0xff) << 8) | ((word >> 8) & 0xff));
+    values[i + 1] = dmx_curve_interpolate(
+        table, ((word >> 8) & 0xff00) | (word >> 24));
+  }
+  for (; i < count; ++i) {
+    values[i] =
+        dmx_curve_interpolate(table, (slots[i * 2] << 8) | slots[i * 2 + 1]);
+  }
+}
+
+void dmx_curve_apply(dmx_driver_t *driver, int size) {
+  struct dmx_driver_curve_t *const curve = &driver->curve;
+  if (curve->spans == NULL) {
+    return;
+  }
+
+  const uint16_t start_address = dmx_get_start_address(driver->dmx_num);
+  if (start_address == DMX_START_ADDRESS_NONE) {
+    return;
+  }
+
+  const uint8_t *const data = DMX_LOAD(driver->dmx.data);
+  uint16_t *values = curve->values;
+  for (int i = 0; i < curve->num_spans; ++i) {
+    const dmx_curve_span_t *const span = &curve->spans[i];
+    const int width = span->mode == DMX_CURVE_MODE_16BIT ? 2 : 1;
+    const int first = start_address + span->offset;
+
+    // Only map the channels whose slots were received
+    int count = span->count;
+    if (first + count * width > size) {
+      count = first < size ? (size - first) / width : 0;
+    }
+
+    if (span->mode == DMX_CURVE_MODE_16BIT) {
+      dmx_curve_map_16bit(values, &data[first], count, span->table);
+    } else {
+      const int shift = span->mode == DMX_CURVE_MODE_8BIT ? 8 : 0;
+      dmx_curve_map_8bit(values, &data[first], count, span->table, shift);
+    }
+    values += span->count;
+  }
+}
+
+bool dmx_curve_make_gamma(uint16_t *table, float gamma) {
+  DMX_CHECK(table != NULL, false, "table is null");
+  DMX_CHECK(gamma > 0.0f, false, "gamma error");
+
+  for (int i = 0; i < DMX_CURVE_TABLE_SIZE; ++i) {
+    const float input = (float)i / (DMX_CURVE_TABLE_SIZE - 1);
+    table[i] = (uint16_t)(powf(input, gamma) * 65535.0f + 0.5f);
+  }
+
+  return true;
+}
+
+bool dmx_curve_enable(dmx_port_t dmx_num, const dmx_curve_span_t *spans,
+                      int num_spans) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(spans != NULL, false, "spans is null");
+  DMX_CHECK(num_spans > 0 && num_spans <= DMX_CURVE_SPANS_MAX, false,
+            "num_spans error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_curve_is_enabled(dmx_num), false,
+            "curve is already enabled");
+
+  size_t count = 0;
+  for (int i = 0; i < num_spans; ++i) {
+    const int width = spans[i].mode == DMX_CURVE_MODE_16BIT ? 2 : 1;
+    DMX_CHECK(spans[i].mode <= DMX_CURVE_MODE_16BIT, false, "mode error");
+    DMX_CHECK(spans[i].count > 0 && spans[i].offset + spans[i].count * width <
+                                        DMX_PACKET_SIZE_MAX,
+              false, "span error");
+    count += spans[i].count;
+  }
+  DMX_CHECK(count < DMX_PACKET_SIZE_MAX, false, "span error");
+
+  // Allocate the spans and their values together
+  const size_t spans_size = sizeof(*spans) * num_spans;
+  uint8_t *const buffer = heap_caps_malloc(
+      spans_size + sizeof(uint16_t) * count, MALLOC_CAP_8BIT);
+  DMX_CHECK(buffer != NULL, false, "curve malloc error");
+  dmx_curve_span_t *const copy = (dmx_curve_span_t *)buffer;
+  uint16_t *const values = (uint16_t *)(buffer + spans_size);
+  memcpy(copy, spans, spans_size);
+  memset(values, 0, sizeof(uint16_t) * count);
+
+  // Spans without a lookup table are mapped with a linear table
+  for (int i = 0; i < DMX_CURVE_TABLE_SIZE; ++i) {
+    dmx_curve_linear[i] = i * 257;
+  }
+  for (int i = 0; i < num_spans; ++i) {
+    if (copy[i].table == NULL) {
+      copy[i].table = dmx_curve_linear;
+    }
+  }
+
+  // Block dmx_receive() while the DMX packet may be mapped
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  driver->curve.values = values;
+  driver->curve.count = count;
+  driver->curve.num_spans = num_spans;
+  driver->curve.spans = copy;
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return true;
+}
+
+bool dmx_curve_disable(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(dmx_curve_is_enabled(dmx_num), false, "curve is not enabled");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  void *const buffer = (void *)driver->curve.spans;
+  driver->curve.spans = NULL;
+  driver->curve.num_spans = 0;
+  driver->curve.values = NULL;
+  driver->curve.count = 0;
+  xSemaphoreGiveRecursive(driver->mux);
+  heap_caps_free(buffer);
+
+  return true;
+}
+
+bool dmx_curve_is_enabled(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && dmx_driver_is_installed(dmx_num) &&
+         dmx_driver[dmx_num]->curve.spans != NULL;
+}
+
+const uint16_t *dmx_curve_get_values(dmx_port_t dmx_num, size_t *count) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, NULL, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), NULL, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  const uint16_t *const values = DMX_LOAD(driver->curve.values);
+  if (count != NULL) {
+    *count = values != NULL ? driver->curve.count : 0;
+  }
+
+  return values;
+}
@@ -0,0 +1,124 @@
+/**
+ * @file dmx/curve.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the dimming curve stage of the DMX driver. When it
+ * is enabled, each DMX packet with a null start code which is returned by
+ * dmx_receive() is passed through lookup tables over the DMX footprint of the
+ * device, so that PWM and LED drivers may use the resulting values directly.
+ * Channels may be 8-bit slots, which are mapped to 8-bit or 16-bit values, or
+ * 16-bit coarse and fine slot pairs, which are mapped to 16-bit values.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The number of entries in a dimming curve lookup table. Entry i is
+ * the 16-bit output of the 8-bit input i. 16-bit inputs are interpolated
+ * between neighbouring entries.*/
+#define DMX_CURVE_TABLE_SIZE (256)
+
+/** @brief The maximum number of spans of channels which may be passed to
+ * dmx_curve_enable().*/
+#define DMX_CURVE_SPANS_MAX (32)
+
+/** @brief The ways in which the slots of a span of channels are mapped.*/
+typedef enum dmx_curve_mode_t {
+  /** @brief Each channel is one slot which is mapped to a value from 0 to 255.
+     The value is the upper byte of the lookup table entry.*/
+  DMX_CURVE_MODE_8BIT = 0,
+  /** @brief Each channel is one slot which is mapped to a value from 0 to
+     65535.*/
+  DMX_CURVE_MODE_8BIT_TO_16BIT,
+  /** @brief Each channel is a coarse slot followed by a fine slot which are
+     mapped to a value from 0 to 65535.*/
+  DMX_CURVE_MODE_16BIT,
+} dmx_curve_mode_t;
+
+/** @brief A span of consecutive channels in the DMX footprint which are mapped
+ * with the same lookup table.*/
+typedef struct dmx_curve_span_t {
+  /** @brief The offset in slots of the first channel from the DMX start
+     address of the device.*/
+  uint16_t offset;
+  /** @brief The number of channels in the span. DMX_CURVE_MODE_16BIT channels
+     use two slots each.*/
+  uint16_t count;
+  /** @brief The way in which the slots of the span are mapped.*/
+  dmx_curve_mode_t mode;
+  /** @brief A lookup table of DMX_CURVE_TABLE_SIZE entries, or NULL to map the
+     slots linearly. The table must remain valid while the dimming curve stage
+     is enabled.*/
+  const uint16_t *table;
+} dmx_curve_span_t;
+
+/**
+ * @brief Fills a lookup table with a gamma curve. The first entry is 0 and the
+ * last entry is 65535.
+ *
+ * @param[out] table A lookup table of DMX_CURVE_TABLE_SIZE entries.
+ * @param gamma The exponent of the curve, such as 2.2. A gamma of 1.0 is
+ * linear.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_curve_make_gamma(uint16_t *table, float gamma);
+
+/**
+ * @brief Enables the dimming curve stage on a DMX port. Each call to
+ * dmx_receive() which returns a DMX packet with the null start code maps the
+ * slots of each span into one value per channel, in the order of the spans.
+ * The values may be read with dmx_curve_get_values().
+ *
+ * @note Channels whose slots were not received keep their previous values. No
+ * values are updated while the device does not have a DMX start address.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] spans An array of the spans of channels to map.
+ * @param num_spans The number of spans in the array, no more than
+ * DMX_CURVE_SPANS_MAX.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_curve_enable(dmx_port_t dmx_num, const dmx_curve_span_t *spans,
+                      int num_spans);
+
+/**
+ * @brief Disables the dimming curve stage on a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_curve_disable(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the dimming curve stage is enabled on a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the dimming curve stage is enabled.
+ * @return false if it is not.
+ */
+bool dmx_curve_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the values which were mapped from the last DMX packet returned
+ * by dmx_receive(). The values are updated in place by the next call to
+ * dmx_receive(), so they should be read by the task which receives DMX.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] count A pointer into which to copy the number of values, or
+ * NULL.
+ * @return A pointer to one value per channel, or NULL if the dimming curve
+ * stage is not enabled.
+ */
+const uint16_t *dmx_curve_get_values(dmx_port_t dmx_num, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
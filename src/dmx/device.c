@@ -3,15 +3,31 @@
 #include "dmx/hal/include/nvs.h"
 #include "dmx/include/driver.h"
 #include "dmx/include/service.h"
-#include "rdm/responder/include/dmx_setup.h"
-#include "rdm/responder/include/utils.h"
+#include "dmx/include/parameter.h"
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+#include "rdm/responder/include/queue_status.h"
+#endif
+
+static bool dmx_device_set(dmx_port_t dmx_num, rdm_pid_t pid,
+                           const void *source, size_t size) {
+  if (!dmx_parameter_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, source, size)) {
+    return false;
+  }
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+  rdm_queue_push(dmx_num, pid);
+#endif
+
+  return true;
+}
 
 uint16_t dmx_get_start_address(dmx_port_t dmx_num) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
 
   uint16_t dmx_start_address;
-  if (!rdm_get_dmx_start_address(dmx_num, &dmx_start_address)) {
+  if (!dmx_parameter_copy(dmx_num, RDM_SUB_DEVICE_ROOT,
+                          RDM_PID_DMX_START_ADDRESS, &dmx_start_address,
+                          sizeof(dmx_start_address))) {
     // This device does not use a DMX address
     dmx_start_address = DMX_START_ADDRESS_NONE;
   }
@@ -27,7 +43,8 @@ bool dmx_set_start_address(dmx_port_t dmx_num, uint16_t dmx_start_address) {
   DMX_CHECK(dmx_get_start_address(dmx_num) != DMX_START_ADDRESS_NONE, false,
             "cannot set DMX start address");
 
-  if (!rdm_set_dmx_start_address(dmx_num, dmx_start_address)) {
+  if (!dmx_device_set(dmx_num, RDM_PID_DMX_START_ADDRESS, &dmx_start_address,
+                      sizeof(dmx_start_address))) {
     // An unusual error occurred
     DMX_ERR("unable to set DMX start address");
     return false;
@@ -41,7 +58,8 @@ uint8_t dmx_get_current_personality(dmx_port_t dmx_num) {
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
 
   rdm_dmx_personality_t personality;
-  if (!rdm_get_dmx_personality(dmx_num, &personality)) {
+  if (!dmx_parameter_copy(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_PERSONALITY,
+                          &personality, sizeof(personality))) {
     // This device does not use a DMX address
     personality.current = 0;
   }
@@ -56,7 +74,14 @@ bool dmx_set_current_personality(dmx_port_t dmx_num, uint8_t personality_num) {
              personality_num <= dmx_get_personality_count(dmx_num)),
             false, "personality_num error");
 
-  if (!rdm_set_dmx_personality(dmx_num, personality_num)) {
+  rdm_dmx_personality_t personality;
+  if (!dmx_parameter_copy(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_PERSONALITY,
+                          &personality, sizeof(personality))) {
+    return false;
+  }
+  personality.current = personality_num;
+  if (!dmx_device_set(dmx_num, RDM_PID_DMX_PERSONALITY, &personality,
+                      sizeof(personality))) {
     // An unusual error occurred
     DMX_ERR("unable to set DMX personality");
     return false;
@@ -70,7 +95,8 @@ uint8_t dmx_get_personality_count(dmx_port_t dmx_num) {
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
 
   rdm_dmx_personality_t personality;
-  if (!rdm_get_dmx_personality(dmx_num, &personality)) {
+  if (!dmx_parameter_copy(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_PERSONALITY,
+                          &personality, sizeof(personality))) {
     // This device does not use a DMX address
     personality.count = 0;
   }
@@ -85,13 +111,16 @@ size_t dmx_get_footprint(dmx_port_t dmx_num, uint8_t personality_num) {
              personality_num <= dmx_get_personality_count(dmx_num)),
             0, "personality_num is invalid");
 
-  rdm_dmx_personality_description_t personality;
-  if (!rdm_get_dmx_personality_description(dmx_num, personality_num,
-                                           &personality)) {
+  // Get a pointer to the stored personality
+  const rdm_dmx_personality_description_t *personalities =
+      dmx_parameter_get_data(dmx_num, RDM_SUB_DEVICE_ROOT,
+                             RDM_PID_DMX_PERSONALITY_DESCRIPTION);
+  if (personalities == NULL) {
     return 0;
   }
 
-  return personality.footprint;
+  --personality_num;  // Personalities are indexed beginning at 1
+  return personalities[personality_num].footprint;
 }
 
 const char *dmx_get_personality_description(dmx_port_t dmx_num,
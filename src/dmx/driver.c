@@ -2,18 +2,51 @@
 
 #include <string.h>
 
+#include "dmx/capture.h"
+#include "dmx/curve.h"
+#include "dmx/hal/include/dma.h"
 #include "dmx/hal/include/gpio.h"
 #include "dmx/hal/include/nvs.h"
 #include "dmx/hal/include/timer.h"
 #include "dmx/hal/include/uart.h"
 #include "dmx/include/service.h"
+#include "dmx/merge.h"
 #include "dmx/sniffer.h"
+#include "dmx/sleep.h"
 #include "endian.h"
 #include "rdm/include/types.h"
 #include "rdm/responder/include/utils.h"
 
 #if ESP_IDF_VERSION_MAJOR >= 5
 #include "esp_mac.h"  // TODO: Make this hardware agnostic
+#include "esp_memory_utils.h"
+#else
+#include "soc/soc_memory_layout.h"
+#endif
+
+#ifdef CONFIG_DMX_SINK_ENABLE
+#include "dmx/sink.h"
+#endif
+
+#ifdef CONFIG_DMX_HEALTH_ENABLE
+#include "dmx/health.h"
+#endif
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+#include "dmx/failover.h"
+#endif
+
+#ifdef CONFIG_DMX_BRIDGE_ENABLE
+#include "dmx/bridge.h"
+#endif
+
+#ifdef CONFIG_RDM_CONTROLLER_ENABLE
+#include "rdm/controller/include/cache.h"
+#include "rdm/controller/include/scheduler.h"
+#endif
+
+#ifdef CONFIG_RDM_PROXY_ENABLE
+#include "rdm/controller/include/proxy.h"
 #endif
 
 #ifdef CONFIG_RDM_DEVICE_UID_MAN_ID
@@ -52,7 +85,9 @@
 const char *TAG = "dmx";  // The log tagline for the library.
 
 dmx_driver_t *dmx_driver[DMX_NUM_MAX] = {};  // The DMX drivers for each port.
+struct dmx_sync_group_t dmx_sync_group = {.spinlock = DMX_SPINLOCK_INIT};
 
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
 static void rdm_default_identify_cb(dmx_port_t dmx_num, rdm_header_t *request,
                                     rdm_header_t *response, void *context) {
   if (request->cc == RDM_CC_SET_COMMAND &&
@@ -66,14 +101,144 @@ static void rdm_default_identify_cb(dmx_port_t dmx_num, rdm_header_t *request,
 #endif
   }
 }
+#else
+static void dmx_driver_add_dmx_parameters(
+    dmx_port_t dmx_num, const rdm_dmx_personality_description_t *personalities,
+    int personality_count) {
+  // Restore the DMX personality from NVS without registering RDM parameters
+  rdm_dmx_personality_t personality;
+  if (!dmx_nvs_get(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_PERSONALITY,
+                   &personality, sizeof(personality)) ||
+      personality.count != personality_count || personality.current == 0 ||
+      personality.current > personality_count) {
+    personality.current = 1;
+    personality.count = personality_count;
+  }
+  dmx_parameter_add(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_PERSONALITY,
+                    DMX_PARAMETER_TYPE_NON_VOLATILE, &personality,
+                    sizeof(personality));
+  dmx_parameter_add(dmx_num, RDM_SUB_DEVICE_ROOT,
+                    RDM_PID_DMX_PERSONALITY_DESCRIPTION,
+                    DMX_PARAMETER_TYPE_DYNAMIC, (void *)personalities,
+                    sizeof(*personalities) * personality_count);
+
+  // Reset the DMX start address if the current footprint is too large
+  uint16_t dmx_start_address;
+  if (!dmx_nvs_get(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_START_ADDRESS,
+                   &dmx_start_address, sizeof(dmx_start_address)) ||
+      dmx_start_address == 0 ||
+      dmx_start_address + personalities[personality.current - 1].footprint >
+          DMX_PACKET_SIZE_MAX) {
+    dmx_start_address = 1;
+  }
+  dmx_parameter_add(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_PID_DMX_START_ADDRESS,
+                    DMX_PARAMETER_TYPE_NON_VOLATILE, &dmx_start_address,
+                    sizeof(dmx_start_address));
+}
+#endif
+
+struct dmx_isr_init_t {
+  dmx_port_t dmx_num;      // The DMX port number.
+  dmx_driver_t *driver;    // The DMX driver which is passed to the DMX ISRs.
+  int interrupt_flags;     // The interrupt allocation flags to use.
+  TaskHandle_t caller;     // The task which called dmx_driver_install().
+  bool uart_is_init;       // True if the UART was initialized.
+  bool timer_is_init;      // True if the timer was initialized.
+};
+
+static void dmx_isr_init(struct dmx_isr_init_t *isr_init) {
+  // Interrupts are allocated on the core which initializes the peripherals
+  const dmx_port_t dmx_num = isr_init->dmx_num;
+  isr_init->uart_is_init =
+      dmx_uart_init(dmx_num, isr_init->driver, isr_init->interrupt_flags);
+  isr_init->timer_is_init =
+      isr_init->uart_is_init &&
+      dmx_timer_init(dmx_num, isr_init->driver, isr_init->interrupt_flags);
+}
+
+static void dmx_isr_init_task(void *arg) {
+  struct dmx_isr_init_t *isr_init = arg;
+  dmx_isr_init(isr_init);
+  xTaskNotifyGive(isr_init->caller);
+  vTaskDelete(NULL);
+}
+
+static int dmx_driver_required_parameter_count(bool uses_dmx) {
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+  return uses_dmx ? 7 : 6;
+#else
+  return uses_dmx ? 3 : 0;
+#endif
+}
+
+static int dmx_driver_root_parameter_count(const dmx_config_t *config,
+                                           bool uses_dmx) {
+  // The root device must have room for its required parameters if it has any
+  const int required_parameter_count =
+      dmx_driver_required_parameter_count(uses_dmx);
+  const int root_param_count = config->root_device_parameter_count;
+  if (root_param_count > 0 && root_param_count < required_parameter_count) {
+    return required_parameter_count;
+  }
+  return root_param_count;
+}
 
-bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
-                        const dmx_personality_t *personalities,
-                        int personality_count) {
+static size_t dmx_driver_align(size_t size) {
+  // Arena allocations have the same alignment as in dmx_alloc()
+  const size_t align = sizeof(uint64_t);
+  return (size + align - 1) & ~(align - 1);
+}
+
+static size_t dmx_driver_size(int root_param_count) {
+  // Keep the arena which follows the driver in static storage aligned
+  return dmx_driver_align(sizeof(dmx_driver_t) +
+                          (sizeof(dmx_parameter_t) * root_param_count));
+}
+
+static size_t dmx_driver_default_parameter_size(const dmx_config_t *config,
+                                                int root_param_count,
+                                                int personality_count) {
+  size_t size = 0;
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+  const uint32_t pid_count =
+      root_param_count + config->sub_device_parameter_count;
+  size += dmx_driver_align(rdm_dispatch_get_table_size(pid_count));
+  size += dmx_driver_align(sizeof(uint8_t));  // Shared by both mute PIDs
+  // The device info stores the model ID, category, and software version ID
+  size += dmx_driver_align(sizeof(uint16_t) * 2 + sizeof(uint32_t));
+  size += dmx_driver_align(RDM_ASCII_SIZE_MAX);  // Software version label
+  size += dmx_driver_align(sizeof(uint8_t));     // Identify device
+  if (config->queue_size_max > 0) {
+    size += dmx_driver_align(rdm_queue_get_size(config->queue_size_max));
+  }
+#ifndef CONFIG_DMX_PROFILE_RESPONDER_LITE
+  size += dmx_driver_align(RDM_ASCII_SIZE_MAX);  // Device label
+#endif
+#endif
+  if (personality_count > 0) {
+    size += dmx_driver_align(sizeof(uint16_t));  // DMX start address
+    size += dmx_driver_align(sizeof(rdm_dmx_personality_t));
+    size += dmx_driver_align(sizeof(rdm_dmx_personality_description_t) *
+                             personality_count);
+  }
+
+  return size;
+}
+
+static bool dmx_driver_install_into(dmx_port_t dmx_num,
+                                    const dmx_config_t *config,
+                                    const dmx_personality_t *personalities,
+                                    int personality_count,
+                                    dmx_static_storage_t *storage) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
   DMX_CHECK(config != NULL, false, "config is null");
   DMX_CHECK(personality_count >= 0 && personality_count <= 255, false,
             "personality_count error");
+  DMX_CHECK(config->isr_core >= DMX_ISR_CORE_DEFAULT &&
+                config->isr_core <= DMX_ISR_CORE(portNUM_PROCESSORS - 1),
+            false, "isr_core error");
+  DMX_CHECK(config->isr_priority >= 0 && config->isr_priority <= 3, false,
+            "isr_priority error");
   DMX_CHECK(!dmx_driver_is_installed(dmx_num), false,
             "driver is already installed");
   bool uses_dmx = false;
@@ -94,39 +259,99 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
     ESP_LOGI(TAG, "ESP_INTR_FLAG_IRAM flag not set, flag updated");
   }
 #endif
+  if (config->isr_priority > 0) {
+    // ESP_INTR_FLAG_LEVELn is equal to (1 << n)
+    interrupt_flags &= ~ESP_INTR_FLAG_LEVELMASK;
+    interrupt_flags |= 1 << config->isr_priority;
+  }
   
   // Ensure the parameter count is valid
-  const int required_parameter_count = uses_dmx ? 7 : 6;
-  int root_param_count = config->root_device_parameter_count;
-  if (root_param_count > 0 && root_param_count < required_parameter_count) {
+  const int root_param_count =
+      dmx_driver_root_parameter_count(config, uses_dmx);
+  if (root_param_count != config->root_device_parameter_count) {
     DMX_WARN(
         "root_device_parameter_count must be 0 or at least %i, "
         "root_device_parameter_count updated to %i",
-        required_parameter_count, required_parameter_count);
-    root_param_count = required_parameter_count;
+        root_param_count, root_param_count);
   }
 
-  // Initialize NVS
-  dmx_nvs_init(dmx_num);
-
-  // Allocate the DMX driver
-  const size_t driver_size =
-      sizeof(dmx_driver_t) + (sizeof(dmx_parameter_t) * root_param_count);
-  dmx_driver_t *driver = heap_caps_malloc(driver_size, MALLOC_CAP_8BIT);
-  DMX_CHECK(driver != NULL, false, "DMX driver malloc error");
+  // Start committing non-volatile parameters, but only touch NVS when needed
+  DMX_CHECK(dmx_parameter_commit_init(), false,
+            "DMX parameter commit task create error");
+
+  // Allocate the DMX driver, or place it at the start of the static storage
+  const size_t driver_size = dmx_driver_size(root_param_count);
+  dmx_driver_t *driver;
+  if (storage != NULL) {
+    DMX_CHECK(storage->size >= driver_size, false,
+              "static storage is too small");
+    DMX_CHECK(!config->dma_flags ||
+                  (esp_ptr_dma_capable(storage->buffer) &&
+                   esp_ptr_dma_capable((uint8_t *)storage->buffer +
+                                       storage->size - 1)),
+              false, "static storage is not DMA capable");
+    driver = storage->buffer;
+  } else {
+    const int malloc_caps = config->dma_flags
+                                ? (MALLOC_CAP_8BIT | MALLOC_CAP_DMA)
+                                : MALLOC_CAP_8BIT;
+    driver = heap_caps_malloc(driver_size, malloc_caps);
+    DMX_CHECK(driver != NULL, false, "DMX driver malloc error");
+  }
   dmx_driver[dmx_num] = driver;
   driver->mux = NULL;
+  driver->events = NULL;
+  driver->device.root.num_parameters = 0;
+  driver->device.sub_devices = NULL;
+  driver->device.sub_device_table_size = 0;
+  driver->device.sub_device_count = 0;
+  driver->device.generation = 0;
+#ifdef CONFIG_DMX_NVS_LAZY_RESTORE
+  driver->device.restore_is_pending = false;
+#endif
+  driver->device.dispatch = NULL;
+  driver->device.dispatch_mask = 0;
+  driver->arena.base = NULL;
+  driver->arena.size = 0;
+  driver->arena.used = 0;
+  driver->arena.is_static = (storage != NULL);
 #ifdef DMX_USE_SPINLOCK
   driver->spinlock = (dmx_spinlock_t)DMX_SPINLOCK_INIT;
 #endif
 
   // Allocate mutex
-  driver->mux = xSemaphoreCreateRecursiveMutex();
+  driver->mux = storage != NULL
+                    ? xSemaphoreCreateRecursiveMutexStatic(&storage->mux)
+                    : xSemaphoreCreateRecursiveMutex();
   if (driver->mux == NULL) {
     dmx_driver_delete(dmx_num);
     DMX_CHECK(driver->mux != NULL, false, "DMX driver mutex malloc error");
   }
 
+  // Allocate event group
+  driver->events = storage != NULL ? xEventGroupCreateStatic(&storage->events)
+                                   : xEventGroupCreate();
+  if (driver->events == NULL) {
+    dmx_driver_delete(dmx_num);
+    DMX_CHECK(driver->events != NULL, false,
+              "DMX driver event group malloc error");
+  }
+
+  // Allocate the memory arena, or use the remainder of the static storage
+  if (storage != NULL) {
+    driver->arena.base = (uint8_t *)storage->buffer + driver_size;
+    driver->arena.size = storage->size - driver_size;
+  } else if (config->arena_size > 0) {
+    const int arena_caps =
+        config->arena_caps ? config->arena_caps : MALLOC_CAP_8BIT;
+    driver->arena.base = heap_caps_malloc(config->arena_size, arena_caps);
+    if (driver->arena.base == NULL) {
+      dmx_driver_delete(dmx_num);
+      DMX_CHECK(false, false, "DMX driver arena malloc error");
+    }
+    driver->arena.size = config->arena_size;
+  }
+
   // Driver configuration
   driver->dmx_num = dmx_num;
   driver->uid.man_id = RDM_UID_MANUFACTURER_ID;
@@ -142,33 +367,68 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
   *(uint8_t *)(&driver->uid.dev_id) += dmx_num;  // Increment last octect
   driver->break_len = RDM_BREAK_LEN_US;
   driver->mab_len = RDM_MAB_LEN_US;
+  driver->rx_fifo_threshold = DMX_FIFO_THRESHOLD_ADAPTIVE;
+  driver->tx_fifo_threshold = DMX_UART_EMPTY_DEFAULT;
 
   // Set the default values for the root device
   driver->device.root.num = RDM_SUB_DEVICE_ROOT;
-  driver->device.root.next = NULL;
-  for (int i = 0; i < config->root_device_parameter_count; ++i) {
+  driver->device.root.generation = 0;
+  driver->device.root.num_parameters = 0;
+  for (int i = 0; i < root_param_count; ++i) {
     driver->device.root.parameters[i].pid = 0;
   }
 
   // Set the default values for the DMX device
-  driver->device.parameter_count.root = config->root_device_parameter_count;
+  driver->device.parameter_count.root = root_param_count;
   driver->device.parameter_count.sub_devices =
       config->sub_device_parameter_count;
   driver->device.parameter_count.staged = 0;
   driver->is_controller = false;  // Assume false until dmx_send_num()
   driver->is_enabled = true;
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+  driver->is_extended = false;  // Standard DMX until dmx_set_extended_mode()
+#endif
 
   // Synchronization state
   driver->task_waiting = NULL;
+  driver->event_waiters = 0;
+
+  // Start code filter
+  memset(driver->start_code.accept, 0xff, sizeof(driver->start_code.accept));
+  driver->start_code.route_count = 0;
 
   // Data buffer
   driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
   driver->dmx.size = DMX_PACKET_SIZE_MAX;
-  memset(driver->dmx.data, 0, sizeof(driver->dmx.data));
+  driver->dmx.rx_is_truncated = false;
+  memset(driver->dmx.buffers, 0, sizeof(driver->dmx.buffers));
+  driver->dmx.data = driver->dmx.buffers[0];
+  driver->dmx.rx_data = driver->dmx.buffers[DMX_RX_BUFFER_COUNT - 1];
+#if DMX_RX_BUFFER_COUNT > 2
+  driver->dmx.ready = driver->dmx.buffers[1];
+  driver->dmx.ready_is_fresh = false;
+#endif
+  driver->dmx.rx_checksum = 0;
+  driver->dmx.header_buf = NULL;
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+  memset(&driver->dmx.dirty, 0, sizeof(driver->dmx.dirty));
+  driver->dmx.dirty.first = -1;
+  driver->dmx.dirty.last = -1;
+  driver->dmx.changes = driver->dmx.dirty;
+  driver->dmx.last_rx_size = 0;
+#endif
+  driver->dmx.err = DMX_OK;
+  driver->dmx.data_is_acquired = false;
   driver->dmx.status = DMX_STATUS_IDLE;
   driver->dmx.progress = DMX_PROGRESS_STALE;
+  driver->dmx.seq = 0;
   driver->dmx.last_controller_pid = 0;
   driver->dmx.controller_eop_timestamp = 0;
+  driver->dmx.rx_break_ts = 0;
+  driver->dmx.rx_last_break_ts = 0;
+  driver->dmx.rx_last_eop_ts = 0;
+  driver->dmx.rx_refresh_break_ts = 0;
+  driver->dmx.rx_period_us = 0;
   driver->dmx.last_responder_pid = 0;
   driver->dmx.responder_sent_last = false;
   driver->dmx.last_request_pid = 0;
@@ -176,6 +436,32 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
 
   // RDM responder configuration
   driver->rdm.tn = 0;
+  driver->rdm.controller_depth = 0;
+
+  // DMX auto-refresh configuration
+  driver->auto_refresh.is_enabled = false;
+  driver->auto_refresh.period = 0;
+  driver->auto_refresh.size = 0;
+  driver->auto_refresh.shadow = NULL;
+  driver->auto_refresh.shadow_is_dirty = false;
+  driver->auto_refresh.frame_start_ts = 0;
+  driver->auto_refresh.is_synced = false;
+
+  // DMX repeater configuration
+  driver->repeater.outputs = 0;
+  driver->repeater.input = DMX_NUM_MAX;
+  driver->repeater.rx_fifo_threshold = DMX_FIFO_THRESHOLD_ADAPTIVE;
+
+  // RDM turnaround statistics
+  driver->turnaround.last_us = 0;
+  driver->turnaround.min_us = 0;
+  driver->turnaround.max_us = 0;
+  driver->turnaround.count = 0;
+  memset(&driver->stats, 0, sizeof(driver->stats));
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  memset(&driver->trace, 0, sizeof(driver->trace));
+  driver->trace.source = dmx_num;
+#endif
 
   // DMX sniffer configuration
   driver->sniffer.is_enabled = false;
@@ -183,6 +469,58 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
   // The driver->metadata field is left uninitialized
   driver->sniffer.last_pos_edge_ts = -1;
   driver->sniffer.last_neg_edge_ts = -1;
+  driver->sniffer.is_armed = false;
+  driver->sniffer.is_measured = false;
+  driver->sniffer.break_ts = 0;
+  driver->sniffer.head = 0;
+  driver->sniffer.tail = 0;
+  driver->sniffer.dropped = 0;
+
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+  // Low-power receive mode
+  driver->sleep.pm_lock = NULL;
+  driver->sleep.timer = NULL;
+  driver->sleep.is_asleep = false;
+#endif
+
+#ifdef CONFIG_DMX_HEALTH_ENABLE
+  // DMX bus health monitor
+  driver->health.timer = NULL;
+#endif
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+  // Redundant input mode
+  driver->failover.backup = DMX_NUM_MAX;
+  driver->failover.primary = DMX_NUM_MAX;
+#endif
+
+  // Packet capture ring buffer
+  driver->capture.buffer = NULL;
+  driver->capture.size = 0;
+  driver->capture.head = 0;
+  driver->capture.tail = 0;
+  driver->capture.records = 0;
+  driver->capture.dropped = 0;
+
+  // Dimming curve stage
+  driver->curve.spans = NULL;
+  driver->curve.num_spans = 0;
+  driver->curve.values = NULL;
+  driver->curve.count = 0;
+
+#ifdef CONFIG_DMX_SINK_ENABLE
+  // DMX output sink
+  driver->sink.task = NULL;
+  driver->sink.is_busy = false;
+  driver->sink.frames = 0;
+  driver->sink.overruns = 0;
+#endif
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+  driver->rdm_disc.generation = driver->device.generation - 1;  // Stale
+  driver->rdm_disc.is_muted = NULL;
+  driver->rdm_disc.dub_is_enabled = false;
+  driver->rdm_disc.is_sending = false;
+#endif
 
   // Add the personality numbers to the DMX personalities
   rdm_dmx_personality_description_t *personality_description =
@@ -192,7 +530,14 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
     personality_description[i].personality_num = i + 1;
   }
 
-  // Register the default RDM parameters
+  // Register the default RDM parameters, restoring them from NVS in one pass
+#ifdef CONFIG_DMX_NVS_LAZY_RESTORE
+  dmx_nvs_load_begin(dmx_num, true);  // Restored on first use instead
+#else
+  dmx_nvs_load_begin(dmx_num, false);
+#endif
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+  rdm_dispatch_init(dmx_num);  // Must precede every RDM definition
   rdm_register_disc_unique_branch(dmx_num, NULL, NULL);
   rdm_register_disc_mute(dmx_num, NULL, NULL);
   rdm_register_disc_un_mute(dmx_num, NULL, NULL);
@@ -211,29 +556,67 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
   if (config->queue_size_max > 0) {
     rdm_register_queued_message(dmx_num, config->queue_size_max, NULL, NULL);
   }
+#ifndef CONFIG_DMX_PROFILE_RESPONDER_LITE
   rdm_register_manufacturer_label(dmx_num, RDM_MANUFACTURER_LABEL, NULL, NULL);
+#endif
   if (uses_dmx > 0) {
     rdm_register_dmx_personality(dmx_num, personality_count, NULL, NULL);
     rdm_register_dmx_personality_description(dmx_num, personality_description,
                                              personality_count, NULL, NULL);
   }
+#ifndef CONFIG_DMX_PROFILE_RESPONDER_LITE
   const char *default_device_label = "";
   rdm_register_device_label(dmx_num, default_device_label, NULL, NULL);
+#endif
   rdm_register_supported_parameters(dmx_num, NULL, NULL);
+#ifndef CONFIG_DMX_PROFILE_RESPONDER_LITE
   rdm_register_parameter_description(dmx_num, NULL, NULL);
+#endif
+  dmx_nvs_load_end(dmx_num);
+  rdm_disc_isr_update(dmx_num);
+#else
+  // Only the DMX parameters are needed when the RDM responder is not compiled
+  if (uses_dmx > 0) {
+    dmx_driver_add_dmx_parameters(dmx_num, personality_description,
+                                  personality_count);
+  }
+  dmx_nvs_load_end(dmx_num);
+
+  // Drop RDM packets as soon as their start code is received
+  driver->start_code.accept[RDM_SC / 32] &= ~(1u << (RDM_SC % 32));
+#endif
+#ifdef CONFIG_DMX_NVS_LAZY_RESTORE
+  // Restore the deferred parameters the first time that one of them is used
+  driver->device.restore_is_pending = true;
+#endif
 
-  // Initialize the UART peripheral
-  if (!dmx_uart_init(dmx_num, driver, interrupt_flags)) {
+  // Initialize the UART and timer peripherals on the desired core
+  struct dmx_isr_init_t isr_init = {.dmx_num = dmx_num,
+                                    .driver = driver,
+                                    .interrupt_flags = interrupt_flags,
+                                    .caller = xTaskGetCurrentTaskHandle()};
+  const int core_id = config->isr_core - DMX_ISR_CORE(0);
+  if (config->isr_core == DMX_ISR_CORE_DEFAULT ||
+      core_id == xPortGetCoreID()) {
+    dmx_isr_init(&isr_init);
+  } else if (xTaskCreatePinnedToCore(dmx_isr_init_task, "dmx_isr_init", 2048,
+                                     &isr_init, uxTaskPriorityGet(NULL),
+                                     NULL, core_id) == pdPASS) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+  if (!isr_init.uart_is_init) {
     dmx_driver_delete(dmx_num);
     DMX_CHECK(false, false, "UART init error");
-  }
-
-  // Initialize the timer peripheral
-  if (!dmx_timer_init(dmx_num, driver, interrupt_flags)) {
+  } else if (!isr_init.timer_is_init) {
     dmx_driver_delete(dmx_num);
     DMX_CHECK(false, false, "timer init error");
   }
 
+  // Initialize the DMA if it was requested
+  if (config->dma_flags && !dmx_dma_init(dmx_num, config->dma_flags)) {
+    DMX_WARN("DMA is unavailable, the UART FIFO will be used instead");
+  }
+
   // Enable reading on the DMX port
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   xTaskNotifyStateClear(xTaskGetCurrentTaskHandle());
@@ -246,57 +629,203 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
   return true;
 }
 
+bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
+                        const dmx_personality_t *personalities,
+                        int personality_count) {
+  return dmx_driver_install_into(dmx_num, config, personalities,
+                                 personality_count, NULL);
+}
+
+bool dmx_driver_install_static(dmx_port_t dmx_num, const dmx_config_t *config,
+                               const dmx_personality_t *personalities,
+                               int personality_count,
+                               dmx_static_storage_t *storage) {
+  DMX_CHECK(storage != NULL, false, "storage is null");
+  DMX_CHECK(storage->buffer != NULL, false, "storage buffer is null");
+  DMX_CHECK(((uintptr_t)storage->buffer & (sizeof(uint64_t) - 1)) == 0, false,
+            "storage buffer must be 8-byte aligned");
+
+  return dmx_driver_install_into(dmx_num, config, personalities,
+                                 personality_count, storage);
+}
+
+size_t dmx_driver_get_static_size(const dmx_config_t *config,
+                                  int personality_count) {
+  DMX_CHECK(config != NULL, 0, "config is null");
+  DMX_CHECK(personality_count >= 0 && personality_count <= 255, 0,
+            "personality_count error");
+
+  // Every personality has a footprint, so DMX parameters are used if any exist
+  const int root_param_count =
+      dmx_driver_root_parameter_count(config, personality_count > 0);
+
+  // The default parameters are allocated from the arena when installing
+  return dmx_driver_size(root_param_count) +
+         dmx_driver_default_parameter_size(config, root_param_count,
+                                           personality_count) +
+         config->arena_size;
+}
+
 bool dmx_driver_delete(dmx_port_t dmx_num) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
 
+#ifdef CONFIG_RDM_PROXY_ENABLE
+  // Stop proxying RDM requests so that its pending requests complete
+  if (rdm_proxy_has_port(dmx_num)) {
+    rdm_proxy_stop();
+  }
+#endif
+
+#ifdef CONFIG_RDM_CONTROLLER_ENABLE
+  // Stop the RDM scheduler first because its task takes the mutex to send
+  if (rdm_scheduler_is_running(dmx_num)) {
+    rdm_scheduler_stop(dmx_num);
+  }
+
+  // Free the RDM device cache once the requests which use it have finished
+  if (rdm_cache_is_initialized(dmx_num)) {
+    rdm_cache_deinit(dmx_num);
+  }
+#endif
+
+  // Stop merging DMX packets to or from this port before its tasks are blocked
+  for (dmx_port_t output = dmx_merge_get_output(dmx_num); output < DMX_NUM_MAX;
+       output = dmx_merge_get_output(dmx_num)) {
+    dmx_merge_disable(output);
+  }
+
+#ifdef CONFIG_DMX_BRIDGE_ENABLE
+  // Stop bridging network universes to this port
+  if (dmx_bridge_has_port(dmx_num)) {
+    dmx_bridge_stop();
+  }
+#endif
+
   // Take the mutex
   if (!xSemaphoreTakeRecursive(driver->mux, 0)) {
     return false;
   }
   SemaphoreHandle_t mux = driver->mux;
 
+  // Commit staged parameters and stop the commit task from accessing them
+  const bool commit_is_locked = dmx_parameter_commit_lock();
+  dmx_parameter_commit(dmx_num);
+
+  // Stop capturing packets
+  if (dmx_capture_is_enabled(dmx_num)) {
+    dmx_capture_stop(dmx_num);
+  }
+
+#ifdef CONFIG_DMX_SINK_ENABLE
+  // Stop writing DMX packets to the output sink
+  if (dmx_sink_is_enabled(dmx_num)) {
+    dmx_sink_disable(dmx_num);
+  }
+#endif
+
+  // Stop mapping DMX packets through the dimming curves
+  if (dmx_curve_is_enabled(dmx_num)) {
+    dmx_curve_disable(dmx_num);
+  }
+
   // Uninstall sniffer ISR
   if (dmx_sniffer_is_enabled(dmx_num)) {
     dmx_sniffer_disable(dmx_num);
   }
 
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+  // Stop sleeping between DMX packets
+  if (dmx_sleep_is_enabled(dmx_num)) {
+    dmx_sleep_disable(dmx_num);
+  }
+#endif
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+  // Stop failing over to or from this port
+  if (dmx_failover_is_enabled(dmx_num)) {
+    dmx_failover_disable(dmx_num);
+  } else if (driver->failover.primary < DMX_NUM_MAX) {
+    dmx_failover_disable(driver->failover.primary);
+  }
+#endif
+
+#ifdef CONFIG_DMX_HEALTH_ENABLE
+  // Stop monitoring the health of the DMX bus
+  if (dmx_health_is_enabled(dmx_num)) {
+    dmx_health_disable(dmx_num);
+  }
+#endif
+
+  // Stop repeating DMX packets to or from this port
+  if (dmx_repeater_is_enabled(dmx_num)) {
+    dmx_repeater_disable(dmx_num);
+  } else if (driver->repeater.input < DMX_NUM_MAX) {
+    dmx_repeater_disable(driver->repeater.input);
+  }
+
+  // Stop sending DMX automatically
+  if (driver->auto_refresh.is_synced) {
+    dmx_sync_group_disable();
+  }
+  if (dmx_auto_refresh_is_enabled(dmx_num)) {
+    dmx_auto_refresh_disable(dmx_num);
+  }
+
   // Free hardware timer ISR
   dmx_timer_deinit(dmx_num);
 
+  // Free the DMA channel
+  dmx_dma_deinit(dmx_num);
+
   // Disable UART module
   dmx_uart_deinit(dmx_num);
 
-  // Free parameters
-  dmx_device_t *device = &driver->device.root;
-  do {
-    int param_count = device->num == RDM_SUB_DEVICE_ROOT
-                          ? driver->device.parameter_count.root
-                          : driver->device.parameter_count.sub_devices;
-    for (int i = 0; i < param_count; ++i) {
-      if (device->parameters[i].pid == 0) {
-        break;  // No more parameters remaining
-      } else if (device->parameters[i].type != DMX_PARAMETER_TYPE_DYNAMIC) {
+  // Free parameters and devices
+  for (int d = 0; d < driver->device.sub_device_table_size || d == 0; ++d) {
+    dmx_device_t *device = d == RDM_SUB_DEVICE_ROOT
+                               ? &driver->device.root
+                               : driver->device.sub_devices[d];
+    if (device == NULL) {
+      continue;  // Sub-device does not exist
+    }
+    for (int i = 0; i < device->num_parameters; ++i) {
+      dmx_free(dmx_num, device->parameters[i].response);
+      const int type = device->parameters[i].type;
+      if (type == DMX_PARAMETER_TYPE_STATIC ||
+          type == DMX_PARAMETER_TYPE_NULL) {
         continue;  // Nothing to free
       }
-      free(device->parameters[i].data);
+      dmx_free(dmx_num, device->parameters[i].data);
+    }
+    if (device != &driver->device.root) {
+      dmx_free(dmx_num, device);  // Can't free root device
     }
-    device = device->next;   
-  } while (device != NULL);
+  }
+  dmx_free(dmx_num, driver->device.sub_devices);
+  dmx_free(dmx_num, driver->device.dispatch);
 
-  // Free devices
-  device = driver->device.root.next;  // Can't free root device
-  while (device != NULL) {
-    dmx_device_t *next_device = device->next;
-    free(device);
-    device = next_device;
-  } 
+  // Free the memory arena unless it is in caller-provided storage
+  const bool is_static = driver->arena.is_static;
+  if (!is_static) {
+    heap_caps_free(driver->arena.base);
+  }
+
+  // Free the event group
+  if (driver->events != NULL) {
+    vEventGroupDelete(driver->events);
+  }
 
   // Free driver
-  heap_caps_free(driver);
+  if (!is_static) {
+    heap_caps_free(driver);
+  }
   dmx_driver[dmx_num] = NULL;
+  if (commit_is_locked) {
+    dmx_parameter_commit_unlock();
+  }
 
   // Free driver mutex
   xSemaphoreGiveRecursive(mux);
@@ -310,6 +839,8 @@ bool dmx_driver_disable(dmx_port_t dmx_num) {
   DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
   DMX_CHECK(dmx_driver_is_enabled(dmx_num), false,
             "driver is already disabled");
+  DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), false,
+            "driver is auto-refreshing");
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
 
@@ -391,10 +922,16 @@ uint32_t dmx_set_baud_rate(dmx_port_t dmx_num, uint32_t baud_rate) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
 
   // Clamp the baud rate to within DMX specification
+  uint32_t baud_rate_max = DMX_BAUD_RATE_MAX;
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+  if (dmx_extended_mode_is_enabled(dmx_num)) {
+    baud_rate_max = DMX_EXTENDED_BAUD_RATE_MAX;
+  }
+#endif
   if (baud_rate < DMX_BAUD_RATE_MIN) {
     baud_rate = DMX_BAUD_RATE_MIN;
-  } else if (baud_rate > DMX_BAUD_RATE_MAX) {
-    baud_rate = DMX_BAUD_RATE_MAX;
+  } else if (baud_rate > baud_rate_max) {
+    baud_rate = baud_rate_max;
   }
 
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
@@ -421,8 +958,18 @@ uint32_t dmx_set_break_len(dmx_port_t dmx_num, uint32_t break_len) {
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
 
   // Clamp the break length to within DMX specification
-  if (break_len < DMX_BREAK_LEN_MIN_US) {
-    break_len = DMX_BREAK_LEN_MIN_US;
+  uint32_t break_len_min = DMX_BREAK_LEN_MIN_US;
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+  if (dmx_extended_mode_is_enabled(dmx_num)) {
+    // Each slot is a start bit, eight data bits, and two stop bits
+    const uint32_t slots_len = 2 * 11 * 1000000 / dmx_get_baud_rate(dmx_num);
+    break_len_min = slots_len > DMX_EXTENDED_BREAK_LEN_MIN_US
+                        ? slots_len
+                        : DMX_EXTENDED_BREAK_LEN_MIN_US;
+  }
+#endif
+  if (break_len < break_len_min) {
+    break_len = break_len_min;
   } else if (break_len > DMX_BREAK_LEN_MAX_US) {
     break_len = DMX_BREAK_LEN_MAX_US;
   }
@@ -451,8 +998,14 @@ uint32_t dmx_set_mab_len(dmx_port_t dmx_num, uint32_t mab_len) {
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
 
   // Clamp the mark-after-break length to within DMX specification
-  if (mab_len < DMX_MAB_LEN_MIN_US) {
-    mab_len = DMX_MAB_LEN_MIN_US;
+  uint32_t mab_len_min = DMX_MAB_LEN_MIN_US;
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+  if (dmx_extended_mode_is_enabled(dmx_num)) {
+    mab_len_min = DMX_EXTENDED_MAB_LEN_MIN_US;
+  }
+#endif
+  if (mab_len < mab_len_min) {
+    mab_len = mab_len_min;
   } else if (mab_len > DMX_MAB_LEN_MAX_US) {
     mab_len = DMX_MAB_LEN_MAX_US;
   }
@@ -464,6 +1017,237 @@ uint32_t dmx_set_mab_len(dmx_port_t dmx_num, uint32_t mab_len) {
   return mab_len;
 }
 
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+bool dmx_set_extended_mode(dmx_port_t dmx_num, bool enable) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Don't change the packet size while a packet is being sent
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23));
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->is_extended = enable;
+  if (!enable && driver->dmx.size > DMX_PACKET_SIZE_MAX) {
+    driver->dmx.size = DMX_PACKET_SIZE_MAX;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Clamp the baud rate and timing back to within DMX specification
+  if (!enable) {
+    dmx_set_baud_rate(dmx_num, dmx_get_baud_rate(dmx_num));
+    dmx_set_break_len(dmx_num, dmx_get_break_len(dmx_num));
+    dmx_set_mab_len(dmx_num, dmx_get_mab_len(dmx_num));
+  }
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return true;
+}
+
+bool dmx_extended_mode_is_enabled(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && dmx_driver_is_installed(dmx_num) &&
+         dmx_driver[dmx_num]->is_extended;
+}
+#endif
+
 const rdm_uid_t *rdm_uid_get(dmx_port_t dmx_num) {
   return dmx_driver_is_installed(dmx_num) ? &dmx_driver[dmx_num]->uid : NULL;
 }
+
+bool dmx_get_turnaround(dmx_port_t dmx_num, dmx_turnaround_t *turnaround) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(turnaround != NULL, false, "turnaround is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  *turnaround = dmx_driver[dmx_num]->turnaround;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+bool dmx_get_stats(dmx_port_t dmx_num, dmx_stats_t *stats) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  int64_t rx_elapsed;
+  int64_t tx_elapsed;
+  uint32_t rx_window_packets;
+  uint32_t tx_window_packets;
+  const int64_t now = dmx_timer_get_micros_since_boot();
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  *stats = driver->stats.counters;
+  stats->turnaround = driver->turnaround;
+  rx_elapsed = now - driver->stats.rx_window_start;
+  tx_elapsed = now - driver->stats.tx_window_start;
+  rx_window_packets = driver->stats.rx_window_packets;
+  tx_window_packets = driver->stats.tx_window_packets;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // The packet rates are only published when packets are counted
+  if (rx_elapsed >= 2000000) {
+    stats->rx_packets_per_second = 0;
+  } else if (rx_elapsed >= 1000000) {
+    stats->rx_packets_per_second = rx_window_packets;
+  }
+  if (tx_elapsed >= 2000000) {
+    stats->tx_packets_per_second = 0;
+  } else if (tx_elapsed >= 1000000) {
+    stats->tx_packets_per_second = tx_window_packets;
+  }
+
+  return true;
+}
+
+bool dmx_reset_stats(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  memset(&driver->stats, 0, sizeof(driver->stats));
+  memset(&driver->turnaround, 0, sizeof(driver->turnaround));
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+int dmx_get_rx_fifo_threshold(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+
+  int threshold;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  threshold = dmx_driver[dmx_num]->rx_fifo_threshold;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return threshold;
+}
+
+int dmx_set_rx_fifo_threshold(dmx_port_t dmx_num, int threshold) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+
+  // Clamp the threshold to the size of the UART FIFO
+  if (threshold < DMX_FIFO_THRESHOLD_ADAPTIVE) {
+    threshold = DMX_FIFO_THRESHOLD_ADAPTIVE;
+  } else if (threshold > DMX_FIFO_THRESHOLD_MAX) {
+    threshold = DMX_FIFO_THRESHOLD_MAX;
+  }
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Adaptive thresholds begin in bulk mode and are updated by the DMX ISR
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->rx_fifo_threshold = threshold;
+  dmx_uart_set_rxfifo_full(dmx_num, threshold == DMX_FIFO_THRESHOLD_ADAPTIVE
+                                        ? DMX_UART_FULL_BULK
+                                        : threshold);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return threshold;
+}
+
+int dmx_get_tx_fifo_threshold(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+
+  int threshold;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  threshold = dmx_driver[dmx_num]->tx_fifo_threshold;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return threshold;
+}
+
+int dmx_set_tx_fifo_threshold(dmx_port_t dmx_num, int threshold) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+
+  // Clamp the threshold to the size of the UART FIFO
+  if (threshold < 1) {
+    threshold = 1;
+  } else if (threshold > DMX_FIFO_THRESHOLD_MAX) {
+    threshold = DMX_FIFO_THRESHOLD_MAX;
+  }
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_driver[dmx_num]->tx_fifo_threshold = threshold;
+  dmx_uart_set_txfifo_empty(dmx_num, threshold);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return threshold;
+}
+
+bool dmx_set_start_code_filter(dmx_port_t dmx_num, int sc, bool accept) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(sc == DMX_START_CODE_ALL || (sc >= 0 && sc <= 255), false,
+            "sc error");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (sc == DMX_START_CODE_ALL) {
+    memset(driver->start_code.accept, accept ? 0xff : 0,
+           sizeof(driver->start_code.accept));
+  } else if (accept) {
+    driver->start_code.accept[sc / 32] |= (1u << (sc % 32));
+  } else {
+    driver->start_code.accept[sc / 32] &= ~(1u << (sc % 32));
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+bool dmx_get_start_code_filter(dmx_port_t dmx_num, uint8_t sc) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  return dmx_start_code_is_accepted(dmx_driver[dmx_num], sc);
+}
+
+bool dmx_set_start_code_callback(dmx_port_t dmx_num, uint8_t sc,
+                                 dmx_start_code_cb_t callback, void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_start_code_is_rdm(sc), false, "sc error");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  struct dmx_driver_start_code_t *const start_code = &driver->start_code;
+
+  bool success = true;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  int i = 0;
+  for (; i < start_code->route_count; ++i) {
+    if (start_code->routes[i].sc == sc) {
+      break;
+    }
+  }
+  if (callback == NULL) {
+    // Remove the route by moving the last route into its place
+    if (i < start_code->route_count) {
+      --start_code->route_count;
+      start_code->routes[i] = start_code->routes[start_code->route_count];
+    }
+  } else if (i < DMX_START_CODE_ROUTE_MAX) {
+    start_code->routes[i].sc = sc;
+    start_code->routes[i].callback = callback;
+    start_code->routes[i].context = context;
+    if (i == start_code->route_count) {
+      ++start_code->route_count;
+    }
+  } else {
+    success = false;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  DMX_CHECK(success, false, "no free start code routes");
+
+  return true;
+}
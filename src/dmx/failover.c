@@ -0,0 +1,221 @@
+#include "dmx/failover.h"
+
+#include "dmx/hal/include/timer.h"
+#include "dmx/health.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+static bool dmx_failover_is_live(dmx_port_t dmx_num, int missed_packets,
+                                 int64_t now) {
+  if (!dmx_health_is_ok(dmx_num)) {
+    return false;
+  }
+
+  // The bus health monitor remembers the last DMX break after RDM responses
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  int64_t break_ts = driver->dmx.rx_break_ts;
+  if (break_ts < driver->health.break_ts) {
+    break_ts = driver->health.break_ts;
+  }
+  const uint32_t period_us = driver->dmx.rx_period_us;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // The packet period is not known until two DMX packets have been received
+  return period_us == 0 ||
+         now - break_ts <= (int64_t)period_us * missed_packets;
+}
+
+static dmx_port_t dmx_failover_select(dmx_driver_t *driver, int64_t now) {
+  struct dmx_driver_failover_t *const failover = &driver->failover;
+  const dmx_port_t primary = driver->dmx_num;
+  const int missed_packets = failover->config.missed_packets;
+  const bool primary_is_live =
+      dmx_failover_is_live(primary, missed_packets, now);
+  const bool backup_is_live =
+      dmx_failover_is_live(failover->backup, missed_packets, now);
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(primary));
+  if (!primary_is_live) {
+    failover->live_ts = 0;
+  } else if (failover->live_ts == 0) {
+    failover->live_ts = now;
+  }
+
+  // Only switch to the other DMX port if it is better than the active port
+  dmx_port_t active = failover->active;
+  if (active == primary) {
+    if (!primary_is_live && backup_is_live) {
+      active = failover->backup;
+    }
+  } else if (primary_is_live &&
+             (!backup_is_live ||
+              now - failover->live_ts >=
+                  (int64_t)failover->config.revert_ms * 1000)) {
+    active = primary;
+  }
+  if (active != failover->active) {
+    failover->active = active;
+    ++failover->switches;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(primary));
+
+  return active;
+}
+
+bool dmx_failover_enable(dmx_port_t primary, dmx_port_t backup,
+                         const dmx_failover_config_t *config) {
+  DMX_CHECK(primary < DMX_NUM_MAX, false, "primary error");
+  DMX_CHECK(backup < DMX_NUM_MAX && backup != primary, false, "backup error");
+  DMX_CHECK(config != NULL, false, "config is null");
+  DMX_CHECK(config->missed_packets > 0, false, "missed_packets error");
+  const dmx_port_t inputs[] = {primary, backup};
+  for (int i = 0; i < 2; ++i) {
+    const dmx_port_t dmx_num = inputs[i];
+    DMX_CHECK(dmx_driver_is_installed(dmx_num), false,
+              "driver is not installed");
+    DMX_CHECK(dmx_driver_is_enabled(dmx_num), false, "driver is not enabled");
+    DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), false,
+              "driver is auto-refreshing");
+    DMX_CHECK(dmx_health_is_enabled(dmx_num), false,
+              "health monitor is not enabled");
+    DMX_CHECK(!dmx_failover_is_enabled(dmx_num) &&
+                  dmx_driver[dmx_num]->failover.primary == DMX_NUM_MAX,
+              false, "port is already in a failover pair");
+  }
+
+  // Start reading the DMX bus on both ports so that the backup is ready
+  dmx_receive(primary, NULL, 0);
+  dmx_receive(backup, NULL, 0);
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(backup));
+  dmx_driver[backup]->failover.primary = primary;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(backup));
+
+  dmx_driver_t *const driver = dmx_driver[primary];
+  taskENTER_CRITICAL(DMX_SPINLOCK(primary));
+  driver->failover.config = *config;
+  driver->failover.active = primary;
+  driver->failover.received = primary;
+  driver->failover.live_ts = 0;
+  driver->failover.switches = 0;
+  driver->failover.primary_packets = 0;
+  driver->failover.backup_packets = 0;
+  driver->failover.backup = backup;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(primary));
+
+  return true;
+}
+
+bool dmx_failover_disable(dmx_port_t primary) {
+  DMX_CHECK(primary < DMX_NUM_MAX, false, "primary error");
+  DMX_CHECK(dmx_failover_is_enabled(primary), false,
+            "failover is not enabled");
+
+  dmx_driver_t *const driver = dmx_driver[primary];
+  taskENTER_CRITICAL(DMX_SPINLOCK(primary));
+  const dmx_port_t backup = driver->failover.backup;
+  driver->failover.backup = DMX_NUM_MAX;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(primary));
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(backup));
+  dmx_driver[backup]->failover.primary = DMX_NUM_MAX;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(backup));
+
+  return true;
+}
+
+bool dmx_failover_is_enabled(dmx_port_t primary) {
+  return primary < DMX_NUM_MAX && dmx_driver_is_installed(primary) &&
+         DMX_LOAD(dmx_driver[primary]->failover.backup) < DMX_NUM_MAX;
+}
+
+size_t dmx_failover_receive(dmx_port_t primary, dmx_packet_t *packet,
+                            TickType_t wait_ticks) {
+  DMX_CHECK(primary < DMX_NUM_MAX, 0, "primary error");
+  DMX_CHECK(dmx_failover_is_enabled(primary), 0, "failover is not enabled");
+
+  dmx_driver_t *const driver = dmx_driver[primary];
+  struct dmx_driver_failover_t *const failover = &driver->failover;
+  DMX_CHECK(dmx_driver_is_enabled(primary) &&
+                dmx_driver_is_enabled(failover->backup),
+            0, "driver is not enabled");
+
+  // Wake at each check of the bus health monitor to pick the active port
+  TickType_t slice = dmx_ms_to_ticks(driver->health.config.interval_ms);
+  if (slice == 0) {
+    slice = 1;  // Block for at least one tick so that the loop yields
+  }
+  TimeOut_t timeout;
+  vTaskSetTimeOutState(&timeout);
+  while (true) {
+    const int64_t now = dmx_timer_get_micros_since_boot();
+    const dmx_port_t active = dmx_failover_select(driver, now);
+    const TickType_t ticks = wait_ticks < slice ? wait_ticks : slice;
+    if (!dmx_driver_is_enabled(active)) {
+      // Wait for the other port to be picked instead of spinning on this one
+      if (wait_ticks == 0) {
+        return 0;
+      }
+      vTaskDelay(ticks);
+      if (xTaskCheckForTimeOut(&timeout, &wait_ticks)) {
+        return 0;
+      }
+      continue;
+    }
+    const size_t size = dmx_receive(active, packet, ticks);
+    if (size > 0) {
+      taskENTER_CRITICAL(DMX_SPINLOCK(primary));
+      failover->received = active;
+      if (active == primary) {
+        ++failover->primary_packets;
+      } else {
+        ++failover->backup_packets;
+      }
+      taskEXIT_CRITICAL(DMX_SPINLOCK(primary));
+      return size;
+    }
+    if (wait_ticks == 0 || xTaskCheckForTimeOut(&timeout, &wait_ticks)) {
+      return 0;
+    }
+  }
+}
+
+size_t dmx_failover_read(dmx_port_t primary, void *destination, size_t size) {
+  DMX_CHECK(primary < DMX_NUM_MAX, 0, "primary error");
+  DMX_CHECK(dmx_failover_is_enabled(primary), 0, "failover is not enabled");
+
+  const dmx_port_t received = DMX_LOAD(dmx_driver[primary]->failover.received);
+
+  return dmx_read(received, destination, size);
+}
+
+dmx_port_t dmx_failover_get_active(dmx_port_t primary) {
+  if (!dmx_failover_is_enabled(primary)) {
+    return DMX_NUM_MAX;
+  }
+
+  return DMX_LOAD(dmx_driver[primary]->failover.active);
+}
+
+bool dmx_failover_get_stats(dmx_port_t primary, dmx_failover_stats_t *stats) {
+  DMX_CHECK(primary < DMX_NUM_MAX, false, "primary error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+
+  if (!dmx_failover_is_enabled(primary)) {
+    return false;
+  }
+
+  const struct dmx_driver_failover_t *const failover =
+      &dmx_driver[primary]->failover;
+  taskENTER_CRITICAL(DMX_SPINLOCK(primary));
+  stats->active = failover->active;
+  stats->switches = failover->switches;
+  stats->primary_packets = failover->primary_packets;
+  stats->backup_packets = failover->backup_packets;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(primary));
+
+  return true;
+}
+#endif
@@ -0,0 +1,146 @@
+/**
+ * @file dmx/failover.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the redundant input mode of the DMX driver. Two
+ * DMX ports receive the same DMX universe from a primary and a backup console.
+ * The packets of only one of them, the active port, are returned by
+ * dmx_failover_receive() and dmx_failover_read(), so that a single wait and a
+ * single copy are needed for each DMX packet. The bus health monitors of both
+ * DMX ports decide which port is active. The active port is switched as soon
+ * as the primary misses DMX packets, loses its signal, or has an error burst,
+ * and is switched back once the primary has been healthy for a while. The
+ * redundant input mode is only available when CONFIG_DMX_FAILOVER_ENABLE is
+ * set.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief Configuration settings of the redundant input mode.*/
+typedef struct dmx_failover_config_t {
+  /** @brief The number of DMX packet periods without a DMX break after which
+     the active port is no longer used. The period is measured by the DMX
+     driver. This is usually much faster than the loss timeout of the bus
+     health monitor.*/
+  uint8_t missed_packets;
+  /** @brief The time in milliseconds for which the primary must be healthy
+     before its packets are used again, or 0 to switch back as soon as it is
+     healthy.*/
+  uint32_t revert_ms;
+} dmx_failover_config_t;
+
+/** @brief The default configuration of the redundant input mode.*/
+#define DMX_FAILOVER_CONFIG_DEFAULT              \
+  (dmx_failover_config_t) {                      \
+    2,            /*missed_packets*/             \
+        1000,     /*revert_ms*/                  \
+  }
+
+/** @brief Statistics of the redundant input mode.*/
+typedef struct dmx_failover_stats_t {
+  /** @brief The DMX port whose packets are currently used.*/
+  dmx_port_t active;
+  /** @brief The number of times that the active port was switched.*/
+  uint32_t switches;
+  /** @brief The number of packets which were received from the primary.*/
+  uint32_t primary_packets;
+  /** @brief The number of packets which were received from the backup.*/
+  uint32_t backup_packets;
+} dmx_failover_stats_t;
+
+/**
+ * @brief Enables the redundant input mode on a pair of DMX ports. The bus
+ * health monitor must be enabled on both DMX ports. Both DMX ports are set to
+ * receive so that the backup is ready as soon as it is needed. The primary is
+ * the active port when this function returns.
+ *
+ * @note dmx_receive() must not be called on either DMX port while the
+ * redundant input mode is enabled. If the primary is an input of the DMX merge
+ * engine, its packets are taken from the active port.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @param backup The DMX port number of the backup input.
+ * @param[in] config The configuration of the redundant input mode.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_failover_enable(dmx_port_t primary, dmx_port_t backup,
+                         const dmx_failover_config_t *config);
+
+/**
+ * @brief Disables the redundant input mode of a pair of DMX ports.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_failover_disable(dmx_port_t primary);
+
+/**
+ * @brief Checks if the redundant input mode is enabled with a DMX port as its
+ * primary input.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @return true if the redundant input mode is enabled.
+ * @return false if it is not.
+ */
+bool dmx_failover_is_enabled(dmx_port_t primary);
+
+/**
+ * @brief Receives a DMX packet from the active port of a pair of redundant DMX
+ * ports. This function behaves like dmx_receive(), but wakes at each check of
+ * the bus health monitor so that it may switch to the other DMX port while it
+ * is waiting.
+ *
+ * @note This function uses FreeRTOS direct-to-task notifications to block and
+ * unblock. Using task notifications on the same task that calls this function
+ * can lead to undesired behavior and program instability.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @param[out] packet An optional pointer to a dmx_packet_t which contains
+ * information about the received DMX packet.
+ * @param wait_ticks The number of ticks to wait before this function times out.
+ * @return The size of the received DMX packet or 0 if no packet was received.
+ */
+size_t dmx_failover_receive(dmx_port_t primary, dmx_packet_t *packet,
+                            TickType_t wait_ticks);
+
+/**
+ * @brief Reads the DMX packet which was last returned by
+ * dmx_failover_receive() from the DMX port which received it.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @param[out] destination The destination buffer into which to read the data.
+ * @param size The size of the destination buffer.
+ * @return The number of bytes read from the DMX driver.
+ */
+size_t dmx_failover_read(dmx_port_t primary, void *destination, size_t size);
+
+/**
+ * @brief Gets the DMX port whose packets are currently used.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @return The active DMX port, or DMX_NUM_MAX if the redundant input mode is
+ * not enabled.
+ */
+dmx_port_t dmx_failover_get_active(dmx_port_t primary);
+
+/**
+ * @brief Gets the statistics of the redundant input mode since it was enabled.
+ *
+ * @param primary The DMX port number of the primary input.
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false if the redundant input mode is not enabled.
+ */
+bool dmx_failover_get_stats(dmx_port_t primary, dmx_failover_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
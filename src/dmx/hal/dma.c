@@ -0,0 +1,118 @@
+#include "include/dma.h"
+
+#include "dmx/include/service.h"
+
+#ifdef DMX_DMA_IS_SUPPORTED
+#include "esp_private/gdma.h"
+#include "esp_private/periph_ctrl.h"
+#include "hal/dma_types.h"
+#include "hal/uhci_ll.h"
+#include "hal/uhci_types.h"
+#include "soc/uhci_struct.h"
+#endif
+
+static struct dmx_dma_t {
+#ifdef DMX_DMA_IS_SUPPORTED
+  gdma_channel_handle_t tx_channel;  // The GDMA channel used to send data.
+  dma_descriptor_t tx_descriptor;  // The DMA descriptor for outgoing packets.
+#endif
+  bool tx_is_enabled;
+} dmx_dma_context[DMX_NUM_MAX] = {};
+
+#ifdef DMX_DMA_IS_SUPPORTED
+static int dmx_dma_owner = -1;  // The DMX port that owns the UHCI peripheral.
+#endif
+
+bool dmx_dma_init(dmx_port_t dmx_num, int flags) {
+#ifdef DMX_DMA_IS_SUPPORTED
+  struct dmx_dma_t *dma = &dmx_dma_context[dmx_num];
+
+  if (!(flags & DMX_DMA_FLAG_TX)) {
+    return false;  // No DMA functionality was requested
+  } else if (dmx_dma_owner != -1) {
+    return false;  // The UHCI peripheral is already in use
+  }
+
+  // Allocate and connect the GDMA transmit channel
+  gdma_channel_alloc_config_t tx_channel_config = {
+      .direction = GDMA_CHANNEL_DIRECTION_TX,
+  };
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+  if (gdma_new_ahb_channel(&tx_channel_config, &dma->tx_channel) != ESP_OK) {
+    return false;
+  }
+#else
+  if (gdma_new_channel(&tx_channel_config, &dma->tx_channel) != ESP_OK) {
+    return false;
+  }
+#endif
+  if (gdma_connect(dma->tx_channel, GDMA_MAKE_TRIGGER(GDMA_TRIG_PERIPH_UHCI,
+                                                      0)) != ESP_OK) {
+    gdma_del_channel(dma->tx_channel);
+    return false;
+  }
+
+  // Initialize UHCI without SLIP framing so that DMX data is sent unaltered
+  periph_module_enable(PERIPH_UHCI0_MODULE);
+  periph_module_reset(PERIPH_UHCI0_MODULE);
+  uhci_ll_init(&UHCI0);
+  uhci_seper_chr_t seper_chr = {.sub_chr_en = 0};
+  uhci_ll_set_seper_chr(&UHCI0, &seper_chr);
+  uhci_ll_attach_uart_port(&UHCI0, -1);  // Attached only while sending
+
+  dma->tx_descriptor.next = NULL;
+  dma->tx_is_enabled = true;
+  dmx_dma_owner = dmx_num;
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+void dmx_dma_deinit(dmx_port_t dmx_num) {
+#ifdef DMX_DMA_IS_SUPPORTED
+  struct dmx_dma_t *dma = &dmx_dma_context[dmx_num];
+  if (!dma->tx_is_enabled) {
+    return;
+  }
+
+  gdma_stop(dma->tx_channel);
+  gdma_disconnect(dma->tx_channel);
+  gdma_del_channel(dma->tx_channel);
+  uhci_ll_attach_uart_port(&UHCI0, -1);
+  periph_module_disable(PERIPH_UHCI0_MODULE);
+
+  dma->tx_is_enabled = false;
+  dmx_dma_owner = -1;
+#endif
+}
+
+bool DMX_ISR_ATTR dmx_dma_tx_is_enabled(dmx_port_t dmx_num) {
+  return dmx_dma_context[dmx_num].tx_is_enabled;
+}
+
+void DMX_ISR_ATTR dmx_dma_write(dmx_port_t dmx_num, const void *buf,
+                                size_t size) {
+#ifdef DMX_DMA_IS_SUPPORTED
+  struct dmx_dma_t *dma = &dmx_dma_context[dmx_num];
+
+  // A DMX packet always fits within a single DMA descriptor
+  dma->tx_descriptor.dw0.size = size;
+  dma->tx_descriptor.dw0.length = size;
+  dma->tx_descriptor.dw0.suc_eof = 1;
+  dma->tx_descriptor.dw0.owner = DMA_DESCRIPTOR_BUFFER_OWNER_DMA;
+  dma->tx_descriptor.buffer = (void *)buf;
+
+  uhci_ll_attach_uart_port(&UHCI0, dmx_num);
+  gdma_reset(dma->tx_channel);
+  gdma_start(dma->tx_channel, (intptr_t)&dma->tx_descriptor);
+#endif
+}
+
+void DMX_ISR_ATTR dmx_dma_write_done(dmx_port_t dmx_num) {
+#ifdef DMX_DMA_IS_SUPPORTED
+  // Detach the UHCI so that it does not consume received data
+  uhci_ll_attach_uart_port(&UHCI0, -1);
+#endif
+}
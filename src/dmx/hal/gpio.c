@@ -22,16 +22,21 @@ static void DMX_ISR_ATTR dmx_gpio_isr(void *arg) {
 
   if (dmx_gpio_read(dmx_num)) {
     /* If this ISR is called on a positive edge and the current DMX frame is in
-    a break and a negative edge timestamp has been recorded then a break has
-    just finished. Therefore the DMX break length is able to be recorded. It can
-    also be deduced that the driver is now in a DMX mark-after-break. */
+    a break then a break has just finished. If the negative edge which started
+    the break was seen, the DMX break length is able to be recorded. It can also
+    be deduced that the driver is now in a DMX mark-after-break. */
 
-    if (driver->dmx.progress == DMX_PROGRESS_IN_BREAK &&
-        driver->sniffer.last_neg_edge_ts > -1) {
+    if (driver->dmx.progress == DMX_PROGRESS_IN_BREAK) {
       taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
       driver->sniffer.buffer_index = !driver->sniffer.buffer_index;
       driver->sniffer.metadata[driver->sniffer.buffer_index].break_len =
-          now - driver->sniffer.last_neg_edge_ts;
+          driver->sniffer.last_neg_edge_ts > -1
+              ? now - driver->sniffer.last_neg_edge_ts
+              : 0;
+      driver->sniffer.break_ts = driver->sniffer.last_neg_edge_ts > -1
+                                     ? driver->sniffer.last_neg_edge_ts
+                                     : 0;
+      driver->sniffer.is_measured = false;
       taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
       driver->dmx.progress = DMX_PROGRESS_IN_MAB;
     }
@@ -39,14 +44,18 @@ static void DMX_ISR_ATTR dmx_gpio_isr(void *arg) {
   } else {
     /* If this ISR is called on a negative edge in a DMX mark-after-break then
     the DMX mark-after-break has just finished. It can be recorded. Sniffer data
-    is now available to be read by the user. */
+    is now available to be read by the user. The edges of the DMX slots are not
+    needed, so the interrupt is disabled until the end of the packet. */
 
     if (driver->dmx.progress == DMX_PROGRESS_IN_MAB) {
       taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
       driver->sniffer.metadata[driver->sniffer.buffer_index].mab_len =
           now - driver->sniffer.last_pos_edge_ts;
+      driver->sniffer.is_armed = false;
+      driver->sniffer.is_measured = true;
       taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
       driver->dmx.progress = DMX_PROGRESS_IN_DATA;
+      dmx_gpio_disable_interrupt(dmx_num);
     }
     driver->sniffer.last_neg_edge_ts = now;
   }
@@ -71,3 +80,15 @@ int DMX_ISR_ATTR dmx_gpio_read(dmx_port_t dmx_num) {
   struct dmx_gpio_t *gpio = &dmx_gpio_context[dmx_num];
   return gpio_ll_get_level(GPIO_LL_GET_HW(GPIO_PORT_0), gpio->sniffer_pin);
 }
+
+void DMX_ISR_ATTR dmx_gpio_enable_interrupt(dmx_port_t dmx_num) {
+  struct dmx_gpio_t *gpio = &dmx_gpio_context[dmx_num];
+  gpio_ll_set_intr_type(GPIO_LL_GET_HW(GPIO_PORT_0), gpio->sniffer_pin,
+                        GPIO_INTR_ANYEDGE);
+}
+
+void DMX_ISR_ATTR dmx_gpio_disable_interrupt(dmx_port_t dmx_num) {
+  struct dmx_gpio_t *gpio = &dmx_gpio_context[dmx_num];
+  gpio_ll_set_intr_type(GPIO_LL_GET_HW(GPIO_PORT_0), gpio->sniffer_pin,
+                        GPIO_INTR_DISABLE);
+}
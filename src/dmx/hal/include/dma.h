@@ -0,0 +1,74 @@
+/**
+ * @file dmx/hal/include/dma.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file is the DMA Hardware Abstraction Layer (HAL) of esp_dmx. It
+ * contains low-level functions to perform tasks relating to the UHCI and GDMA
+ * hardware. DMA is used to move DMX packets from the DMX driver buffer into the
+ * UART without needing an interrupt each time the UART FIFO is emptied. This
+ * file is not considered part of the API and should not be included by the
+ * user.
+ */
+#pragma once
+
+#include "dmx/include/types.h"
+#include "soc/soc_caps.h"
+
+#if ESP_IDF_VERSION_MAJOR >= 5 && SOC_GDMA_SUPPORTED && \
+    defined(SOC_UHCI_NUM) && SOC_UHCI_NUM > 0
+/** @brief This macro is used to conditionally compile DMA functionality on
+ * targets which have a UHCI peripheral that is connected to GDMA.*/
+#define DMX_DMA_IS_SUPPORTED
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initializes the DMX DMA. Only one DMX port may use DMA at a time
+ * because there is only one UHCI peripheral.
+ *
+ * @param dmx_num The DMX port number.
+ * @param flags The DMA flags to use, a mask of enum dmx_dma_flag_t.
+ * @return true on success.
+ * @return false if DMA is not supported or is already in use.
+ */
+bool dmx_dma_init(dmx_port_t dmx_num, int flags);
+
+/**
+ * @brief De-initializes the DMX DMA.
+ *
+ * @param dmx_num The DMX port number.
+ */
+void dmx_dma_deinit(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the DMX port uses DMA to send DMX packets.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if DMA is used to send DMX packets.
+ * @return false if the UART FIFO is written by the DMX ISR.
+ */
+bool dmx_dma_tx_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Starts a DMA transfer from a buffer into the UART. The buffer must be
+ * DMA-capable and must not be modified until the transfer has finished.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] buf The buffer to send.
+ * @param size The number of bytes to send.
+ */
+void dmx_dma_write(dmx_port_t dmx_num, const void *buf, size_t size);
+
+/**
+ * @brief Detaches the DMA from the UART after a transfer has been sent. This
+ * should be called once the UART has finished sending the DMX packet.
+ *
+ * @param dmx_num The DMX port number.
+ */
+void dmx_dma_write_done(dmx_port_t dmx_num);
+
+#ifdef __cplusplus
+}
+#endif
@@ -60,6 +60,20 @@ void dmx_gpio_deinit(dmx_port_t dmx_num);
  */
 int dmx_gpio_read(dmx_port_t dmx_num);
 
+/**
+ * @brief Enables the interrupt on both edges of the DMX sniffer GPIO.
+ *
+ * @param dmx_num The DMX port number.
+ */
+void dmx_gpio_enable_interrupt(dmx_port_t dmx_num);
+
+/**
+ * @brief Disables the interrupt of the DMX sniffer GPIO.
+ *
+ * @param dmx_num The DMX port number.
+ */
+void dmx_gpio_disable_interrupt(dmx_port_t dmx_num);
+
 #ifdef __cplusplus
 }
 #endif
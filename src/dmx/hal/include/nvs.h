@@ -16,13 +16,62 @@
 extern "C" {
 #endif
 
+/** @brief A parameter which is to be written to non-volatile storage.*/
+typedef struct dmx_nvs_entry_t {
+  dmx_port_t dmx_num;           // The DMX port number.
+  rdm_sub_device_t sub_device;  // The sub-device which owns the parameter.
+  rdm_pid_t pid;                // The parameter ID.
+  const void *data;             // A pointer to the parameter data.
+  size_t size;                  // The size of the parameter data.
+} dmx_nvs_entry_t;
+
 /**
- * @brief Initialize non-volatile storage.
+ * @brief Initialize non-volatile storage. The NVS partition is only
+ * initialized once, the first time that it is read or written, so this
+ * function needn't be called before the other functions in this file.
  *
  * @param dmx_num The DMX port number.
  */
 void dmx_nvs_init(dmx_port_t dmx_num);
 
+/**
+ * @brief Begins a bulk load of parameters from non-volatile storage. Until
+ * dmx_nvs_load_end() is called, calls to dmx_nvs_get() on this DMX port share
+ * a single NVS handle and DMX drivers are disabled only once, instead of once
+ * per parameter. This should be used when many parameters are restored at
+ * once, such as when the DMX driver is installed.
+ *
+ * If the load is deferred, calls to dmx_nvs_get() fail without accessing NVS
+ * and their keys are kept so that the parameters can be loaded later with
+ * dmx_nvs_take_deferred(). Once the list of deferred keys is full, further
+ * parameters are read from NVS immediately.
+ *
+ * @param dmx_num The DMX port number.
+ * @param is_deferred True to defer loading the parameters.
+ */
+void dmx_nvs_load_begin(dmx_port_t dmx_num, bool is_deferred);
+
+/**
+ * @brief Ends a bulk load of parameters from non-volatile storage which was
+ * started with dmx_nvs_load_begin().
+ *
+ * @param dmx_num The DMX port number.
+ */
+void dmx_nvs_load_end(dmx_port_t dmx_num);
+
+/**
+ * @brief Takes the keys of the parameters whose loads were deferred on a DMX
+ * port. The data of each entry is NULL and its size is the size which was
+ * requested from dmx_nvs_get(). The keys are cleared by this function.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] entries An array into which to copy the keys.
+ * @param max The maximum number of keys to copy.
+ * @return The number of keys which were copied.
+ */
+size_t dmx_nvs_take_deferred(dmx_port_t dmx_num, dmx_nvs_entry_t *entries,
+                             size_t max);
+
 /**
  * @brief Gets parameter data from non-volatile storage.
  *
@@ -50,6 +99,18 @@ size_t dmx_nvs_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 bool dmx_nvs_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device, rdm_pid_t pid,
                  const void *param, size_t size);
 
+/**
+ * @brief Sets several parameters to non-volatile storage using a single NVS
+ * handle and a single NVS commit. When the DMX driver is not in IRAM, DMX
+ * drivers are disabled only once for the entire batch of parameters. Nothing
+ * is written if any enabled DMX driver cannot be disabled. Parameters are
+ * written in order and writing stops at the first parameter which fails.
+ * @param[in] entries An array of parameters to write.
+ * @param num The number of parameters in the array.
+ * @return The number of leading parameters written, or 0 on failure.
+ */
+size_t dmx_nvs_set_many(const dmx_nvs_entry_t *entries, size_t num);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,13 +17,30 @@
 extern "C" {
 #endif
 
+/** @brief The default UART RX FIFO full threshold. Interrupting on every byte
+ * is needed to enforce RDM responder inter-slot timing.*/
+#define DMX_UART_FULL_DEFAULT 1
+
+/** @brief The UART RX FIFO full threshold used when inter-slot timing does not
+ * need to be enforced. The RX timeout interrupt delivers any remaining bytes at
+ * the end of each packet.*/
+#define DMX_UART_FULL_BULK 100
+
+/** @brief The default UART TX FIFO empty threshold.*/
+#define DMX_UART_EMPTY_DEFAULT 8
+
+/** @brief The number of UART bit periods that the RX line must be idle before
+ * the RX timeout interrupt is triggered.*/
+#define DMX_UART_TIMEOUT_DEFAULT 45
+
 enum dmx_interrupt_mask_t {
   DMX_INTR_RX_FIFO_OVERFLOW = UART_INTR_RXFIFO_OVF,
   DMX_INTR_RX_FRAMING_ERR = UART_INTR_PARITY_ERR | UART_INTR_FRAM_ERR,
   DMX_INTR_RX_ERR = DMX_INTR_RX_FIFO_OVERFLOW | DMX_INTR_RX_FRAMING_ERR,
 
   DMX_INTR_RX_BREAK = UART_INTR_BRK_DET,
-  DMX_INTR_RX_DATA = UART_INTR_RXFIFO_FULL,
+  DMX_INTR_RX_TIMEOUT = UART_INTR_RXFIFO_TOUT,
+  DMX_INTR_RX_DATA = UART_INTR_RXFIFO_FULL | DMX_INTR_RX_TIMEOUT,
   DMX_INTR_RX_ALL = DMX_INTR_RX_DATA | DMX_INTR_RX_BREAK | DMX_INTR_RX_ERR,
 
   DMX_INTR_TX_DATA = UART_INTR_TXFIFO_EMPTY,
@@ -141,6 +158,24 @@ uint32_t dmx_uart_get_rxfifo_len(dmx_port_t dmx_num);
  */
 void dmx_uart_read_rxfifo(dmx_port_t dmx_num, uint8_t *buf, int *size);
 
+/**
+ * @brief Sets the number of bytes that must be in the UART RX FIFO before the
+ * RX FIFO full interrupt is triggered.
+ *
+ * @param dmx_num The DMX port number.
+ * @param threshold The RX FIFO full threshold.
+ */
+void dmx_uart_set_rxfifo_full(dmx_port_t dmx_num, int threshold);
+
+/**
+ * @brief Sets the number of bytes that may remain in the UART TX FIFO before
+ * the TX FIFO empty interrupt is triggered.
+ *
+ * @param dmx_num The DMX port number.
+ * @param threshold The TX FIFO empty threshold.
+ */
+void dmx_uart_set_txfifo_empty(dmx_port_t dmx_num, int threshold);
+
 /**
  * @brief Enables or disables the UART RTS line.
  *
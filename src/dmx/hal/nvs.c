@@ -1,8 +1,12 @@
 #include "include/nvs.h"
 
+#include <string.h>
+
 #include "dmx/include/service.h"
 #include "esp_dmx.h"
+#ifndef CONFIG_DMX_NVS_DISABLE
 #include "nvs_flash.h"
+#endif
 
 #ifndef CONFIG_DMX_NVS_PARTITION_NAME
 #define DMX_NVS_PARTITION_NAME "nvs"
@@ -11,9 +15,62 @@
 #endif
 
 #define DMX_NVS_KEY_SIZE_MAX (16)
+#define DMX_NVS_DEFERRED_MAX (8)
+
+static struct dmx_nvs_deferred_t {
+  bool is_deferring;  // True if a deferred bulk load is in progress.
+  int count;          // The number of parameters whose loads were deferred.
+  dmx_nvs_entry_t entries[DMX_NVS_DEFERRED_MAX];  // The deferred parameters.
+} dmx_nvs_deferred[DMX_NUM_MAX] = {};
+
+size_t dmx_nvs_take_deferred(dmx_port_t dmx_num, dmx_nvs_entry_t *entries,
+                             size_t max) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(entries != NULL || max == 0);
 
+  struct dmx_nvs_deferred_t *const deferred = &dmx_nvs_deferred[dmx_num];
+  size_t num = deferred->count < max ? deferred->count : max;
+  memcpy(entries, deferred->entries, sizeof(*entries) * num);
+  deferred->count = 0;
+
+  return num;
+}
+
+#ifndef CONFIG_DMX_NVS_DISABLE
 static const char *dmx_nvs_namespace = "esp_dmx";
 
+static bool dmx_nvs_is_init = false;
+
+static bool dmx_nvs_defer_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
+                              rdm_pid_t pid, size_t size) {
+  struct dmx_nvs_deferred_t *const deferred = &dmx_nvs_deferred[dmx_num];
+  if (!deferred->is_deferring) {
+    return false;
+  }
+
+  // Parameters beyond the limit are read now instead of keeping their defaults
+  if (deferred->count >= DMX_NVS_DEFERRED_MAX) {
+    return false;
+  }
+  dmx_nvs_entry_t *const entry = &deferred->entries[deferred->count];
+  entry->dmx_num = dmx_num;
+  entry->sub_device = sub_device;
+  entry->pid = pid;
+  entry->data = NULL;
+  entry->size = size;
+  ++deferred->count;
+  return true;
+}
+
+static struct dmx_nvs_load_t {
+  bool is_loading;  // True if a bulk load of parameters is in progress.
+  esp_err_t err;    // The result of opening the NVS handle for the bulk load.
+  nvs_handle_t nvs;  // The NVS handle which is shared during the bulk load.
+#ifndef DMX_ISR_IN_IRAM
+  bool driver_is_enabled[DMX_NUM_MAX];  // Drivers to re-enable after loading.
+#endif
+} dmx_nvs_load[DMX_NUM_MAX] = {};
+
 static void dmx_nvs_get_key(char *key, dmx_port_t dmx_num,
                             rdm_sub_device_t sub_device, rdm_pid_t pid) {
   const int w =
@@ -22,8 +79,103 @@ static void dmx_nvs_get_key(char *key, dmx_port_t dmx_num,
   assert(w < DMX_NVS_KEY_SIZE_MAX);
 }
 
+#ifndef DMX_ISR_IN_IRAM
+static bool dmx_nvs_disable_drivers(bool *driver_is_enabled) {
+  // Track which drivers are currently enabled and disable those which are
+  bool ret = true;
+  for (int i = 0; i < DMX_NUM_MAX; ++i) {
+    driver_is_enabled[i] = dmx_driver_is_enabled(i);
+    if (driver_is_enabled[i] && !dmx_driver_disable(i)) {
+      driver_is_enabled[i] = false;
+      ret = false;
+    }
+  }
+
+  // Re-enable the drivers which were disabled if any of them failed
+  if (!ret) {
+    for (int i = 0; i < DMX_NUM_MAX; ++i) {
+      if (driver_is_enabled[i]) {
+        dmx_driver_enable(i);
+      }
+    }
+  }
+
+  return ret;
+}
+#endif
+
 void dmx_nvs_init(dmx_port_t dmx_num) {
-  nvs_flash_init_partition(DMX_NVS_PARTITION_NAME);
+  // Initializing the partition scans the flash, so it is only done once
+  if (!dmx_nvs_is_init) {
+    nvs_flash_init_partition(DMX_NVS_PARTITION_NAME);
+    dmx_nvs_is_init = true;
+  }
+}
+
+void dmx_nvs_load_begin(dmx_port_t dmx_num, bool is_deferred) {
+  assert(dmx_num < DMX_NUM_MAX);
+
+  struct dmx_nvs_load_t *const load = &dmx_nvs_load[dmx_num];
+  assert(!load->is_loading);
+
+  // Keep the keys of deferred loads without touching the flash
+  if (is_deferred) {
+    dmx_nvs_deferred[dmx_num].is_deferring = true;
+    return;
+  }
+
+  // Open the NVS namespace once for every parameter which is to be loaded
+  dmx_nvs_init(dmx_num);
+  load->err = nvs_open(dmx_nvs_namespace, NVS_READONLY, &load->nvs);
+  load->is_loading = true;
+  if (load->err) {
+    return;  // Nothing has been stored in NVS yet
+  }
+
+#ifndef DMX_ISR_IN_IRAM
+  // Do not read the flash while a DMX driver could not be disabled
+  if (!dmx_nvs_disable_drivers(load->driver_is_enabled)) {
+    nvs_close(load->nvs);
+    load->err = ESP_ERR_INVALID_STATE;
+  }
+#endif
+}
+
+void dmx_nvs_load_end(dmx_port_t dmx_num) {
+  assert(dmx_num < DMX_NUM_MAX);
+
+  dmx_nvs_deferred[dmx_num].is_deferring = false;
+  struct dmx_nvs_load_t *const load = &dmx_nvs_load[dmx_num];
+  if (!load->is_loading) {
+    return;
+  }
+
+  if (!load->err) {
+#ifndef DMX_ISR_IN_IRAM
+    for (int i = 0; i < DMX_NUM_MAX; ++i) {
+      if (load->driver_is_enabled[i]) {
+        dmx_driver_enable(i);
+      }
+    }
+#endif
+    nvs_close(load->nvs);
+  }
+  load->is_loading = false;
+}
+
+static esp_err_t dmx_nvs_read(nvs_handle_t nvs, const char *key, void *param,
+                              size_t *size) {
+  // Read the parameter from NVS depending on its type
+  switch (*size) {
+    case sizeof(uint8_t):
+      return nvs_get_u8(nvs, key, param);
+    case sizeof(uint16_t):
+      return nvs_get_u16(nvs, key, param);
+    case sizeof(uint32_t):
+      return nvs_get_u32(nvs, key, param);
+    default:
+      return nvs_get_blob(nvs, key, param, size);
+  }
 }
 
 size_t dmx_nvs_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
@@ -35,52 +187,30 @@ size_t dmx_nvs_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 
   if (size == 0) {
     return size;
+  } else if (dmx_nvs_defer_get(dmx_num, sub_device, pid, size)) {
+    return 0;
   }
 
   // Get the NVS key
   char key[DMX_NVS_KEY_SIZE_MAX];
   dmx_nvs_get_key(key, dmx_num, sub_device, pid);
 
+  // Use the shared NVS handle if a bulk load is in progress
+  const struct dmx_nvs_load_t *const load = &dmx_nvs_load[dmx_num];
+  if (load->is_loading) {
+    if (load->err || dmx_nvs_read(load->nvs, key, param, &size)) {
+      size = 0;
+    }
+    return size;
+  }
+
+  // A single read is shorter than the UART FIFO takes to fill, so the DMX
+  // drivers needn't be disabled even if their ISRs are deferred by the read
+  dmx_nvs_init(dmx_num);
   nvs_handle_t nvs;
   esp_err_t err = nvs_open(dmx_nvs_namespace, NVS_READONLY, &nvs);
   if (!err) {
-#ifndef DMX_ISR_IN_IRAM
-    // Track which drivers are currently enabled and disable those which are
-    bool driver_is_enabled[DMX_NUM_MAX];
-    for (int i = 0; i < DMX_NUM_MAX; ++i) {
-      driver_is_enabled[i] = dmx_driver_is_enabled(i);
-      if (dmx_driver_is_installed(i)) {
-        dmx_driver_disable(i);
-      }
-    }
-#endif
-
-    // Read the parameter from NVS depending on its type
-    switch (size) {
-      case sizeof(uint8_t):
-        err = nvs_get_u8(nvs, key, param);
-        size = sizeof(uint8_t);
-        break;
-      case sizeof(uint16_t):
-        err = nvs_get_u16(nvs, key, param);
-        size = sizeof(uint16_t);
-        break;
-      case sizeof(uint32_t):
-        err = nvs_get_u32(nvs, key, param);
-        size = sizeof(uint32_t);
-        break;
-      default:
-        err = nvs_get_blob(nvs, key, param, &size);
-    }
-
-#ifndef DMX_ISR_IN_IRAM
-    for (int i = 0; i < DMX_NUM_MAX; ++i) {
-      if (driver_is_enabled[i]) {
-        dmx_driver_enable(i);
-      }
-    }
-#endif
-
+    err = dmx_nvs_read(nvs, key, param, &size);
     nvs_close(nvs);
   }
 
@@ -98,56 +228,109 @@ bool dmx_nvs_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device, rdm_pid_t pid,
   assert(sub_device < 513);
   assert(param != NULL);
 
-  if (size == 0) {
-    return true;
-  }
+  const dmx_nvs_entry_t entry = {.dmx_num = dmx_num,
+                                 .sub_device = sub_device,
+                                 .pid = pid,
+                                 .data = param,
+                                 .size = size};
 
-  // Get the NVS key
-  char key[DMX_NVS_KEY_SIZE_MAX];
-  dmx_nvs_get_key(key, dmx_num, sub_device, pid);
+  return dmx_nvs_set_many(&entry, 1) == 1;
+}
+
+size_t dmx_nvs_set_many(const dmx_nvs_entry_t *entries, size_t num) {
+  assert(entries != NULL || num == 0);
+
+  if (num == 0) {
+    return 0;
+  }
 
+  dmx_nvs_init(entries[0].dmx_num);
   nvs_handle_t nvs;
   esp_err_t err = nvs_open(dmx_nvs_namespace, NVS_READWRITE, &nvs);
-  if (!err) {
+  if (err) {
+    return 0;
+  }
+
 #ifndef DMX_ISR_IN_IRAM
-    // Track which drivers are currently enabled and disable those which are
-    bool driver_is_enabled[DMX_NUM_MAX];
-    for (int i = 0; i < DMX_NUM_MAX; ++i) {
-      driver_is_enabled[i] = dmx_driver_is_enabled(i);
-      if (dmx_driver_is_installed(i)) {
-        dmx_driver_disable(i);
-      }
-    }
+  // Do not write the flash while a DMX driver could not be disabled
+  bool driver_is_enabled[DMX_NUM_MAX];
+  if (!dmx_nvs_disable_drivers(driver_is_enabled)) {
+    nvs_close(nvs);
+    return 0;
+  }
 #endif
 
-    // Write the parameter to NVS depending on its type
-    switch (size) {
+  // Write each parameter to NVS depending on its type
+  size_t written = 0;
+  for (size_t i = 0; i < num; ++i) {
+    const dmx_nvs_entry_t *const entry = &entries[i];
+    assert(entry->dmx_num < DMX_NUM_MAX);
+    assert(entry->pid > 0);
+    assert(entry->data != NULL);
+    if (entry->size == 0) {
+      ++written;
+      continue;
+    }
+
+    // Get the NVS key
+    char key[DMX_NVS_KEY_SIZE_MAX];
+    dmx_nvs_get_key(key, entry->dmx_num, entry->sub_device, entry->pid);
+
+    switch (entry->size) {
       case sizeof(uint8_t):
-        err = nvs_set_u8(nvs, key, *(uint8_t *)param);
+        err = nvs_set_u8(nvs, key, *(uint8_t *)entry->data);
         break;
       case sizeof(uint16_t):
-        err = nvs_set_u16(nvs, key, *(uint16_t *)param);
+        err = nvs_set_u16(nvs, key, *(uint16_t *)entry->data);
         break;
       case sizeof(uint32_t):
-        err = nvs_set_u32(nvs, key, *(uint32_t *)param);
+        err = nvs_set_u32(nvs, key, *(uint32_t *)entry->data);
         break;
       default:
-        err = nvs_set_blob(nvs, key, param, size);
+        err = nvs_set_blob(nvs, key, entry->data, entry->size);
     }
-    if (!err) {
-      err = nvs_commit(nvs);
+    if (err) {
+      break;  // Stop so that the written parameters are the leading entries
     }
+    ++written;
+  }
+
+  // Commit all of the parameters at once
+  if (nvs_commit(nvs) != ESP_OK) {
+    written = 0;
+  }
 
 #ifndef DMX_ISR_IN_IRAM
-    for (int i = 0; i < DMX_NUM_MAX; ++i) {
-      if (driver_is_enabled[i]) {
-        dmx_driver_enable(i);
-      }
+  for (int i = 0; i < DMX_NUM_MAX; ++i) {
+    if (driver_is_enabled[i]) {
+      dmx_driver_enable(i);
     }
+  }
 #endif
 
-    nvs_close(nvs);
-  }
+  nvs_close(nvs);
+
+  return written;
+}
+#else
+void dmx_nvs_init(dmx_port_t dmx_num) {}
+
+void dmx_nvs_load_begin(dmx_port_t dmx_num, bool is_deferred) {}
+
+void dmx_nvs_load_end(dmx_port_t dmx_num) {}
+
+size_t dmx_nvs_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
+                   rdm_pid_t pid, void *param, size_t size) {
+  // Parameters are only kept in RAM so they always keep their default values
+  return 0;
+}
+
+bool dmx_nvs_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device, rdm_pid_t pid,
+                 const void *param, size_t size) {
+  return false;
+}
 
-  return (err == ESP_OK);
+size_t dmx_nvs_set_many(const dmx_nvs_entry_t *entries, size_t num) {
+  return 0;
 }
+#endif
@@ -1,7 +1,9 @@
 #include "include/timer.h"
 
 #include <stdbool.h>
+#include <string.h>
 
+#include "dmx/hal/include/dma.h"
 #include "dmx/hal/include/uart.h"
 #include "dmx/include/service.h"
 #include "driver/gpio.h"
@@ -16,35 +18,128 @@ static struct dmx_timer_t {
   bool is_running;
 } dmx_timer_context[DMX_NUM_MAX] = {};
 
+static void DMX_ISR_ATTR dmx_timer_start_packet(dmx_driver_t *driver,
+                                                int64_t now, bool latch) {
+  const dmx_port_t dmx_num = driver->dmx_num;
+
+  // Latch the most recent user writes into the DMX buffer
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  if (latch && driver->auto_refresh.shadow_is_dirty) {
+    memcpy(driver->dmx.data, driver->auto_refresh.shadow,
+           driver->auto_refresh.size);
+    driver->auto_refresh.shadow_is_dirty = false;
+    if (driver->dmx.header_buf == driver->dmx.data) {
+      driver->dmx.header_buf = NULL;  // The cached RDM header may be stale
+    }
+  }
+  driver->dmx.size = driver->auto_refresh.size;
+  driver->dmx.head = 0;
+  driver->dmx.progress = DMX_PROGRESS_IN_BREAK;
+  driver->dmx.status = DMX_STATUS_SENDING;
+  driver->auto_refresh.frame_start_ts = now;
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
+  // Start the next DMX break
+  dmx_timer_set_counter(dmx_num, 0);
+  dmx_timer_set_alarm(dmx_num, driver->break_len, true);
+  dmx_timer_start(dmx_num);
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+  dmx_uart_set_rts(dmx_num, 0);
+#endif
+  dmx_uart_invert_tx(dmx_num, 1);
+}
+
 static bool DMX_ISR_ATTR dmx_timer_isr(
 #if ESP_IDF_VERSION_MAJOR >= 5
     gptimer_handle_t gptimer_handle,
     const gptimer_alarm_event_data_t *event_data,
 #endif
     void *arg) {
+  const int64_t now = dmx_timer_get_micros_since_boot();
   dmx_driver_t *const driver = (dmx_driver_t *)arg;
   const dmx_port_t dmx_num = driver->dmx_num;
   int task_awoken = false;
 
   if (driver->dmx.status == DMX_STATUS_SENDING) {
-    if (driver->dmx.progress == DMX_PROGRESS_IN_BREAK) {
+    if (driver->dmx.progress == DMX_PROGRESS_IN_TURNAROUND) {
+      // Turn the DMX bus around to send the packet
+      dmx_uart_set_rts(dmx_num, 0);
+      if (!driver->is_controller) {
+        taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+        dmx_turnaround_record(driver, now);
+        taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      }
+      if (!driver->is_controller &&
+          driver->dmx.last_responder_pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+        // RDM discovery responses do not send a DMX break - write immediately
+        int write_len = driver->dmx.size;
+        dmx_uart_write_txfifo(dmx_num, driver->dmx.data, &write_len);
+        driver->dmx.head = write_len;
+        driver->dmx.progress = DMX_PROGRESS_IN_DATA;
+        dmx_timer_stop(dmx_num);
+        dmx_uart_enable_interrupt(dmx_num, DMX_INTR_TX_ALL);
+      } else {
+        // Start the DMX break
+        driver->dmx.progress = DMX_PROGRESS_IN_BREAK;
+        dmx_timer_set_counter(dmx_num, 0);
+        dmx_timer_set_alarm(dmx_num, driver->break_len, true);
+        dmx_uart_invert_tx(dmx_num, 1);
+      }
+    } else if (driver->dmx.progress == DMX_PROGRESS_IN_BREAK) {
       dmx_uart_invert_tx(dmx_num, 0);
       driver->dmx.progress = DMX_PROGRESS_IN_MAB;
 
       // Reset the alarm for the end of the DMX mark-after-break
       dmx_timer_set_alarm(dmx_num, driver->mab_len, false);
+    } else if (driver->repeater.input < DMX_NUM_MAX) {
+      // Stream the slots which the repeater input has received so far
+      dmx_timer_stop(dmx_num);
+      taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      driver->dmx.progress = DMX_PROGRESS_IN_DATA;
+      taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      dmx_repeater_write(driver);
+    } else if (dmx_dma_tx_is_enabled(dmx_num)) {
+      // Send the whole packet using DMA
+      dmx_dma_write(dmx_num, driver->dmx.data, driver->dmx.size);
+      driver->dmx.head = driver->dmx.size;
+
+      // DMA requires ESP-IDF v5, where the MAB alarm does not reload, but the
+      // timer is stopped so that the next dmx_timer_start() takes effect
+      dmx_timer_stop(dmx_num);
+
+      // Only the DMX write done interrupt is needed
+      dmx_uart_clear_interrupt(dmx_num, DMX_INTR_TX_DONE);
+      dmx_uart_enable_interrupt(dmx_num, DMX_INTR_TX_DONE);
     } else {
       // Write data to the UART
       int write_len = driver->dmx.size;
       dmx_uart_write_txfifo(dmx_num, driver->dmx.data, &write_len);
       driver->dmx.head = write_len;
 
-      // Pause MAB timer alarm
-      dmx_timer_stop(dmx_num);  // TODO: is this needed?
+      // The legacy timer of ESP-IDF v4 always auto-reloads its alarm, so stop
+      // it while sending slots. This also lets dmx_timer_start() restart it.
+      dmx_timer_stop(dmx_num);
 
       // Enable DMX write interrupts
       dmx_uart_enable_interrupt(dmx_num, DMX_INTR_TX_ALL);
     }
+  } else if (driver->auto_refresh.is_enabled) {
+    if (driver->auto_refresh.is_synced) {
+      // Start the next DMX packet of every member of the DMX sync group
+      taskENTER_CRITICAL_ISR(&dmx_sync_group.spinlock);
+      const uint32_t members = dmx_sync_group.members;
+      const bool is_committed = dmx_sync_group.is_committed;
+      dmx_sync_group.is_committed = false;
+      dmx_sync_group.pending = members;
+      taskEXIT_CRITICAL_ISR(&dmx_sync_group.spinlock);
+      for (int i = 0; i < DMX_NUM_MAX; ++i) {
+        if (members & (1 << i)) {
+          dmx_timer_start_packet(dmx_driver[i], now, is_committed);
+        }
+      }
+    } else {
+      dmx_timer_start_packet(driver, now, true);
+    }
   } else {
     taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
     if (driver->task_waiting) {
@@ -55,6 +150,15 @@ static bool DMX_ISR_ATTR dmx_timer_isr(
     dmx_timer_stop(dmx_num);  // TODO: is this needed?
   }
 
+  // Record the number of calls and the duration of this interrupt handler
+  const uint32_t isr_duration = dmx_timer_get_micros_since_boot() - now;
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  ++driver->stats.counters.timer_isr_count;
+  if (isr_duration > driver->stats.counters.timer_isr_max_us) {
+    driver->stats.counters.timer_isr_max_us = isr_duration;
+  }
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
   return task_awoken;
 }
 
@@ -63,10 +167,23 @@ bool dmx_timer_init(dmx_port_t dmx_num, void *isr_context, int isr_flags) {
 
   // Initialize hardware timer
 #if ESP_IDF_VERSION_MAJOR >= 5
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+  // The GPTimer driver takes a priority level instead of interrupt flags
+  int intr_priority = 0;  // Allows the GPTimer driver to choose the priority
+  for (int level = 1; level <= 3; ++level) {
+    if (isr_flags & (1 << level)) {
+      intr_priority = level;
+      break;
+    }
+  }
+#endif
   const gptimer_config_t timer_config = {
       .clk_src = GPTIMER_CLK_SRC_DEFAULT,
       .direction = GPTIMER_COUNT_UP,
       .resolution_hz = 1000000,  // 1MHz resolution timer
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 1, 0)
+      .intr_priority = intr_priority,
+#endif
   };
   esp_err_t err = gptimer_new_timer(&timer_config, &timer->gptimer_handle);
   if (err) {
@@ -1,5 +1,7 @@
 #include "include/uart.h"
 
+#include "dmx/hal/include/dma.h"
+#include "dmx/hal/include/gpio.h"
 #include "dmx/hal/include/timer.h"
 #include "dmx/include/service.h"
 #include "driver/uart.h"
@@ -19,9 +21,6 @@
 #include "driver/timer.h"
 #endif
 
-#define DMX_UART_FULL_DEFAULT 1
-#define DMX_UART_EMPTY_DEFAULT 8
-
 static struct dmx_uart_t {
   const int num;
   uart_dev_t *const dev;
@@ -43,6 +42,363 @@ enum {
   RDM_TYPE_IS_UNKNOWN,  // The packet is RDM, but it is unclear what type it is.
 };
 
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+static void DMX_ISR_ATTR dmx_uart_mark_changes(dmx_driver_t *driver,
+                                              const uint8_t *prev, int size) {
+  dmx_changes_t *const dirty = &driver->dmx.dirty;
+  const uint8_t *const next = driver->dmx.rx_data;
+  if (size > DMX_PACKET_SIZE_MAX) {
+    size = DMX_PACKET_SIZE_MAX;
+  }
+
+  // Slots which were only received in one of the two packets have changed
+  const int last_rx_size = driver->dmx.last_rx_size;
+  const int compare_size = size < last_rx_size ? size : last_rx_size;
+  const int changed_size = size > last_rx_size ? size : last_rx_size;
+  driver->dmx.last_rx_size = size;
+
+  int first = -1;
+  int last = -1;
+  for (int i = 0; i < changed_size; ++i) {
+    if (i < compare_size && prev[i] == next[i]) {
+      continue;
+    }
+    dirty->bitmap[i / 32] |= (1u << (i % 32));
+    if (first == -1) {
+      first = i;
+    }
+    last = i;
+  }
+  if (first == -1) {
+    return;  // The packet has not changed
+  }
+
+  dirty->is_changed = true;
+  if (dirty->first == -1 || first < dirty->first) {
+    dirty->first = first;
+  }
+  if (last > dirty->last) {
+    dirty->last = last;
+  }
+}
+#endif
+
+static void DMX_ISR_ATTR dmx_uart_swap_buffers(dmx_driver_t *driver,
+                                              int size) {
+#if DMX_RX_BUFFER_COUNT == 2
+  if (driver->dmx.data_is_acquired) {
+    // Drop the completed packet while the data buffer is borrowed
+    ++driver->stats.counters.rx_packets_dropped;
+    return;
+  }
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+  dmx_uart_mark_changes(driver, driver->dmx.data, size);
+#endif
+
+  // Make the completed packet readable and receive into the previous buffer
+  uint8_t *const rx_data = driver->dmx.rx_data;
+  driver->dmx.rx_data = driver->dmx.data;
+  driver->dmx.data = rx_data;
+#elif DMX_RX_BUFFER_COUNT > 2
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+  dmx_uart_mark_changes(driver,
+                        driver->dmx.ready_is_fresh ? driver->dmx.ready
+                                                   : driver->dmx.data,
+                        size);
+#endif
+
+  // Publish the completed packet and receive into the stale ready buffer
+  uint8_t *const rx_data = driver->dmx.rx_data;
+  driver->dmx.rx_data = driver->dmx.ready;
+  driver->dmx.ready = rx_data;
+  driver->dmx.ready_is_fresh = true;
+#endif
+}
+
+static void DMX_ISR_ATTR dmx_uart_sniffer_arm(dmx_driver_t *driver) {
+  if (!driver->sniffer.is_enabled || driver->sniffer.is_armed) {
+    return;  // Edges are only needed from the end of a packet to the next MAB
+  }
+
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(driver->dmx_num));
+  driver->sniffer.is_armed = true;
+  driver->sniffer.last_neg_edge_ts = -1;  // The DMX break has not been seen
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(driver->dmx_num));
+  dmx_gpio_enable_interrupt(driver->dmx_num);
+}
+
+static bool DMX_ISR_ATTR dmx_uart_route_packet(dmx_driver_t *driver,
+                                              size_t size, int64_t now) {
+  const dmx_port_t dmx_num = driver->dmx_num;
+  if (driver->start_code.route_count == 0 || size == 0) {
+    return false;  // Nothing to route
+  }
+
+  // Find the callback of the start code
+  const uint8_t sc = driver->dmx.rx_data[0];
+  dmx_start_code_cb_t callback = NULL;
+  void *context = NULL;
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  for (int i = 0; i < driver->start_code.route_count; ++i) {
+    if (driver->start_code.routes[i].sc == sc) {
+      callback = driver->start_code.routes[i].callback;
+      context = driver->start_code.routes[i].context;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  if (callback == NULL) {
+    return false;  // The start code is not routed
+  }
+
+  callback(dmx_num, driver->dmx.rx_data, size, context);
+
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  dmx_packet_state_write_begin(driver);
+  driver->dmx.progress = DMX_PROGRESS_STALE;  // Don't handle it again
+  dmx_packet_state_write_end(driver);
+  driver->dmx.status = DMX_STATUS_IDLE;
+  ++driver->stats.counters.rx_packets_routed;
+  dmx_capture_record(driver, size, DMX_OK, now);
+  dmx_stats_count_packet(driver, true, now);
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+static void DMX_ISR_ATTR dmx_uart_rdm_isr_send(dmx_driver_t *driver,
+                                               rdm_pid_t pid,
+                                               size_t response_len,
+                                               int64_t eop_timestamp) {
+  const dmx_port_t dmx_num = driver->dmx_num;
+
+  // Wait for the minimum responder turnaround time before sending
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  driver->is_controller = false;
+  driver->dmx.last_responder_pid = pid;
+  driver->dmx.responder_sent_last = true;
+  driver->dmx.size = response_len;
+  driver->dmx.head = 0;
+  driver->dmx.status = DMX_STATUS_SENDING;
+  driver->dmx.progress = DMX_PROGRESS_IN_TURNAROUND;
+  driver->rdm_disc.is_sending = true;
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  const int64_t elapsed = dmx_timer_get_micros_since_boot() - eop_timestamp;
+  dmx_timer_set_counter(dmx_num, elapsed);
+  dmx_timer_set_alarm(dmx_num,
+                      elapsed < RDM_TIMING_RESPONDER_MIN
+                          ? RDM_TIMING_RESPONDER_MIN
+                          : elapsed + 1,
+                      false);
+  dmx_timer_start(dmx_num);
+}
+
+static bool DMX_ISR_ATTR dmx_uart_rdm_disc_respond(dmx_driver_t *driver,
+                                                   const rdm_header_t *header,
+                                                   int64_t eop_timestamp) {
+  const dmx_port_t dmx_num = driver->dmx_num;
+  struct dmx_driver_rdm_disc_t *const rdm_disc = &driver->rdm_disc;
+
+  // Only respond to root discovery requests when the responses are current
+  if (header->cc != RDM_CC_DISC_COMMAND ||
+      header->sub_device != RDM_SUB_DEVICE_ROOT ||
+      !rdm_uid_is_target(&driver->uid, &header->dest_uid) ||
+      rdm_disc->generation != driver->device.generation ||
+      driver->dmx.data_is_acquired || driver->auto_refresh.is_enabled) {
+    return false;
+  }
+
+  // Copy the request fields before the response overwrites the buffer
+  const uint8_t *request = driver->dmx.rx_data;
+  const uint8_t *response;
+  size_t response_len;
+  if (header->pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+    if (!rdm_disc->dub_is_enabled || rdm_disc->is_muted == NULL ||
+        header->pdl != 12) {
+      return false;
+    } else if (*rdm_disc->is_muted) {
+      return true;  // Muted responders do not respond
+    }
+    uint64_t lower_bound = 0;
+    uint64_t upper_bound = 0;
+    for (int i = 0; i < 6; ++i) {
+      lower_bound = (lower_bound << 8) | request[24 + i];
+      upper_bound = (upper_bound << 8) | request[30 + i];
+    }
+    if (rdm_disc->uid < lower_bound || rdm_disc->uid > upper_bound) {
+      return true;  // Request not for this device
+    }
+    response = rdm_disc->dub_response;
+    response_len = sizeof(rdm_disc->dub_response);
+  } else if (header->pid == RDM_PID_DISC_MUTE ||
+             header->pid == RDM_PID_DISC_UN_MUTE) {
+    if (rdm_disc->is_muted == NULL) {
+      return false;
+    }
+    *rdm_disc->is_muted = (header->pid == RDM_PID_DISC_MUTE);
+    if (rdm_uid_is_broadcast(&header->dest_uid)) {
+      return true;  // Do not respond to broadcast requests
+    }
+    response = rdm_disc->mute_response;
+    response_len = rdm_disc->mute_response_len;
+  } else {
+    return false;
+  }
+  uint8_t src_uid[6];
+  for (int i = 0; i < 6; ++i) {
+    src_uid[i] = request[9 + i];
+  }
+  const uint8_t tn = request[15];
+
+  // Copy the response without function calls for IRAM ISR
+  uint8_t *data = driver->dmx.data;
+  if (driver->dmx.header_buf == data) {
+    driver->dmx.header_buf = NULL;  // The buffer is being overwritten
+  }
+  for (int i = 0; i < response_len; ++i) {
+    data[i] = response[i];
+  }
+  if (response == rdm_disc->mute_response) {
+    // Address the response and re-calculate its checksum
+    for (int i = 0; i < 6; ++i) {
+      data[3 + i] = src_uid[i];
+    }
+    data[15] = tn;
+    data[21] = header->pid >> 8;
+    data[22] = header->pid & 0xff;
+    const size_t message_len = response_len - 2;
+    uint16_t checksum = 0;
+    for (int i = 0; i < message_len; ++i) {
+      checksum += data[i];
+    }
+    data[message_len] = checksum >> 8;
+    data[message_len + 1] = checksum & 0xff;
+  }
+
+  dmx_uart_rdm_isr_send(driver, header->pid, response_len, eop_timestamp);
+
+  return true;
+}
+
+#ifdef CONFIG_RDM_RESPONDER_CACHED_GET_IN_ISR
+static bool DMX_ISR_ATTR dmx_uart_rdm_get_respond(dmx_driver_t *driver,
+                                                  const rdm_header_t *header,
+                                                  int64_t eop_timestamp) {
+  const dmx_port_t dmx_num = driver->dmx_num;
+  struct dmx_driver_rdm_disc_t *const rdm_disc = &driver->rdm_disc;
+  const uint8_t *request = driver->dmx.rx_data;
+
+  // Only GET requests addressed to this device may have a cached response
+  if (header->cc != RDM_CC_GET_COMMAND ||
+      header->sub_device >= RDM_SUB_DEVICE_MAX ||
+      header->dest_uid.man_id != driver->uid.man_id ||
+      header->dest_uid.dev_id != driver->uid.dev_id ||
+      header->pdl > sizeof(((dmx_parameter_response_t *)0)->request_pd)) {
+    return false;
+  }
+
+  // Find the parameter without function calls for IRAM ISR
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  const dmx_device_t *device = NULL;
+  if (header->sub_device == RDM_SUB_DEVICE_ROOT) {
+    device = &driver->device.root;
+  } else if (header->sub_device < driver->device.sub_device_table_size) {
+    device = driver->device.sub_devices[header->sub_device];
+  }
+  const dmx_parameter_t *entry = NULL;
+  if (device != NULL) {
+    int low = 0;
+    int high = device->num_parameters;
+    while (low < high) {
+      const int mid = (low + high) / 2;
+      const rdm_pid_t pid = device->parameters[mid].pid;
+      if (pid == header->pid) {
+        entry = &device->parameters[mid];
+        break;
+      } else if (pid < header->pid) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+  }
+
+  // The response must be current and the request must not need a callback
+  const dmx_parameter_response_t *response =
+      entry != NULL && entry->callback == NULL ? entry->response : NULL;
+  bool is_cached = response != NULL &&
+                   response->generation == driver->device.generation &&
+                   response->device_generation == device->generation &&
+                   response->request_pdl == header->pdl;
+  for (int i = 0; is_cached && i < header->pdl; ++i) {
+    is_cached = (response->request_pd[i] == request[24 + i]);
+  }
+  if (!is_cached) {
+    taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+    return false;
+  }
+
+  // Encode the response header and copy the cached parameter data
+  uint8_t *data = driver->dmx.data;
+  if (driver->dmx.header_buf == data) {
+    driver->dmx.header_buf = NULL;  // The buffer is being overwritten
+  }
+  const rdm_header_t response_header = {
+      .message_len = 24 + response->pdl,
+      .dest_uid = header->src_uid,
+      .src_uid = driver->uid,
+      .tn = header->tn,
+      .response_type = RDM_RESPONSE_TYPE_ACK,
+      .message_count = rdm_disc->message_count,
+      .sub_device = header->sub_device,
+      .cc = RDM_CC_GET_COMMAND_RESPONSE,
+      .pid = header->pid,
+      .pdl = response->pdl};
+  rdm_header_encode(data, &response_header);
+  uint16_t checksum = response->pd_sum;
+  for (int i = 0; i < 24; ++i) {
+    checksum += data[i];
+  }
+  for (int i = 0; i < response->pdl; ++i) {
+    data[24 + i] = response->pd[i];
+  }
+  const size_t message_len = response_header.message_len;
+  data[message_len] = checksum >> 8;
+  data[message_len + 1] = checksum & 0xff;
+
+  // Track repeated requests as rdm_send_response() does
+  if (header->pid == driver->dmx.last_request_pid) {
+    ++driver->dmx.last_request_pid_repeats;
+  } else {
+    driver->dmx.last_request_pid_repeats = 0;
+  }
+  driver->dmx.last_request_pid = header->pid;
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
+  dmx_uart_rdm_isr_send(driver, header->pid, message_len + 2, eop_timestamp);
+
+  return true;
+}
+#endif
+
+static bool DMX_ISR_ATTR dmx_uart_rdm_isr_respond(dmx_driver_t *driver,
+                                                  const rdm_header_t *header,
+                                                  int64_t eop_timestamp) {
+  if (dmx_uart_rdm_disc_respond(driver, header, eop_timestamp)) {
+    return true;
+  }
+#ifdef CONFIG_RDM_RESPONDER_CACHED_GET_IN_ISR
+  // Cached responses are only current if the ISR's responses are current
+  if (driver->rdm_disc.generation == driver->device.generation &&
+      !driver->dmx.data_is_acquired && !driver->auto_refresh.is_enabled) {
+    return dmx_uart_rdm_get_respond(driver, header, eop_timestamp);
+  }
+#endif
+  return false;
+}
+#endif
+
 static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
   const int64_t now = dmx_timer_get_micros_since_boot();
   dmx_driver_t *const driver = arg;
@@ -60,13 +416,52 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
       taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
       dmx_head = driver->dmx.head;
       taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
-      if (dmx_head >= 0 && dmx_head < DMX_PACKET_SIZE_MAX) {
-        int read_len = DMX_PACKET_SIZE_MAX - dmx_head;
-        dmx_uart_read_rxfifo(dmx_num, &driver->dmx.data[dmx_head], &read_len);
-        dmx_head += read_len;
+
+      // Stop copying DMX slots beyond the expected size if it was requested
+      int rx_limit = dmx_packet_size_max(driver);
+      if (driver->dmx.rx_is_truncated && dmx_head > 0 &&
+          !dmx_start_code_is_rdm(driver->dmx.rx_data[0])) {
+        rx_limit = driver->dmx.size;
+      }
+      if (dmx_head >= 0 && dmx_head < rx_limit) {
+        int read_len = rx_limit - dmx_head;
+        dmx_uart_read_rxfifo(dmx_num, &driver->dmx.rx_data[dmx_head],
+                             &read_len);
+
+        // Sum the RDM message slots as they arrive to verify the checksum
+        const uint8_t *rx_data = driver->dmx.rx_data;
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+        if (rx_data[0] == RDM_SC) {
+          uint16_t checksum = driver->dmx.rx_checksum;
+          for (int i = dmx_head; i < dmx_head + read_len; ++i) {
+            if (i < 3 || i < rx_data[2]) {
+              checksum += rx_data[i];
+            }
+          }
+          driver->dmx.rx_checksum = checksum;
+        }
+#endif
         taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
-        driver->dmx.head = dmx_head;
+        if (dmx_head == 0 && read_len > 0 &&
+            !(intr_flags & DMX_INTR_RX_BREAK) &&
+            !dmx_start_code_is_accepted(driver, rx_data[0])) {
+          // Drop the packet as soon as its start code is received
+          dmx_packet_state_write_begin(driver);
+          driver->dmx.progress = DMX_PROGRESS_STALE;
+          driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+          dmx_packet_state_write_end(driver);
+          ++driver->stats.counters.rx_packets_filtered;
+        } else {
+          dmx_trace_record_slots(driver, now, dmx_head);
+          dmx_head += read_len;
+          driver->dmx.head = dmx_head;
+        }
         taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
+        // Cut the received slots through to the DMX repeater outputs
+        if (driver->repeater.outputs != 0 && read_len > 0 && dmx_head > 0) {
+          dmx_repeater_forward(driver, dmx_head - read_len, now);
+        }
       } else {
         if (dmx_head > 0) {
           // Record the number of slots received for error reporting
@@ -79,24 +474,51 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
       }
       dmx_uart_clear_interrupt(dmx_num, DMX_INTR_RX_ALL);
 
+      // Measure the next DMX break with the sniffer once the bus is idle
+      if (intr_flags & (DMX_INTR_RX_TIMEOUT | DMX_INTR_RX_BREAK)) {
+        dmx_uart_sniffer_arm(driver);
+      }
+
       // Handle DMX break condition
       if (intr_flags & DMX_INTR_RX_BREAK) {
         // Handle possible condition where expected packet size is too large
-        if (driver->dmx.progress == DMX_PROGRESS_IN_DATA && dmx_head > 0) {
+        if (driver->dmx.progress == DMX_PROGRESS_IN_DATA && dmx_head > 0 &&
+            !dmx_uart_route_packet(driver, dmx_head - 1, now)) {
           taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
           driver->dmx.size = dmx_head - 1;  // Attempt to fix packet size
+          dmx_packet_state_write_begin(driver);
+          driver->dmx.err = DMX_ERR_NOT_ENOUGH_SLOTS;
+          dmx_packet_state_write_end(driver);
+          ++driver->stats.counters.not_enough_slots;
+          dmx_rx_timing_record(driver, now,
+                               driver->dmx.rx_data[0] == DMX_SC);
+          dmx_capture_record(driver, dmx_head - 1, DMX_ERR_NOT_ENOUGH_SLOTS,
+                             now);
+          dmx_sniffer_record_frame(driver, dmx_head - 1,
+                                   DMX_ERR_NOT_ENOUGH_SLOTS, now);
+          dmx_uart_swap_buffers(driver, dmx_head - 1);
           if (driver->task_waiting) {
             xTaskNotifyFromISR(driver->task_waiting, DMX_ERR_NOT_ENOUGH_SLOTS,
                                eSetValueWithOverwrite, &task_awoken);
           }
           taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+          dmx_event_set_from_isr(driver, DMX_EVENT_PACKET_RECEIVED,
+                                 &task_awoken);
         }
 
         // Reset the DMX buffer for the next packet
         taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
         driver->dmx.status = DMX_STATUS_RECEIVING;
+        dmx_packet_state_write_begin(driver);
         driver->dmx.progress = DMX_PROGRESS_IN_BREAK;
         driver->dmx.head = 0;
+        dmx_packet_state_write_end(driver);
+        driver->dmx.rx_checksum = 0;
+        driver->dmx.rx_break_ts = now;
+        dmx_trace_record(driver, DMX_TRACE_EVENT_BREAK, now);
+        if (driver->dmx.header_buf == driver->dmx.rx_data) {
+          driver->dmx.header_buf = NULL;  // The buffer is being overwritten
+        }
         taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
         continue;  // Nothing else to do on DMX break
       } else if (driver->dmx.progress == DMX_PROGRESS_IN_BREAK ||
@@ -113,6 +535,7 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
       }
 
       // Process the data depending on the type of packet that was received
+      rdm_header_t header;  // The decoded header of a valid RDM packet.
       dmx_err_t err;
       int rdm_type;
       bool packet_is_complete;
@@ -124,12 +547,15 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
                   : DMX_ERR_IMPROPER_SLOT;  // Missing stop bits
       } else {
         // Determine the type of the packet that was received
-        const uint8_t sc = driver->dmx.data[0];  // DMX start-code.
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+        const uint8_t sc = driver->dmx.rx_data[0];  // DMX start-code.
         if (sc == RDM_SC) {
           rdm_type = RDM_TYPE_IS_UNKNOWN;  // Determine actual type later
         } else if (sc == RDM_PREAMBLE || sc == RDM_DELIMITER) {
           rdm_type = RDM_TYPE_IS_DISCOVERY;
-        } else {
+        } else
+#endif
+        {
           rdm_type = RDM_TYPE_IS_NOT_RDM;
           taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
           // Get the best resolution on the controller EOP timestamp
@@ -157,7 +583,7 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
           // Get the delimiter index
           int delimiter_idx = 0;
           for (; delimiter_idx <= 7; ++delimiter_idx) {
-            const uint8_t slot_value = driver->dmx.data[delimiter_idx];
+            const uint8_t slot_value = driver->dmx.rx_data[delimiter_idx];
             if (slot_value != RDM_PREAMBLE) {
               if (slot_value != RDM_DELIMITER) {
                 delimiter_idx = 9;  // Force invalid packet type
@@ -174,7 +600,8 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
           if (dmx_head < delimiter_idx + 17) {
             packet_is_complete = false;
             break;  // Haven't received full RDM_PID_DISC_UNIQUE_BRANCH response
-          } else if (!rdm_read_header(dmx_num, NULL)) {
+          } else if (!rdm_read_header_from_buffer(driver->dmx.rx_data,
+                                                  &header)) {
             rdm_type = RDM_TYPE_IS_NOT_RDM;
             continue;  // Packet is malformed - treat it as DMX
           } else {
@@ -189,28 +616,30 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
           if (dmx_head < sizeof(rdm_header_t) + 2) {
             packet_is_complete = false;
             break;  // Haven't received full RDM header and checksum yet
-          } else if (driver->dmx.data[1] != RDM_SUB_SC ||
-                     !rdm_cc_is_valid(driver->dmx.data[20]) ||
-                     (msg_len = driver->dmx.data[2]) < sizeof(rdm_header_t)) {
+          } else if (driver->dmx.rx_data[1] != RDM_SUB_SC ||
+                     !rdm_cc_is_valid(driver->dmx.rx_data[20]) ||
+                     (msg_len = driver->dmx.rx_data[2]) <
+                         sizeof(rdm_header_t)) {
             rdm_type = RDM_TYPE_IS_NOT_RDM;
             continue;  // Packet is malformed - treat it as DMX
           } else if (dmx_head < msg_len + 2) {
             packet_is_complete = false;
             break;  // Haven't received full RDM packet and checksum yet
-          } else if (!rdm_read_header(dmx_num, NULL)) {
+          } else if (driver->dmx.rx_checksum !=
+                     ((driver->dmx.rx_data[msg_len] << 8) |
+                      driver->dmx.rx_data[msg_len + 1])) {
+            taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+            ++driver->stats.counters.rdm_checksum_errors;
+            taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
             rdm_type = RDM_TYPE_IS_NOT_RDM;
-            continue;  // Packet is malformed - treat it as DMX
+            continue;  // Checksum is invalid - treat it as DMX
           } else {
             bool responder_sent_last;
-            const rdm_cc_t cc = driver->dmx.data[20];
-            const rdm_pid_t *pid = (rdm_pid_t *)&driver->dmx.data[21];
-            const rdm_uid_t *uid_ptr = (rdm_uid_t *)&driver->dmx.data[3];
-            const rdm_uid_t dest_uid = {.man_id = bswap16(uid_ptr->man_id),
-                                        .dev_id = bswap32(uid_ptr->dev_id)};
-            if (!rdm_cc_is_request(cc)) {
+            rdm_decode_header(driver->dmx.rx_data, &header);
+            if (!rdm_cc_is_request(header.cc)) {
               rdm_type = RDM_TYPE_IS_RESPONSE;
               responder_sent_last = true;
-            } else if (rdm_uid_is_broadcast(&dest_uid)) {
+            } else if (rdm_uid_is_broadcast(&header.dest_uid)) {
               rdm_type = RDM_TYPE_IS_BROADCAST;
               responder_sent_last = false;
             } else {
@@ -220,11 +649,11 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
             if (!responder_sent_last) {
               taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
               driver->dmx.controller_eop_timestamp = now;
-              driver->dmx.last_controller_pid = bswap16(*pid);
+              driver->dmx.last_controller_pid = header.pid;
               taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
             } else {
               taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
-              driver->dmx.last_responder_pid = bswap16(*pid);
+              driver->dmx.last_responder_pid = header.pid;
               taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
             }
             taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
@@ -249,15 +678,76 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
       }
       dmx_timer_stop(dmx_num);
 
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+      // Answer discovery and cached requests without waking a task
+      if (err == DMX_OK &&
+          (rdm_type == RDM_TYPE_IS_REQUEST ||
+           rdm_type == RDM_TYPE_IS_BROADCAST) &&
+          dmx_uart_rdm_isr_respond(driver, &header, now)) {
+        if (driver->dmx.status != DMX_STATUS_SENDING) {
+          taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+          driver->dmx.progress = DMX_PROGRESS_STALE;  // Don't handle it again
+          taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+        }
+        continue;
+      }
+#endif
+
+      // Pass packets with a routed start code to their callback
+      if (err == DMX_OK && rdm_type == RDM_TYPE_IS_NOT_RDM &&
+          dmx_uart_route_packet(driver, dmx_head, now)) {
+        continue;
+      }
+
       // Set driver flags and notify task
+      const bool is_refresh = err == DMX_OK &&
+                              rdm_type == RDM_TYPE_IS_NOT_RDM &&
+                              driver->dmx.rx_data[0] == DMX_SC;
       taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      dmx_packet_state_write_begin(driver);
       driver->dmx.progress = DMX_PROGRESS_COMPLETE;
+      driver->dmx.err = err;
+      dmx_packet_state_write_end(driver);
       driver->dmx.status = DMX_STATUS_IDLE;  // Could still be receiving data
+      dmx_rx_timing_record(driver, now, is_refresh);
+      dmx_capture_record(driver, dmx_head, err, now);
+      dmx_sniffer_record_frame(driver, dmx_head, err, now);
+      if (err == DMX_ERR_UART_OVERFLOW) {
+        ++driver->stats.counters.uart_overflows;
+      } else if (err == DMX_ERR_IMPROPER_SLOT) {
+        ++driver->stats.counters.improper_slots;
+      } else {
+        dmx_stats_count_packet(driver, true, now);
+      }
+      if (err == DMX_OK) {
+        if (rdm_type != RDM_TYPE_IS_NOT_RDM) {
+          // Cache the decoded header so that tasks needn't parse it again
+          driver->dmx.header = header;
+          driver->dmx.header_buf = driver->dmx.rx_data;
+        }
+        dmx_uart_swap_buffers(driver, dmx_head);  // Keep last good packet
+      }
+      if (is_refresh) {
+        dmx_sink_notify_from_isr(driver, dmx_head, &task_awoken);
+      }
+      dmx_trace_record_stage(driver, DMX_TRACE_STAGE_NOTIFY, now);
       if (driver->task_waiting) {
+        dmx_trace_record(driver, DMX_TRACE_EVENT_NOTIFY,
+                         dmx_timer_get_micros_since_boot());
         xTaskNotifyFromISR(driver->task_waiting, err, eSetValueWithOverwrite,
                            &task_awoken);
       }
       taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      dmx_uart_sniffer_arm(driver);
+      if (err == DMX_OK && rdm_type != RDM_TYPE_IS_NOT_RDM) {
+        dmx_event_set_from_isr(
+            driver, DMX_EVENT_PACKET_RECEIVED | DMX_EVENT_RDM_RECEIVED,
+            &task_awoken);
+      } else {
+        dmx_event_set_from_isr(driver, DMX_EVENT_PACKET_RECEIVED,
+                               &task_awoken);
+      }
+      dmx_sleep_record_frame(driver, is_refresh, now);
     }
 
     // DMX Transmit #####################################################
@@ -277,6 +767,27 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
       // Disable write interrupts and clear the interrupt
       dmx_uart_disable_interrupt(dmx_num, DMX_INTR_TX_ALL);
       dmx_uart_clear_interrupt(dmx_num, DMX_INTR_TX_DONE);
+      if (dmx_dma_tx_is_enabled(dmx_num)) {
+        dmx_dma_write_done(dmx_num);
+      }
+
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+      // Return to reading the DMX bus without waking a task
+      if (driver->rdm_disc.is_sending) {
+        taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+        dmx_stats_count_packet(driver, false, now);
+        driver->rdm_disc.is_sending = false;
+        dmx_packet_state_write_begin(driver);
+        driver->dmx.progress = DMX_PROGRESS_STALE;
+        driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+        dmx_packet_state_write_end(driver);
+        driver->dmx.status = DMX_STATUS_IDLE;
+        dmx_uart_rxfifo_reset(dmx_num);
+        dmx_uart_set_rts(dmx_num, 1);
+        taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+        continue;
+      }
+#endif
 
       // Record the EOP timestamp if this device is the DMX controller
       if (driver->is_controller) {
@@ -287,6 +798,7 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
 
       // Update the DMX status and notify task
       taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      dmx_stats_count_packet(driver, false, now);
       driver->dmx.progress = DMX_PROGRESS_COMPLETE;
       driver->dmx.status = DMX_STATUS_IDLE;
       if (driver->task_waiting) {
@@ -294,33 +806,85 @@ static void DMX_ISR_ATTR dmx_uart_isr(void *arg) {
                            &task_awoken);
       }
       taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+      dmx_trace_record_sent_from_isr(driver, now);
+      dmx_event_set_from_isr(driver, DMX_EVENT_SENT, &task_awoken);
+
+      // Schedule the next DMX packet if the DMX driver is sending them
+      if (driver->auto_refresh.is_synced) {
+        dmx_sync_group_sent(dmx_num, now);
+        continue;
+      } else if (driver->auto_refresh.is_enabled) {
+        const int64_t elapsed = now - driver->auto_refresh.frame_start_ts;
+        const int64_t remaining = driver->auto_refresh.period - elapsed;
+        dmx_timer_set_counter(dmx_num, 0);
+        dmx_timer_set_alarm(dmx_num, remaining > 0 ? remaining : 1, false);
+        dmx_timer_start(dmx_num);
+        continue;
+      }
 
       // Skip the rest of the ISR loop if an RDM response is not expected
+      const bool is_adaptive =
+          driver->rx_fifo_threshold == DMX_FIFO_THRESHOLD_ADAPTIVE;
       if (!driver->is_controller || driver->dmx.last_controller_pid == 0 ||
           (driver->dmx.last_request_was_broadcast &&
            driver->dmx.last_controller_pid != RDM_PID_DISC_UNIQUE_BRANCH)) {
+        if (is_adaptive) {
+          dmx_uart_set_rxfifo_full(dmx_num, DMX_UART_FULL_BULK);
+        }
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+        if (!driver->is_controller) {
+          // Release the DMX bus as soon as the RDM response has been sent
+          taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+          dmx_uart_rxfifo_reset(dmx_num);
+          dmx_uart_set_rts(dmx_num, 1);
+          dmx_packet_state_write_begin(driver);
+          driver->dmx.progress = DMX_PROGRESS_STALE;
+          driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+          dmx_packet_state_write_end(driver);
+          taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+        }
+#endif
         continue;
       }
 
+      // Read RDM responses one byte at a time to enforce inter-slot timing
+      if (is_adaptive) {
+        dmx_uart_set_rxfifo_full(dmx_num, DMX_UART_FULL_DEFAULT);
+      }
+
       // Determine if a DMX break is expected in the response packet
       int progress;
+      int head;
       if (driver->dmx.last_controller_pid == RDM_PID_DISC_UNIQUE_BRANCH) {
         progress = DMX_PROGRESS_IN_DATA;
-        driver->dmx.head = 0;  // Not expecting a DMX break
+        head = 0;  // Not expecting a DMX break
       } else {
         progress = DMX_PROGRESS_STALE;
-        driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+        head = DMX_HEAD_WAITING_FOR_BREAK;
       }
 
       // Flip the DMX bus so the response may be read
       taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
       dmx_uart_rxfifo_reset(dmx_num);
       dmx_uart_set_rts(dmx_num, 1);
+      dmx_packet_state_write_begin(driver);
       driver->dmx.progress = progress;
+      driver->dmx.head = head;
+      dmx_packet_state_write_end(driver);
+      driver->dmx.rx_break_ts = 0;  // The response may not have a DMX break
       taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
     }
   }
 
+  // Record the number of calls and the duration of this interrupt handler
+  const uint32_t isr_duration = dmx_timer_get_micros_since_boot() - now;
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  ++driver->stats.counters.uart_isr_count;
+  if (isr_duration > driver->stats.counters.uart_isr_max_us) {
+    driver->stats.counters.uart_isr_max_us = isr_duration;
+  }
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
   if (task_awoken) portYIELD_FROM_ISR();
 }
 
@@ -357,7 +921,11 @@ bool dmx_uart_init(dmx_port_t dmx_num, void *isr_context, int isr_flags) {
   uart_ll_set_sclk(uart->dev, UART_SCLK_APB);
   uart_ll_set_baudrate(uart->dev, DMX_BAUD_RATE);
 #endif
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+  uart_ll_set_mode(uart->dev, UART_MODE_RS485_HALF_DUPLEX);
+#else
   uart_ll_set_mode(uart->dev, UART_MODE_UART);
+#endif
   uart_ll_set_parity(uart->dev, UART_PARITY_DISABLE);
   uart_ll_set_data_bit_num(uart->dev, UART_DATA_8_BITS);
   uart_ll_set_stop_bits(uart->dev, UART_STOP_BITS_2);
@@ -365,7 +933,8 @@ bool dmx_uart_init(dmx_port_t dmx_num, void *isr_context, int isr_flags) {
   uart_ll_set_tx_idle_num(uart->dev, 0);
   uart_ll_set_hw_flow_ctrl(uart->dev, UART_HW_FLOWCTRL_DISABLE, 0);
   uart_ll_set_txfifo_empty_thr(uart->dev, DMX_UART_EMPTY_DEFAULT);
-  uart_ll_set_rxfifo_full_thr(uart->dev, DMX_UART_FULL_DEFAULT);
+  uart_ll_set_rxfifo_full_thr(uart->dev, DMX_UART_FULL_BULK);
+  uart_ll_set_rx_tout(uart->dev, DMX_UART_TIMEOUT_DEFAULT);
 
   dmx_uart_rxfifo_reset(dmx_num);
   dmx_uart_txfifo_reset(dmx_num);
@@ -467,6 +1036,17 @@ void DMX_ISR_ATTR dmx_uart_read_rxfifo(dmx_port_t dmx_num, uint8_t *buf,
   uart_ll_read_rxfifo(uart->dev, buf, *size);
 }
 
+void DMX_ISR_ATTR dmx_uart_set_rxfifo_full(dmx_port_t dmx_num,
+                                           int threshold) {
+  struct dmx_uart_t *uart = &dmx_uart_context[dmx_num];
+  uart_ll_set_rxfifo_full_thr(uart->dev, threshold);
+}
+
+void dmx_uart_set_txfifo_empty(dmx_port_t dmx_num, int threshold) {
+  struct dmx_uart_t *uart = &dmx_uart_context[dmx_num];
+  uart_ll_set_txfifo_empty_thr(uart->dev, threshold);
+}
+
 void DMX_ISR_ATTR dmx_uart_set_rts(dmx_port_t dmx_num, int set) {
   struct dmx_uart_t *uart = &dmx_uart_context[dmx_num];
   uart_ll_set_rts_active_level(uart->dev, set);
@@ -0,0 +1,262 @@
+#include "dmx/health.h"
+
+#include "dmx/hal/include/timer.h"
+#include "dmx/hal/include/uart.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+
+#ifdef CONFIG_DMX_HEALTH_ENABLE
+enum {
+  DMX_HEALTH_EVENT_COUNT = DMX_HEALTH_EVENT_STUCK + 1,
+};
+
+static bool dmx_health_recover(dmx_driver_t *driver, int64_t now) {
+  const dmx_port_t dmx_num = driver->dmx_num;
+
+  // Leave the receiver alone while it is sending or is not reading the bus
+  bool is_receiving = driver->is_enabled &&
+                      driver->dmx.status != DMX_STATUS_SENDING &&
+                      dmx_uart_get_rts(dmx_num) == 1;
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+  is_receiving = is_receiving && !driver->sleep.is_asleep;
+#endif
+  if (!is_receiving) {
+    return false;
+  }
+
+  // Discard the slots in the UART and wait for the next break
+  dmx_uart_rxfifo_reset(dmx_num);
+  dmx_packet_state_write_begin(driver);
+  driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+  dmx_packet_state_write_end(driver);
+  driver->health.head = DMX_HEAD_WAITING_FOR_BREAK;
+  driver->health.head_ts = now;
+  ++driver->health.recoveries;
+
+  return true;
+}
+
+static void dmx_health_check(void *arg) {
+  dmx_driver_t *const driver = arg;
+  const dmx_port_t dmx_num = driver->dmx_num;
+  struct dmx_driver_health_t *const health = &driver->health;
+  const int64_t now = dmx_timer_get_micros_since_boot();
+
+  uint32_t events = 0;
+  bool is_faulted = false;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (health->timer == NULL) {
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    return;  // The bus health monitor was disabled
+  }
+  health->checker = xTaskGetCurrentTaskHandle();
+  const dmx_health_config_t *const config = &health->config;
+
+  // Packets which do not begin with a DMX break have a break timestamp of 0
+  const int64_t break_ts = driver->dmx.rx_break_ts;
+  if (break_ts > health->break_ts) {
+    health->break_ts = break_ts;
+    if (!health->has_signal) {
+      health->has_signal = true;
+      events |= 1 << DMX_HEALTH_EVENT_SIGNAL_RESTORED;
+    }
+  } else if (health->has_signal &&
+             now - health->break_ts > config->loss_timeout_ms * 1000) {
+    health->has_signal = false;
+    ++health->signal_losses;
+    events |= 1 << DMX_HEALTH_EVENT_SIGNAL_LOST;
+    is_faulted = true;
+  }
+
+  // A packet is stuck if it stops receiving slots part of the way through
+  const int head = driver->dmx.head;
+  const int progress = driver->dmx.progress;
+  const bool is_in_packet = head >= 0 &&
+                            driver->dmx.status == DMX_STATUS_RECEIVING &&
+                            (progress == DMX_PROGRESS_IN_BREAK ||
+                             progress == DMX_PROGRESS_IN_MAB ||
+                             progress == DMX_PROGRESS_IN_DATA);
+  if (!is_in_packet || head != health->head) {
+    health->head = head;
+    health->head_ts = now;
+  } else if (now - health->head_ts > config->stuck_timeout_ms * 1000) {
+    events |= 1 << DMX_HEALTH_EVENT_STUCK;
+    is_faulted = true;
+  }
+
+  // Count the errors in the current window and detect bursts immediately
+  const dmx_stats_t *const counters = &driver->stats.counters;
+  const uint32_t errors = counters->uart_overflows + counters->improper_slots +
+                          counters->not_enough_slots;
+  const uint32_t window_errors = errors - health->window_base_errors;
+  if (!health->has_errors && window_errors >= config->error_threshold) {
+    health->has_errors = true;
+    ++health->error_bursts;
+    events |= 1 << DMX_HEALTH_EVENT_ERROR_BURST;
+    is_faulted = true;
+  }
+  if (now - health->window_start >= config->error_window_ms * 1000) {
+    health->window_errors = window_errors;
+    health->window_packets =
+        counters->rx_packets - health->window_base_packets;
+    if (health->has_errors) {
+      if (window_errors < config->error_threshold) {
+        health->has_errors = false;
+        events |= 1 << DMX_HEALTH_EVENT_ERRORS_CLEARED;
+      } else {
+        is_faulted = true;  // The errors persisted for the whole window
+      }
+    }
+    health->window_start = now;
+    health->window_base_errors = errors;
+    health->window_base_packets = counters->rx_packets;
+  }
+
+  if (is_faulted && !dmx_health_recover(driver, now)) {
+    events &= ~(1 << DMX_HEALTH_EVENT_STUCK);  // Still stuck on the next check
+  }
+  const dmx_health_cb_t callback = config->callback;
+  void *const context = config->context;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Report the events outside of the critical section
+  if (callback != NULL) {
+    for (int i = 0; i < DMX_HEALTH_EVENT_COUNT; ++i) {
+      if (events & (1 << i)) {
+        callback(dmx_num, i, context);
+      }
+    }
+  }
+
+  // Wake the task which is waiting to disable the bus health monitor
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const TaskHandle_t waiter = health->waiter;
+  health->checker = NULL;
+  health->waiter = NULL;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (waiter != NULL) {
+    xTaskNotifyGive(waiter);
+  }
+}
+
+bool dmx_health_enable(dmx_port_t dmx_num, const dmx_health_config_t *config) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(config != NULL, false, "config is null");
+  DMX_CHECK(config->interval_ms > 0, false, "interval_ms error");
+  DMX_CHECK(config->loss_timeout_ms > 0 && config->stuck_timeout_ms > 0,
+            false, "timeout error");
+  DMX_CHECK(config->error_window_ms > 0 && config->error_threshold > 0, false,
+            "error window error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_health_is_enabled(dmx_num), false,
+            "health monitor is already enabled");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  const esp_timer_create_args_t timer_args = {
+      .callback = dmx_health_check,
+      .arg = driver,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "dmx_health",
+  };
+  esp_timer_handle_t timer;
+  if (esp_timer_create(&timer_args, &timer)) {
+    DMX_CHECK(false, false, "health timer create error");
+  }
+
+  const int64_t now = dmx_timer_get_micros_since_boot();
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const dmx_stats_t *const counters = &driver->stats.counters;
+  driver->health.config = *config;
+  driver->health.has_signal = false;
+  driver->health.has_errors = false;
+  driver->health.break_ts = driver->dmx.rx_break_ts;
+  driver->health.head = driver->dmx.head;
+  driver->health.head_ts = now;
+  driver->health.window_start = now;
+  driver->health.window_base_errors = counters->uart_overflows +
+                                      counters->improper_slots +
+                                      counters->not_enough_slots;
+  driver->health.window_base_packets = counters->rx_packets;
+  driver->health.signal_losses = 0;
+  driver->health.error_bursts = 0;
+  driver->health.recoveries = 0;
+  driver->health.window_errors = 0;
+  driver->health.window_packets = 0;
+  driver->health.checker = NULL;
+  driver->health.waiter = NULL;
+  driver->health.timer = timer;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  esp_timer_start_periodic(timer, config->interval_ms * 1000);
+
+  return true;
+}
+
+bool dmx_health_disable(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(dmx_health_is_enabled(dmx_num), false,
+            "health monitor is not enabled");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Checks which start after the timer is NULL return early
+  const TaskHandle_t this_task = xTaskGetCurrentTaskHandle();
+  bool is_waiting;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  esp_timer_handle_t timer = driver->health.timer;
+  driver->health.timer = NULL;
+  is_waiting = driver->health.checker != NULL &&
+               driver->health.checker != this_task;  // Not from a callback
+  if (is_waiting) {
+    driver->health.waiter = this_task;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  esp_timer_stop(timer);
+
+  // Wait for a check which is already running to finish before deleting it
+  if (is_waiting) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+  esp_timer_delete(timer);
+
+  return true;
+}
+
+bool dmx_health_is_enabled(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && dmx_driver_is_installed(dmx_num) &&
+         dmx_driver[dmx_num]->health.timer != NULL;
+}
+
+bool dmx_health_is_ok(dmx_port_t dmx_num) {
+  if (!dmx_health_is_enabled(dmx_num)) {
+    return false;
+  }
+
+  const struct dmx_driver_health_t *const health = &dmx_driver[dmx_num]->health;
+  return DMX_LOAD(health->has_signal) && !DMX_LOAD(health->has_errors);
+}
+
+bool dmx_health_get_stats(dmx_port_t dmx_num, dmx_health_stats_t *stats) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+
+  if (!dmx_health_is_enabled(dmx_num)) {
+    return false;
+  }
+
+  const struct dmx_driver_health_t *const health = &dmx_driver[dmx_num]->health;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  stats->has_signal = health->has_signal;
+  stats->has_errors = health->has_errors;
+  stats->signal_losses = health->signal_losses;
+  stats->error_bursts = health->error_bursts;
+  stats->recoveries = health->recoveries;
+  stats->window_errors = health->window_errors;
+  stats->window_packets = health->window_packets;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+#endif
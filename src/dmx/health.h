@@ -0,0 +1,161 @@
+/**
+ * @file dmx/health.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the bus health monitor of the DMX driver. When it
+ * is enabled, a timer periodically checks the state of the DMX driver and its
+ * error counters for loss of signal, receivers which are stuck part of the way
+ * through a packet, and bursts of UART overflows and improper slots. Faults
+ * are recovered by resetting the UART RX FIFO so that the DMX driver waits for
+ * the next DMX break, which is much cheaper than reinstalling the DMX driver.
+ * Faults and recoveries are reported with a callback. The bus health monitor
+ * is only available when CONFIG_DMX_HEALTH_ENABLE is set.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The events which are reported by the bus health monitor.*/
+typedef enum dmx_health_event_t {
+  /** @brief No DMX break was received for the loss timeout.*/
+  DMX_HEALTH_EVENT_SIGNAL_LOST = 0,
+  /** @brief A DMX break was received after the signal was lost.*/
+  DMX_HEALTH_EVENT_SIGNAL_RESTORED,
+  /** @brief At least the error threshold of errors was counted within one
+     error window.*/
+  DMX_HEALTH_EVENT_ERROR_BURST,
+  /** @brief An error window ended with fewer errors than the error threshold
+     after an error burst.*/
+  DMX_HEALTH_EVENT_ERRORS_CLEARED,
+  /** @brief A packet stopped receiving slots for the stuck timeout and the
+     receiver was reset.*/
+  DMX_HEALTH_EVENT_STUCK,
+} dmx_health_event_t;
+
+/**
+ * @brief The function which is called by the bus health monitor when an event
+ * occurs. It is called from the esp_timer task, so it must not block.
+ *
+ * @param dmx_num The DMX port number.
+ * @param event The event which occurred.
+ * @param[inout] context The context which was passed in dmx_health_config_t.
+ */
+typedef void (*dmx_health_cb_t)(dmx_port_t dmx_num, dmx_health_event_t event,
+                                void *context);
+
+/** @brief Configuration settings of the bus health monitor.*/
+typedef struct dmx_health_config_t {
+  /** @brief The time in milliseconds between checks of the DMX driver.*/
+  uint32_t interval_ms;
+  /** @brief The time in milliseconds without a DMX break after which the
+     signal is lost.*/
+  uint32_t loss_timeout_ms;
+  /** @brief The time in milliseconds without a new slot after which a packet
+     which is being received is stuck.*/
+  uint32_t stuck_timeout_ms;
+  /** @brief The length in milliseconds of the window in which errors are
+     counted.*/
+  uint32_t error_window_ms;
+  /** @brief The number of UART overflows, improper slots, and packets without
+     enough slots within one error window which is an error burst.*/
+  uint32_t error_threshold;
+  /** @brief The function which is called on each event, or NULL.*/
+  dmx_health_cb_t callback;
+  /** @brief Context for the callback.*/
+  void *context;
+} dmx_health_config_t;
+
+/** @brief The default configuration of the bus health monitor. The loss
+ * timeout is the DMX timeout, 1250 milliseconds. Redundant systems may use
+ * much shorter timeouts.*/
+#define DMX_HEALTH_CONFIG_DEFAULT                    \
+  (dmx_health_config_t) {                            \
+    10,           /*interval_ms*/                    \
+        1250,     /*loss_timeout_ms*/                \
+        1000,     /*stuck_timeout_ms*/               \
+        1000,     /*error_window_ms*/                \
+        5,        /*error_threshold*/                \
+        NULL,     /*callback*/                       \
+        NULL,     /*context*/                        \
+  }
+
+/** @brief Statistics of the bus health monitor of a DMX port.*/
+typedef struct dmx_health_stats_t {
+  /** @brief True if a DMX break has been received within the loss timeout.*/
+  bool has_signal;
+  /** @brief True if the last error window was an error burst.*/
+  bool has_errors;
+  /** @brief The number of times that the signal was lost.*/
+  uint32_t signal_losses;
+  /** @brief The number of error bursts.*/
+  uint32_t error_bursts;
+  /** @brief The number of times that the receiver was reset.*/
+  uint32_t recoveries;
+  /** @brief The number of errors which were counted in the last complete
+     error window.*/
+  uint32_t window_errors;
+  /** @brief The number of packets which were received in the last complete
+     error window.*/
+  uint32_t window_packets;
+} dmx_health_stats_t;
+
+/**
+ * @brief Enables the bus health monitor of a DMX port. A timer checks the DMX
+ * driver every interval_ms. The receiver is reset when the signal is lost,
+ * when a packet is stuck, and on each error burst. Nothing is reset while the
+ * DMX port is sending.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] config The configuration of the bus health monitor.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_health_enable(dmx_port_t dmx_num, const dmx_health_config_t *config);
+
+/**
+ * @brief Disables the bus health monitor of a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_health_disable(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the bus health monitor of a DMX port is enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the bus health monitor is enabled.
+ * @return false if it is not.
+ */
+bool dmx_health_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if a DMX port has a DMX signal without an error burst,
+ * according to its bus health monitor.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the DMX port is healthy.
+ * @return false if it is not, or if the bus health monitor is not enabled.
+ */
+bool dmx_health_is_ok(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the statistics of the bus health monitor of a DMX port since it
+ * was enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false if the bus health monitor is not enabled.
+ */
+bool dmx_health_get_stats(dmx_port_t dmx_num, dmx_health_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -40,6 +40,55 @@ bool dmx_driver_install(dmx_port_t dmx_num, const dmx_config_t *config,
                         const dmx_personality_t *personalities,
                         int personality_count);
 
+/**
+ * @brief Installs the DMX driver into caller-provided storage. This function
+ * behaves like dmx_driver_install(), except that the DMX driver, its mutex,
+ * its event group, and its parameters are placed in the storage instead of
+ * being allocated from the heap. Parameters which do not fit in the storage
+ * are not allocated from the heap, so the DMX driver never uses the heap after
+ * it is installed. The dmx_config_t.arena_caps field is ignored. The storage
+ * after the DMX driver is used as its memory arena, so the storage should be at
+ * least the size returned by dmx_driver_get_static_size().
+ *
+ * @note The UART, hardware timer, and interrupt allocation of the ESP-IDF may
+ * still allocate memory while the DMX driver is installed. Modules which are
+ * started after the DMX driver is installed, such as the DMX sniffer or the
+ * RDM scheduler, allocate their own memory.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] config A pointer to a DMX configuration which will be used to
+ * setup the DMX driver.
+ * @param[in] personalities A pointer to an array of DMX personalities which
+ * the DMX driver will support.
+ * @param personality_count The number of personalities in the previous
+ * argument. This value must be between 0 and 255, inclusive.
+ * @param[inout] storage A pointer to the storage into which to install the DMX
+ * driver. It must remain valid until the DMX driver is deleted.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_driver_install_static(dmx_port_t dmx_num, const dmx_config_t *config,
+                               const dmx_personality_t *personalities,
+                               int personality_count,
+                               dmx_static_storage_t *storage);
+
+/**
+ * @brief Gets the size in bytes of the storage buffer which is needed to
+ * install the DMX driver with dmx_driver_install_static(). The size includes
+ * the DMX driver, its root device parameters, the data of the default
+ * parameters which are registered when the DMX driver is installed, and an
+ * additional dmx_config_t.arena_size bytes for parameter data, sub-devices, and
+ * RDM parameters which are registered by the user.
+ *
+ * @param[in] config A pointer to the DMX configuration which will be used to
+ * setup the DMX driver.
+ * @param personality_count The number of personalities which will be passed to
+ * dmx_driver_install_static().
+ * @return The size of the storage buffer in bytes, or 0 on failure.
+ */
+size_t dmx_driver_get_static_size(const dmx_config_t *config,
+                                  int personality_count);
+
 /**
  * @brief Uninstalls the DMX driver.
  *
@@ -194,11 +243,139 @@ uint32_t dmx_get_mab_len(dmx_port_t dmx_num);
  */
 uint32_t dmx_set_mab_len(dmx_port_t dmx_num, uint32_t mab_len);
 
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+/**
+ * @brief Enables or disables the extended mode of a DMX port. In extended
+ * mode, dmx_set_baud_rate() allows baud rates up to DMX_EXTENDED_BAUD_RATE_MAX,
+ * dmx_set_break_len() and dmx_set_mab_len() allow lengths down to
+ * DMX_EXTENDED_BREAK_LEN_MIN_US and DMX_EXTENDED_MAB_LEN_MIN_US, and packets of
+ * up to DMX_EXTENDED_PACKET_SIZE_MAX slots may be sent and received. When the
+ * extended mode is disabled, the baud rate, break length, mark-after-break
+ * length, and packet size are clamped back to within DMX specification.
+ *
+ * @note The extended mode is not DMX. It should only be used on links where
+ * every device has been configured with the same settings. RDM timing is not
+ * changed, so RDM should not be used in extended mode.
+ *
+ * @param dmx_num The DMX port number.
+ * @param enable True to enable the extended mode, false to disable it.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_set_extended_mode(dmx_port_t dmx_num, bool enable);
+
+/**
+ * @brief Checks if the extended mode of a DMX port is enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the extended mode is enabled.
+ * @return false if it is not.
+ */
+bool dmx_extended_mode_is_enabled(dmx_port_t dmx_num);
+#endif
+
+/**
+ * @brief Gets the UART RX FIFO full threshold.
+ *
+ * @param dmx_num The DMX port number.
+ * @return The UART RX FIFO full threshold, DMX_FIFO_THRESHOLD_ADAPTIVE, or -1
+ * on error.
+ */
+int dmx_get_rx_fifo_threshold(dmx_port_t dmx_num);
+
+/**
+ * @brief Sets the number of bytes that must be received before the DMX driver
+ * reads from the UART RX FIFO. Higher thresholds use fewer interrupts but any
+ * remaining bytes are only read once the DMX bus is idle. The threshold will
+ * be clamped to DMX_FIFO_THRESHOLD_MAX. If the threshold is set to
+ * DMX_FIFO_THRESHOLD_ADAPTIVE, the DMX driver uses a high threshold while
+ * receiving DMX data and a threshold of one byte while an RDM response is
+ * expected. This is the default.
+ *
+ * @note Fixed thresholds above one byte prevent RDM controllers from detecting
+ * RDM responder inter-slot timing violations.
+ *
+ * @param dmx_num The DMX port number.
+ * @param threshold The UART RX FIFO full threshold.
+ * @return The value that the threshold was set to or -1 on error.
+ */
+int dmx_set_rx_fifo_threshold(dmx_port_t dmx_num, int threshold);
+
+/**
+ * @brief Gets the UART TX FIFO empty threshold.
+ *
+ * @param dmx_num The DMX port number.
+ * @return The UART TX FIFO empty threshold or -1 on error.
+ */
+int dmx_get_tx_fifo_threshold(dmx_port_t dmx_num);
+
+/**
+ * @brief Sets the number of bytes that may remain in the UART TX FIFO before
+ * the DMX driver refills it. Lower thresholds use fewer interrupts but leave
+ * less time for the interrupt to be serviced before the FIFO is emptied. The
+ * threshold will be clamped between 1 and DMX_FIFO_THRESHOLD_MAX.
+ *
+ * @param dmx_num The DMX port number.
+ * @param threshold The UART TX FIFO empty threshold.
+ * @return The value that the threshold was set to or -1 on error.
+ */
+int dmx_set_tx_fifo_threshold(dmx_port_t dmx_num, int threshold);
+
+/**
+ * @brief Sets whether received packets with a start code are accepted. Packets
+ * with start codes which are not accepted are dropped by the DMX ISR as soon as
+ * their start code is received, so they do not wake the task which calls
+ * dmx_receive(). All start codes are accepted by default.
+ *
+ * @note RDM controllers must accept RDM_SC, RDM_PREAMBLE, and RDM_DELIMITER to
+ * receive RDM responses, and RDM responders must accept RDM_SC to receive RDM
+ * requests.
+ *
+ * @param dmx_num The DMX port number.
+ * @param sc The start code to filter, or DMX_START_CODE_ALL to filter every
+ * start code.
+ * @param accept True to accept packets with the start code. False to drop them.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_set_start_code_filter(dmx_port_t dmx_num, int sc, bool accept);
+
+/**
+ * @brief Checks if received packets with a start code are accepted.
+ *
+ * @param dmx_num The DMX port number.
+ * @param sc The start code to check.
+ * @return true if packets with the start code are accepted.
+ * @return false if packets with the start code are dropped or on failure.
+ */
+bool dmx_get_start_code_filter(dmx_port_t dmx_num, uint8_t sc);
+
+/**
+ * @brief Routes received packets with a start code to a callback. Routed
+ * packets are passed to the callback from the DMX ISR once they are complete
+ * and are not returned by dmx_receive(). Up to DMX_START_CODE_ROUTE_MAX start
+ * codes may be routed on each DMX port. RDM start codes may not be routed.
+ *
+ * @param dmx_num The DMX port number.
+ * @param sc The start code to route.
+ * @param callback The callback which receives the packets, or NULL to stop
+ * routing the start code.
+ * @param[inout] context Context which is passed to the callback.
+ * @return true on success.
+ * @return false if there are no free routes or on failure.
+ */
+bool dmx_set_start_code_callback(dmx_port_t dmx_num, uint8_t sc,
+                                 dmx_start_code_cb_t callback, void *context);
+
 /**
  * @brief Reads DMX data from the driver into a destination buffer with an
  * offset. This can be useful when a receiving DMX device only needs to process
  * a small footprint of the DMX packet.
  *
+ * @note When CONFIG_DMX_RX_BUFFER_COUNT is greater than 1, this function reads
+ * from the last completed DMX packet instead of the packet that is currently
+ * being received.
+ *
  * @param dmx_num The DMX port number.
  * @param offset The number of slots with which to offset the read. If set to 0
  * this function is equivalent to dmx_read().
@@ -230,6 +407,54 @@ size_t dmx_read(dmx_port_t dmx_num, void *destination, size_t size);
  */
 int dmx_read_slot(dmx_port_t dmx_num, size_t slot_num);
 
+/**
+ * @brief Borrows a pointer to the last completed DMX packet in the DMX driver
+ * buffer. This allows DMX data to be processed without copying it out of the
+ * DMX driver. The DMX driver will not swap out the borrowed buffer until
+ * dmx_frame_release() is called. Only one borrow may be active at a time on
+ * each DMX port.
+ *
+ * @note When CONFIG_DMX_RX_BUFFER_COUNT is 1, the DMX driver receives directly
+ * into the borrowed buffer so its contents may change while it is borrowed.
+ * When CONFIG_DMX_RX_BUFFER_COUNT is 2, packets which are received while the
+ * buffer is borrowed are discarded and counted in the rx_packets_dropped
+ * statistic. dmx_receive() still returns when such a packet is received, but
+ * dmx_read() returns the borrowed packet until the buffer is released, so a
+ * borrow should be held for less than one DMX packet. When
+ * CONFIG_DMX_RX_BUFFER_COUNT is 3, packets continue to be received while the
+ * buffer is borrowed and the most recent packet is latched by the next call
+ * to dmx_receive() or dmx_frame_acquire() after the buffer is released.
+ *
+ * @param dmx_num The DMX port number.
+ * @return A pointer to the DMX packet buffer or NULL on failure.
+ */
+const uint8_t *dmx_frame_acquire(dmx_port_t dmx_num);
+
+/**
+ * @brief Releases a DMX packet buffer that was borrowed with
+ * dmx_frame_acquire(). The pointer returned by dmx_frame_acquire() must not be
+ * used after calling this function.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if a borrowed buffer was released.
+ * @return false if no buffer was borrowed.
+ */
+bool dmx_frame_release(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the slots which changed between the DMX packet that was returned
+ * by the last call to dmx_receive() and the packet returned by the call before
+ * it. Packets which were received in between are included, so a slot is marked
+ * as changed if it changed in any of them. CONFIG_DMX_RX_CHANGE_DETECTION must
+ * be enabled to use this function.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] changes A pointer to store the changed slots.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_get_changes(dmx_port_t dmx_num, dmx_changes_t *changes);
+
 /**
  * @brief Writes DMX data from a source buffer into the DMX driver buffer with
  * an offset. Allows a source buffer to be written to a specific slot number in
@@ -265,6 +490,37 @@ size_t dmx_write(dmx_port_t dmx_num, const void *source, size_t size);
  */
 int dmx_write_slot(dmx_port_t dmx_num, size_t slot_num, uint8_t value);
 
+/**
+ * @brief Writes a list of scattered DMX slots. Every slot is written within a
+ * single critical section, so the slots are always sent in the same DMX packet.
+ * This is faster than calling dmx_write_slot() for each slot. While the DMX
+ * driver is auto-refreshing, the slots are written to the shadow buffer which
+ * is latched at the start of the next DMX packet.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] slots An array of slot updates to write. Updates of slots which
+ * are outside of the DMX packet are ignored.
+ * @param count The number of slot updates in the array.
+ * @return The number of slots written into the DMX driver.
+ */
+size_t dmx_write_slots(dmx_port_t dmx_num, const dmx_slot_write_t *slots,
+                       size_t count);
+
+/**
+ * @brief Writes a list of spans of DMX slots. Every span is written within a
+ * single critical section, so the spans are always sent in the same DMX
+ * packet. While the DMX driver is auto-refreshing, the spans are written to the
+ * shadow buffer which is latched at the start of the next DMX packet.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] spans An array of spans to write. Spans which extend beyond the
+ * DMX packet are clamped.
+ * @param count The number of spans in the array.
+ * @return The number of bytes written into the DMX driver.
+ */
+size_t dmx_write_spans(dmx_port_t dmx_num, const dmx_span_write_t *spans,
+                       size_t count);
+
 /**
  * @brief Receives a DMX packet of a specified size from the DMX bus. This is a
  * blocking function. This function first blocks until the DMX driver is idle
@@ -278,6 +534,10 @@ int dmx_write_slot(dmx_port_t dmx_num, size_t slot_num, uint8_t value);
  * unblock. Using task notifications on the same task that calls this function
  * can lead to undesired behavior and program instability.
  *
+ * @note When CONFIG_DMX_RX_BUFFER_COUNT is 3, the received packet is latched
+ * when this function returns and is not modified by the DMX driver until this
+ * function is called again.
+ *
  * @param dmx_num The DMX port number.
  * @param[out] packet An optional pointer to a dmx_packet_t which contains
  * information about the received DMX packet.
@@ -289,6 +549,28 @@ int dmx_write_slot(dmx_port_t dmx_num, size_t slot_num, uint8_t value);
 size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
                        TickType_t wait_ticks);
 
+/**
+ * @brief Receives the slots of the DMX footprint of this device from the DMX
+ * bus. This function behaves like dmx_receive_num() with a size that ends at
+ * the last slot of the footprint of the current DMX personality, as given by
+ * dmx_get_start_address() and dmx_get_footprint(). The DMX driver notifies
+ * this function as soon as the footprint has been received and does not copy
+ * the slots of DMX packets beyond it. If the device does not have a DMX start
+ * address or personality, a full DMX packet is received.
+ *
+ * @note This function uses FreeRTOS direct-to-task notifications to block and
+ * unblock. Using task notifications on the same task that calls this function
+ * can lead to undesired behavior and program instability.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] packet An optional pointer to a dmx_packet_t which contains
+ * information about the received DMX packet.
+ * @param wait_ticks The number of ticks to wait before this function times out.
+ * @return The size of the received DMX packet or 0 if no packet was received.
+ */
+size_t dmx_receive_footprint(dmx_port_t dmx_num, dmx_packet_t *packet,
+                             TickType_t wait_ticks);
+
 /**
  * @brief Receives a DMX packet from the DMX bus. This is a blocking function.
  * This function first blocks until the DMX driver is idle and then it blocks
@@ -353,6 +635,196 @@ size_t dmx_send(dmx_port_t dmx_num);
  */
 bool dmx_wait_sent(dmx_port_t dmx_num, TickType_t wait_ticks);
 
+/**
+ * @brief Waits for one or more DMX driver events. Unlike dmx_receive() and
+ * dmx_wait_sent(), this function does not take the DMX driver mutex, so any
+ * number of tasks may wait for events at the same time and every waiting task
+ * is woken by the same event. Events are not kept for tasks which are not
+ * waiting when the event occurs. This function does not read or latch the DMX
+ * packet, so it may be used alongside a task which calls dmx_receive().
+ *
+ * @note Events are delivered by the FreeRTOS timer service task, so a task is
+ * woken only after the timer service task has run.
+ *
+ * @param dmx_num The DMX port number.
+ * @param events A mask of enum dmx_event_t to wait for.
+ * @param wait_ticks The number of ticks to wait before this function times out.
+ * @return A mask of enum dmx_event_t which were broadcast, or 0 if the function
+ * timed out.
+ */
+uint32_t dmx_wait_event(dmx_port_t dmx_num, uint32_t events,
+                        TickType_t wait_ticks);
+
+/**
+ * @brief Enables DMX auto-refresh. When auto-refresh is enabled, the DMX driver
+ * sends DMX packets continuously at the desired refresh rate from within the
+ * DMX interrupt handlers. Calls to dmx_write() are made to a shadow buffer
+ * which is latched at the start of the next DMX break so that each sent packet
+ * is never torn. dmx_send() and dmx_receive() may not be called while
+ * auto-refresh is enabled.
+ *
+ * @note If the refresh rate is too fast for the size of the DMX packet, DMX
+ * packets are sent back-to-back.
+ *
+ * @param dmx_num The DMX port number.
+ * @param refresh_rate The desired refresh rate in packets per second.
+ * @param size The size of the DMX packets to send. Sizes of 0 or greater than
+ * DMX_PACKET_SIZE_MAX send packets of DMX_PACKET_SIZE_MAX.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_auto_refresh_enable(dmx_port_t dmx_num, uint32_t refresh_rate,
+                             size_t size);
+
+/**
+ * @brief Disables DMX auto-refresh. The DMX packet currently being sent is
+ * allowed to finish and any writes made to the shadow buffer are copied into
+ * the DMX buffer.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_auto_refresh_disable(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if DMX auto-refresh is enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if DMX auto-refresh is enabled.
+ * @return false if DMX auto-refresh is not enabled.
+ */
+bool dmx_auto_refresh_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Enables the DMX sync group. The DMX sync group sends DMX packets on
+ * several DMX ports in lockstep. The DMX breaks of every port in the group are
+ * started from a single timer event, and the next packet is not started until
+ * every port in the group has finished sending. Each port in the group
+ * auto-refreshes, so calls to dmx_write() are made to the shadow buffer of the
+ * port. The shadow buffers are latched only when dmx_sync_group_commit() is
+ * called, so that a new frame is sent on every port at once. Only one DMX sync
+ * group may be enabled at a time.
+ *
+ * @param[in] ports An array of the DMX port numbers to add to the group. The
+ * timer of the first port is used to schedule the packets of the group.
+ * @param num_ports The number of DMX ports in the array.
+ * @param refresh_rate The desired refresh rate in packets per second.
+ * @param size The size of the DMX packets to send. Sizes of 0 or greater than
+ * DMX_PACKET_SIZE_MAX send packets of DMX_PACKET_SIZE_MAX.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sync_group_enable(const dmx_port_t *ports, int num_ports,
+                           uint32_t refresh_rate, size_t size);
+
+/**
+ * @brief Latches the shadow buffers of every port in the DMX sync group at the
+ * start of the next DMX packet. Writes which are made to a shadow buffer after
+ * this function is called and before the next packet is started are included
+ * in that packet.
+ *
+ * @return true on success.
+ * @return false if the DMX sync group is not enabled.
+ */
+bool dmx_sync_group_commit();
+
+/**
+ * @brief Disables the DMX sync group. The DMX packets which are currently being
+ * sent are allowed to finish and auto-refresh is disabled on every port in the
+ * group. Writes made to the shadow buffers are copied into the DMX buffers.
+ *
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sync_group_disable();
+
+/**
+ * @brief Checks if the DMX sync group is enabled.
+ *
+ * @return true if the DMX sync group is enabled.
+ * @return false if the DMX sync group is not enabled.
+ */
+bool dmx_sync_group_is_enabled();
+
+/**
+ * @brief Enables the DMX repeater on an input DMX port. The slots of each DMX
+ * packet received on the input are cut through to the UART of each output by
+ * the DMX ISR as they arrive, so the outputs lag the input by only a few slots
+ * instead of a whole packet. The DMX break of each output is started when the
+ * start code of the input is received. Packets with an RDM start code are not
+ * repeated. The UART RX FIFO full threshold of the input is set to
+ * DMX_REPEATER_RX_FIFO_THRESHOLD while the DMX repeater is enabled.
+ *
+ * @note dmx_send() and dmx_receive() must not be called on the output DMX
+ * ports while the DMX repeater is enabled. The input may still be read with
+ * dmx_receive().
+ *
+ * @param input The DMX port number whose received packets are repeated.
+ * @param[in] outputs An array of the DMX port numbers on which the packets are
+ * repeated.
+ * @param num_outputs The number of DMX ports in the array.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_repeater_enable(dmx_port_t input, const dmx_port_t *outputs,
+                         int num_outputs);
+
+/**
+ * @brief Disables the DMX repeater on an input DMX port. This function blocks
+ * until the slots which have already been forwarded have been sent. The UART
+ * RX FIFO full threshold of the input is restored.
+ *
+ * @param input The DMX port number whose received packets are repeated.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_repeater_disable(dmx_port_t input);
+
+/**
+ * @brief Checks if the DMX repeater is enabled on an input DMX port.
+ *
+ * @param input The DMX port number whose received packets are repeated.
+ * @return true if the DMX repeater is enabled.
+ * @return false if the DMX repeater is not enabled.
+ */
+bool dmx_repeater_is_enabled(dmx_port_t input);
+
+/**
+ * @brief Gets the RDM response turnaround statistics of the DMX port. The
+ * turnaround time is the time from the end of the last RDM request until the
+ * DMX driver turns the DMX bus around to send its response. The minimum time
+ * allowed by the RDM standard is 176 microseconds.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] turnaround A pointer to store the turnaround statistics.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_get_turnaround(dmx_port_t dmx_num, dmx_turnaround_t *turnaround);
+
+/**
+ * @brief Gets the statistics of the DMX driver. The statistics are counted by
+ * the DMX interrupt handlers since the DMX driver was installed or since the
+ * statistics were last reset.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] stats A pointer to store the DMX driver statistics.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_get_stats(dmx_port_t dmx_num, dmx_stats_t *stats);
+
+/**
+ * @brief Resets the statistics of the DMX driver, including its RDM response
+ * turnaround statistics.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_reset_stats(dmx_port_t dmx_num);
+
 #ifdef __cplusplus
 }
 #endif
@@ -114,16 +114,34 @@ size_t dmx_parameter_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
                          rdm_pid_t pid, const void *source, size_t size);
 
 /**
- * @brief Commits any updated non-volatile parameters to non-volatile storage.
- * Because committing non-volatile parameters can take some time, this function
- * commits only one parameter per function call. This function is not
- * thread-safe.
+ * @brief Sets the value of a desired parameter on the root device and on every
+ * sub-device which has the parameter, such as when a request is addressed to
+ * RDM_SUB_DEVICE_ALL. The sub-devices are written in a single pass and their
+ * non-volatile parameters are staged together so that they are written to
+ * non-volatile storage in one commit.
  *
  * @param dmx_num The DMX port number.
- * @return The parameter ID of the parameter that was committed or 0 if there
- * are no parameters waiting to be committed.
+ * @param pid The parameter ID of the desired parameter.
+ * @param[in] source The value to which to set the parameter.
+ * @param size The size of the source buffer.
+ * @return The number of devices on which the parameter was written.
+ */
+size_t dmx_parameter_set_all(dmx_port_t dmx_num, rdm_pid_t pid,
+                             const void *source, size_t size);
+
+/**
+ * @brief Commits all updated non-volatile parameters to non-volatile storage
+ * immediately. Parameters are written in a single NVS commit unless there is
+ * not enough memory to list them all at once.
+ * Staged parameters are also committed automatically by a low-priority
+ * background task once no parameters have been updated for
+ * CONFIG_DMX_NVS_COMMIT_DEBOUNCE_MS milliseconds, so calling this function is
+ * usually unnecessary. This function is not thread-safe.
+ *
+ * @param dmx_num The DMX port number.
+ * @return The number of parameters that were committed.
  */
-rdm_pid_t dmx_parameter_commit(dmx_port_t dmx_num);
+int dmx_parameter_commit(dmx_port_t dmx_num);
 
 #ifdef __cplusplus
 }
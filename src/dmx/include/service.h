@@ -10,11 +10,28 @@
 
 #include "dmx/include/parameter.h"
 #include "dmx/include/types.h"
+#include "dmx/trace.h"
 #include "esp_check.h"
+#include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "freertos/semphr.h"
+#include "rdm/include/format.h"
 #include "rdm/responder/include/utils.h"
 
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+#include "esp_pm.h"
+#include "esp_timer.h"
+#endif
+
+#ifdef CONFIG_DMX_HEALTH_ENABLE
+#include "dmx/health.h"
+#include "esp_timer.h"
+#endif
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+#include "dmx/failover.h"
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -57,6 +74,66 @@ extern "C" {
 typedef spinlock_t dmx_spinlock_t;
 #define DMX_SPINLOCK_INIT portMUX_INITIALIZER_UNLOCKED
 
+/** @brief Reads a field of the DMX driver which is written by the DMX ISR
+ * without entering a critical section. The field must be no larger than 32
+ * bits so that it is read in a single load.*/
+#define DMX_LOAD(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+
+#ifdef CONFIG_DMX_RX_BUFFER_COUNT
+/** @brief The number of DMX packet buffers allocated for each DMX driver.*/
+#define DMX_RX_BUFFER_COUNT CONFIG_DMX_RX_BUFFER_COUNT
+#else
+/** @brief The number of DMX packet buffers allocated for each DMX driver.*/
+#define DMX_RX_BUFFER_COUNT 1
+#endif
+
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+/** @brief The size in bytes of each DMX packet buffer of each DMX driver.*/
+#define DMX_BUFFER_SIZE DMX_EXTENDED_PACKET_SIZE_MAX
+/** @brief Evaluates to the largest DMX packet which the DMX driver may send
+ * or receive.*/
+#define dmx_packet_size_max(driver)                               \
+  ((driver)->is_extended ? DMX_EXTENDED_PACKET_SIZE_MAX : DMX_PACKET_SIZE_MAX)
+#else
+/** @brief The size in bytes of each DMX packet buffer of each DMX driver.*/
+#define DMX_BUFFER_SIZE DMX_PACKET_SIZE_MAX
+/** @brief Evaluates to the largest DMX packet which the DMX driver may send
+ * or receive.*/
+#define dmx_packet_size_max(driver) (DMX_PACKET_SIZE_MAX)
+#endif
+
+#ifdef CONFIG_DMX_TRACE_BUFFER_SIZE
+/** @brief The number of entries in the DMX trace buffer of each DMX driver.*/
+#define DMX_TRACE_BUFFER_SIZE CONFIG_DMX_TRACE_BUFFER_SIZE
+#else
+/** @brief The number of entries in the DMX trace buffer of each DMX driver.*/
+#define DMX_TRACE_BUFFER_SIZE 64
+#endif
+
+#ifdef CONFIG_DMX_TRACE_FRAME_COUNT
+/** @brief The number of frame profiles which are kept by each DMX driver.*/
+#define DMX_TRACE_FRAME_COUNT CONFIG_DMX_TRACE_FRAME_COUNT
+#else
+/** @brief The number of frame profiles which are kept by each DMX driver.*/
+#define DMX_TRACE_FRAME_COUNT 32
+#endif
+
+/** @brief The longest time in microseconds between the DMX breaks of two DMX
+ * packets which is used to measure the refresh rate of received packets.*/
+#define DMX_RX_PERIOD_MAX_US 1250000
+
+/** @brief The weight of each newly measured period in the rolling average of
+ * the time between received DMX packets. Larger values smooth the average.*/
+#define DMX_RX_PERIOD_WEIGHT 8
+
+#ifdef CONFIG_DMX_SNIFFER_HISTORY_SIZE
+/** @brief The number of entries in the sniffer history of each DMX driver.*/
+#define DMX_SNIFFER_HISTORY_SIZE CONFIG_DMX_SNIFFER_HISTORY_SIZE
+#else
+/** @brief The number of entries in the sniffer history of each DMX driver.*/
+#define DMX_SNIFFER_HISTORY_SIZE 16
+#endif
+
 extern const char *TAG;  // The log tagline for the library.
 
 enum dmx_parameter_type_t {
@@ -75,12 +152,28 @@ enum {
   DMX_PROGRESS_IN_MAB,     // The packet is in the DMX mark-after-break.
   DMX_PROGRESS_IN_DATA,    // Packet slot data is being sent or received.
   DMX_PROGRESS_COMPLETE,   // The packet is complete.
+  DMX_PROGRESS_IN_TURNAROUND,  // The driver is waiting to turn the bus around.
 
   DMX_STATUS_IDLE = 0,   // The DMX driver is idle.
   DMX_STATUS_RECEIVING,  // The DMX driver is receiving data.
   DMX_STATUS_SENDING,    // The DMX driver is sending data.
 };
 
+/**
+ * @brief An encoded RDM GET response which is cached so that identical GET
+ * requests can be answered without calling the parameter's response handler.
+ */
+typedef struct dmx_parameter_response_t {
+  uint32_t generation;  // The parameter generation of the driver when the response was cached. The response is stale if the generation has changed.
+  uint32_t device_generation;  // The parameter generation of the device when the response was cached. The response is stale if the generation has changed.
+  uint8_t request_pdl;  // The parameter data length of the request which generated the response.
+  uint8_t request_pd[4];  // The parameter data of the request which generated the response.
+  uint8_t capacity;  // The maximum size of the encoded parameter data in bytes.
+  uint8_t pdl;  // The size of the encoded parameter data in bytes.
+  uint16_t pd_sum;  // The sum of the encoded parameter data bytes, which is added to the checksum of the response.
+  uint8_t pd[];  // The encoded parameter data of the response.
+} dmx_parameter_response_t;
+
 /**
  * @brief The DMX parameter type. Contains information necessary for maintaining
  * parameter information as well as RDM response information if necessary.
@@ -93,16 +186,18 @@ typedef struct dmx_parameter_t {
   const rdm_parameter_definition_t *definition;  // The RDM definition of the parameter. Is only needed for RDM responders.
   rdm_callback_t callback;  // A user callback for the parameter. Is only needed for RDM responders.
   void *context;            // Context for the user callback.
+  dmx_parameter_response_t *response;  // The cached RDM GET response of the parameter, or NULL if no response has been cached.
 } dmx_parameter_t;
 
 /**
  * @brief The DMX device type. Holds an array of parameters associated with the
- * device as well as a linked-list style pointer to the next DMX device.
+ * device, sorted by PID.
  */
 typedef struct dmx_device_t {
   dmx_device_num_t num;  // The device number.
-  struct dmx_device_t *next;  // A pointer to the next device.
-  dmx_parameter_t parameters[];  // An array of parameters associated with this device.
+  int num_parameters;  // The number of parameters which have been added to this device.
+  uint32_t generation;  // Is incremented whenever a parameter of this device is set. Used to invalidate the cached RDM responses of this device.
+  dmx_parameter_t parameters[];  // An array of parameters associated with this device. It is sorted by PID so that it can be binary searched.
 } dmx_device_t;
 
 /** @brief The DMX driver object used to handle reading and writing DMX data on
@@ -114,13 +209,20 @@ typedef struct dmx_driver_t {
   rdm_uid_t uid;       // The driver's UID.
   uint32_t break_len;  // Length in microseconds of the transmitted break.
   uint32_t mab_len;  // Length in microseconds of the transmitted mark-after-break.
+  int rx_fifo_threshold;  // The UART RX FIFO full threshold, or DMX_FIFO_THRESHOLD_ADAPTIVE.
+  int tx_fifo_threshold;  // The UART TX FIFO empty threshold.
 
   bool is_enabled;  // True if the DMX driver is enabled.
   bool is_controller;  // True if the DMX driver is the controller on the DMX bus.
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+  bool is_extended;  // True if the DMX driver may use baud rates, timings, and packet sizes beyond DMX specification.
+#endif
 
   // Synchronization state
   SemaphoreHandle_t mux;      // The handle to the driver mutex which allows multi-threaded driver function calls.
   TaskHandle_t task_waiting;  // The handle to a task that is waiting for data to be sent or received.
+  EventGroupHandle_t events;  // The event group used to broadcast DMX driver events to any number of tasks.
+  uint32_t event_waiters;  // The number of tasks waiting in dmx_wait_event(). Events are only broadcast while this is non-zero.
 #ifdef DMX_USE_SPINLOCK
   dmx_spinlock_t spinlock;  // The spinlock used for critical sections.
 #endif
@@ -128,12 +230,35 @@ typedef struct dmx_driver_t {
   // Data buffer
   struct dmx_driver_dmx_t {
     int head;  // The index of the slot being transmitted or received.
-    uint8_t data[DMX_PACKET_SIZE_MAX];  // The buffer that stores the DMX packet.
+    uint8_t *data;  // A pointer to the buffer that stores the last completed DMX packet. Packets are sent from this buffer.
+    uint8_t *rx_data;  // A pointer to the buffer into which the current DMX packet is being received. Is the same as data when only one buffer is used.
+#if DMX_RX_BUFFER_COUNT > 2
+    uint8_t *ready;  // A pointer to the buffer that stores the most recently completed DMX packet which has not yet been latched into data.
+    bool ready_is_fresh;  // True if the ready buffer contains a packet which has not yet been latched.
+#endif
+    uint8_t buffers[DMX_RX_BUFFER_COUNT][DMX_BUFFER_SIZE];  // The buffers that store DMX packets.
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+    dmx_changes_t dirty;  // The slots which changed in packets completed since the last call to dmx_receive(). Is accumulated by the DMX ISR.
+    dmx_changes_t changes;  // The slots which changed in the packet returned by the last call to dmx_receive().
+    int last_rx_size;  // The size of the last completed packet, used to compare it with the next packet.
+#endif
+    uint16_t rx_checksum;  // The sum of the RDM message slots which have been received into rx_data. Is accumulated by the DMX ISR as slots are received.
+    const uint8_t *header_buf;  // The buffer from which the cached RDM header was decoded, or NULL if no RDM header is cached.
+    rdm_header_t header;  // The cached RDM header of the packet in header_buf. Is valid only while header_buf is not NULL.
+    dmx_err_t err;  // The error of the last completed packet.
+    bool data_is_acquired;  // True if the data buffer is borrowed by dmx_frame_acquire(). The DMX driver will not swap the data buffer while it is borrowed.
     int size;  // The expected size of the incoming/outgoing packet.
+    bool rx_is_truncated;  // True if the DMX ISR stops copying slots of DMX packets beyond the expected size. Is set by dmx_receive_footprint().
     int status;  // The status of the DMX port.
     int progress;  // The progress of the current packet.
+    uint32_t seq;  // A sequence counter which is odd while the DMX ISR updates the progress, head, and error of the current packet. Allows tasks to read them together without a critical section.
     rdm_pid_t last_controller_pid;  // The PID of the last controller-generated packet.
     int64_t controller_eop_timestamp;  // The timestamp (in microseconds since boot) of the end-of-packet of the last controller-generated packet.
+    int64_t rx_break_ts;  // The timestamp (in microseconds since boot) of the DMX break of the packet being received, or 0 if the packet did not begin with a DMX break.
+    int64_t rx_last_break_ts;  // The timestamp of the DMX break of the last completed packet, or 0 if it did not begin with a DMX break.
+    int64_t rx_last_eop_ts;  // The timestamp of the end of the last completed packet.
+    int64_t rx_refresh_break_ts;  // The timestamp of the DMX break of the last completed null start code packet. Used to measure the refresh rate.
+    uint32_t rx_period_us;  // The rolling average time in microseconds between the DMX breaks of completed null start code packets, or 0 if it has not been measured.
     rdm_pid_t last_responder_pid;  // The PID of the last responder-generated packet.
     bool responder_sent_last;  // True if the last packet was a responder-generated packet.
     union {
@@ -151,8 +276,50 @@ typedef struct dmx_driver_t {
       uint8_t tn;  // The current RDM transaction number. Is incremented with every RDM request sent.
       bool boot_loader;  // The RDM responder boot-loader flag. True when when the device is incapable of normal operation until receiving a firmware upload.
     };
+    int controller_depth;  // The number of nested RDM controller transactions which hold the DMX driver.
+    uint8_t controller_slots[DMX_BUFFER_SIZE];  // The DMX slots from before the outermost RDM controller transaction. They are written back when it completes.
   } rdm;
   
+  dmx_turnaround_t turnaround;  // The RDM response turnaround statistics of the driver.
+
+  // Driver statistics
+  struct dmx_driver_stats_t {
+    dmx_stats_t counters;  // The counters which are reported by dmx_get_stats(). The turnaround field is unused.
+    int64_t rx_window_start;  // The timestamp at which the current one-second receive window started.
+    uint32_t rx_window_packets;  // The number of packets received in the current one-second window.
+    int64_t tx_window_start;  // The timestamp at which the current one-second send window started.
+    uint32_t tx_window_packets;  // The number of packets sent in the current one-second window.
+  } stats;
+
+  // DMX auto-refresh configuration
+  struct dmx_driver_auto_refresh_t {
+    bool is_enabled;  // True if the DMX timer automatically sends DMX packets.
+    uint32_t period;  // The length of time in microseconds from the start of one DMX packet to the start of the next.
+    size_t size;  // The size of the DMX packets that are sent.
+    uint8_t *shadow;  // The buffer into which user writes are made. It is latched into the DMX buffer at the next DMX break.
+    bool shadow_is_dirty;  // True if the shadow buffer has been written since it was last latched.
+    int64_t frame_start_ts;  // The timestamp of the start of the last DMX break.
+    bool is_synced;  // True if the DMX port is a member of the DMX sync group and its packets are started by the timer of the group leader.
+  } auto_refresh;
+
+  // DMX repeater configuration
+  struct dmx_driver_repeater_t {
+    uint32_t outputs;  // A bitmask of the DMX ports to which the packets received on this port are repeated, or 0 if this port is not a repeater input.
+    dmx_port_t input;  // The DMX port whose received packets are repeated on this port, or DMX_NUM_MAX if this port is not a repeater output.
+    int rx_fifo_threshold;  // The UART RX FIFO full threshold of the repeater input before the DMX repeater was enabled.
+  } repeater;
+
+  // Start code filter and routes
+  struct dmx_driver_start_code_t {
+    uint32_t accept[256 / 32];  // A bitmask of the start codes which are accepted. Packets with other start codes are dropped by the DMX ISR as soon as their start code is received.
+    struct dmx_driver_start_code_route_t {
+      uint8_t sc;  // The start code which is routed to the callback.
+      dmx_start_code_cb_t callback;  // The callback which receives packets with the start code.
+      void *context;  // Context for the callback.
+    } routes[DMX_START_CODE_ROUTE_MAX];  // The start codes which are passed to a callback instead of dmx_receive().
+    int route_count;  // The number of routes which are in use.
+  } start_code;
+
   // DMX sniffer configuration
   struct dmx_driver_sniffer_t {
     bool is_enabled;
@@ -160,8 +327,143 @@ typedef struct dmx_driver_t {
     dmx_metadata_t metadata[2];  // The metadata received by the DMX sniffer.
     int64_t last_pos_edge_ts;  // Timestamp of the last positive edge on the sniffer pin.
     int64_t last_neg_edge_ts;  // Timestamp of the last negative edge on the sniffer pin.
+    bool is_armed;  // True while the interrupt of the sniffer pin is enabled. It is enabled at the end of each packet and disabled at the end of the next mark-after-break.
+    bool is_measured;  // True if the DMX break and mark-after-break of the packet being received were measured.
+    int64_t break_ts;  // The timestamp of the start of the DMX break of the packet being received, or 0 if it was not seen.
+    dmx_sniffer_frame_t history[DMX_SNIFFER_HISTORY_SIZE];  // The timing of the most recent packets. It is written as a ring buffer.
+    uint32_t head;  // The number of entries which have been written to the sniffer history.
+    uint32_t tail;  // The number of entries which have been read from the sniffer history.
+    uint32_t dropped;  // The number of entries which were overwritten before they were read.
+    struct dmx_driver_sniffer_range_t {
+      uint32_t min;  // The shortest value which was measured.
+      uint32_t max;  // The longest value which was measured.
+      uint32_t count;  // The number of values which were measured.
+      uint64_t sum;  // The sum of the values which were measured.
+    } break_len, mab_len, frame_len, mark_time;  // The running statistics of the sniffer.
   } sniffer;
 
+  // Packet capture ring buffer
+  struct dmx_driver_capture_t {
+    uint8_t *buffer;  // The ring buffer into which captured packets are written, or NULL if packet capture is disabled.
+    uint32_t size;  // The size of the ring buffer in bytes. It is a power of two.
+    uint32_t head;  // The number of bytes which have been written to the ring buffer. Is only written by the DMX ISR.
+    uint32_t tail;  // The number of bytes which have been read from the ring buffer. Is only written by the capture task.
+    uint32_t records;  // The number of packets which were written to the ring buffer.
+    uint32_t dropped;  // The number of packets which were dropped because the ring buffer was full.
+  } capture;
+
+  // Dimming curve stage
+  struct dmx_driver_curve_t {
+    const struct dmx_curve_span_t *spans;  // The spans of channels which are mapped, or NULL if the dimming curve stage is disabled.
+    int num_spans;  // The number of spans of channels which are mapped.
+    uint16_t *values;  // The values which were mapped from the last DMX packet returned by dmx_receive(). Is only written while the driver mutex is taken.
+    size_t count;  // The number of values, which is the total number of channels in the spans.
+  } curve;
+
+#ifdef CONFIG_DMX_SINK_ENABLE
+  // DMX output sink
+  struct dmx_driver_sink_t {
+    TaskHandle_t task;  // The sink task which is notified of each null start code packet, or NULL if no sink is enabled.
+    bool is_busy;  // True from the time the sink task is notified until it has started writing the frame.
+    uint32_t frames;  // The number of frames which were written by the sink.
+    uint32_t overruns;  // The number of packets which were received while the sink was busy.
+  } sink;
+#endif
+
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+  // Low-power receive mode
+  struct dmx_driver_sleep_t {
+    esp_pm_lock_handle_t pm_lock;  // The power management lock which is held while the DMX driver is awake, or NULL if the low-power receive mode is disabled.
+    esp_timer_handle_t timer;  // The timer which wakes the DMX driver before the predicted DMX break.
+    bool is_asleep;  // True while the receive interrupts are disabled between DMX packets.
+    uint32_t guard_us;  // The time before each predicted DMX break at which the DMX driver wakes.
+    int32_t period_us;  // The refresh period of the DMX signal when the DMX driver last slept.
+    int64_t break_ts;  // The timestamp of the DMX break of the packet after which the DMX driver last slept, or 0 if the next packet has been checked.
+    int64_t sleep_ts;  // The time at which the DMX driver last slept.
+    uint32_t sleeps;  // The number of times that the DMX driver slept.
+    uint32_t missed;  // The number of DMX breaks which arrived before the DMX driver woke.
+    uint64_t asleep_us;  // The total time for which the DMX driver slept.
+  } sleep;
+#endif
+
+#ifdef CONFIG_DMX_HEALTH_ENABLE
+  // DMX bus health monitor
+  struct dmx_driver_health_t {
+    esp_timer_handle_t timer;  // The timer which periodically checks the DMX driver, or NULL if the bus health monitor is disabled.
+    dmx_health_config_t config;  // The configuration of the bus health monitor.
+    bool has_signal;  // True if a DMX break has been received within the loss timeout.
+    bool has_errors;  // True if the error threshold was reached in the current or last error window.
+    int64_t break_ts;  // The timestamp of the last DMX break which was seen by the bus health monitor.
+    int head;  // The head of the DMX packet which was seen by the last check.
+    int64_t head_ts;  // The time at which the head of the DMX packet last changed.
+    int64_t window_start;  // The time at which the current error window started.
+    uint32_t window_base_errors;  // The number of errors which were counted before the current error window.
+    uint32_t window_base_packets;  // The number of packets which were received before the current error window.
+    uint32_t window_errors;  // The number of errors which were counted in the last complete error window.
+    uint32_t window_packets;  // The number of packets which were received in the last complete error window.
+    uint32_t signal_losses;  // The number of times that the signal was lost.
+    uint32_t error_bursts;  // The number of error bursts.
+    uint32_t recoveries;  // The number of times that the receiver was reset.
+    TaskHandle_t checker;  // The task which is running a check, or NULL.
+    TaskHandle_t waiter;  // The task which is waiting for the running check to finish before disabling the bus health monitor, or NULL.
+  } health;
+#endif
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+  // Redundant input mode
+  struct dmx_driver_failover_t {
+    dmx_port_t backup;  // The backup input of this primary input, or DMX_NUM_MAX if the redundant input mode is not enabled with this port as its primary.
+    dmx_port_t primary;  // The primary input of this backup input, or DMX_NUM_MAX if this port is not a backup input.
+    dmx_failover_config_t config;  // The configuration of the redundant input mode.
+    dmx_port_t active;  // The DMX port whose packets are currently used.
+    dmx_port_t received;  // The DMX port from which the last packet was returned.
+    int64_t live_ts;  // The time since which the primary has been healthy, or 0 if it is not healthy.
+    uint32_t switches;  // The number of times that the active port was switched.
+    uint32_t primary_packets;  // The number of packets which were received from the primary.
+    uint32_t backup_packets;  // The number of packets which were received from the backup.
+  } failover;
+#endif
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  // DMX trace buffer and latency histograms
+  struct dmx_driver_trace_t {
+    dmx_trace_entry_t entries[DMX_TRACE_BUFFER_SIZE];  // The trace buffer. It is written as a ring buffer.
+    uint32_t head;  // The number of entries which have been written to the trace buffer.
+    uint32_t histograms[DMX_TRACE_HISTOGRAM_MAX][DMX_TRACE_HISTOGRAM_BUCKETS];  // The latency histograms.
+    int64_t break_ts;  // The timestamp of the last DMX break.
+    int64_t notify_ts;  // The timestamp of the last task notification.
+    int64_t slot_ts;  // The timestamp of the last read of received slots.
+    dmx_trace_frame_t frames[DMX_TRACE_FRAME_COUNT];  // The frame profiles. They are written as a ring buffer indexed by sequence number.
+    uint32_t seq;  // The sequence number of the frame which is being received.
+    uint32_t latched_seq;  // The sequence number of the frame which was last returned by dmx_receive().
+    dmx_port_t source;  // The DMX port in whose frame profiles the send stages of this DMX port are recorded.
+    uint32_t send_seq;  // The sequence number of the frame which is being sent.
+  } trace;
+#endif
+
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+  // RDM discovery responses which are sent by the DMX ISR
+  struct dmx_driver_rdm_disc_t {
+    uint32_t generation;  // The parameter generation of the driver when the responses were encoded. The DMX ISR does not respond if the generation has changed.
+    uint8_t *is_muted;  // A pointer to the RDM_PID_DISC_MUTE parameter data, or NULL if the DMX ISR may not respond to RDM_PID_DISC_MUTE or RDM_PID_DISC_UN_MUTE.
+    bool dub_is_enabled;  // True if the DMX ISR may respond to RDM_PID_DISC_UNIQUE_BRANCH.
+    uint64_t uid;  // The UID of this port as a 48-bit integer so that it can be compared against discovery address spaces.
+    uint8_t dub_response[24];  // The encoded RDM_PID_DISC_UNIQUE_BRANCH response.
+    uint8_t mute_response[34];  // The encoded RDM_PID_DISC_MUTE response. The destination UID, transaction number, PID, and checksum are written by the DMX ISR.
+    uint8_t mute_response_len;  // The size of the encoded RDM_PID_DISC_MUTE response.
+    uint8_t message_count;  // The RDM message count when the responses were encoded. Is used by the DMX ISR to answer cached RDM_CC_GET_COMMAND requests.
+    bool is_sending;  // True if the DMX ISR is sending a discovery response.
+  } rdm_disc;
+#endif
+
+  // Parameter memory arena
+  struct dmx_driver_arena_t {
+    uint8_t *base;  // A pointer to the start of the arena, or NULL if the arena is not used.
+    size_t size;  // The size of the arena in bytes.
+    size_t used;  // The number of bytes of the arena which have been allocated.
+    bool is_static;  // True if the driver and its arena are in caller-provided storage. Allocations never fall back to the heap and nothing is freed when the driver is deleted.
+  } arena;
+
   // DMX device information
   struct dmx_driver_device_t {
     struct dmx_driver_parameter_count_t {
@@ -169,14 +471,398 @@ typedef struct dmx_driver_t {
       unsigned int sub_devices;  // The number of parameters supported by sub-devices.
       unsigned int staged;  // The number of non-volatile parameters waiting to be committed to non-volatile storage.
     } parameter_count;  // Parameter counts for various purposes.
+    dmx_device_t **sub_devices;  // A table of sub-devices which is directly indexed by sub-device number. Entries of sub-devices which do not exist are NULL.
+    int sub_device_table_size;  // The number of entries in the sub-device table.
+    int sub_device_count;  // The number of sub-devices which have been added.
+    uint32_t generation;  // Is incremented whenever a parameter or sub-device is added, parameters are restored, or the RDM response state of the driver changes. Used to invalidate cached RDM responses.
+#ifdef CONFIG_DMX_NVS_LAZY_RESTORE
+    bool restore_is_pending;  // True if the non-volatile parameters have not yet been restored from NVS.
+#endif
+    struct rdm_dispatch_entry_t {
+      rdm_pid_t pid;  // The parameter ID of the entry, or 0 if the entry is empty.
+      bool sub_device_is_ambiguous;  // True if sub-devices have set different RDM definitions for the parameter.
+      uint16_t sub_device_definitions;  // The number of sub-devices which have set an RDM definition for the parameter.
+      rdm_dispatch_t root;  // The dispatch of requests to the root device.
+      rdm_dispatch_t sub_device;  // The dispatch of requests to sub-devices.
+    } *dispatch;  // An open-addressed hash table of the RDM dispatch of each parameter ID, or NULL if it could not be allocated.
+    uint32_t dispatch_mask;  // The number of entries in the dispatch table minus one. The number of entries is a power of two.
     dmx_device_t root;  // The root device of the RDM driver.
   } device;
 } dmx_driver_t;
 
 extern dmx_driver_t *dmx_driver[DMX_NUM_MAX];
 
-// TODO: implement dmx_device_add()
-// dmx_device_add(dmx_num, device_num);
+/** @brief The DMX sync group, which starts the DMX packets of several DMX ports
+ * from a single timer event so that they are sent in lockstep.*/
+extern struct dmx_sync_group_t {
+  dmx_spinlock_t spinlock;  // The spinlock used for critical sections of the DMX sync group.
+  uint32_t members;  // A bitmask of the DMX ports in the group, or 0 if the DMX sync group is disabled.
+  uint32_t pending;  // A bitmask of the members which have not yet finished sending the current packet.
+  dmx_port_t leader;  // The DMX port whose timer schedules the packets of the group.
+  bool is_committed;  // True if the shadow buffers of every member are latched at the start of the next packet.
+} dmx_sync_group;
+
+/**
+ * @brief Notifies the DMX sync group that a member has finished sending its
+ * DMX packet. When every member has finished, the next packet of the group is
+ * scheduled on the timer of the group leader. This function must be called
+ * from the DMX ISR.
+ *
+ * @param dmx_num The DMX port number of the member.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_sync_group_sent(dmx_port_t dmx_num, int64_t now);
+
+/**
+ * @brief Prepares the DMX driver to be written. While the DMX driver is
+ * auto-refreshing, data is written into the shadow buffer. Otherwise the DMX
+ * bus is flipped to write mode and data is written into the DMX buffer. On
+ * success, this function returns within a critical section which must be
+ * exited by the caller once the data has been written.
+ *
+ * @param dmx_num The DMX port number.
+ * @return A pointer to the buffer to write or NULL if the DMX driver may not be
+ * written because an RDM packet is being sent.
+ */
+uint8_t *dmx_write_begin(dmx_port_t dmx_num);
+
+/**
+ * @brief Forwards the slots which were just received on a DMX repeater input
+ * to each of its outputs. When the start code of a packet is received, the DMX
+ * break of each output is started as soon as its previous packet has left the
+ * UART. Packets with an RDM start code are not repeated. This function must be
+ * called from the DMX ISR outside of a critical section.
+ *
+ * @param driver A pointer to the DMX driver of the repeater input.
+ * @param prev_head The index of the first slot which was just received.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_repeater_forward(dmx_driver_t *driver, int prev_head, int64_t now);
+
+/**
+ * @brief Writes the slots which the DMX repeater input has received, and which
+ * have not yet been sent, to the UART of a DMX repeater output. This function
+ * must be called from the DMX ISR outside of a critical section.
+ *
+ * @param output A pointer to the DMX driver of the repeater output.
+ */
+void dmx_repeater_write(dmx_driver_t *output);
+
+/**
+ * @brief Broadcasts DMX driver events to every task which is waiting for them
+ * in dmx_wait_event(). The event bits are set and then immediately cleared so
+ * that events are not kept for tasks which are not yet waiting. This function
+ * must be called from the DMX ISR outside of a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param events A mask of enum dmx_event_t.
+ * @param[inout] task_awoken Set to true if a higher priority task was woken.
+ */
+FORCE_INLINE_ATTR void dmx_event_set_from_isr(dmx_driver_t *driver,
+                                              uint32_t events,
+                                              int *task_awoken) {
+  if (__atomic_load_n(&driver->event_waiters, __ATOMIC_ACQUIRE) > 0) {
+    xEventGroupSetBitsFromISR(driver->events, events, task_awoken);
+    xEventGroupClearBitsFromISR(driver->events, events);
+  }
+}
+
+/**
+ * @brief Records the timestamps of a completed packet and updates the rolling
+ * average time between received null start code packets. This function must
+ * be called within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param now The current time in microseconds since boot.
+ * @param is_refresh True if the packet is a valid null start code packet.
+ */
+FORCE_INLINE_ATTR void dmx_rx_timing_record(dmx_driver_t *driver, int64_t now,
+                                            bool is_refresh) {
+  const int64_t break_ts = driver->dmx.rx_break_ts;
+  driver->dmx.rx_last_break_ts = break_ts;
+  driver->dmx.rx_last_eop_ts = now;
+  if (!is_refresh || break_ts == 0) {
+    return;
+  }
+
+  // Restart the measurement if the DMX signal was lost
+  const int64_t last_break_ts = driver->dmx.rx_refresh_break_ts;
+  driver->dmx.rx_refresh_break_ts = break_ts;
+  const int64_t elapsed = break_ts - last_break_ts;
+  if (last_break_ts == 0 || elapsed <= 0 || elapsed > DMX_RX_PERIOD_MAX_US) {
+    driver->dmx.rx_period_us = 0;
+    return;
+  }
+
+  const int32_t period = driver->dmx.rx_period_us;
+  if (period == 0) {
+    driver->dmx.rx_period_us = elapsed;
+  } else {
+    driver->dmx.rx_period_us =
+        period + ((int32_t)elapsed - period) / DMX_RX_PERIOD_WEIGHT;
+  }
+}
+
+/**
+ * @brief Checks if received packets with the start code are accepted by the
+ * DMX driver.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param sc The start code to check.
+ * @return true if the start code is accepted.
+ * @return false if packets with the start code are dropped.
+ */
+FORCE_INLINE_ATTR bool dmx_start_code_is_accepted(const dmx_driver_t *driver,
+                                                  uint8_t sc) {
+  return driver->start_code.accept[sc / 32] & (1u << (sc % 32));
+}
+
+/**
+ * @brief Begins an update of the progress, head, and error of the current
+ * packet. Tasks which read these fields with dmx_packet_state_read() retry
+ * until dmx_packet_state_write_end() is called. This function must be called
+ * within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ */
+FORCE_INLINE_ATTR void dmx_packet_state_write_begin(dmx_driver_t *driver) {
+  __atomic_store_n(&driver->dmx.seq, driver->dmx.seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Ends an update of the progress, head, and error of the current packet.
+ * This function must be called within the same critical section as
+ * dmx_packet_state_write_begin().
+ *
+ * @param driver A pointer to the DMX driver.
+ */
+FORCE_INLINE_ATTR void dmx_packet_state_write_end(dmx_driver_t *driver) {
+  __atomic_store_n(&driver->dmx.seq, driver->dmx.seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Reads a consistent snapshot of the progress, head, and error of the
+ * current packet without entering a critical section. The DMX ISR is the only
+ * writer of these fields while a task is waiting for a packet, so the read is
+ * retried only if it overlaps an update by the DMX ISR.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param[out] progress The progress of the current packet.
+ * @param[out] head The index of the next slot of the current packet.
+ * @param[out] err The error of the last completed packet.
+ */
+FORCE_INLINE_ATTR void dmx_packet_state_read(const dmx_driver_t *driver,
+                                             int *progress, int *head,
+                                             dmx_err_t *err) {
+  uint32_t seq;
+  do {
+    seq = __atomic_load_n(&driver->dmx.seq, __ATOMIC_ACQUIRE);
+    *progress = __atomic_load_n(&driver->dmx.progress, __ATOMIC_RELAXED);
+    *head = __atomic_load_n(&driver->dmx.head, __ATOMIC_RELAXED);
+    *err = __atomic_load_n(&driver->dmx.err, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while ((seq & 1) ||
+           seq != __atomic_load_n(&driver->dmx.seq, __ATOMIC_RELAXED));
+}
+
+/**
+ * @brief Records the turnaround time of an RDM response which is being sent.
+ * This function must be called within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_turnaround_record(dmx_driver_t *driver, int64_t now);
+
+/**
+ * @brief Counts a packet which was received or sent by the DMX driver and
+ * updates the packets-per-second statistic. This function must be called
+ * within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param is_rx True if the packet was received, false if it was sent.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_stats_count_packet(dmx_driver_t *driver, bool is_rx, int64_t now);
+
+/**
+ * @brief Records the timing of a completed packet in the sniffer history and
+ * adds it to the running statistics of the sniffer. This function must be
+ * called within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param size The number of slots in the packet.
+ * @param err The error of the packet.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_sniffer_record_frame(dmx_driver_t *driver, int size, dmx_err_t err,
+                              int64_t now);
+
+/**
+ * @brief Writes a completed packet into the packet capture ring buffer. The
+ * packet is dropped if the ring buffer is full. This function must be called
+ * within a critical section and before the receive buffers are swapped.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param size The number of slots in the packet.
+ * @param err The error of the packet.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_capture_record(dmx_driver_t *driver, int size, dmx_err_t err,
+                        int64_t now);
+
+/**
+ * @brief Maps the slots of the readable DMX packet through the lookup tables
+ * of the dimming curve stage if it is enabled. This function must be called
+ * while the driver mutex is taken and after the packet has been latched.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param size The number of slots in the packet.
+ */
+void dmx_curve_apply(dmx_driver_t *driver, int size);
+
+#ifdef CONFIG_DMX_SINK_ENABLE
+/**
+ * @brief Notifies the task of the DMX output sink that a null start code
+ * packet has been received, if a sink is enabled. This function must be called
+ * within a critical section and after the receive buffers are swapped.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param size The number of slots in the packet.
+ * @param[inout] task_awoken Is set to true if a higher priority task was woken.
+ */
+void dmx_sink_notify_from_isr(dmx_driver_t *driver, int size,
+                              int *task_awoken);
+#else
+static inline void dmx_sink_notify_from_isr(dmx_driver_t *driver, int size,
+                                            int *task_awoken) {}
+#endif
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+/**
+ * @brief Records an event in the DMX trace buffer and adds its latency to the
+ * histogram of the event. This function must be called within a critical
+ * section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param event The event to record, one of dmx_trace_event_t.
+ * @param timestamp The time of the event in microseconds since boot.
+ */
+void dmx_trace_record(dmx_driver_t *driver, int event, int64_t timestamp);
+
+/**
+ * @brief Adds the time since received slots were last read to the inter-slot
+ * histogram. This function must be called within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param timestamp The time of the read in microseconds since boot.
+ * @param head The index of the first slot which was read.
+ */
+void dmx_trace_record_slots(dmx_driver_t *driver, int64_t timestamp,
+                            int head);
+
+/**
+ * @brief Records a stage in a frame profile. Stages up to and including
+ * DMX_TRACE_STAGE_LATCHED are recorded in the frame which is being received.
+ * Later stages are recorded in the frame which was last returned by
+ * dmx_receive(). This function must be called within a critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param stage The stage to record, one of dmx_trace_stage_t.
+ * @param timestamp The time of the stage in microseconds since boot.
+ */
+void dmx_trace_record_stage(dmx_driver_t *driver, int stage,
+                            int64_t timestamp);
+
+/**
+ * @brief Records a send stage in the frame profile of the source DMX port of
+ * a DMX driver. DMX_TRACE_STAGE_SEND attributes the packet which is being
+ * sent to the frame which was last returned by dmx_receive() on the source.
+ * This function must not be called within a critical section.
+ *
+ * @param driver A pointer to the DMX driver which is sending.
+ * @param stage The stage to record, one of dmx_trace_stage_t.
+ * @param timestamp The time of the stage in microseconds since boot.
+ */
+void dmx_trace_record_send(dmx_driver_t *driver, int stage,
+                           int64_t timestamp);
+
+/**
+ * @brief Records DMX_TRACE_STAGE_TX_DONE in the frame profile of the source
+ * DMX port of a DMX driver. This function must be called from the DMX ISR
+ * outside of a critical section.
+ *
+ * @param driver A pointer to the DMX driver which sent a packet.
+ * @param timestamp The time at which the packet was sent in microseconds since
+ * boot.
+ */
+void dmx_trace_record_sent_from_isr(dmx_driver_t *driver, int64_t timestamp);
+#else
+static inline void dmx_trace_record(dmx_driver_t *driver, int event,
+                                    int64_t timestamp) {}
+static inline void dmx_trace_record_slots(dmx_driver_t *driver,
+                                          int64_t timestamp, int head) {}
+static inline void dmx_trace_record_stage(dmx_driver_t *driver, int stage,
+                                          int64_t timestamp) {}
+static inline void dmx_trace_record_send(dmx_driver_t *driver, int stage,
+                                         int64_t timestamp) {}
+static inline void dmx_trace_record_sent_from_isr(dmx_driver_t *driver,
+                                                  int64_t timestamp) {}
+#endif
+
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+/**
+ * @brief Lets the DMX driver sleep until shortly before the predicted DMX break
+ * of the next packet if the low-power receive mode is enabled. This function
+ * must be called from the DMX ISR when a packet is complete, outside of a
+ * critical section.
+ *
+ * @param driver A pointer to the DMX driver.
+ * @param is_refresh True if the packet is a valid null start code packet.
+ * @param now The current time in microseconds since boot.
+ */
+void dmx_sleep_record_frame(dmx_driver_t *driver, bool is_refresh,
+                            int64_t now);
+#else
+static inline void dmx_sleep_record_frame(dmx_driver_t *driver,
+                                          bool is_refresh, int64_t now) {}
+#endif
+
+/**
+ * @brief Adds a sub-device to the DMX driver. The sub-device is allocated with
+ * enough space for the number of sub-device parameters that was configured when
+ * the DMX driver was installed.
+ *
+ * @param dmx_num The DMX port number.
+ * @param device_num The sub-device number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_device_add(dmx_port_t dmx_num, dmx_device_num_t device_num);
+
+/**
+ * @brief Allocates memory for the DMX driver. Memory is allocated from the DMX
+ * driver's memory arena if it has space remaining, otherwise it is allocated
+ * from the heap. Memory allocated from the arena is never individually freed;
+ * the arena is freed all at once when the DMX driver is deleted. If the DMX
+ * driver was installed with dmx_driver_install_static(), memory is never
+ * allocated from the heap.
+ *
+ * @param dmx_num The DMX port number.
+ * @param size The number of bytes to allocate.
+ * @return A pointer to the allocated memory, or NULL on failure.
+ */
+void *dmx_alloc(dmx_port_t dmx_num, size_t size);
+
+/**
+ * @brief Frees memory which was allocated with dmx_alloc(). Memory within the
+ * DMX driver's memory arena is not freed.
+ *
+ * @param dmx_num The DMX port number.
+ * @param ptr A pointer to the memory to free, or NULL.
+ */
+void dmx_free(dmx_port_t dmx_num, void *ptr);
 
 /**
  * @brief Gets a pointer to the desired device, if it exists.
@@ -215,6 +901,65 @@ dmx_parameter_t *dmx_parameter_get_entry(dmx_port_t dmx_num,
                                          dmx_device_num_t device_num,
                                          rdm_pid_t pid);
 
+/**
+ * @brief Restores the non-volatile parameters whose loads were deferred when
+ * the DMX driver was installed. This is called by dmx_parameter_get_entry()
+ * the first time that a non-volatile parameter is used, and has no effect
+ * after the parameters have been restored. It must not be called within a
+ * critical section.
+ *
+ * @param dmx_num The DMX port number.
+ */
+void dmx_parameter_restore(dmx_port_t dmx_num);
+
+/**
+ * @brief Starts the background task which commits staged non-volatile
+ * parameters to NVS. The task is shared by all DMX ports. Calling this function
+ * when the task is already running has no effect.
+ *
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_parameter_commit_init();
+
+/**
+ * @brief Prevents the background commit task from committing parameters until
+ * dmx_parameter_commit_unlock() is called. This is used to ensure that
+ * parameters are not committed while a DMX driver is being deleted.
+ *
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_parameter_commit_lock();
+
+/**
+ * @brief Allows the background commit task to commit parameters.
+ */
+void dmx_parameter_commit_unlock();
+
+/**
+ * @brief Encodes an RDM packet into a buffer other than the DMX driver buffer.
+ * This is the implementation of rdm_write() and does not check its arguments.
+ *
+ * @param[out] data A pointer to a buffer which is large enough for the packet.
+ * @param[in] header A pointer to the header of the RDM packet.
+ * @param[in] format The format string of the parameter data, or NULL.
+ * @param[in] pd A pointer to the parameter data, or NULL.
+ * @return The size of the encoded RDM packet.
+ */
+size_t rdm_encode_packet(void *data, const rdm_header_t *header,
+                         const char *format, const void *pd);
+
+/**
+ * @brief Re-encodes the RDM discovery responses which are sent by the DMX ISR
+ * if the parameters of the DMX driver have changed since they were last
+ * encoded. Has no effect unless CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR is
+ * enabled.
+ *
+ * @param dmx_num The DMX port number.
+ */
+void rdm_disc_isr_update(dmx_port_t dmx_num);
+
 #ifdef __cplusplus
 }
 #endif
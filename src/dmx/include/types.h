@@ -83,6 +83,16 @@ enum {
   DMX_PIN_NO_CHANGE = -1
 };
 
+/** @brief DMX UART FIFO constants.*/
+enum {
+  /** @brief Constant for dmx_set_rx_fifo_threshold(). Indicates that the DMX
+     driver should use a high threshold while receiving DMX data and a
+     threshold of one byte while an RDM response is expected.*/
+  DMX_FIFO_THRESHOLD_ADAPTIVE = 0,
+  /** @brief The maximum UART FIFO threshold.*/
+  DMX_FIFO_THRESHOLD_MAX = 127
+};
+
 /** @brief DMX requirements constants. These constants are simplified
  * significantly to ensure ease of use for the end user. When used with this
  * library, these constants will ensure that library settings are always within
@@ -115,6 +125,10 @@ enum {
   /** @brief The maximum DMX mark-after-break length in microseconds.*/
   DMX_MAB_LEN_MAX_US = 999999,
 
+  /** @brief The length of a DMX slot in microseconds at the typical baud
+     rate. Each slot is a start bit, eight data bits, and two stop bits.*/
+  DMX_SLOT_LEN_US = 44,
+
   /** @brief The DMX receive timeout length in FreeRTOS ticks. If it takes
      longer than this amount of time to receive the next DMX packet the signal
      is considered lost.*/
@@ -135,6 +149,26 @@ enum {
   RDM_MAB_LEN_MAX_US = 88,
 };
 
+#ifdef CONFIG_DMX_EXTENDED_MODE_ENABLE
+/** @brief DMX extended mode constants. These constants are outside of DMX
+ * specification and are only used on DMX ports whose extended mode has been
+ * enabled with dmx_set_extended_mode(). Both ends of the link must use the same
+ * settings.*/
+enum {
+  /** @brief The maximum packet size in extended mode.*/
+  DMX_EXTENDED_PACKET_SIZE_MAX = CONFIG_DMX_EXTENDED_PACKET_SIZE_MAX,
+  /** @brief The maximum baud rate in extended mode.*/
+  DMX_EXTENDED_BAUD_RATE_MAX = CONFIG_DMX_EXTENDED_BAUD_RATE_MAX,
+  /** @brief The minimum break length in extended mode in microseconds. The
+     break is also never shorter than two slots at the current baud rate so
+     that the UART can tell it apart from a slot of zero.*/
+  DMX_EXTENDED_BREAK_LEN_MIN_US = 20,
+  /** @brief The minimum mark-after-break length in extended mode in
+     microseconds.*/
+  DMX_EXTENDED_MAB_LEN_MIN_US = 4,
+};
+#endif
+
 /** @brief DMX start codes. These are the start codes used within the DMX
  * specification. This enum also includes RDM specific codes than can be used in
  * place of a start code or are use similarly to DMX start codes.*/
@@ -263,6 +297,64 @@ typedef enum dmx_err_t {
   DMX_FAIL = -1
 } dmx_err_t;
 
+/** @brief Flags which select the directions in which the DMX driver uses DMA.
+ * DMA is only supported on targets with a UHCI peripheral connected to GDMA and
+ * may only be used by one DMX port at a time.*/
+enum dmx_dma_flag_t {
+  /** @brief Use DMA to send DMX packets instead of refilling the UART FIFO in
+     the DMX interrupt.*/
+  DMX_DMA_FLAG_TX = (1 << 0),
+};
+
+/** @brief Events which are broadcast by the DMX driver to every task waiting
+ * in dmx_wait_event().*/
+enum dmx_event_t {
+  /** @brief A DMX or RDM packet was received.*/
+  DMX_EVENT_PACKET_RECEIVED = (1 << 0),
+  /** @brief A valid RDM packet was received.*/
+  DMX_EVENT_RDM_RECEIVED = (1 << 1),
+  /** @brief The DMX driver finished sending a packet.*/
+  DMX_EVENT_SENT = (1 << 2),
+  /** @brief A mask of all DMX driver events.*/
+  DMX_EVENT_ALL = (1 << 3) - 1,
+};
+
+/** @brief Used in dmx_set_start_code_filter() to set the filter of every start
+ * code at once.*/
+#define DMX_START_CODE_ALL (-1)
+
+/** @brief The maximum number of start codes which may be routed to a callback
+ * on each DMX port.*/
+#define DMX_START_CODE_ROUTE_MAX 4
+
+/** @brief The UART RX FIFO full threshold of a DMX repeater input. A low
+ * threshold lets the DMX ISR forward slots to the repeater outputs soon after
+ * they arrive.*/
+#define DMX_REPEATER_RX_FIFO_THRESHOLD 4
+
+/**
+ * @brief The type of callback which receives packets of a routed start code.
+ * The callback is called from the DMX ISR and must not block. It should be
+ * placed in IRAM when CONFIG_DMX_ISR_IN_IRAM is enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] data A pointer to the received packet, including its start code.
+ * The data is only valid until the callback returns.
+ * @param size The size of the received packet in bytes.
+ * @param[inout] context The context which was passed to
+ * dmx_set_start_code_callback().
+ */
+typedef void (*dmx_start_code_cb_t)(dmx_port_t dmx_num, const uint8_t *data,
+                                    size_t size, void *context);
+
+/** @brief Used in dmx_config_t to allocate the DMX interrupts on the core which
+ * calls dmx_driver_install(). A zero-filled configuration uses this value.*/
+#define DMX_ISR_CORE_DEFAULT (0)
+
+/** @brief Used in dmx_config_t to allocate the DMX interrupts on a specific
+ * core. The core ID is encoded plus one so that 0 remains the default.*/
+#define DMX_ISR_CORE(core_id) ((core_id) + 1)
+
 /** @brief Configuration settings for the DMX driver.*/
 typedef struct dmx_config_t {
   /** @brief The interrupt allocation flags to use.*/
@@ -288,8 +380,48 @@ typedef struct dmx_config_t {
   /** @brief The maximum size of the RDM queue. Setting this value to 0 disables
    * the RDM queue.*/
   uint32_t queue_size_max;
+  /** @brief The DMA flags to use, a mask of enum dmx_dma_flag_t. If DMA is
+   * unavailable the DMX driver falls back to using the UART FIFO.*/
+  int dma_flags;
+  /** @brief The size in bytes of a memory arena from which the DMX driver's
+   * parameter data, sub-devices, and RDM queue are allocated. Setting this
+   * value to 0 allocates each of these from the heap individually. If the arena
+   * is exhausted, further allocations are made from the heap. When the DMX
+   * driver is installed with dmx_driver_install_static(), this is the size
+   * which is reserved in addition to the data of the default parameters.*/
+  size_t arena_size;
+  /** @brief The heap capabilities of the memory arena, a mask of MALLOC_CAP_*
+   * flags. Setting this value to 0 uses MALLOC_CAP_8BIT.*/
+  int arena_caps;
+  /** @brief The core on which the DMX interrupts are allocated. This is not a
+   * core ID; it must be set using DMX_ISR_CORE(core_id). Setting this value to
+   * DMX_ISR_CORE_DEFAULT, or 0, allocates the DMX interrupts on the core which
+   * calls dmx_driver_install().*/
+  int isr_core;
+  /** @brief The priority level of the DMX interrupts, from 1 to 3. Setting
+   * this value to 0 uses the priority levels allowed by interrupt_flags.*/
+  int isr_priority;
 } dmx_config_t;
 
+/** @brief Caller-provided storage into which a DMX driver is installed with
+ * dmx_driver_install_static(). The storage must remain valid until the DMX
+ * driver is deleted.*/
+typedef struct dmx_static_storage_t {
+  /** @brief The memory in which the DMX driver is placed. It must be aligned
+   * to 8 bytes. The DMX driver is placed at the start of the buffer and the
+   * remainder is the memory arena from which its parameter data, sub-devices,
+   * and RDM queue are allocated. If dmx_config_t.dma_flags is set, the buffer
+   * must be DMA-capable.*/
+  void *buffer;
+  /** @brief The size of the buffer in bytes. The minimum size may be found
+   * with dmx_driver_get_static_size().*/
+  size_t size;
+  /** @brief The storage of the DMX driver mutex.*/
+  StaticSemaphore_t mux;
+  /** @brief The storage of the DMX driver event group.*/
+  StaticEventGroup_t events;
+} dmx_static_storage_t;
+
 /** @brief A struct which defines DMX personalities. Used to declare the
  * personalities of the DMX device upon calling dmx_driver_install(). */
 typedef struct __attribute__((packed)) dmx_personality_t {
@@ -311,16 +443,178 @@ typedef struct dmx_packet_t {
   size_t size;
   /** @brief True if the received packet is RDM.*/
   bool is_rdm;
+  /** @brief The time in microseconds since boot at which the DMX break of the
+     packet was received, or 0 if the packet did not begin with a DMX break.*/
+  int64_t break_ts;
+  /** @brief The time in microseconds since boot at which the DMX driver
+     received the end of the packet, or 0 if no packet was received.*/
+  int64_t eop_ts;
+  /** @brief The rolling average time in microseconds between the DMX breaks of
+     received null start code packets, or 0 if it has not been measured.*/
+  uint32_t period_us;
+  /** @brief The measured refresh rate of null start code packets in packets
+     per second, or 0 if it has not been measured.*/
+  uint32_t refresh_rate;
 } dmx_packet_t;
 
+/** @brief A single slot update for use with dmx_write_slots().*/
+typedef struct dmx_slot_write_t {
+  /** @brief The DMX slot number to write.*/
+  uint16_t slot;
+  /** @brief The value to write to the DMX slot.*/
+  uint8_t value;
+} dmx_slot_write_t;
+
+/** @brief A contiguous span of slots for use with dmx_write_spans().*/
+typedef struct dmx_span_write_t {
+  /** @brief The DMX slot number of the first slot of the span.*/
+  uint16_t offset;
+  /** @brief The number of slots in the span.*/
+  uint16_t size;
+  /** @brief The data which is written to the span.*/
+  const void *source;
+} dmx_span_write_t;
+
+/** @brief The number of 32-bit words in the bitmap of changed DMX slots.*/
+#define DMX_CHANGES_BITMAP_WORDS ((DMX_PACKET_SIZE_MAX + 31) / 32)
+
+/** @brief The slots of received DMX packets which have changed. For use with
+ * dmx_get_changes().*/
+typedef struct dmx_changes_t {
+  /** @brief True if any slot of the DMX packet has changed.*/
+  bool is_changed;
+  /** @brief The index of the first slot which changed, or -1 if no slots
+     changed.*/
+  int first;
+  /** @brief The index of the last slot which changed, or -1 if no slots
+     changed.*/
+  int last;
+  /** @brief A bitmap of the slots which changed. Slot n is represented by bit
+     (n % 32) of word (n / 32).*/
+  uint32_t bitmap[DMX_CHANGES_BITMAP_WORDS];
+} dmx_changes_t;
+
 /** @brief Metadata for received DMX packets. For use in the DMX sniffer.*/
 typedef struct dmx_metadata_t {
-  /** @brief Length in microseconds of the last received DMX break.*/
+  /** @brief Length in microseconds of the last received DMX break, or 0 if
+     the start of the DMX break was not seen by the sniffer.*/
   uint32_t break_len;
   /** @brief Length in microseconds of the last received DMX mark-after-break.*/
   uint32_t mab_len;
 } dmx_metadata_t;
 
+/** @brief The timing of a single packet received by the DMX sniffer. Entries
+ * are read from the sniffer history with dmx_sniffer_read_history().*/
+typedef struct dmx_sniffer_frame_t {
+  /** @brief The time in microseconds since boot at which the DMX break of the
+     packet started, or 0 if the start of the DMX break was not seen.*/
+  int64_t timestamp;
+  /** @brief Length in microseconds of the DMX break, or 0 if it was not
+     measured.*/
+  uint32_t break_len;
+  /** @brief Length in microseconds of the DMX mark-after-break, or 0 if it was
+     not measured.*/
+  uint32_t mab_len;
+  /** @brief Length in microseconds from the start of the DMX break until the
+     DMX driver received the end of the packet, or 0 if it was not measured.*/
+  uint32_t frame_len;
+  /** @brief The total length in microseconds of the marks between the slots
+     of the packet. It is the frame length less the DMX break, the DMX
+     mark-after-break, and the time taken to send each slot.*/
+  uint32_t mark_time;
+  /** @brief The number of slots in the packet, including the start code.*/
+  uint16_t size;
+  /** @brief The start code of the packet.*/
+  uint8_t sc;
+  /** @brief The error of the packet, if any.*/
+  dmx_err_t err;
+} dmx_sniffer_frame_t;
+
+/** @brief The range of a timing measurement of the DMX sniffer.*/
+typedef struct dmx_sniffer_range_t {
+  /** @brief The shortest value which was measured in microseconds.*/
+  uint32_t min;
+  /** @brief The longest value which was measured in microseconds.*/
+  uint32_t max;
+  /** @brief The mean of the measured values in microseconds.*/
+  uint32_t mean;
+} dmx_sniffer_range_t;
+
+/** @brief Running statistics of the packets received by the DMX sniffer.*/
+typedef struct dmx_sniffer_stats_t {
+  /** @brief The number of packets which were recorded by the DMX sniffer.*/
+  uint32_t frames;
+  /** @brief The number of entries which were overwritten in the sniffer
+     history before they were read.*/
+  uint32_t dropped;
+  /** @brief The DMX break lengths which were measured.*/
+  dmx_sniffer_range_t break_len;
+  /** @brief The DMX mark-after-break lengths which were measured.*/
+  dmx_sniffer_range_t mab_len;
+  /** @brief The frame lengths which were measured.*/
+  dmx_sniffer_range_t frame_len;
+  /** @brief The mark time between slots of each packet which was measured.*/
+  dmx_sniffer_range_t mark_time;
+} dmx_sniffer_stats_t;
+
+/** @brief Statistics of the RDM response turnaround time of a DMX port. The
+ * turnaround time is measured from the end of the last RDM request to the
+ * moment the DMX bus is turned around to send the response.*/
+typedef struct dmx_turnaround_t {
+  /** @brief The turnaround time of the most recent RDM response.*/
+  uint32_t last_us;
+  /** @brief The shortest turnaround time that has been measured.*/
+  uint32_t min_us;
+  /** @brief The longest turnaround time that has been measured.*/
+  uint32_t max_us;
+  /** @brief The number of RDM responses that have been measured.*/
+  uint32_t count;
+} dmx_turnaround_t;
+
+/** @brief Statistics of the DMX driver which are counted by the DMX interrupt
+ * handlers. They are used to determine the cause of DMX dropouts.*/
+typedef struct dmx_stats_t {
+  /** @brief The number of DMX and RDM packets which have been received.*/
+  uint32_t rx_packets;
+  /** @brief The number of DMX and RDM packets which have been sent.*/
+  uint32_t tx_packets;
+  /** @brief The number of packets which were received in the last second.*/
+  uint32_t rx_packets_per_second;
+  /** @brief The number of packets which were sent in the last second.*/
+  uint32_t tx_packets_per_second;
+  /** @brief The number of DMX_ERR_UART_OVERFLOW errors.*/
+  uint32_t uart_overflows;
+  /** @brief The number of DMX_ERR_IMPROPER_SLOT errors.*/
+  uint32_t improper_slots;
+  /** @brief The number of DMX_ERR_NOT_ENOUGH_SLOTS errors.*/
+  uint32_t not_enough_slots;
+  /** @brief The number of received RDM packets with an invalid checksum.*/
+  uint32_t rdm_checksum_errors;
+  /** @brief The number of RDM responses which could not be sent in time.*/
+  uint32_t rdm_responses_missed;
+  /** @brief The number of times the UART interrupt handler was called.*/
+  uint32_t uart_isr_count;
+  /** @brief The number of times the timer interrupt handler was called.*/
+  uint32_t timer_isr_count;
+  /** @brief The longest duration in microseconds of the UART interrupt
+     handler.*/
+  uint32_t uart_isr_max_us;
+  /** @brief The longest duration in microseconds of the timer interrupt
+     handler.*/
+  uint32_t timer_isr_max_us;
+  /** @brief The number of received packets which were dropped because their
+     start code was not accepted.*/
+  uint32_t rx_packets_filtered;
+  /** @brief The number of received packets which were passed to a start code
+     callback instead of dmx_receive().*/
+  uint32_t rx_packets_routed;
+  /** @brief The number of received packets which were dropped because the
+     DMX packet buffer was borrowed with dmx_frame_acquire().*/
+  uint32_t rx_packets_dropped;
+  /** @brief The RDM response turnaround statistics.*/
+  dmx_turnaround_t turnaround;
+} dmx_stats_t;
+
 /** @brief DMX start address which indicates the device does not have a DMX
  * start address.*/
 static const uint16_t DMX_START_ADDRESS_NONE = 0xffff;
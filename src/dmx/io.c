@@ -4,6 +4,7 @@
 #include "dmx/hal/include/nvs.h"
 #include "dmx/hal/include/timer.h"
 #include "dmx/hal/include/uart.h"
+#include "dmx/include/device.h"
 #include "dmx/include/driver.h"
 #include "dmx/include/parameter.h"
 #include "dmx/include/service.h"
@@ -11,24 +12,53 @@
 #include "rdm/include/uid.h"
 #include "rdm/responder/include/utils.h"
 
+static void dmx_latch_buffer(dmx_driver_t *driver) {
+#if DMX_RX_BUFFER_COUNT > 2
+  // Swap the most recently completed packet into the readable buffer
+  if (driver->dmx.ready_is_fresh && !driver->dmx.data_is_acquired) {
+    uint8_t *const data = driver->dmx.data;
+    driver->dmx.data = driver->dmx.ready;
+    driver->dmx.ready = data;
+    driver->dmx.ready_is_fresh = false;
+  }
+#endif
+}
+
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+static void dmx_send_turnaround(dmx_driver_t *driver) {
+  // Drive the DMX bus only once the packet is about to be sent
+  dmx_uart_set_rts(driver->dmx_num, 0);
+  if (!driver->is_controller) {
+    dmx_turnaround_record(driver, dmx_timer_get_micros_since_boot());
+  }
+}
+#endif
+
 size_t dmx_read_offset(dmx_port_t dmx_num, size_t offset, void *destination,
                        size_t size) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
-  DMX_CHECK(offset < DMX_PACKET_SIZE_MAX, 0, "offset error");
   DMX_CHECK(destination, 0, "destination is null");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
 
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  const size_t size_max = dmx_packet_size_max(driver);
+  DMX_CHECK(offset < size_max, 0, "offset error");
+
   // Clamp size to the maximum DMX packet size
-  if (size + offset > DMX_PACKET_SIZE_MAX) {
-    size = DMX_PACKET_SIZE_MAX - offset;
+  if (size + offset > size_max) {
+    size = size_max - offset;
   } else if (size == 0) {
     return 0;
   }
 
-  dmx_driver_t *const driver = dmx_driver[dmx_num];
-
   // Copy data from the driver buffer to the destination asynchronously
   memcpy(destination, driver->dmx.data + offset, size);
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  const int64_t now = dmx_timer_get_micros_since_boot();
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_trace_record_stage(driver, DMX_TRACE_STAGE_READ, now);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+#endif
 
   return size;
 }
@@ -43,7 +73,7 @@ size_t dmx_read(dmx_port_t dmx_num, void *destination, size_t size) {
 
 int dmx_read_slot(dmx_port_t dmx_num, size_t slot_num) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
-  DMX_CHECK(slot_num < DMX_PACKET_SIZE_MAX, -1, "slot_num error");
+  DMX_CHECK(slot_num < DMX_BUFFER_SIZE, -1, "slot_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
 
   uint8_t slot;
@@ -52,45 +82,119 @@ int dmx_read_slot(dmx_port_t dmx_num, size_t slot_num) {
   return slot;
 }
 
-size_t dmx_write_offset(dmx_port_t dmx_num, size_t offset, const void *source,
-                        size_t size) {
-  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
-  DMX_CHECK(offset < DMX_PACKET_SIZE_MAX, 0, "offset error");
-  DMX_CHECK(source, 0, "source is null");
-  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+const uint8_t *dmx_frame_acquire(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, NULL, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), NULL, "driver is not installed");
 
-  // Clamp size to the maximum DMX packet size
-  if (size + offset > DMX_PACKET_SIZE_MAX) {
-    size = DMX_PACKET_SIZE_MAX - offset;
-  } else if (size == 0) {
-    return 0;
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Latch the most recent packet and pin it so that it cannot be swapped out
+  const uint8_t *data;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (!driver->dmx.data_is_acquired) {
+    dmx_latch_buffer(driver);
+    driver->dmx.data_is_acquired = true;
+    data = driver->dmx.data;
+  } else {
+    data = NULL;
   }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return data;
+}
+
+bool dmx_frame_release(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
 
-  // Check if the driver is currently sending an RDM packet
-  int dmx_status;
+  bool was_acquired;
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  dmx_status = driver->dmx.status;
+  was_acquired = driver->dmx.data_is_acquired;
+  driver->dmx.data_is_acquired = false;
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
-  if (dmx_status == DMX_STATUS_SENDING) {
+
+  return was_acquired;
+}
+
+bool dmx_get_changes(dmx_port_t dmx_num, dmx_changes_t *changes) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(changes != NULL, false, "changes is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  *changes = driver->dmx.changes;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+#else
+  DMX_CHECK(false, false, "change detection is not enabled");
+#endif
+}
+
+uint8_t *dmx_write_begin(dmx_port_t dmx_num) {
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Write into the shadow buffer while the DMX driver is auto-refreshing
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (driver->auto_refresh.is_enabled) {
+    driver->auto_refresh.shadow_is_dirty = true;
+    return driver->auto_refresh.shadow;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Check if the driver is currently sending an RDM packet
+  if (DMX_LOAD(driver->dmx.status) == DMX_STATUS_SENDING) {
     rdm_header_t header;
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
     const bool is_rdm = rdm_read_header(dmx_num, &header);
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
     if (is_rdm) {
-      return 0;  // Do not allow asynchronous writes while sending RDM
+      return NULL;  // Do not allow asynchronous writes while sending RDM
     }
   }
 
+#ifndef CONFIG_DMX_RS485_HALF_DUPLEX
   // Flip the DMX bus to write mode
   if (dmx_uart_get_rts(dmx_num) == 1) {
     dmx_uart_set_rts(dmx_num, 0);
   }
+#endif
 
-  // Copy data from the source to the driver buffer asynchronously
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  memcpy(driver->dmx.data + offset, source, size);
+  if (driver->dmx.header_buf == driver->dmx.data) {
+    driver->dmx.header_buf = NULL;  // The cached RDM header may be stale
+  }
+
+  return driver->dmx.data;
+}
+
+size_t dmx_write_offset(dmx_port_t dmx_num, size_t offset, const void *source,
+                        size_t size) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(source, 0, "source is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  const size_t size_max = dmx_packet_size_max(dmx_driver[dmx_num]);
+  DMX_CHECK(offset < size_max, 0, "offset error");
+
+  // Clamp size to the maximum DMX packet size
+  if (size + offset > size_max) {
+    size = size_max - offset;
+  } else if (size == 0) {
+    return 0;
+  }
+
+  // Copy data from the source to the driver buffer asynchronously
+  uint8_t *const data = dmx_write_begin(dmx_num);
+  if (data == NULL) {
+    return 0;
+  }
+  memcpy(data + offset, source, size);
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
   return size;
@@ -106,7 +210,7 @@ size_t dmx_write(dmx_port_t dmx_num, const void *source, size_t size) {
 
 int dmx_write_slot(dmx_port_t dmx_num, size_t slot_num, uint8_t value) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
-  DMX_CHECK(slot_num < DMX_PACKET_SIZE_MAX, -1, "slot_num error");
+  DMX_CHECK(slot_num < DMX_BUFFER_SIZE, -1, "slot_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
 
   dmx_write_offset(dmx_num, slot_num, &value, 1);
@@ -114,11 +218,76 @@ int dmx_write_slot(dmx_port_t dmx_num, size_t slot_num, uint8_t value) {
   return value;
 }
 
-size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
-                       TickType_t wait_ticks) {
+size_t dmx_write_slots(dmx_port_t dmx_num, const dmx_slot_write_t *slots,
+                       size_t count) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(slots != NULL || count == 0, 0, "slots is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  if (count == 0) {
+    return 0;
+  }
+
+  // Apply every update within a single critical section
+  const size_t size_max = dmx_packet_size_max(dmx_driver[dmx_num]);
+  uint8_t *const data = dmx_write_begin(dmx_num);
+  if (data == NULL) {
+    return 0;
+  }
+  size_t written = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (slots[i].slot < size_max) {
+      data[slots[i].slot] = slots[i].value;
+      ++written;
+    }
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return written;
+}
+
+size_t dmx_write_spans(dmx_port_t dmx_num, const dmx_span_write_t *spans,
+                       size_t count) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(spans != NULL || count == 0, 0, "spans is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  if (count == 0) {
+    return 0;
+  }
+
+  // Apply every update within a single critical section
+  const size_t size_max = dmx_packet_size_max(dmx_driver[dmx_num]);
+  uint8_t *const data = dmx_write_begin(dmx_num);
+  if (data == NULL) {
+    return 0;
+  }
+  size_t written = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const size_t offset = spans[i].offset;
+    if (offset >= size_max || spans[i].source == NULL) {
+      continue;
+    }
+    size_t size = spans[i].size;
+    if (size + offset > size_max) {
+      size = size_max - offset;
+    }
+    memcpy(data + offset, spans[i].source, size);
+    written += size;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return written;
+}
+
+static size_t dmx_receive_slots(dmx_port_t dmx_num, dmx_packet_t *packet,
+                                size_t size, bool is_truncated,
+                                TickType_t wait_ticks) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
   DMX_CHECK(dmx_driver_is_enabled(dmx_num), 0, "driver is not enabled");
+  DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), 0,
+            "driver is auto-refreshing");
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
 
@@ -132,6 +301,10 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
       packet->sc = -1;
       packet->size = 0;
       packet->is_rdm = 0;
+      packet->break_ts = 0;
+      packet->eop_ts = 0;
+      packet->period_us = 0;
+      packet->refresh_rate = 0;
     }
     return 0;
   } else if (!dmx_wait_sent(dmx_num, wait_ticks) ||
@@ -142,6 +315,10 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
       packet->sc = -1;
       packet->size = 0;
       packet->is_rdm = 0;
+      packet->break_ts = 0;
+      packet->eop_ts = 0;
+      packet->period_us = 0;
+      packet->refresh_rate = 0;
     }
     return 0;
   }
@@ -152,18 +329,19 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
     driver->dmx.progress = DMX_PROGRESS_STALE;
     driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+#if DMX_RX_BUFFER_COUNT > 2
+    driver->dmx.ready_is_fresh = false;
+#endif
     dmx_uart_set_rts(dmx_num, 1);
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
   }
 
   // Update the receive size only if it has changed
-  int old_size;
-  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  old_size = driver->dmx.size;
-  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
-  if (size != old_size) {
+  if (size != DMX_LOAD(driver->dmx.size) ||
+      is_truncated != driver->dmx.rx_is_truncated) {
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
     driver->dmx.size = size;
+    driver->dmx.rx_is_truncated = is_truncated;
     if (driver->dmx.progress != DMX_PROGRESS_STALE &&
         driver->dmx.head >= size) {
       driver->dmx.progress = DMX_PROGRESS_COMPLETE;
@@ -174,10 +352,17 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
   // Guard against condition where this task cannot block and data isn't ready
   int packet_status;
   int packet_size;
-  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  packet_status = driver->dmx.progress;
-  packet_size = driver->dmx.head;
-  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_err_t err;
+  dmx_packet_state_read(driver, &packet_status, &packet_size, &err);
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  if (packet_status == DMX_PROGRESS_COMPLETE) {
+    // The mutex wait delayed a packet which had already been received
+    const int64_t now = dmx_timer_get_micros_since_boot();
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    dmx_trace_record_stage(driver, DMX_TRACE_STAGE_LOCKED, now);
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  }
+#endif
   if (packet_status != DMX_PROGRESS_COMPLETE && wait_ticks == 0) {
     // Not enough DMX data has been received yet - return early
     if (packet != NULL) {
@@ -185,13 +370,16 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
       packet->sc = -1;
       packet->size = 0;
       packet->is_rdm = 0;
+      packet->break_ts = 0;
+      packet->eop_ts = 0;
+      packet->period_us = 0;
+      packet->refresh_rate = 0;
     }
     xSemaphoreGiveRecursive(driver->mux);
     return 0;
   }
 
   // Block the task to wait for data to be ready
-  dmx_err_t err;
   if (packet_status != DMX_PROGRESS_COMPLETE) {
     // Tell the DMX driver that this task is awaiting a DMX packet
     const TaskHandle_t current_task_handle = xTaskGetCurrentTaskHandle();
@@ -222,6 +410,10 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
           packet->sc = -1;
           packet->size = 0;
           packet->is_rdm = 0;
+          packet->break_ts = 0;
+          packet->eop_ts = 0;
+          packet->period_us = 0;
+          packet->refresh_rate = 0;
         }
         xSemaphoreGiveRecursive(driver->mux);
         return 0;
@@ -240,6 +432,10 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
     packet_size = driver->dmx.head;
     driver->task_waiting = NULL;
+    if (notified) {
+      dmx_trace_record(driver, DMX_TRACE_EVENT_TASK_WAKE,
+                       dmx_timer_get_micros_since_boot());
+    }
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
     if (!notified) {
       xTaskNotifyStateClear(current_task_handle);  // Avoid race condition
@@ -248,50 +444,98 @@ size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
         packet->sc = -1;
         packet->size = 0;
         packet->is_rdm = 0;
+        packet->break_ts = 0;
+        packet->eop_ts = 0;
+        packet->period_us = 0;
+        packet->refresh_rate = 0;
       }
       xSemaphoreGiveRecursive(driver->mux);
-      dmx_parameter_commit(dmx_num);
       return 0;
     }
-  } else {
-    // TODO: store error code on the driver
-    err = DMX_OK;
   }
   if (packet_size < 0) {
     packet_size = 0;
+  } else if (is_truncated && packet_size > size) {
+    packet_size = size;  // Slots beyond the packet size were not copied
   }
 
   // Parse DMX packet data
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   driver->dmx.progress = DMX_PROGRESS_STALE;  // Prevent parsing old data
+  dmx_latch_buffer(driver);
+#ifdef CONFIG_DMX_RX_CHANGE_DETECTION
+  // Publish the slots which changed since the last packet was returned
+  driver->dmx.changes = driver->dmx.dirty;
+  memset(driver->dmx.dirty.bitmap, 0, sizeof(driver->dmx.dirty.bitmap));
+  driver->dmx.dirty.is_changed = false;
+  driver->dmx.dirty.first = -1;
+  driver->dmx.dirty.last = -1;
+#endif
+  const int64_t break_ts = driver->dmx.rx_last_break_ts;
+  const int64_t eop_ts = driver->dmx.rx_last_eop_ts;
+  const uint32_t period_us = driver->dmx.rx_period_us;
+  if (packet_size > 0) {
+    dmx_trace_record_stage(driver, DMX_TRACE_STAGE_LATCHED,
+                           dmx_timer_get_micros_since_boot());
+  }
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
   if (packet != NULL) {
     if (packet_size > 0) {
-      taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-      packet->sc = driver->dmx.data[0];
-      taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+      packet->sc = DMX_LOAD(driver->dmx.data)[0];
     } else {
       packet->sc = -1;
     }
     packet->err = err;
     packet->size = packet_size;
     packet->is_rdm = dmx_start_code_is_rdm(packet->sc);
+    packet->break_ts = break_ts;
+    packet->eop_ts = eop_ts;
+    packet->period_us = period_us;
+    packet->refresh_rate =
+        period_us > 0 ? (1000000 + period_us / 2) / period_us : 0;
+  }
+
+  // Map the slots through the dimming curves before the packet is handed off
+  if (err == DMX_OK && packet_size > 0 &&
+      DMX_LOAD(driver->dmx.data)[0] == DMX_SC) {
+    dmx_curve_apply(driver, packet_size);
   }
 
   xSemaphoreGiveRecursive(driver->mux);
   return packet_size;
 }
 
+size_t dmx_receive_num(dmx_port_t dmx_num, dmx_packet_t *packet, size_t size,
+                       TickType_t wait_ticks) {
+  return dmx_receive_slots(dmx_num, packet, size, false, wait_ticks);
+}
+
+size_t dmx_receive_footprint(dmx_port_t dmx_num, dmx_packet_t *packet,
+                             TickType_t wait_ticks) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  // Receive only the slots up to the end of the DMX footprint
+  size_t size = dmx_packet_size_max(dmx_driver[dmx_num]);
+  const uint16_t start_address = dmx_get_start_address(dmx_num);
+  const uint8_t personality_num = dmx_get_current_personality(dmx_num);
+  if (start_address != DMX_START_ADDRESS_NONE && personality_num > 0) {
+    const size_t footprint = dmx_get_footprint(dmx_num, personality_num);
+    if (footprint > 0 && start_address + footprint < DMX_PACKET_SIZE_MAX) {
+      size = start_address + footprint;
+    }
+  }
+
+  return dmx_receive_slots(dmx_num, packet, size, true, wait_ticks);
+}
+
 size_t dmx_receive(dmx_port_t dmx_num, dmx_packet_t *packet,
                    TickType_t wait_ticks) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
   DMX_CHECK(dmx_driver_is_enabled(dmx_num), 0, "driver is not enabled");
 
-  size_t size;
-  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  size = dmx_driver[dmx_num]->dmx.size;
-  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const size_t size = DMX_LOAD(dmx_driver[dmx_num]->dmx.size);
 
   return dmx_receive_num(dmx_num, packet, size, wait_ticks);
 }
@@ -300,8 +544,14 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
   DMX_CHECK(dmx_driver_is_enabled(dmx_num), 0, "driver is not enabled");
+  DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), 0,
+            "driver is auto-refreshing");
+  DMX_CHECK(dmx_driver[dmx_num]->repeater.input == DMX_NUM_MAX, 0,
+            "driver is a repeater output");
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
+  dmx_trace_record_send(driver, DMX_TRACE_STAGE_SEND,
+                        dmx_timer_get_micros_since_boot());
 
   // Block until the mutex can be taken
   if (!xSemaphoreTakeRecursive(driver->mux, 0)) {
@@ -324,8 +574,21 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
     is_rdm = false;
   }
 
+  // Determine if the packet is an RDM_PID_DISC_UNIQUE_BRANCH response
+  bool is_disc_response;
+  if (is_rdm) {
+    is_disc_response = header.cc == RDM_CC_DISC_COMMAND_RESPONSE &&
+                       header.pid == RDM_PID_DISC_UNIQUE_BRANCH;
+  } else {
+    // A discovery response with a bad checksum is sent with an explicit size
+    const uint8_t sc = driver->dmx.data[0];
+    is_disc_response = size > 0 && size <= RDM_DISC_RESPONSE_SIZE_MAX &&
+                       (sc == RDM_PREAMBLE || sc == RDM_DELIMITER);
+  }
+
   // Determine if this device is the controller
-  driver->is_controller = !is_rdm || rdm_cc_is_request(header.cc);
+  driver->is_controller =
+      !is_disc_response && (!is_rdm || rdm_cc_is_request(header.cc));
 
   // Determine if it is necessary to set a hardware timeout alarm
   int64_t timer_alarm;
@@ -356,6 +619,7 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
 
   // If necessary, set an alarm to wait the minimum duration before sending
   int64_t timer_elapsed;
+#ifndef CONFIG_DMX_TURNAROUND_IN_ISR
   const TaskHandle_t this_task_handle = xTaskGetCurrentTaskHandle();
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   timer_elapsed =
@@ -375,6 +639,12 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
     }
     driver->task_waiting = NULL;
   }
+#else
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  timer_elapsed =
+      dmx_timer_get_micros_since_boot() - driver->dmx.controller_eop_timestamp;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+#endif
 
   // Return early if it is too late to send a response packet
   if (!driver->is_controller) {
@@ -384,23 +654,17 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
     }
   }
 
-  // Turn the DMX bus around and get the send size
-  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  if (dmx_uart_get_rts(dmx_num) == 1) {
-    dmx_uart_set_rts(dmx_num, 0);
-  }
-  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
-
   // Determine the size of the packet to send
   if (is_rdm) {
-    if (header.cc == RDM_CC_DISC_COMMAND_RESPONSE &&
-        header.pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+    if (is_disc_response) {
       size = header.message_len;  // Send an RDM_PID_DISC_UNIQUE_BRANCH response
     } else {
       size = header.message_len + 2;  // Send a standard RDM packet
     }
-  } else if (size == 0 || size > DMX_PACKET_SIZE_MAX) {
-    size = DMX_PACKET_SIZE_MAX;  // Send a standard DMX packet
+  } else if (is_disc_response) {
+    // Send the discovery response with the size that was requested
+  } else if (size == 0 || size > dmx_packet_size_max(driver)) {
+    size = dmx_packet_size_max(driver);  // Send a full DMX packet
   }
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   driver->dmx.size = size;
@@ -419,18 +683,54 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
       ++driver->rdm.tn;
     }
   } else {
-    rdm_pid_t pid = is_rdm ? header.pid : 0;
+    rdm_pid_t pid = is_disc_response ? RDM_PID_DISC_UNIQUE_BRANCH : header.pid;
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
     driver->dmx.last_responder_pid = pid;
     driver->dmx.responder_sent_last = true;
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
   }
 
+#ifdef CONFIG_DMX_TURNAROUND_IN_ISR
+  // Let the DMX timer turn the bus around when the minimum time has elapsed
+  bool is_waiting = false;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  timer_elapsed =
+      dmx_timer_get_micros_since_boot() - driver->dmx.controller_eop_timestamp;
+  if (timer_elapsed < timer_alarm) {
+    driver->dmx.head = 0;
+    driver->dmx.progress = DMX_PROGRESS_IN_TURNAROUND;
+    driver->dmx.status = DMX_STATUS_SENDING;
+    dmx_timer_set_counter(dmx_num, timer_elapsed);
+    dmx_timer_set_alarm(dmx_num, timer_alarm, false);
+    dmx_timer_start(dmx_num);
+    is_waiting = true;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (is_waiting) {
+    xSemaphoreGiveRecursive(driver->mux);
+    return size;
+  }
+#endif
+
+#ifndef CONFIG_DMX_RS485_HALF_DUPLEX
+  // Turn the DMX bus around
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (dmx_uart_get_rts(dmx_num) == 1) {
+    dmx_uart_set_rts(dmx_num, 0);
+  }
+  if (!driver->is_controller) {
+    dmx_turnaround_record(driver, dmx_timer_get_micros_since_boot());
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+#endif
+
   // Determine if a DMX break is required and send the packet
-  if (is_rdm && header.cc == RDM_CC_DISC_COMMAND_RESPONSE &&
-      header.pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+  if (is_disc_response) {
     // RDM discovery responses do not send a DMX break - write immediately
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+    dmx_send_turnaround(driver);
+#endif
     driver->dmx.status = DMX_STATUS_SENDING;
 
     int write_len = driver->dmx.size;
@@ -440,9 +740,14 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
     // Enable DMX write interrupts
     dmx_uart_enable_interrupt(dmx_num, DMX_INTR_TX_ALL);
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    dmx_trace_record_send(driver, DMX_TRACE_STAGE_TX_START,
+                          dmx_timer_get_micros_since_boot());
   } else {
     // Send the packet by starting the DMX break
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+    dmx_send_turnaround(driver);
+#endif
     driver->dmx.head = 0;
     driver->dmx.progress = DMX_PROGRESS_IN_BREAK;
     driver->dmx.status = DMX_STATUS_SENDING;
@@ -452,6 +757,8 @@ size_t dmx_send_num(dmx_port_t dmx_num, size_t size) {
 
     dmx_uart_invert_tx(dmx_num, 1);
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    dmx_trace_record_send(driver, DMX_TRACE_STAGE_TX_START,
+                          dmx_timer_get_micros_since_boot());
   }
 
   // Give the mutex back
@@ -498,14 +805,367 @@ bool dmx_wait_sent(dmx_port_t dmx_num, TickType_t wait_ticks) {
       driver->task_waiting = NULL;
     }
   } else {
-    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-    if (driver->dmx.status == DMX_STATUS_SENDING) {
-      result = false;
-    }
-    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    result = DMX_LOAD(driver->dmx.status) != DMX_STATUS_SENDING;
   }
 
   // Give the mutex back and return
   xSemaphoreGiveRecursive(driver->mux);
   return result;
 }
+
+uint32_t dmx_wait_event(dmx_port_t dmx_num, uint32_t events,
+                        TickType_t wait_ticks) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+  DMX_CHECK(events != 0 && (events & ~DMX_EVENT_ALL) == 0, 0, "events error");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Wait without the mutex so that any number of tasks may wait at once
+  __atomic_add_fetch(&driver->event_waiters, 1, __ATOMIC_RELEASE);
+  const EventBits_t bits =
+      xEventGroupWaitBits(driver->events, events, pdFALSE, pdFALSE, wait_ticks);
+  __atomic_sub_fetch(&driver->event_waiters, 1, __ATOMIC_RELEASE);
+
+  return bits & events;
+}
+
+static bool dmx_auto_refresh_start(dmx_port_t dmx_num, uint32_t refresh_rate,
+                                   size_t size, bool is_synced) {
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Clamp size to the maximum DMX packet size
+  if (size == 0 || size > dmx_packet_size_max(driver)) {
+    size = dmx_packet_size_max(driver);
+  }
+
+  // Allocate the shadow buffer
+  uint8_t *shadow = malloc(DMX_BUFFER_SIZE);
+  DMX_CHECK(shadow != NULL, false, "shadow buffer malloc error");
+
+  // Block until the driver is done sending
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  if (!dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23))) {
+    xSemaphoreGiveRecursive(driver->mux);
+    free(shadow);
+    return false;
+  }
+
+#ifndef CONFIG_DMX_RS485_HALF_DUPLEX
+  // Flip the DMX bus to write mode
+  if (dmx_uart_get_rts(dmx_num) == 1) {
+    dmx_uart_set_rts(dmx_num, 0);
+  }
+#endif
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  memcpy(shadow, driver->dmx.data, DMX_BUFFER_SIZE);
+  driver->auto_refresh.shadow = shadow;
+  driver->auto_refresh.shadow_is_dirty = false;
+  driver->auto_refresh.period = 1000000 / refresh_rate;
+  driver->auto_refresh.size = size;
+  driver->auto_refresh.is_synced = is_synced;
+  driver->auto_refresh.is_enabled = true;
+  driver->is_controller = true;
+  driver->dmx.last_controller_pid = 0;
+  driver->dmx.last_request_was_broadcast = false;
+  driver->dmx.responder_sent_last = false;
+
+  // Start the first DMX packet, the DMX timer ISR will send the rest
+  if (!is_synced) {
+    driver->dmx.size = size;
+    driver->dmx.head = 0;
+    driver->dmx.progress = DMX_PROGRESS_IN_BREAK;
+    driver->dmx.status = DMX_STATUS_SENDING;
+    driver->auto_refresh.frame_start_ts = dmx_timer_get_micros_since_boot();
+    dmx_timer_set_counter(dmx_num, 0);
+    dmx_timer_set_alarm(dmx_num, driver->break_len, true);
+    dmx_timer_start(dmx_num);
+
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+    dmx_uart_set_rts(dmx_num, 0);
+#endif
+    dmx_uart_invert_tx(dmx_num, 1);
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  xSemaphoreGiveRecursive(driver->mux);
+  return true;
+}
+
+static void dmx_auto_refresh_stop(dmx_port_t dmx_num) {
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+
+  // Stop scheduling DMX packets and allow the current packet to finish
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->auto_refresh.is_enabled = false;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23));
+  dmx_timer_stop(dmx_num);
+
+  // Keep the most recent user writes in the DMX buffer
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (driver->auto_refresh.shadow_is_dirty) {
+    memcpy(driver->dmx.data, driver->auto_refresh.shadow, DMX_BUFFER_SIZE);
+    if (driver->dmx.header_buf == driver->dmx.data) {
+      driver->dmx.header_buf = NULL;  // The cached RDM header may be stale
+    }
+  }
+  uint8_t *shadow = driver->auto_refresh.shadow;
+  driver->auto_refresh.shadow = NULL;
+  driver->auto_refresh.shadow_is_dirty = false;
+  driver->auto_refresh.is_synced = false;
+  driver->dmx.controller_eop_timestamp = dmx_timer_get_micros_since_boot();
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  free(shadow);
+
+  xSemaphoreGiveRecursive(driver->mux);
+}
+
+bool dmx_auto_refresh_enable(dmx_port_t dmx_num, uint32_t refresh_rate,
+                             size_t size) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(refresh_rate > 0, false, "refresh_rate error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(dmx_driver_is_enabled(dmx_num), false, "driver is not enabled");
+  DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), false,
+            "driver is already auto-refreshing");
+
+  return dmx_auto_refresh_start(dmx_num, refresh_rate, size, false);
+}
+
+bool dmx_auto_refresh_disable(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(dmx_auto_refresh_is_enabled(dmx_num), false,
+            "driver is not auto-refreshing");
+  DMX_CHECK(!dmx_driver[dmx_num]->auto_refresh.is_synced, false,
+            "driver is in the DMX sync group");
+
+  dmx_auto_refresh_stop(dmx_num);
+  return true;
+}
+
+bool dmx_auto_refresh_is_enabled(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  return dmx_driver[dmx_num]->auto_refresh.is_enabled;
+}
+
+bool dmx_sync_group_enable(const dmx_port_t *ports, int num_ports,
+                           uint32_t refresh_rate, size_t size) {
+  DMX_CHECK(ports != NULL, false, "ports is null");
+  DMX_CHECK(num_ports > 0 && num_ports <= DMX_NUM_MAX, false,
+            "num_ports error");
+  DMX_CHECK(refresh_rate > 0, false, "refresh_rate error");
+  DMX_CHECK(!dmx_sync_group_is_enabled(), false,
+            "sync group is already enabled");
+  uint32_t members = 0;
+  for (int i = 0; i < num_ports; ++i) {
+    const dmx_port_t dmx_num = ports[i];
+    DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "ports error");
+    DMX_CHECK(!(members & (1 << dmx_num)), false, "ports error");
+    DMX_CHECK(dmx_driver_is_installed(dmx_num), false,
+              "driver is not installed");
+    DMX_CHECK(dmx_driver_is_enabled(dmx_num), false, "driver is not enabled");
+    DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), false,
+              "driver is already auto-refreshing");
+    members |= 1 << dmx_num;
+  }
+
+  // Prepare each member to have its packets started by the group leader
+  for (int i = 0; i < num_ports; ++i) {
+    if (!dmx_auto_refresh_start(ports[i], refresh_rate, size, true)) {
+      while (--i >= 0) {
+        dmx_auto_refresh_stop(ports[i]);
+      }
+      return false;
+    }
+  }
+
+  const dmx_port_t leader = ports[0];
+  taskENTER_CRITICAL(&dmx_sync_group.spinlock);
+  dmx_sync_group.members = members;
+  dmx_sync_group.pending = 0;
+  dmx_sync_group.leader = leader;
+  dmx_sync_group.is_committed = false;
+  taskEXIT_CRITICAL(&dmx_sync_group.spinlock);
+
+  // Start the first DMX packet, the timer of the leader will send the rest
+  dmx_driver_t *const driver = dmx_driver[leader];
+  taskENTER_CRITICAL(DMX_SPINLOCK(leader));
+  driver->auto_refresh.frame_start_ts = dmx_timer_get_micros_since_boot();
+  dmx_timer_set_counter(leader, 0);
+  dmx_timer_set_alarm(leader, 1, false);
+  dmx_timer_start(leader);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(leader));
+
+  return true;
+}
+
+bool dmx_sync_group_commit() {
+  DMX_CHECK(dmx_sync_group_is_enabled(), false, "sync group is not enabled");
+
+  taskENTER_CRITICAL(&dmx_sync_group.spinlock);
+  dmx_sync_group.is_committed = true;
+  taskEXIT_CRITICAL(&dmx_sync_group.spinlock);
+
+  return true;
+}
+
+bool dmx_sync_group_disable() {
+  DMX_CHECK(dmx_sync_group_is_enabled(), false, "sync group is not enabled");
+
+  // Stop the leader from starting any more packets
+  taskENTER_CRITICAL(&dmx_sync_group.spinlock);
+  const uint32_t members = dmx_sync_group.members;
+  dmx_sync_group.members = 0;
+  taskEXIT_CRITICAL(&dmx_sync_group.spinlock);
+
+  // Allow the current packets to finish and then stop each member
+  for (int i = 0; i < DMX_NUM_MAX; ++i) {
+    if (members & (1 << i)) {
+      dmx_auto_refresh_stop(i);
+    }
+  }
+
+  return true;
+}
+
+bool dmx_sync_group_is_enabled() {
+  bool is_enabled;
+  taskENTER_CRITICAL(&dmx_sync_group.spinlock);
+  is_enabled = dmx_sync_group.members != 0;
+  taskEXIT_CRITICAL(&dmx_sync_group.spinlock);
+
+  return is_enabled;
+}
+
+static void dmx_repeater_remove_output(dmx_port_t dmx_num) {
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+
+  // Stop the DMX ISR from starting or streaming packets on the output
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->repeater.input = DMX_NUM_MAX;
+  dmx_timer_stop(dmx_num);
+  dmx_uart_invert_tx(dmx_num, 0);
+  const int pending = SOC_UART_FIFO_LEN - dmx_uart_get_txfifo_len(dmx_num);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Allow the slots in the TX FIFO to be sent before the output is idle
+  if (pending > 0) {
+    vTaskDelay(dmx_ms_to_ticks((pending * DMX_SLOT_LEN_US + 999) / 1000) + 1);
+  }
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->dmx.progress = DMX_PROGRESS_COMPLETE;
+  driver->dmx.status = DMX_STATUS_IDLE;
+  driver->dmx.controller_eop_timestamp = dmx_timer_get_micros_since_boot();
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  xSemaphoreGiveRecursive(driver->mux);
+}
+
+bool dmx_repeater_enable(dmx_port_t input, const dmx_port_t *outputs,
+                         int num_outputs) {
+  DMX_CHECK(input < DMX_NUM_MAX, false, "input error");
+  DMX_CHECK(outputs != NULL, false, "outputs is null");
+  DMX_CHECK(num_outputs > 0 && num_outputs < DMX_NUM_MAX, false,
+            "num_outputs error");
+  DMX_CHECK(dmx_driver_is_installed(input), false, "driver is not installed");
+  DMX_CHECK(dmx_driver_is_enabled(input), false, "driver is not enabled");
+  DMX_CHECK(!dmx_repeater_is_enabled(input), false,
+            "repeater is already enabled");
+  DMX_CHECK(dmx_driver[input]->repeater.input == DMX_NUM_MAX, false,
+            "input is a repeater output");
+  uint32_t mask = 0;
+  for (int i = 0; i < num_outputs; ++i) {
+    const dmx_port_t dmx_num = outputs[i];
+    DMX_CHECK(dmx_num < DMX_NUM_MAX && dmx_num != input, false,
+              "outputs error");
+    DMX_CHECK(!(mask & (1u << dmx_num)), false, "outputs error");
+    DMX_CHECK(dmx_driver_is_installed(dmx_num), false,
+              "driver is not installed");
+    DMX_CHECK(dmx_driver_is_enabled(dmx_num), false, "driver is not enabled");
+    DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), false,
+              "driver is auto-refreshing");
+    DMX_CHECK(dmx_driver[dmx_num]->repeater.input == DMX_NUM_MAX &&
+                  dmx_driver[dmx_num]->repeater.outputs == 0,
+              false, "output is already in a repeater");
+    mask |= 1u << dmx_num;
+  }
+
+  // Turn each output around so that the DMX ISR may send on it
+  for (int i = 0; i < num_outputs; ++i) {
+    const dmx_port_t dmx_num = outputs[i];
+    dmx_driver_t *const driver = dmx_driver[dmx_num];
+    xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+    dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23));
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    driver->is_controller = true;
+    driver->repeater.input = input;
+    driver->dmx.head = 0;
+    driver->dmx.progress = DMX_PROGRESS_STALE;
+    driver->dmx.status = DMX_STATUS_IDLE;
+    driver->dmx.last_controller_pid = 0;
+    driver->dmx.last_request_was_broadcast = false;
+    driver->dmx.responder_sent_last = false;
+#ifndef CONFIG_DMX_RS485_HALF_DUPLEX
+    dmx_uart_set_rts(dmx_num, 0);
+#endif
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    xSemaphoreGiveRecursive(driver->mux);
+  }
+
+  // Forward slots from the input as soon as a few of them have arrived
+  dmx_driver_t *const driver = dmx_driver[input];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  driver->repeater.rx_fifo_threshold = dmx_get_rx_fifo_threshold(input);
+  dmx_set_rx_fifo_threshold(input, DMX_REPEATER_RX_FIFO_THRESHOLD);
+  taskENTER_CRITICAL(DMX_SPINLOCK(input));
+  if (dmx_uart_get_rts(input) == 0) {
+    driver->dmx.progress = DMX_PROGRESS_STALE;
+    driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+    dmx_uart_set_rts(input, 1);
+  }
+  driver->repeater.outputs = mask;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(input));
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return true;
+}
+
+bool dmx_repeater_disable(dmx_port_t input) {
+  DMX_CHECK(input < DMX_NUM_MAX, false, "input error");
+  DMX_CHECK(dmx_repeater_is_enabled(input), false, "repeater is not enabled");
+
+  // Stop the input from forwarding any more slots
+  dmx_driver_t *const driver = dmx_driver[input];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  taskENTER_CRITICAL(DMX_SPINLOCK(input));
+  const uint32_t outputs = driver->repeater.outputs;
+  driver->repeater.outputs = 0;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(input));
+  dmx_set_rx_fifo_threshold(input, driver->repeater.rx_fifo_threshold);
+  xSemaphoreGiveRecursive(driver->mux);
+
+  // Allow the current packets to finish and then stop each output
+  for (int i = 0; i < DMX_NUM_MAX; ++i) {
+    if (outputs & (1u << i)) {
+      dmx_repeater_remove_output(i);
+    }
+  }
+
+  return true;
+}
+
+bool dmx_repeater_is_enabled(dmx_port_t input) {
+  DMX_CHECK(input < DMX_NUM_MAX, false, "input error");
+  DMX_CHECK(dmx_driver_is_installed(input), false, "driver is not installed");
+
+  return DMX_LOAD(dmx_driver[input]->repeater.outputs) != 0;
+}
@@ -0,0 +1,317 @@
+#include "dmx/merge.h"
+
+#include <string.h>
+
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+#include "dmx/failover.h"
+#endif
+
+enum {
+  DMX_MERGE_TASK_STACK_SIZE = 3072,  // The merge task stack in bytes.
+  DMX_MERGE_WORDS = (DMX_PACKET_SIZE_MAX + 3) / 4,  // Words in a DMX packet.
+};
+
+/** @brief The high bit of each byte of a 32-bit word.*/
+#define DMX_MERGE_HIGH_BITS 0x80808080
+
+typedef struct dmx_merge_t {
+  SemaphoreHandle_t mux;      // Prevents inputs from being merged at once.
+  SemaphoreHandle_t stopped;  // Is given by each merge task when it stops.
+  dmx_port_t output;          // The DMX port which sends merged packets.
+  dmx_merge_mode_t mode;      // The rule used to merge slots.
+  volatile bool is_running;   // False when the merge tasks should stop.
+  int num_inputs;             // The number of inputs which are merged.
+  struct dmx_merge_input_t {
+    struct dmx_merge_t *merge;  // The DMX merge engine of the input.
+    dmx_port_t dmx_num;         // The DMX port which receives the input.
+    uint8_t priority;           // The priority of the input.
+    int64_t last_rx_ts;  // The timestamp of the last packet, or 0 if none.
+    size_t size;         // The size of the last packet of the input.
+    uint32_t data[DMX_MERGE_WORDS];  // The last packet of the input.
+    uint32_t prev[DMX_MERGE_WORDS];  // The packet before, for LTP merges.
+  } inputs[DMX_NUM_MAX];
+  uint32_t merged[DMX_MERGE_WORDS];  // The merged DMX packet.
+} dmx_merge_t;
+
+static dmx_merge_t *dmx_merge_context[DMX_NUM_MAX] = {};
+
+static inline uint32_t dmx_merge_max4(uint32_t x, uint32_t y) {
+  // Set the high bit of each byte of x which is greater or equal to y
+  const uint32_t t = (x | DMX_MERGE_HIGH_BITS) - (y & ~DMX_MERGE_HIGH_BITS);
+  const uint32_t ge = ((x & ~y) | (~(x ^ y) & t)) & DMX_MERGE_HIGH_BITS;
+
+  // Expand the high bits into a mask of the bytes to take from x
+  const uint32_t mask = (ge >> 7) * 0xff;
+  return (x & mask) | (y & ~mask);
+}
+
+static inline uint32_t dmx_merge_changed4(uint32_t x, uint32_t y) {
+  // Set the high bit of each byte which differs between x and y
+  const uint32_t z = x ^ y;
+  const uint32_t low = ~DMX_MERGE_HIGH_BITS;
+  const uint32_t nz = (((z & low) + low) | z) & DMX_MERGE_HIGH_BITS;
+
+  return (nz >> 7) * 0xff;
+}
+
+size_t dmx_merge_htp(void *destination, const void *const *sources,
+                     int num_sources, size_t size) {
+  DMX_CHECK(destination != NULL, 0, "destination is null");
+  DMX_CHECK(sources != NULL || num_sources == 0, 0, "sources is null");
+  DMX_CHECK(num_sources >= 0, 0, "num_sources error");
+
+  uint8_t *const dest = destination;
+  if (num_sources == 0) {
+    memset(dest, 0, size);
+    return size;
+  }
+
+  // Only use 32-bit words if every buffer is aligned
+  bool is_aligned = ((uintptr_t)dest & 3) == 0;
+  for (int i = 0; i < num_sources; ++i) {
+    DMX_CHECK(sources[i] != NULL, 0, "sources is null");
+    is_aligned = is_aligned && ((uintptr_t)sources[i] & 3) == 0;
+  }
+  if (dest != sources[0]) {
+    memmove(dest, sources[0], size);
+  }
+
+  size_t i = 0;
+  if (is_aligned) {
+    uint32_t *const dest_words = (uint32_t *)dest;
+    for (int s = 1; s < num_sources; ++s) {
+      const uint32_t *const src_words = (const uint32_t *)sources[s];
+      for (size_t w = 0; w < size / 4; ++w) {
+        dest_words[w] = dmx_merge_max4(dest_words[w], src_words[w]);
+      }
+    }
+    i = size & ~3;
+  }
+  for (int s = 1; s < num_sources; ++s) {
+    const uint8_t *const src = sources[s];
+    for (size_t j = i; j < size; ++j) {
+      if (src[j] > dest[j]) {
+        dest[j] = src[j];
+      }
+    }
+  }
+
+  return size;
+}
+
+static size_t dmx_merge_run(dmx_merge_t *merge,
+                            struct dmx_merge_input_t *latest, int64_t now) {
+  // Find the size of the merged packet and the highest active priority
+  bool is_active[DMX_NUM_MAX];
+  int priority = -1;
+  size_t size = 0;
+  for (int i = 0; i < merge->num_inputs; ++i) {
+    const struct dmx_merge_input_t *const input = &merge->inputs[i];
+    is_active[i] = input->last_rx_ts > 0 &&
+                   now - input->last_rx_ts < DMX_MERGE_SOURCE_TIMEOUT_US;
+    if (!is_active[i]) {
+      continue;
+    }
+    if (input->size > size) {
+      size = input->size;
+    }
+    if (input->priority > priority) {
+      priority = input->priority;
+    }
+  }
+  const size_t words = (size + 3) / 4;
+
+  if (merge->mode == DMX_MERGE_LTP) {
+    // Take each slot which was changed by the latest input
+    for (size_t w = 0; w < words; ++w) {
+      const uint32_t changed =
+          dmx_merge_changed4(latest->data[w], latest->prev[w]);
+      merge->merged[w] =
+          (merge->merged[w] & ~changed) | (latest->data[w] & changed);
+      latest->prev[w] = latest->data[w];
+    }
+  } else {
+    // Take the highest value of each slot among the merged inputs
+    memset(merge->merged, 0, sizeof(merge->merged));
+    for (int i = 0; i < merge->num_inputs; ++i) {
+      const struct dmx_merge_input_t *const input = &merge->inputs[i];
+      if (!is_active[i] || (merge->mode == DMX_MERGE_PRIORITY &&
+                            input->priority != priority)) {
+        continue;
+      }
+      for (size_t w = 0; w < words; ++w) {
+        merge->merged[w] = dmx_merge_max4(merge->merged[w], input->data[w]);
+      }
+    }
+  }
+
+  return size;
+}
+
+static size_t dmx_merge_receive(dmx_port_t dmx_num, dmx_packet_t *packet,
+                                TickType_t wait_ticks) {
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+  // Take the packets of redundant inputs from whichever port is active
+  if (dmx_failover_is_enabled(dmx_num)) {
+    return dmx_failover_receive(dmx_num, packet, wait_ticks);
+  }
+#endif
+  return dmx_receive(dmx_num, packet, wait_ticks);
+}
+
+static size_t dmx_merge_read(dmx_port_t dmx_num, void *destination,
+                             size_t size) {
+#ifdef CONFIG_DMX_FAILOVER_ENABLE
+  if (dmx_failover_is_enabled(dmx_num)) {
+    return dmx_failover_read(dmx_num, destination, size);
+  }
+#endif
+  return dmx_read(dmx_num, destination, size);
+}
+
+static void dmx_merge_task(void *arg) {
+  struct dmx_merge_input_t *const input = arg;
+  dmx_merge_t *const merge = input->merge;
+
+  while (merge->is_running) {
+    // Wake periodically to check if the DMX merge engine was disabled
+    const TickType_t wait_ticks = dmx_ms_to_ticks(100);
+    TimeOut_t timeout;
+    vTaskSetTimeOutState(&timeout);
+    dmx_packet_t packet;
+    if (!dmx_merge_receive(input->dmx_num, &packet, wait_ticks)) {
+      // Back off if the receive failed without blocking, e.g. if disabled
+      TickType_t remaining = wait_ticks;
+      if (!xTaskCheckForTimeOut(&timeout, &remaining)) {
+        vTaskDelay(remaining);
+      }
+      continue;
+    } else if (packet.err != DMX_OK || packet.sc != DMX_SC) {
+      continue;
+    }
+    const int64_t now = esp_timer_get_time();
+
+    // Merge the received packet as soon as it has arrived
+    xSemaphoreTake(merge->mux, portMAX_DELAY);
+    memset(input->data, 0, sizeof(input->data));
+    dmx_merge_read(input->dmx_num, input->data, packet.size);
+    input->size = packet.size;
+    input->last_rx_ts = now;
+    const size_t size = dmx_merge_run(merge, input, now);
+    dmx_write(merge->output, merge->merged, size);
+    if (!dmx_auto_refresh_is_enabled(merge->output)) {
+      dmx_send_num(merge->output, size);
+    }
+    xSemaphoreGive(merge->mux);
+  }
+
+  xSemaphoreGive(merge->stopped);
+  vTaskDelete(NULL);
+}
+
+static void dmx_merge_free(dmx_merge_t *merge, int num_tasks) {
+  // Wait for every merge task to stop before freeing the DMX merge engine
+  merge->is_running = false;
+  for (int i = 0; i < num_tasks; ++i) {
+    xSemaphoreTake(merge->stopped, portMAX_DELAY);
+  }
+  if (merge->stopped != NULL) {
+    vSemaphoreDelete(merge->stopped);
+  }
+  if (merge->mux != NULL) {
+    vSemaphoreDelete(merge->mux);
+  }
+  heap_caps_free(merge);
+}
+
+bool dmx_merge_enable(dmx_port_t output, const dmx_port_t *inputs,
+                      const uint8_t *priorities, int num_inputs,
+                      dmx_merge_mode_t mode) {
+  DMX_CHECK(output < DMX_NUM_MAX, false, "output error");
+  DMX_CHECK(inputs != NULL, false, "inputs is null");
+  DMX_CHECK(num_inputs > 0 && num_inputs < DMX_NUM_MAX, false,
+            "num_inputs error");
+  DMX_CHECK(mode >= DMX_MERGE_HTP && mode <= DMX_MERGE_PRIORITY, false,
+            "mode error");
+  DMX_CHECK(dmx_driver_is_installed(output), false, "driver is not installed");
+  DMX_CHECK(!dmx_merge_is_enabled(output), false, "merge is already enabled");
+  for (int i = 0; i < num_inputs; ++i) {
+    DMX_CHECK(inputs[i] < DMX_NUM_MAX && inputs[i] != output, false,
+              "inputs error");
+    DMX_CHECK(dmx_driver_is_installed(inputs[i]), false,
+              "driver is not installed");
+    for (int j = 0; j < i; ++j) {
+      DMX_CHECK(inputs[i] != inputs[j], false, "inputs error");
+    }
+  }
+
+  // Allocate the DMX merge engine
+  dmx_merge_t *const merge = heap_caps_malloc(sizeof(*merge), MALLOC_CAP_8BIT);
+  DMX_CHECK(merge != NULL, false, "merge malloc error");
+  memset(merge, 0, sizeof(*merge));
+  merge->output = output;
+  merge->mode = mode;
+  merge->is_running = true;
+  merge->num_inputs = num_inputs;
+  merge->mux = xSemaphoreCreateMutex();
+  merge->stopped = xSemaphoreCreateCounting(num_inputs, 0);
+  if (merge->mux == NULL || merge->stopped == NULL) {
+    dmx_merge_free(merge, 0);
+    DMX_CHECK(false, false, "merge mutex malloc error");
+  }
+  for (int i = 0; i < num_inputs; ++i) {
+    merge->inputs[i].merge = merge;
+    merge->inputs[i].dmx_num = inputs[i];
+    merge->inputs[i].priority = priorities != NULL ? priorities[i] : 0;
+  }
+
+  // Start a merge task for each input
+  for (int i = 0; i < num_inputs; ++i) {
+    if (!xTaskCreate(dmx_merge_task, "dmx_merge", DMX_MERGE_TASK_STACK_SIZE,
+                     &merge->inputs[i], uxTaskPriorityGet(NULL), NULL)) {
+      dmx_merge_free(merge, i);
+      DMX_CHECK(false, false, "merge task create error");
+    }
+  }
+  dmx_merge_context[output] = merge;
+
+  return true;
+}
+
+bool dmx_merge_disable(dmx_port_t output) {
+  DMX_CHECK(output < DMX_NUM_MAX, false, "output error");
+  DMX_CHECK(dmx_merge_is_enabled(output), false, "merge is not enabled");
+
+  dmx_merge_t *const merge = dmx_merge_context[output];
+  dmx_merge_context[output] = NULL;
+  dmx_merge_free(merge, merge->num_inputs);
+
+  return true;
+}
+
+dmx_port_t dmx_merge_get_output(dmx_port_t dmx_num) {
+  for (dmx_port_t output = 0; output < DMX_NUM_MAX; ++output) {
+    const dmx_merge_t *const merge = dmx_merge_context[output];
+    if (merge == NULL) {
+      continue;
+    } else if (output == dmx_num) {
+      return output;
+    }
+    for (int i = 0; i < merge->num_inputs; ++i) {
+      if (merge->inputs[i].dmx_num == dmx_num) {
+        return output;
+      }
+    }
+  }
+
+  return DMX_NUM_MAX;
+}
+
+bool dmx_merge_is_enabled(dmx_port_t output) {
+  return output < DMX_NUM_MAX && dmx_merge_context[output] != NULL;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file dmx/merge.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains functions which merge DMX data from several
+ * sources into a single DMX universe. Buffers may be merged directly with
+ * dmx_merge_htp(), or the DMX merge engine may be enabled to merge the packets
+ * received on several DMX ports into the packets sent by another DMX port.
+ */
+#pragma once
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The rules which are used by the DMX merge engine to merge slots.*/
+typedef enum dmx_merge_mode_t {
+  /** @brief Highest takes precedence. Each slot is the highest value of that
+     slot among the active sources.*/
+  DMX_MERGE_HTP = 0,
+  /** @brief Latest takes precedence. Each slot is the value of the source
+     which changed that slot most recently.*/
+  DMX_MERGE_LTP,
+  /** @brief Only the active sources with the highest priority are merged.
+     Sources with equal priority are merged using highest takes precedence.*/
+  DMX_MERGE_PRIORITY,
+} dmx_merge_mode_t;
+
+/** @brief The length of time in microseconds after which a DMX port which has
+ * not received a DMX packet is no longer merged.*/
+#define DMX_MERGE_SOURCE_TIMEOUT_US 1000000
+
+/**
+ * @brief Merges several buffers into a destination buffer using highest takes
+ * precedence. The destination buffer may also be one of the source buffers.
+ * The buffers are compared four slots at a time using 32-bit SIMD within a
+ * register when they are 32-bit aligned.
+ *
+ * @param[out] destination The buffer into which the merged data is written.
+ * @param[in] sources An array of buffers to merge.
+ * @param num_sources The number of buffers in the array.
+ * @param size The number of bytes to merge.
+ * @return The number of bytes merged into the destination buffer.
+ */
+size_t dmx_merge_htp(void *destination, const void *const *sources,
+                     int num_sources, size_t size);
+
+/**
+ * @brief Enables the DMX merge engine on an output DMX port. A task is created
+ * for each input DMX port which receives DMX packets with the null start code.
+ * As soon as a packet is received, the packets of the active inputs are merged
+ * and written to the output DMX port. If the output DMX port is not
+ * auto-refreshing, the merged packet is also sent. Inputs which have not
+ * received a packet within DMX_MERGE_SOURCE_TIMEOUT_US are not merged.
+ *
+ * @note dmx_receive() must not be called on the input DMX ports while the DMX
+ * merge engine is enabled. If the redundant input mode is enabled with an
+ * input as its primary, the packets of that input are received from whichever
+ * of its DMX ports is active. Its backup must not also be an input.
+ *
+ * @param output The DMX port number to which merged packets are written.
+ * @param[in] inputs An array of the DMX port numbers which are merged.
+ * @param[in] priorities An optional array of the priority of each input. This
+ * is only used with DMX_MERGE_PRIORITY. If NULL, every input has the same
+ * priority.
+ * @param num_inputs The number of inputs in the array.
+ * @param mode The rule to merge slots with, one of dmx_merge_mode_t.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_merge_enable(dmx_port_t output, const dmx_port_t *inputs,
+                      const uint8_t *priorities, int num_inputs,
+                      dmx_merge_mode_t mode);
+
+/**
+ * @brief Disables the DMX merge engine on an output DMX port. This function
+ * blocks until the tasks of the DMX merge engine have stopped.
+ *
+ * @param output The DMX port number to which merged packets are written.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_merge_disable(dmx_port_t output);
+
+/**
+ * @brief Checks if the DMX merge engine is enabled on an output DMX port.
+ *
+ * @param output The DMX port number to which merged packets are written.
+ * @return true if the DMX merge engine is enabled.
+ * @return false if it is not.
+ */
+bool dmx_merge_is_enabled(dmx_port_t output);
+
+/**
+ * @brief Gets the output DMX port of the DMX merge engine which uses a DMX
+ * port, either as its output or as one of its inputs.
+ *
+ * @param dmx_num The DMX port number.
+ * @return The output DMX port number of the DMX merge engine or DMX_NUM_MAX if
+ * the DMX port is not used by a DMX merge engine.
+ */
+dmx_port_t dmx_merge_get_output(dmx_port_t dmx_num);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,24 +3,40 @@
 #include <string.h>
 
 #include "dmx/hal/include/nvs.h"
+#include "dmx/include/device.h"
 #include "dmx/include/driver.h"
 #include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "rdm/include/driver.h"
 
+#ifdef CONFIG_DMX_NVS_COMMIT_DEBOUNCE_MS
+/** @brief The length of time in milliseconds to wait after a non-volatile
+ * parameter is staged before committing all staged parameters.*/
+#define DMX_NVS_COMMIT_DEBOUNCE_MS CONFIG_DMX_NVS_COMMIT_DEBOUNCE_MS
+#else
+/** @brief The length of time in milliseconds to wait after a non-volatile
+ * parameter is staged before committing all staged parameters.*/
+#define DMX_NVS_COMMIT_DEBOUNCE_MS 100
+#endif
+
+enum {
+  DMX_NVS_BATCH_SIZE = 16,  // The number of parameters committed per batch.
+  DMX_COMMIT_TASK_STACK_SIZE = 3072,  // The commit task stack in bytes.
+  DMX_COMMIT_RETRY_MS = 1000,  // The delay before a deferred commit retries.
+};
+
+static struct dmx_commit_engine_t {
+  TaskHandle_t task;         // The handle of the background commit task.
+  esp_timer_handle_t timer;  // The debounce timer which wakes the task.
+  SemaphoreHandle_t mux;     // Prevents commits while a driver is deleted.
+} dmx_commit_engine = {};
+
 int dmx_sub_device_get_count(dmx_port_t dmx_num) {
   assert(dmx_num < DMX_NUM_MAX);
   assert(dmx_driver_is_installed(dmx_num));
 
-  dmx_driver_t *const driver = dmx_driver[dmx_num];
-
-  int count = -1;  // Don't count root device
-  dmx_device_t *device = &driver->device.root;
-  do {
-    ++count;
-    device = device->next;
-  } while (device != NULL);
-
-  return count;
+  return dmx_driver[dmx_num]->device.sub_device_count;
 }
 
 bool dmx_sub_device_exists(dmx_port_t dmx_num, dmx_device_num_t device_num) {
@@ -49,25 +65,17 @@ rdm_pid_t dmx_parameter_at(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
   assert(sub_device < RDM_SUB_DEVICE_MAX);
   assert(dmx_driver_is_installed(dmx_num));
 
-  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  // Find the desired sub-device number
+  const dmx_device_t *device = dmx_device_get(dmx_num, sub_device);
+  if (device == NULL) {
+    return 0;  // Sub-device does not exist
+  }
 
   // Return early if the parameter index is out of bounds
-  if ((sub_device == RDM_SUB_DEVICE_ROOT &&
-       index > driver->device.parameter_count.root) ||
-      (sub_device > RDM_SUB_DEVICE_ROOT &&
-       index > driver->device.parameter_count.sub_devices)) {
+  if (index >= device->num_parameters) {
     return 0;
   }
 
-  // Find the desired sub-device number
-  dmx_device_t *device = &driver->device.root;
-  while (device->num != sub_device) {
-    device = device->next;
-    if (device == NULL) {
-      return 0;  // Sub-device does not exist
-    }
-  }
-
   return device->parameters[index].pid;
 }
 
@@ -151,54 +159,349 @@ size_t dmx_parameter_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
     size = entry->size;
   }
 
+  // Only the cached responses of the device which has the parameter are stale
+  dmx_device_t *const device = dmx_device_get(dmx_num, sub_device);
+  assert(device != NULL);
+
+  bool is_non_volatile;
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   memcpy(entry->data, source, size);
+  ++device->generation;
+  is_non_volatile = (entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE ||
+                     entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED);
   if (entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE) {
     entry->type = DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED;
     ++dmx_driver[dmx_num]->device.parameter_count.staged;
   }
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
+  // Restart the debounce window so that bursts of writes are committed at once
+  if (is_non_volatile && dmx_commit_engine.timer != NULL) {
+    esp_timer_stop(dmx_commit_engine.timer);
+    esp_timer_start_once(dmx_commit_engine.timer,
+                         DMX_NVS_COMMIT_DEBOUNCE_MS * 1000);
+  }
+
   return size;
 }
 
-rdm_pid_t dmx_parameter_commit(dmx_port_t dmx_num) {
+size_t dmx_parameter_set_all(dmx_port_t dmx_num, rdm_pid_t pid,
+                             const void *source, size_t size) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(pid > 0);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  // Return early if there is nothing to write
+  if (source == NULL || size == 0) {
+    return 0;
+  }
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Write the parameter of every sub-device in a single pass
+  size_t num_written = 0;
+  bool is_non_volatile = false;
+  for (int d = 0; d < driver->device.sub_device_table_size || d == 0; ++d) {
+    dmx_parameter_t *const entry = dmx_parameter_get_entry(dmx_num, d, pid);
+    if (entry == NULL) {
+      continue;  // Sub-device or parameter does not exist
+    }
+    assert(entry->data != NULL);
+    const size_t entry_size = size < entry->size ? size : entry->size;
+
+    dmx_device_t *const device = dmx_device_get(dmx_num, d);
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    memcpy(entry->data, source, entry_size);
+    ++device->generation;
+    if (entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE) {
+      entry->type = DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED;
+      ++driver->device.parameter_count.staged;
+    }
+    if (entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED) {
+      is_non_volatile = true;
+    }
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    ++num_written;
+  }
+  if (num_written == 0) {
+    return 0;
+  }
+
+  // Stage every sub-device in the same debounce window so they commit at once
+  if (is_non_volatile && dmx_commit_engine.timer != NULL) {
+    esp_timer_stop(dmx_commit_engine.timer);
+    esp_timer_start_once(dmx_commit_engine.timer,
+                         DMX_NVS_COMMIT_DEBOUNCE_MS * 1000);
+  }
+
+  return num_written;
+}
+
+#ifdef CONFIG_DMX_NVS_LAZY_RESTORE
+static bool dmx_parameter_restore_is_valid(dmx_port_t dmx_num, rdm_pid_t pid,
+                                           const void *data) {
+  // Apply the checks which are made when parameters are restored on install
+  if (pid == RDM_PID_DMX_PERSONALITY) {
+    const rdm_dmx_personality_t *const personality = data;
+    return personality->count == dmx_get_personality_count(dmx_num) &&
+           personality->current > 0 &&
+           personality->current <= personality->count;
+  } else if (pid == RDM_PID_DMX_START_ADDRESS) {
+    uint16_t dmx_start_address;
+    memcpy(&dmx_start_address, data, sizeof(dmx_start_address));
+    const uint8_t personality_num = dmx_get_current_personality(dmx_num);
+    const size_t footprint =
+        personality_num > 0 ? dmx_get_footprint(dmx_num, personality_num) : 0;
+    return dmx_start_address > 0 &&
+           dmx_start_address + footprint <= DMX_PACKET_SIZE_MAX;
+  }
+
+  return true;
+}
+
+void dmx_parameter_restore(dmx_port_t dmx_num) {
   assert(dmx_num < DMX_NUM_MAX);
   assert(dmx_driver_is_installed(dmx_num));
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  if (!driver->device.restore_is_pending) {
+    xSemaphoreGiveRecursive(driver->mux);
+    return;  // Another task already restored the parameters
+  }
+  driver->device.restore_is_pending = false;
+
+  // Restore in PID order so that the DMX personality precedes the address
+  dmx_nvs_entry_t keys[DMX_NVS_BATCH_SIZE];
+  const size_t num = dmx_nvs_take_deferred(dmx_num, keys, DMX_NVS_BATCH_SIZE);
+  for (size_t i = 1; i < num; ++i) {
+    const dmx_nvs_entry_t key = keys[i];
+    size_t j = i;
+    for (; j > 0 && keys[j - 1].pid > key.pid; --j) {
+      keys[j] = keys[j - 1];
+    }
+    keys[j] = key;
+  }
+
+  dmx_nvs_load_begin(dmx_num, false);
+  for (size_t i = 0; i < num; ++i) {
+    dmx_parameter_t *const entry =
+        dmx_parameter_get_entry(dmx_num, keys[i].sub_device, keys[i].pid);
+    uint8_t data[RDM_PD_SIZE_MAX];
+    if (entry == NULL || entry->size != keys[i].size ||
+        entry->size > sizeof(data) ||
+        entry->type != DMX_PARAMETER_TYPE_NON_VOLATILE) {
+      continue;  // The parameter was removed or has been set since install
+    }
+    if (dmx_nvs_get(dmx_num, keys[i].sub_device, keys[i].pid, data,
+                    entry->size) != entry->size ||
+        !dmx_parameter_restore_is_valid(dmx_num, keys[i].pid, data)) {
+      continue;  // Keep the default value
+    }
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    memcpy(entry->data, data, entry->size);
+    ++driver->device.generation;
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  }
+  dmx_nvs_load_end(dmx_num);
+
+  xSemaphoreGiveRecursive(driver->mux);
+}
+#endif
+
+static size_t dmx_parameter_collect_staged(dmx_port_t dmx_num,
+                                           dmx_nvs_entry_t *entries,
+                                           size_t max) {
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
 
   // Guard against unnecessarily iterating through all parameters
   if (driver->device.parameter_count.staged == 0) {
     return 0;
   }
 
-  rdm_sub_device_t sub_device;
-  rdm_pid_t pid = 0;
-  void *data = NULL;
-
-  // Iterate through parameters and commit the first found value to NVS
-  dmx_device_t *device = &driver->device.root;
-  for (; device != NULL && pid == 0; device = device->next) {
+  // Iterate through parameters and collect the staged values
+  size_t num = 0;
+  for (int d = 0; d < driver->device.sub_device_table_size || d == 0; ++d) {
+    dmx_device_t *device = d == RDM_SUB_DEVICE_ROOT
+                               ? &driver->device.root
+                               : driver->device.sub_devices[d];
+    if (device == NULL) {
+      continue;  // Sub-device does not exist
+    }
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-    for (int i = 0; i < driver->device.parameter_count.root; ++i) {
-      if (device->parameters[i].type ==
-          DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED) {
-        device->parameters[i].type = DMX_PARAMETER_TYPE_NON_VOLATILE;
+    for (int i = 0; i < device->num_parameters && num < max; ++i) {
+      dmx_parameter_t *const parameter = &device->parameters[i];
+      if (parameter->type == DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED) {
+        parameter->type = DMX_PARAMETER_TYPE_NON_VOLATILE;
         --driver->device.parameter_count.staged;
-        sub_device = device->num;
-        pid = device->parameters[i].pid;
-        data = device->parameters[i].data;
-        break;
+        entries[num].dmx_num = dmx_num;
+        entries[num].sub_device = device->num;
+        entries[num].pid = parameter->pid;
+        entries[num].data = parameter->data;
+        entries[num].size = parameter->size;
+        ++num;
       }
     }
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    if (num == max) {
+      break;
+    }
   }
 
-  if (pid > 0) {
-    dmx_nvs_set(dmx_num, sub_device, pid, data,
-                dmx_parameter_size(dmx_num, sub_device, pid));
+  return num;
+}
+
+static void dmx_parameter_restage(const dmx_nvs_entry_t *entries, size_t num) {
+  for (size_t i = 0; i < num; ++i) {
+    const dmx_port_t dmx_num = entries[i].dmx_num;
+    dmx_parameter_t *const entry = dmx_parameter_get_entry(
+        dmx_num, entries[i].sub_device, entries[i].pid);
+    if (entry == NULL) {
+      continue;  // The parameter was removed while it was being committed
+    }
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    if (entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE) {
+      entry->type = DMX_PARAMETER_TYPE_NON_VOLATILE_STAGED;
+      ++dmx_driver[dmx_num]->device.parameter_count.staged;
+    }
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  }
+}
+
+static int dmx_parameter_commit_ports(dmx_port_t first, dmx_port_t end) {
+  // Size the batch so that every staged parameter is written in one NVS commit
+  size_t max = 0;
+  bool is_static = false;
+  for (dmx_port_t i = first; i < end; ++i) {
+    if (dmx_driver_is_installed(i)) {
+      max += dmx_driver[i]->device.parameter_count.staged;
+      is_static |= dmx_driver[i]->arena.is_static;
+    }
+  }
+  dmx_nvs_entry_t batch[DMX_NVS_BATCH_SIZE];
+  dmx_nvs_entry_t *entries = NULL;
+  if (max > DMX_NVS_BATCH_SIZE && !is_static) {
+    entries = heap_caps_malloc(sizeof(dmx_nvs_entry_t) * max, MALLOC_CAP_8BIT);
   }
+  if (entries == NULL) {
+    entries = batch;  // Fall back to committing in several smaller batches
+    max = DMX_NVS_BATCH_SIZE;
+  }
+
+  int committed = 0;
+  bool more_remaining;
+  do {
+    size_t num = 0;
+    more_remaining = false;
+    for (dmx_port_t i = first; i < end; ++i) {
+      if (dmx_driver_is_installed(i)) {
+        num += dmx_parameter_collect_staged(i, &entries[num], max - num);
+        if (num == max) {
+          more_remaining = true;
+          break;
+        }
+      }
+    }
+    const size_t written = dmx_nvs_set_many(entries, num);
+    committed += written;
+    if (written < num) {
+      // Keep the unwritten parameters staged for the next commit
+      dmx_parameter_restage(entries + written, num - written);
+      break;
+    }
+  } while (more_remaining);
+
+  if (entries != batch) {
+    heap_caps_free(entries);
+  }
+
+  return committed;
+}
+
+int dmx_parameter_commit(dmx_port_t dmx_num) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  return dmx_parameter_commit_ports(dmx_num, dmx_num + 1);
+}
+
+static bool dmx_parameter_commit_is_deferred() {
+#ifndef DMX_ISR_IN_IRAM
+  // Auto-refreshing DMX drivers cannot be disabled while the flash is written
+  for (dmx_port_t i = 0; i < DMX_NUM_MAX; ++i) {
+    if (dmx_driver_is_installed(i) && dmx_auto_refresh_is_enabled(i)) {
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+static void dmx_parameter_commit_task(void *arg) {
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    // Coalesce the staged parameters of every DMX port into one NVS commit
+    bool is_staged = false;
+    xSemaphoreTake(dmx_commit_engine.mux, portMAX_DELAY);
+    if (!dmx_parameter_commit_is_deferred()) {
+      dmx_parameter_commit_ports(0, DMX_NUM_MAX);
+    }
+    for (dmx_port_t i = 0; i < DMX_NUM_MAX; ++i) {
+      if (dmx_driver_is_installed(i) &&
+          dmx_driver[i]->device.parameter_count.staged > 0) {
+        is_staged = true;
+      }
+    }
+    xSemaphoreGive(dmx_commit_engine.mux);
+
+    // Retry later, which fails if an update has already restarted the timer
+    if (is_staged) {
+      esp_timer_start_once(dmx_commit_engine.timer, DMX_COMMIT_RETRY_MS * 1000);
+    }
+  }
+}
+
+static void dmx_parameter_commit_timer_cb(void *arg) {
+  xTaskNotifyGive(dmx_commit_engine.task);
+}
+
+bool dmx_parameter_commit_init() {
+  if (dmx_commit_engine.task != NULL) {
+    return true;  // The commit engine is already running
+  }
+
+  dmx_commit_engine.mux = xSemaphoreCreateMutex();
+  if (dmx_commit_engine.mux == NULL) {
+    return false;
+  }
+  if (!xTaskCreate(dmx_parameter_commit_task, "dmx_commit",
+                   DMX_COMMIT_TASK_STACK_SIZE, NULL, tskIDLE_PRIORITY + 1,
+                   &dmx_commit_engine.task)) {
+    vSemaphoreDelete(dmx_commit_engine.mux);
+    dmx_commit_engine.task = NULL;
+    return false;
+  }
+  const esp_timer_create_args_t timer_args = {
+      .callback = dmx_parameter_commit_timer_cb, .name = "dmx_commit"};
+  if (esp_timer_create(&timer_args, &dmx_commit_engine.timer) != ESP_OK) {
+    vTaskDelete(dmx_commit_engine.task);
+    vSemaphoreDelete(dmx_commit_engine.mux);
+    dmx_commit_engine.task = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+bool dmx_parameter_commit_lock() {
+  if (dmx_commit_engine.mux == NULL) {
+    return false;
+  }
+
+  return xSemaphoreTake(dmx_commit_engine.mux, portMAX_DELAY);
+}
 
-  return pid;
+void dmx_parameter_commit_unlock() {
+  xSemaphoreGive(dmx_commit_engine.mux);
 }
@@ -2,22 +2,293 @@
 
 #include <string.h>
 
+#include "dmx/hal/include/timer.h"
+#include "dmx/hal/include/uart.h"
 #include "dmx/include/driver.h"
 
+void DMX_ISR_ATTR dmx_turnaround_record(dmx_driver_t *driver, int64_t now) {
+  const int64_t elapsed = now - driver->dmx.controller_eop_timestamp;
+  const uint32_t turnaround_us = elapsed > 0 ? elapsed : 0;
+
+  dmx_turnaround_t *const turnaround = &driver->turnaround;
+  turnaround->last_us = turnaround_us;
+  if (turnaround->count == 0 || turnaround_us < turnaround->min_us) {
+    turnaround->min_us = turnaround_us;
+  }
+  if (turnaround_us > turnaround->max_us) {
+    turnaround->max_us = turnaround_us;
+  }
+  ++turnaround->count;
+
+  dmx_trace_record(driver, DMX_TRACE_EVENT_RESPONSE, now);
+}
+
+void DMX_ISR_ATTR dmx_stats_count_packet(dmx_driver_t *driver, bool is_rx,
+                                         int64_t now) {
+  struct dmx_driver_stats_t *const stats = &driver->stats;
+  int64_t *window_start;
+  uint32_t *window_packets;
+  uint32_t *packets_per_second;
+  if (is_rx) {
+    ++stats->counters.rx_packets;
+    window_start = &stats->rx_window_start;
+    window_packets = &stats->rx_window_packets;
+    packets_per_second = &stats->counters.rx_packets_per_second;
+  } else {
+    ++stats->counters.tx_packets;
+    window_start = &stats->tx_window_start;
+    window_packets = &stats->tx_window_packets;
+    packets_per_second = &stats->counters.tx_packets_per_second;
+  }
+
+  // Publish the packet count once every second
+  ++*window_packets;
+  if (now - *window_start >= 1000000) {
+    *packets_per_second = *window_packets;
+    *window_packets = 0;
+    *window_start = now;
+  }
+}
+
+void DMX_ISR_ATTR dmx_sync_group_sent(dmx_port_t dmx_num, int64_t now) {
+  taskENTER_CRITICAL_ISR(&dmx_sync_group.spinlock);
+  dmx_sync_group.pending &= ~(1 << dmx_num);
+  const bool group_is_done =
+      dmx_sync_group.pending == 0 && dmx_sync_group.members != 0;
+  const dmx_port_t leader = dmx_sync_group.leader;
+  taskEXIT_CRITICAL_ISR(&dmx_sync_group.spinlock);
+  if (!group_is_done) {
+    return;  // Wait for the rest of the group to finish sending
+  }
+
+  // Schedule the next packet of the group on the timer of the leader
+  const dmx_driver_t *const driver = dmx_driver[leader];
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(leader));
+  const int64_t elapsed = now - driver->auto_refresh.frame_start_ts;
+  const int64_t remaining = driver->auto_refresh.period - elapsed;
+  dmx_timer_set_counter(leader, 0);
+  dmx_timer_set_alarm(leader, remaining > 0 ? remaining : 1, false);
+  dmx_timer_start(leader);
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(leader));
+}
+
+void DMX_ISR_ATTR dmx_repeater_write(dmx_driver_t *output) {
+  const dmx_port_t dmx_num = output->dmx_num;
+
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  const dmx_port_t input_num = output->repeater.input;
+  if (input_num < DMX_NUM_MAX &&
+      output->dmx.progress == DMX_PROGRESS_IN_DATA) {
+    const dmx_driver_t *const input = dmx_driver[input_num];
+    const uint8_t *const rx_data = DMX_LOAD(input->dmx.rx_data);
+    int input_head = DMX_LOAD(input->dmx.head);
+    if (input_head > dmx_packet_size_max(output)) {
+      input_head = dmx_packet_size_max(output);
+    }
+
+    if (output->dmx.head == 0 && input_head > 0 &&
+        dmx_start_code_is_rdm(rx_data[0])) {
+      output->dmx.progress = DMX_PROGRESS_STALE;  // RDM is not repeated
+    } else if (input_head > output->dmx.head) {
+      // Slots which do not fit in the TX FIFO are written on the next call
+      int write_len = input_head - output->dmx.head;
+      dmx_uart_write_txfifo(dmx_num, &rx_data[output->dmx.head], &write_len);
+      output->dmx.head += write_len;
+      output->dmx.size = output->dmx.head;
+    }
+  }
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+}
+
+void DMX_ISR_ATTR dmx_repeater_forward(dmx_driver_t *driver, int prev_head,
+                                       int64_t now) {
+  const uint32_t outputs = DMX_LOAD(driver->repeater.outputs);
+  const bool is_rdm = dmx_start_code_is_rdm(driver->dmx.rx_data[0]);
+
+  for (int i = 0; i < DMX_NUM_MAX; ++i) {
+    if (!(outputs & (1u << i))) {
+      continue;
+    }
+    dmx_driver_t *const output = dmx_driver[i];
+    if (prev_head > 0) {
+      dmx_repeater_write(output);
+      continue;
+    }
+
+    // Start the next packet when the start code of the input is received
+    taskENTER_CRITICAL_ISR(DMX_SPINLOCK(i));
+    if (output->repeater.input != driver->dmx_num) {
+      taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(i));
+      continue;  // The output is being removed from the DMX repeater
+    }
+    if (output->dmx.status == DMX_STATUS_SENDING && output->dmx.head > 0) {
+      dmx_stats_count_packet(output, false, now);
+    }
+    output->dmx.head = 0;
+    output->dmx.size = 0;
+    if (is_rdm) {
+      output->dmx.progress = DMX_PROGRESS_STALE;  // RDM is not repeated
+      output->dmx.status = DMX_STATUS_IDLE;
+      dmx_timer_stop(i);
+      dmx_uart_invert_tx(i, 0);  // End a DMX break which may have started
+    } else {
+      output->dmx.status = DMX_STATUS_SENDING;
+      dmx_timer_set_counter(i, 0);
+
+      // Wait for the previous packet to leave the UART before the DMX break
+      const int pending = SOC_UART_FIFO_LEN - dmx_uart_get_txfifo_len(i);
+      if (pending > 0) {
+        output->dmx.progress = DMX_PROGRESS_IN_TURNAROUND;
+        dmx_timer_set_alarm(i, (pending + 1) * DMX_SLOT_LEN_US, false);
+      } else {
+        output->dmx.progress = DMX_PROGRESS_IN_BREAK;
+        dmx_timer_set_alarm(i, output->break_len, true);
+#ifdef CONFIG_DMX_RS485_HALF_DUPLEX
+        dmx_uart_set_rts(i, 0);
+#endif
+        dmx_uart_invert_tx(i, 1);
+      }
+      dmx_timer_start(i);
+    }
+    taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(i));
+  }
+}
+
+void *dmx_alloc(dmx_port_t dmx_num, size_t size) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  struct dmx_driver_arena_t *const arena = &dmx_driver[dmx_num]->arena;
+
+  // Keep allocations aligned so that they may store any parameter type
+  const size_t align = sizeof(uint64_t);
+  const size_t aligned_size = (size + align - 1) & ~(align - 1);
+  if (arena->base != NULL && arena->size - arena->used >= aligned_size) {
+    void *ptr = arena->base + arena->used;
+    arena->used += aligned_size;
+    return ptr;
+  }
+
+  // Statically installed drivers must not use the heap
+  if (arena->is_static) {
+    return NULL;
+  }
+
+  return malloc(size);
+}
+
+void dmx_free(dmx_port_t dmx_num, void *ptr) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  const struct dmx_driver_arena_t *const arena = &dmx_driver[dmx_num]->arena;
+
+  if (arena->base != NULL && (uint8_t *)ptr >= arena->base &&
+      (uint8_t *)ptr < arena->base + arena->size) {
+    return;  // Arena memory is freed when the DMX driver is deleted
+  }
+
+  free(ptr);
+}
+
 dmx_device_t *dmx_device_get(dmx_port_t dmx_num, dmx_device_num_t device_num) {
   assert(dmx_num < DMX_NUM_MAX);
   assert(device_num < RDM_SUB_DEVICE_MAX);
   assert(dmx_driver_is_installed(dmx_num));
 
-  dmx_device_t *device = &dmx_driver[dmx_num]->device.root;
-  while (device->num != device_num) {
-    device = device->next;
-    if (device == NULL) {
-      return NULL;  // Sub-device does not exist
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  if (device_num == RDM_SUB_DEVICE_ROOT) {
+    return &driver->device.root;
+  } else if (device_num >= driver->device.sub_device_table_size) {
+    return NULL;  // Sub-device does not exist
+  }
+
+  return driver->device.sub_devices[device_num];
+}
+
+bool dmx_device_add(dmx_port_t dmx_num, dmx_device_num_t device_num) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(device_num > RDM_SUB_DEVICE_ROOT && device_num < RDM_SUB_DEVICE_MAX);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  if (dmx_device_get(dmx_num, device_num) != NULL) {
+    return true;  // Sub-device already exists
+  }
+
+  // Grow the sub-device table geometrically so that it can be directly indexed
+  if (device_num >= driver->device.sub_device_table_size) {
+    const int old_size = driver->device.sub_device_table_size;
+    int table_size = old_size > 0 ? old_size * 2 : 8;
+    if (table_size <= device_num) {
+      table_size = device_num + 1;
+    }
+    if (table_size > RDM_SUB_DEVICE_MAX) {
+      table_size = RDM_SUB_DEVICE_MAX;
+    }
+    dmx_device_t **table =
+        dmx_alloc(dmx_num, sizeof(dmx_device_t *) * table_size);
+    if (table == NULL) {
+      DMX_ERR("sub-device table malloc error");
+      return false;
+    }
+    if (old_size > 0) {
+      memcpy(table, driver->device.sub_devices,
+             sizeof(dmx_device_t *) * old_size);
+    }
+    for (int i = old_size; i < table_size; ++i) {
+      table[i] = NULL;
+    }
+
+    // The DMX ISR may be indexing the old table until it is swapped out
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    dmx_device_t **const old_table = driver->device.sub_devices;
+    driver->device.sub_devices = table;
+    driver->device.sub_device_table_size = table_size;
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    dmx_free(dmx_num, old_table);
+  }
+
+  // Allocate the sub-device and its parameters
+  const uint32_t parameter_count = driver->device.parameter_count.sub_devices;
+  dmx_device_t *device = dmx_alloc(
+      dmx_num, sizeof(dmx_device_t) + sizeof(dmx_parameter_t) * parameter_count);
+  if (device == NULL) {
+    DMX_ERR("sub-device malloc error");
+    return false;
+  }
+  device->num = device_num;
+  device->generation = 0;
+  device->num_parameters = 0;
+  for (int i = 0; i < parameter_count; ++i) {
+    device->parameters[i].pid = 0;
+  }
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->device.sub_devices[device_num] = device;
+  ++driver->device.sub_device_count;
+  ++driver->device.generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+static int dmx_parameter_search(const dmx_device_t *device, rdm_pid_t pid) {
+  // Binary search for the index of the first parameter with a PID >= pid
+  int lower = 0;
+  int upper = device->num_parameters;
+  while (lower < upper) {
+    const int mid = (lower + upper) / 2;
+    if (device->parameters[mid].pid < pid) {
+      lower = mid + 1;
+    } else {
+      upper = mid;
     }
   }
 
-  return device;
+  return lower;
 }
 
 bool dmx_parameter_add(dmx_port_t dmx_num, dmx_device_num_t device_num,
@@ -35,50 +306,62 @@ bool dmx_parameter_add(dmx_port_t dmx_num, dmx_device_num_t device_num,
     return false;  // Device does not exist
   }
 
-  // Iterate through parameters until an empty parameter is found
+  // Find where the parameter belongs in the sorted parameter array
+  const int index = dmx_parameter_search(device, pid);
+  if (index < device->num_parameters && device->parameters[index].pid == pid) {
+    return true;  // Parameter already exists
+  }
   const uint32_t parameter_count =
       device_num == RDM_SUB_DEVICE_ROOT
           ? driver->device.parameter_count.root
           : driver->device.parameter_count.sub_devices;
-  for (int i = 0; i < parameter_count; ++i) {
-    if (device->parameters[i].pid == pid) {
-      return true;  // Parameter already exists
-    } else if (device->parameters[i].pid == 0) {
-      // Initialize parameter memory
-      switch (type) {
-        case DMX_PARAMETER_TYPE_DYNAMIC:
-        case DMX_PARAMETER_TYPE_NON_VOLATILE:
-          device->parameters[i].data = malloc(size);
-          if (device->parameters[i].data == NULL) {
-            DMX_ERR("parameter malloc error");
-            return false;
-          }
-          if (data == NULL) {
-            memset(device->parameters[i].data, 0, size);
-          } else {
-            memcpy(device->parameters[i].data, data, size);
-          }
-          break;
-        case DMX_PARAMETER_TYPE_STATIC:
-          device->parameters[i].data = data;
-          break;
-        case DMX_PARAMETER_TYPE_NULL:
-          device->parameters[i].data = NULL;
-          break;
-        default:
-          return false;
-      }
+  if (device->num_parameters >= parameter_count) {
+    return false;  // No more parameters available on this sub-device
+  }
 
-      device->parameters[i].pid = pid;
-      device->parameters[i].size = size;
-      device->parameters[i].type = type;
-      device->parameters[i].definition = NULL;
-      device->parameters[i].callback = NULL;
-      return true;
-    }
+  // Initialize parameter memory
+  void *parameter_data;
+  switch (type) {
+    case DMX_PARAMETER_TYPE_DYNAMIC:
+    case DMX_PARAMETER_TYPE_NON_VOLATILE:
+      parameter_data = dmx_alloc(dmx_num, size);
+      if (parameter_data == NULL) {
+        DMX_ERR("parameter malloc error");
+        return false;
+      }
+      if (data == NULL) {
+        memset(parameter_data, 0, size);
+      } else {
+        memcpy(parameter_data, data, size);
+      }
+      break;
+    case DMX_PARAMETER_TYPE_STATIC:
+      parameter_data = data;
+      break;
+    case DMX_PARAMETER_TYPE_NULL:
+      parameter_data = NULL;
+      break;
+    default:
+      return false;
   }
 
-  return false;  // No more parameters available on this sub-device
+  // Shift the parameters with greater PIDs while the DMX ISR cannot search
+  dmx_parameter_t *const entry = &device->parameters[index];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  memmove(entry + 1, entry,
+          sizeof(dmx_parameter_t) * (device->num_parameters - index));
+  ++device->num_parameters;
+
+  entry->pid = pid;
+  entry->size = size;
+  entry->data = parameter_data;
+  entry->type = type;
+  entry->definition = NULL;
+  entry->callback = NULL;
+  entry->response = NULL;
+  ++driver->device.generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  return true;
 }
 
 dmx_parameter_t *dmx_parameter_get_entry(dmx_port_t dmx_num,
@@ -94,17 +377,17 @@ dmx_parameter_t *dmx_parameter_get_entry(dmx_port_t dmx_num,
     return NULL;  // Sub-device does not exist
   }
 
-  // Get the parameter count for the requested device
-  const int param_count =
-      (device_num == RDM_SUB_DEVICE_ROOT)
-          ? dmx_driver[dmx_num]->device.parameter_count.root
-          : dmx_driver[dmx_num]->device.parameter_count.sub_devices;
-
-  // Iterate the device's parameters
-  for (int i = 0; i < param_count; ++i) {
-    if (device->parameters[i].pid == pid) {
-      return &device->parameters[i];
+  // Binary search the device's parameters
+  const int index = dmx_parameter_search(device, pid);
+  if (index < device->num_parameters && device->parameters[index].pid == pid) {
+    dmx_parameter_t *const entry = &device->parameters[index];
+#ifdef CONFIG_DMX_NVS_LAZY_RESTORE
+    if (dmx_driver[dmx_num]->device.restore_is_pending &&
+        entry->type == DMX_PARAMETER_TYPE_NON_VOLATILE) {
+      dmx_parameter_restore(dmx_num);
     }
+#endif
+    return entry;
   }
 
   return NULL;  // Parameter does not exist
@@ -0,0 +1,354 @@
+#ifdef CONFIG_DMX_SINK_ENABLE
+#include "dmx/sink.h"
+
+#include <string.h>
+
+#include "dmx/hal/include/timer.h"
+#include "dmx/include/device.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+
+enum {
+  DMX_SINK_TASK_STACK_SIZE = 3072,  // The sink task stack in bytes.
+  DMX_SINK_WS2812_T0H_NS = 300,     // The high time of a WS2812 zero bit.
+  DMX_SINK_WS2812_T1H_NS = 900,     // The high time of a WS2812 one bit.
+  DMX_SINK_WS2812_BIT_NS = 1200,    // The length of a WS2812 bit.
+  DMX_SINK_WS2812_RESET_US = 300,   // The low time which latches WS2812 LEDs.
+  DMX_SINK_APA102_START_SIZE = 4,   // The zero bytes of the APA102 start frame.
+  DMX_SINK_APA102_END_SIZE_MIN = 4,  // The fewest bytes of the end frame.
+};
+
+typedef struct dmx_sink_t {
+  SemaphoreHandle_t stopped;  // Is given by the sink task when it stops.
+  dmx_port_t dmx_num;         // The DMX port which feeds the sink.
+  dmx_sink_config_t config;   // The configuration of the sink.
+  uint8_t *slots;             // The slots which were copied from the driver.
+  uint8_t *frames[2];         // The frames which are written alternately.
+  size_t frame_size;          // The size of each frame in bytes.
+  int index;                  // The index of the next frame to write.
+  bool is_pending;            // True while a frame is written by DMA.
+  rmt_encoder_handle_t encoder;  // The WS2812 encoder of RMT sinks.
+  int64_t idle_ts;  // The time after which the next WS2812 frame may be sent.
+  spi_transaction_t trans[2];  // The transactions of APA102 sinks.
+  volatile bool is_running;    // False when the sink task should stop.
+} dmx_sink_t;
+
+static dmx_sink_t *dmx_sink_context[DMX_NUM_MAX] = {};
+
+void DMX_ISR_ATTR dmx_sink_notify_from_isr(dmx_driver_t *driver, int size,
+                                           int *task_awoken) {
+  struct dmx_driver_sink_t *const sink = &driver->sink;
+  if (sink->task == NULL) {
+    return;
+  }
+  if (driver->dmx.rx_is_truncated && size > driver->dmx.size) {
+    size = driver->dmx.size;  // Slots beyond the packet size were not copied
+  }
+
+  // Only the latest packet is written if the sink is still busy
+  if (sink->is_busy) {
+    ++sink->overruns;
+  }
+  sink->is_busy = true;
+  xTaskNotifyFromISR(sink->task, size, eSetValueWithOverwrite, task_awoken);
+}
+
+static void dmx_sink_map(const dmx_sink_t *sink, uint8_t *frame) {
+  static const uint8_t orders[][3] = {{0, 1, 2}, {1, 0, 2}, {2, 1, 0}};
+  const uint8_t *const order = orders[sink->config.order];
+  const uint16_t *const table = sink->config.table;
+  const uint8_t *slots = sink->slots;
+  const int pixels = sink->config.size / 3;
+
+  // APA102 pixels begin with a brightness byte which is written on enable
+  const bool is_apa102 = sink->config.type == DMX_SINK_SPI_APA102;
+  const int stride = is_apa102 ? 4 : 3;
+  uint8_t *color = frame + (is_apa102 ? DMX_SINK_APA102_START_SIZE + 1 : 0);
+
+  if (table != NULL) {
+    for (int i = 0; i < pixels; ++i, slots += 3, color += stride) {
+      color[0] = table[slots[order[0]]] >> 8;
+      color[1] = table[slots[order[1]]] >> 8;
+      color[2] = table[slots[order[2]]] >> 8;
+    }
+  } else {
+    for (int i = 0; i < pixels; ++i, slots += 3, color += stride) {
+      color[0] = slots[order[0]];
+      color[1] = slots[order[1]];
+      color[2] = slots[order[2]];
+    }
+  }
+}
+
+static void dmx_sink_wait(dmx_sink_t *sink) {
+  if (!sink->is_pending) {
+    return;
+  }
+
+  if (sink->config.type == DMX_SINK_RMT_WS2812) {
+    rmt_tx_wait_all_done(sink->config.rmt.channel, -1);
+
+    // Busy-wait as the reset time is shorter than a FreeRTOS tick
+    while (dmx_timer_get_micros_since_boot() < sink->idle_ts) {
+      continue;
+    }
+  } else if (sink->config.type == DMX_SINK_SPI_APA102) {
+    spi_transaction_t *trans;
+    spi_device_get_trans_result(sink->config.spi.device, &trans,
+                                portMAX_DELAY);
+  }
+  sink->is_pending = false;
+}
+
+static bool dmx_sink_write(dmx_sink_t *sink, const uint8_t *frame) {
+  const dmx_sink_config_t *const config = &sink->config;
+  if (config->type == DMX_SINK_CALLBACK) {
+    return config->callback.write(frame, sink->frame_size,
+                                  config->callback.context);
+  } else if (config->type == DMX_SINK_RMT_WS2812) {
+    const rmt_transmit_config_t tx_config = {.loop_count = 0};
+    if (rmt_transmit(config->rmt.channel, sink->encoder, frame,
+                     sink->frame_size, &tx_config)) {
+      return false;
+    }
+    sink->idle_ts = dmx_timer_get_micros_since_boot() +
+                    sink->frame_size * 8 * DMX_SINK_WS2812_BIT_NS / 1000 +
+                    DMX_SINK_WS2812_RESET_US;
+  } else {
+    spi_transaction_t *const trans = &sink->trans[sink->index];
+    memset(trans, 0, sizeof(*trans));
+    trans->length = sink->frame_size * 8;
+    trans->tx_buffer = frame;
+    if (spi_device_queue_trans(config->spi.device, trans, portMAX_DELAY)) {
+      return false;
+    }
+  }
+  sink->is_pending = true;
+
+  return true;
+}
+
+static void dmx_sink_task(void *arg) {
+  dmx_sink_t *const sink = arg;
+  const dmx_port_t dmx_num = sink->dmx_num;
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  while (true) {
+    uint32_t packet_size;
+    xTaskNotifyWait(0, -1, &packet_size, portMAX_DELAY);
+    if (!sink->is_running) {
+      break;
+    }
+
+    // Find the slots of the footprint which were received
+    uint16_t first = dmx_get_start_address(dmx_num);
+    if (first == DMX_START_ADDRESS_NONE) {
+      first = 1;
+    }
+    first += sink->config.offset;
+    size_t size = sink->config.size;
+    if (first + size > packet_size) {
+      size = first < packet_size ? packet_size - first : 0;
+    }
+
+    // Copy the slots out of the DMX driver before they can be swapped
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    const uint8_t *data = driver->dmx.data;
+#if DMX_RX_BUFFER_COUNT > 2
+    if (driver->dmx.ready_is_fresh) {
+      data = driver->dmx.ready;
+    }
+#endif
+    memcpy(sink->slots, &data[first], size);
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+    // Map the frame while the previous frame is still being written
+    uint8_t *const frame = sink->frames[sink->index];
+    dmx_sink_map(sink, frame);
+    dmx_sink_wait(sink);
+    const bool written = dmx_sink_write(sink, frame);
+    sink->index ^= 1;
+
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    driver->sink.is_busy = false;
+    if (written) {
+      ++driver->sink.frames;
+    }
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  }
+  dmx_sink_wait(sink);
+
+  xSemaphoreGive(sink->stopped);
+  vTaskDelete(NULL);
+}
+
+static void dmx_sink_free(dmx_sink_t *sink) {
+  if (sink->encoder != NULL) {
+    rmt_del_encoder(sink->encoder);
+  }
+  if (sink->stopped != NULL) {
+    vSemaphoreDelete(sink->stopped);
+  }
+  heap_caps_free(sink->frames[1]);
+  heap_caps_free(sink->frames[0]);
+  heap_caps_free(sink->slots);
+  heap_caps_free(sink);
+}
+
+bool dmx_sink_enable(dmx_port_t dmx_num, const dmx_sink_config_t *config) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(config != NULL, false, "config is null");
+  DMX_CHECK(config->type <= DMX_SINK_SPI_APA102, false, "type error");
+  DMX_CHECK(config->order <= DMX_SINK_ORDER_BGR, false, "order error");
+  DMX_CHECK(config->size >= 3, false, "size error");
+  DMX_CHECK(config->type != DMX_SINK_CALLBACK ||
+                config->callback.write != NULL,
+            false, "write is null");
+  DMX_CHECK(config->type != DMX_SINK_RMT_WS2812 ||
+                config->rmt.channel != NULL,
+            false, "channel is null");
+  DMX_CHECK(config->type != DMX_SINK_RMT_WS2812 ||
+                config->rmt.resolution_hz >= 10000000,
+            false, "resolution_hz error");
+  DMX_CHECK(config->type != DMX_SINK_SPI_APA102 ||
+                config->spi.device != NULL,
+            false, "device is null");
+  DMX_CHECK(config->type != DMX_SINK_SPI_APA102 ||
+                config->spi.brightness <= 31,
+            false, "brightness error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_sink_is_enabled(dmx_num), false, "sink is already enabled");
+  DMX_CHECK(config->offset + config->size <
+                dmx_packet_size_max(dmx_driver[dmx_num]),
+            false, "size error");
+
+  // Slots which do not make up a whole pixel are not written
+  const int pixels = config->size / 3;
+  size_t frame_size = pixels * 3;
+  size_t end_size = 0;
+  if (config->type == DMX_SINK_SPI_APA102) {
+    end_size = (pixels + 15) / 16;  // Half a clock for each pixel
+    if (end_size < DMX_SINK_APA102_END_SIZE_MIN) {
+      end_size = DMX_SINK_APA102_END_SIZE_MIN;
+    }
+    frame_size = DMX_SINK_APA102_START_SIZE + pixels * 4 + end_size;
+  }
+
+  // Allocate the sink context and its buffers
+  dmx_sink_t *const sink = heap_caps_calloc(1, sizeof(*sink), MALLOC_CAP_8BIT);
+  DMX_CHECK(sink != NULL, false, "sink malloc error");
+  const uint32_t caps = config->type == DMX_SINK_SPI_APA102
+                            ? MALLOC_CAP_DMA | MALLOC_CAP_8BIT
+                            : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+  sink->slots = heap_caps_calloc(1, config->size, MALLOC_CAP_8BIT);
+  sink->frames[0] = heap_caps_calloc(1, frame_size, caps);
+  sink->frames[1] = heap_caps_calloc(1, frame_size, caps);
+  sink->stopped = xSemaphoreCreateBinary();
+  if (sink->slots == NULL || sink->frames[0] == NULL ||
+      sink->frames[1] == NULL || sink->stopped == NULL) {
+    dmx_sink_free(sink);
+    DMX_CHECK(false, false, "sink buffer malloc error");
+  }
+  sink->dmx_num = dmx_num;
+  sink->config = *config;
+  sink->frame_size = frame_size;
+  sink->is_running = true;
+
+  if (config->type == DMX_SINK_RMT_WS2812) {
+    // Let the RMT encode each bit of the pixels
+    const uint32_t resolution_hz = config->rmt.resolution_hz;
+    const uint32_t t0h =
+        (uint64_t)resolution_hz * DMX_SINK_WS2812_T0H_NS / 1000000000;
+    const uint32_t t1h =
+        (uint64_t)resolution_hz * DMX_SINK_WS2812_T1H_NS / 1000000000;
+    const uint32_t bit =
+        (uint64_t)resolution_hz * DMX_SINK_WS2812_BIT_NS / 1000000000;
+    const rmt_bytes_encoder_config_t encoder_config = {
+        .bit0 = {.level0 = 1, .duration0 = t0h, .level1 = 0,
+                 .duration1 = bit - t0h},
+        .bit1 = {.level0 = 1, .duration0 = t1h, .level1 = 0,
+                 .duration1 = bit - t1h},
+        .flags.msb_first = 1,
+    };
+    if (rmt_new_bytes_encoder(&encoder_config, &sink->encoder)) {
+      sink->encoder = NULL;
+      dmx_sink_free(sink);
+      DMX_CHECK(false, false, "sink encoder create error");
+    }
+  } else if (config->type == DMX_SINK_SPI_APA102) {
+    // The start frame, brightness bytes, and end frame are never rewritten
+    for (int f = 0; f < 2; ++f) {
+      uint8_t *const frame = sink->frames[f];
+      for (int i = 0; i < pixels; ++i) {
+        frame[DMX_SINK_APA102_START_SIZE + i * 4] =
+            0xe0 | config->spi.brightness;
+      }
+      memset(&frame[frame_size - end_size], 0xff, end_size);
+    }
+  }
+
+  TaskHandle_t task;
+  if (!xTaskCreate(dmx_sink_task, "dmx_sink", DMX_SINK_TASK_STACK_SIZE, sink,
+                   uxTaskPriorityGet(NULL), &task)) {
+    dmx_sink_free(sink);
+    DMX_CHECK(false, false, "sink task create error");
+  }
+  dmx_sink_context[dmx_num] = sink;
+
+  // Let the DMX ISR notify the sink task
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->sink.is_busy = false;
+  driver->sink.frames = 0;
+  driver->sink.overruns = 0;
+  driver->sink.task = task;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+bool dmx_sink_disable(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_sink_is_enabled(dmx_num), false, "sink is not enabled");
+
+  dmx_sink_t *const sink = dmx_sink_context[dmx_num];
+  dmx_sink_context[dmx_num] = NULL;
+
+  // Stop the DMX ISR from notifying the sink task
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const TaskHandle_t task = driver->sink.task;
+  driver->sink.task = NULL;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Wait for the sink task to finish writing the last frame
+  sink->is_running = false;
+  xTaskNotify(task, 0, eSetValueWithOverwrite);
+  xSemaphoreTake(sink->stopped, portMAX_DELAY);
+  dmx_sink_free(sink);
+
+  return true;
+}
+
+bool dmx_sink_is_enabled(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && dmx_sink_context[dmx_num] != NULL;
+}
+
+bool dmx_sink_get_stats(dmx_port_t dmx_num, dmx_sink_stats_t *stats) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+
+  if (!dmx_sink_is_enabled(dmx_num)) {
+    return false;
+  }
+
+  const dmx_driver_t *const driver = dmx_driver[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  stats->frames = driver->sink.frames;
+  stats->overruns = driver->sink.overruns;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+#endif
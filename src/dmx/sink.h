@@ -0,0 +1,163 @@
+/**
+ * @file dmx/sink.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the DMX output sinks. The task of a sink is
+ * notified directly by the DMX ISR each time a DMX packet with a null start
+ * code is received, so that the slots of a DMX footprint may be sent to an LED
+ * strip without calling dmx_receive() and dmx_read(). The slots are mapped
+ * once through an optional dimming curve and reordered into pixels, after
+ * which the pixels are encoded by the RMT or SPI peripheral with DMA. Other
+ * peripherals, such as I2S or LCD, may be fed with a user callback. DMX output
+ * sinks are only available when CONFIG_DMX_SINK_ENABLE is set.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+#include "driver/rmt_tx.h"
+#include "driver/spi_master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The peripherals to which a DMX output sink may write pixels.*/
+typedef enum dmx_sink_type_t {
+  /** @brief The pixels are passed to a user callback.*/
+  DMX_SINK_CALLBACK = 0,
+  /** @brief The pixels are sent to WS2812 LEDs on an RMT TX channel. The RMT
+     encodes the pixels so that the CPU does not have to.*/
+  DMX_SINK_RMT_WS2812,
+  /** @brief The pixels are sent to APA102 LEDs on an SPI device with DMA.*/
+  DMX_SINK_SPI_APA102,
+} dmx_sink_type_t;
+
+/** @brief The order in which the colors of each pixel are sent. The slots of
+ * each pixel are received in red, green, and blue order.*/
+typedef enum dmx_sink_order_t {
+  /** @brief Red, green, then blue.*/
+  DMX_SINK_ORDER_RGB = 0,
+  /** @brief Green, red, then blue. This is the order of most WS2812 LEDs.*/
+  DMX_SINK_ORDER_GRB,
+  /** @brief Blue, green, then red. This is the order of most APA102 LEDs.*/
+  DMX_SINK_ORDER_BGR,
+} dmx_sink_order_t;
+
+/**
+ * @brief The function which is called by the sink task of a DMX_SINK_CALLBACK
+ * sink with the pixels of each DMX packet.
+ *
+ * @param[in] data A pointer to the mapped and reordered slots. The buffer is
+ * not reused until the next call of this function has returned.
+ * @param size The number of bytes in the buffer.
+ * @param[inout] context The context which was passed in dmx_sink_config_t.
+ * @return true if the pixels were written.
+ * @return false if they were not.
+ */
+typedef bool (*dmx_sink_write_t)(const uint8_t *data, size_t size,
+                                 void *context);
+
+/** @brief Configuration settings of a DMX output sink.*/
+typedef struct dmx_sink_config_t {
+  /** @brief The peripheral to which the pixels are written.*/
+  dmx_sink_type_t type;
+  /** @brief The offset in slots of the first pixel from the DMX start address
+     of the device, or from slot 1 if the device does not have a DMX start
+     address.*/
+  uint16_t offset;
+  /** @brief The number of slots which are written. Slots which do not make up
+     a whole pixel are not written.*/
+  uint16_t size;
+  /** @brief The order in which the colors of each pixel are written.*/
+  dmx_sink_order_t order;
+  /** @brief A lookup table of DMX_CURVE_TABLE_SIZE entries through which the
+     slots are mapped, or NULL to write the slots unchanged. The table must
+     remain valid while the sink is enabled.*/
+  const uint16_t *table;
+  union {
+    /** @brief The settings of DMX_SINK_CALLBACK sinks.*/
+    struct {
+      /** @brief The function which writes the pixels.*/
+      dmx_sink_write_t write;
+      /** @brief Context for the write function.*/
+      void *context;
+    } callback;
+    /** @brief The settings of DMX_SINK_RMT_WS2812 sinks.*/
+    struct {
+      /** @brief An enabled RMT TX channel.*/
+      rmt_channel_handle_t channel;
+      /** @brief The resolution in hertz of the RMT TX channel.*/
+      uint32_t resolution_hz;
+    } rmt;
+    /** @brief The settings of DMX_SINK_SPI_APA102 sinks.*/
+    struct {
+      /** @brief An SPI device on a bus which was initialized with DMA.*/
+      spi_device_handle_t device;
+      /** @brief The global brightness of every pixel, from 0 to 31.*/
+      uint8_t brightness;
+    } spi;
+  };
+} dmx_sink_config_t;
+
+/** @brief Statistics of a DMX output sink.*/
+typedef struct dmx_sink_stats_t {
+  /** @brief The number of frames which were written.*/
+  uint32_t frames;
+  /** @brief The number of DMX packets which were received while the previous
+     frame was still being written. Only the latest of these is written.*/
+  uint32_t overruns;
+} dmx_sink_stats_t;
+
+/**
+ * @brief Enables a DMX output sink on a DMX port. A sink task is created which
+ * is notified by the DMX ISR each time a DMX packet with a null start code is
+ * received. The task copies the footprint of the sink out of the DMX driver,
+ * maps and reorders it into pixels, waits for the previous frame to finish,
+ * and starts writing the new frame. Only one sink may be enabled on each DMX
+ * port.
+ *
+ * @note The sink task is created with the priority of the calling task, which
+ * should be higher than that of the tasks which call dmx_receive(). The
+ * peripheral must not be used by anything else while the sink is enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] config The configuration of the sink.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sink_enable(dmx_port_t dmx_num, const dmx_sink_config_t *config);
+
+/**
+ * @brief Disables the DMX output sink of a DMX port. This function blocks
+ * until the last frame has been written.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sink_disable(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if a DMX output sink is enabled on a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if a DMX output sink is enabled.
+ * @return false if it is not.
+ */
+bool dmx_sink_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the statistics of the DMX output sink of a DMX port since it was
+ * enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false if a DMX output sink is not enabled.
+ */
+bool dmx_sink_get_stats(dmx_port_t dmx_num, dmx_sink_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,187 @@
+#include "dmx/sleep.h"
+
+#include "dmx/hal/include/timer.h"
+#include "dmx/hal/include/uart.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+
+#ifdef CONFIG_DMX_LIGHT_SLEEP_ENABLE
+static void DMX_ISR_ATTR dmx_sleep_resume(dmx_driver_t *driver, int64_t now) {
+  struct dmx_driver_sleep_t *const sleep = &driver->sleep;
+  const dmx_port_t dmx_num = driver->dmx_num;
+
+  // Discard the slots which arrived while asleep and wait for the next break
+  sleep->asleep_us += now - sleep->sleep_ts;
+  sleep->is_asleep = false;
+  dmx_uart_rxfifo_reset(dmx_num);
+  dmx_packet_state_write_begin(driver);
+  driver->dmx.head = DMX_HEAD_WAITING_FOR_BREAK;
+  dmx_packet_state_write_end(driver);
+  if (driver->is_enabled) {
+    dmx_uart_clear_interrupt(dmx_num, DMX_INTR_RX_ALL);
+    dmx_uart_enable_interrupt(dmx_num, DMX_INTR_RX_ALL);
+  }
+}
+
+static void dmx_sleep_wake(void *arg) {
+  dmx_driver_t *const driver = arg;
+  const dmx_port_t dmx_num = driver->dmx_num;
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  esp_pm_lock_handle_t pm_lock = driver->sleep.pm_lock;
+  const bool is_asleep = driver->sleep.is_asleep && pm_lock != NULL;
+  if (is_asleep) {
+    dmx_sleep_resume(driver, dmx_timer_get_micros_since_boot());
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Keep the UART clocked until the packet has been received
+  if (is_asleep) {
+    esp_pm_lock_acquire(pm_lock);
+  }
+}
+
+void DMX_ISR_ATTR dmx_sleep_record_frame(dmx_driver_t *driver,
+                                         bool is_refresh, int64_t now) {
+  struct dmx_driver_sleep_t *const sleep = &driver->sleep;
+  const dmx_port_t dmx_num = driver->dmx_num;
+
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+  esp_pm_lock_handle_t pm_lock = sleep->pm_lock;
+  if (pm_lock == NULL || sleep->is_asleep) {
+    taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+    return;
+  }
+
+  // Widen the guard time if the DMX break arrived before the driver woke
+  const int64_t break_ts = driver->dmx.rx_refresh_break_ts;
+  if (is_refresh && sleep->break_ts != 0) {
+    const int32_t period = sleep->period_us;
+    if (break_ts - sleep->break_ts > period + period / 2) {
+      ++sleep->missed;
+      sleep->guard_us = sleep->guard_us < period / 4 ? sleep->guard_us * 2
+                                                     : period / 2;
+    }
+    sleep->break_ts = 0;
+  }
+
+  // Sleep until shortly before the predicted DMX break of the next packet
+  const int32_t period = driver->dmx.rx_period_us;
+  const int64_t duration = break_ts + period - sleep->guard_us - now;
+  const bool can_sleep = is_refresh && period > 0 &&
+                         !driver->is_controller &&
+                         driver->repeater.outputs == 0 &&
+                         duration >= DMX_SLEEP_DURATION_MIN_US;
+  if (can_sleep) {
+    dmx_uart_disable_interrupt(dmx_num, DMX_INTR_RX_ALL);
+    dmx_uart_clear_interrupt(dmx_num, DMX_INTR_RX_ALL);
+    sleep->is_asleep = true;
+    sleep->period_us = period;
+    sleep->break_ts = break_ts;
+    sleep->sleep_ts = now;
+    ++sleep->sleeps;
+  }
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(dmx_num));
+
+  if (can_sleep) {
+    esp_timer_start_once(sleep->timer, duration);
+    esp_pm_lock_release(pm_lock);
+  }
+}
+
+bool dmx_sleep_enable(dmx_port_t dmx_num, uint32_t guard_us) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(guard_us > 0, false, "guard_us error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_sleep_is_enabled(dmx_num), false,
+            "sleep is already enabled");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Hold the lock while awake so that light sleep can't stop the UART clock
+  esp_pm_lock_handle_t pm_lock;
+  if (esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "dmx_sleep", &pm_lock)) {
+    DMX_CHECK(false, false, "sleep pm lock create error");
+  }
+  const esp_timer_create_args_t timer_args = {
+      .callback = dmx_sleep_wake,
+      .arg = driver,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "dmx_sleep",
+  };
+  esp_timer_handle_t timer;
+  if (esp_timer_create(&timer_args, &timer)) {
+    esp_pm_lock_delete(pm_lock);
+    DMX_CHECK(false, false, "sleep timer create error");
+  }
+  esp_pm_lock_acquire(pm_lock);
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->sleep.timer = timer;
+  driver->sleep.is_asleep = false;
+  driver->sleep.guard_us = guard_us;
+  driver->sleep.period_us = 0;
+  driver->sleep.break_ts = 0;
+  driver->sleep.sleep_ts = 0;
+  driver->sleep.sleeps = 0;
+  driver->sleep.missed = 0;
+  driver->sleep.asleep_us = 0;
+  driver->sleep.pm_lock = pm_lock;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+bool dmx_sleep_disable(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(dmx_sleep_is_enabled(dmx_num), false, "sleep is not enabled");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Stop the DMX ISR from sleeping and wake the DMX driver if it is asleep
+  esp_timer_stop(driver->sleep.timer);
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  esp_pm_lock_handle_t pm_lock = driver->sleep.pm_lock;
+  driver->sleep.pm_lock = NULL;
+  const bool was_asleep = driver->sleep.is_asleep;
+  if (was_asleep) {
+    dmx_sleep_resume(driver, dmx_timer_get_micros_since_boot());
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // The lock is only held while the DMX driver is awake
+  if (!was_asleep) {
+    esp_pm_lock_release(pm_lock);
+  }
+  esp_pm_lock_delete(pm_lock);
+  esp_timer_delete(driver->sleep.timer);
+  driver->sleep.timer = NULL;
+
+  return true;
+}
+
+bool dmx_sleep_is_enabled(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && dmx_driver_is_installed(dmx_num) &&
+         dmx_driver[dmx_num]->sleep.pm_lock != NULL;
+}
+
+bool dmx_sleep_get_stats(dmx_port_t dmx_num, dmx_sleep_stats_t *stats) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+
+  if (!dmx_sleep_is_enabled(dmx_num)) {
+    return false;
+  }
+
+  const struct dmx_driver_sleep_t *const sleep = &dmx_driver[dmx_num]->sleep;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  stats->sleeps = sleep->sleeps;
+  stats->missed = sleep->missed;
+  stats->asleep_us = sleep->asleep_us;
+  stats->guard_us = sleep->guard_us;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+#endif
@@ -0,0 +1,105 @@
+/**
+ * @file dmx/sleep.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the low-power receive mode of the DMX driver. When
+ * it is enabled, the DMX driver disables its receive interrupts as soon as the
+ * expected slots of each DMX packet have been received and releases its power
+ * management lock so that the system may enter automatic light sleep. The
+ * receive interrupts are enabled again shortly before the next DMX break,
+ * which is predicted from the measured refresh rate of the DMX signal. The
+ * low-power receive mode is only available when CONFIG_DMX_LIGHT_SLEEP_ENABLE
+ * is set.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The default time in microseconds before each predicted DMX break at
+ * which the DMX driver wakes to receive it.*/
+#define DMX_SLEEP_GUARD_US_DEFAULT (2000)
+
+/** @brief The shortest time in microseconds for which the DMX driver releases
+ * its power management lock. Shorter gaps between DMX packets are not worth
+ * the time taken to enter and leave light sleep.*/
+#define DMX_SLEEP_DURATION_MIN_US (1000)
+
+/** @brief Statistics of the low-power receive mode of a DMX port.*/
+typedef struct dmx_sleep_stats_t {
+  /** @brief The number of times that the DMX driver released its power
+     management lock between DMX packets.*/
+  uint32_t sleeps;
+  /** @brief The number of DMX breaks which arrived before the DMX driver woke
+     to receive them. The guard time is doubled each time a break is missed.*/
+  uint32_t missed;
+  /** @brief The total time in microseconds for which the receive interrupts of
+     the DMX driver were disabled.*/
+  uint64_t asleep_us;
+  /** @brief The current time in microseconds before each predicted DMX break
+     at which the DMX driver wakes.*/
+  uint32_t guard_us;
+} dmx_sleep_stats_t;
+
+/**
+ * @brief Enables the low-power receive mode of a DMX port. After each DMX
+ * packet with a null start code has been received up to its expected size,
+ * the receive interrupts are disabled and the power management lock of the DMX
+ * driver is released until guard_us before the predicted start of the next
+ * DMX break. The DMX driver does not sleep until the refresh rate of the DMX
+ * signal has been measured.
+ *
+ * @note Automatic light sleep must be enabled with esp_pm_configure(). The DMX
+ * driver only wakes once per packet when packets are received with
+ * dmx_receive_footprint(), so that the slots beyond the footprint of the
+ * device are not awaited.
+ *
+ * @note Sleeping is skipped while the DMX port is sending, is a DMX repeater
+ * input, or when RDM packets are received, so RDM responders continue to
+ * operate normally.
+ *
+ * @param dmx_num The DMX port number.
+ * @param guard_us The time in microseconds before each predicted DMX break at
+ * which the DMX driver wakes, typically DMX_SLEEP_GUARD_US_DEFAULT.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sleep_enable(dmx_port_t dmx_num, uint32_t guard_us);
+
+/**
+ * @brief Disables the low-power receive mode of a DMX port. The receive
+ * interrupts are enabled if the DMX driver is asleep.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sleep_disable(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the low-power receive mode of a DMX port is enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the low-power receive mode is enabled.
+ * @return false if it is not.
+ */
+bool dmx_sleep_is_enabled(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the statistics of the low-power receive mode of a DMX port since
+ * it was enabled.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false if the low-power receive mode is not enabled.
+ */
+bool dmx_sleep_get_stats(dmx_port_t dmx_num, dmx_sleep_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,9 +1,83 @@
 #include "dmx/sniffer.h"
 
+#include <string.h>
+
 #include "dmx/hal/include/gpio.h"
 #include "dmx/include/driver.h"
 #include "dmx/include/service.h"
 
+static void DMX_ISR_ATTR dmx_sniffer_range_add(
+    struct dmx_driver_sniffer_range_t *range, uint32_t value) {
+  if (range->count == 0 || value < range->min) {
+    range->min = value;
+  }
+  if (value > range->max) {
+    range->max = value;
+  }
+  range->sum += value;
+  ++range->count;
+}
+
+static void dmx_sniffer_range_get(
+    const struct dmx_driver_sniffer_range_t *range,
+    dmx_sniffer_range_t *result) {
+  result->min = range->min;
+  result->max = range->max;
+  result->mean = range->count > 0 ? range->sum / range->count : 0;
+}
+
+void DMX_ISR_ATTR dmx_sniffer_record_frame(dmx_driver_t *driver, int size,
+                                           dmx_err_t err, int64_t now) {
+  struct dmx_driver_sniffer_t *const sniffer = &driver->sniffer;
+  if (!sniffer->is_enabled || size <= 0) {
+    return;
+  }
+  if (size > DMX_PACKET_SIZE_MAX) {
+    size = DMX_PACKET_SIZE_MAX;
+  }
+
+  // Overwrite the oldest entry if the sniffer history is full
+  if (sniffer->head - sniffer->tail >= DMX_SNIFFER_HISTORY_SIZE) {
+    ++sniffer->tail;
+    ++sniffer->dropped;
+  }
+  dmx_sniffer_frame_t *const frame =
+      &sniffer->history[sniffer->head & (DMX_SNIFFER_HISTORY_SIZE - 1)];
+  ++sniffer->head;
+  frame->size = size;
+  frame->sc = driver->dmx.rx_data[0];
+  frame->err = err;
+  if (!sniffer->is_measured) {
+    frame->timestamp = 0;
+    frame->break_len = 0;
+    frame->mab_len = 0;
+    frame->frame_len = 0;
+    frame->mark_time = 0;
+    return;  // The sniffer did not see the start of this packet
+  }
+  sniffer->is_measured = false;
+
+  // The marks between slots are whatever remains after the slots are sent
+  const dmx_metadata_t *const metadata =
+      &sniffer->metadata[sniffer->buffer_index];
+  frame->timestamp = sniffer->break_ts;
+  frame->break_len = metadata->break_len;
+  frame->mab_len = metadata->mab_len;
+  frame->frame_len = sniffer->break_ts > 0 ? now - sniffer->break_ts : 0;
+  const int64_t mark_time = (int64_t)frame->frame_len - frame->break_len -
+                            frame->mab_len - size * DMX_SLOT_LEN_US;
+  frame->mark_time = frame->frame_len > 0 && mark_time > 0 ? mark_time : 0;
+
+  if (frame->break_len > 0) {
+    dmx_sniffer_range_add(&sniffer->break_len, frame->break_len);
+  }
+  dmx_sniffer_range_add(&sniffer->mab_len, frame->mab_len);
+  if (frame->frame_len > 0) {
+    dmx_sniffer_range_add(&sniffer->frame_len, frame->frame_len);
+    dmx_sniffer_range_add(&sniffer->mark_time, frame->mark_time);
+  }
+}
+
 bool dmx_sniffer_enable(dmx_port_t dmx_num, int intr_pin) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
   DMX_CHECK(dmx_sniffer_pin_is_valid(intr_pin), false, "intr_pin error");
@@ -14,6 +88,16 @@ bool dmx_sniffer_enable(dmx_port_t dmx_num, int intr_pin) {
 
   // Set sniffer default values
   driver->sniffer.last_neg_edge_ts = -1;  // Negative edge hasn't been seen yet
+  driver->sniffer.is_armed = true;
+  driver->sniffer.is_measured = false;
+  driver->sniffer.break_ts = 0;
+  driver->sniffer.head = 0;
+  driver->sniffer.tail = 0;
+  driver->sniffer.dropped = 0;
+  memset(&driver->sniffer.break_len, 0, sizeof(driver->sniffer.break_len));
+  memset(&driver->sniffer.mab_len, 0, sizeof(driver->sniffer.mab_len));
+  memset(&driver->sniffer.frame_len, 0, sizeof(driver->sniffer.frame_len));
+  memset(&driver->sniffer.mark_time, 0, sizeof(driver->sniffer.mark_time));
 
   dmx_driver[dmx_num]->sniffer.is_enabled = true;
 
@@ -51,3 +135,67 @@ bool dmx_sniffer_get_data(dmx_port_t dmx_num, dmx_metadata_t *metadata) {
 
   return true;
 }
+
+size_t dmx_sniffer_read_history(dmx_port_t dmx_num, dmx_sniffer_frame_t *frames,
+                                size_t count) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(frames != NULL || count == 0, 0, "frames is null");
+  DMX_CHECK(dmx_sniffer_is_enabled(dmx_num), 0, "sniffer is not enabled");
+
+  struct dmx_driver_sniffer_t *const sniffer = &dmx_driver[dmx_num]->sniffer;
+
+  // Copy and consume the oldest entries without stopping the DMX driver
+  size_t copied = 0;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const uint32_t available = sniffer->head - sniffer->tail;
+  if (count > available) {
+    count = available;
+  }
+  for (; copied < count; ++copied) {
+    frames[copied] =
+        sniffer->history[sniffer->tail & (DMX_SNIFFER_HISTORY_SIZE - 1)];
+    ++sniffer->tail;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return copied;
+}
+
+bool dmx_sniffer_get_stats(dmx_port_t dmx_num, dmx_sniffer_stats_t *stats) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stats != NULL, false, "stats is null");
+  DMX_CHECK(dmx_sniffer_is_enabled(dmx_num), false, "sniffer is not enabled");
+
+  const struct dmx_driver_sniffer_t *const sniffer =
+      &dmx_driver[dmx_num]->sniffer;
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  stats->frames = sniffer->head;
+  stats->dropped = sniffer->dropped;
+  dmx_sniffer_range_get(&sniffer->break_len, &stats->break_len);
+  dmx_sniffer_range_get(&sniffer->mab_len, &stats->mab_len);
+  dmx_sniffer_range_get(&sniffer->frame_len, &stats->frame_len);
+  dmx_sniffer_range_get(&sniffer->mark_time, &stats->mark_time);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
+
+bool dmx_sniffer_reset_stats(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_sniffer_is_enabled(dmx_num), false, "sniffer is not enabled");
+
+  struct dmx_driver_sniffer_t *const sniffer = &dmx_driver[dmx_num]->sniffer;
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  sniffer->head = 0;
+  sniffer->tail = 0;
+  sniffer->dropped = 0;
+  memset(&sniffer->break_len, 0, sizeof(sniffer->break_len));
+  memset(&sniffer->mab_len, 0, sizeof(sniffer->mab_len));
+  memset(&sniffer->frame_len, 0, sizeof(sniffer->frame_len));
+  memset(&sniffer->mark_time, 0, sizeof(sniffer->mark_time));
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+}
@@ -35,6 +35,10 @@ extern "C" {
  * pin to ensure that the analyzer ISR is called with the lowest latency
  * possible.
  *
+ * @note The sniffer interrupt is only enabled from the end of each packet until
+ * the end of the next DMX mark-after-break, so only a few interrupts are taken
+ * per packet instead of one on every edge of the DMX slots.
+ *
  * @param dmx_num The DMX port number.
  * @param intr_pin The pin to which to assign the interrupt.
  * @return true on success.
@@ -71,6 +75,45 @@ bool dmx_sniffer_is_enabled(dmx_port_t dmx_num);
  */
 bool dmx_sniffer_get_data(dmx_port_t dmx_num, dmx_metadata_t *metadata);
 
+/**
+ * @brief Reads and removes the oldest entries from the sniffer history. The
+ * DMX sniffer records the timing of every received packet into a ring buffer
+ * of CONFIG_DMX_SNIFFER_HISTORY_SIZE entries, so the history may be read in
+ * bulk instead of once per packet. If the history is full, the oldest entry is
+ * overwritten.
+ *
+ * @note The marks between individual slots are not seen by the sniffer, so
+ * only the total mark time between the slots of each packet is recorded.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] frames An array into which to copy the entries.
+ * @param count The maximum number of entries to copy.
+ * @return The number of entries which were copied.
+ */
+size_t dmx_sniffer_read_history(dmx_port_t dmx_num, dmx_sniffer_frame_t *frames,
+                                size_t count);
+
+/**
+ * @brief Gets the running minimum, maximum, and mean of the timing of the
+ * packets which were recorded by the DMX sniffer.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sniffer_get_stats(dmx_port_t dmx_num, dmx_sniffer_stats_t *stats);
+
+/**
+ * @brief Clears the sniffer history and the running statistics of the DMX
+ * sniffer.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_sniffer_reset_stats(dmx_port_t dmx_num);
+
 #ifdef __cplusplus
 }
 #endif
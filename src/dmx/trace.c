@@ -0,0 +1,352 @@
+#include "dmx/trace.h"
+
+#include <string.h>
+
+#include "dmx/hal/include/timer.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+_Static_assert((DMX_TRACE_BUFFER_SIZE & (DMX_TRACE_BUFFER_SIZE - 1)) == 0,
+               "DMX_TRACE_BUFFER_SIZE must be a power of two");
+_Static_assert((DMX_TRACE_FRAME_COUNT & (DMX_TRACE_FRAME_COUNT - 1)) == 0,
+               "DMX_TRACE_FRAME_COUNT must be a power of two");
+
+static void DMX_ISR_ATTR dmx_trace_histogram_add(dmx_driver_t *driver,
+                                                 int histogram,
+                                                 uint32_t value) {
+  // Find the power-of-two bucket without function calls for IRAM ISR
+  int bucket = 0;
+  while (value > 0 && bucket < DMX_TRACE_HISTOGRAM_BUCKETS - 1) {
+    value >>= 1;
+    ++bucket;
+  }
+  ++driver->trace.histograms[histogram][bucket];
+}
+
+static void DMX_ISR_ATTR dmx_trace_frame_add(struct dmx_driver_trace_t *trace,
+                                             uint32_t seq, int stage,
+                                             int64_t timestamp) {
+  // Frames which have been overwritten by newer frames are not recorded
+  dmx_trace_frame_t *const frame =
+      &trace->frames[seq & (DMX_TRACE_FRAME_COUNT - 1)];
+  const uint32_t stage_bit = 1 << stage;
+  if (seq == 0 || frame->seq != seq || (frame->stages & stage_bit)) {
+    return;
+  }
+  frame->offsets[stage] =
+      timestamp > frame->break_ts ? timestamp - frame->break_ts : 0;
+  frame->stages |= stage_bit;
+}
+
+void DMX_ISR_ATTR dmx_trace_record(dmx_driver_t *driver, int event,
+                                   int64_t timestamp) {
+  struct dmx_driver_trace_t *const trace = &driver->trace;
+
+  // Measure the latency of the event
+  int64_t reference;
+  int histogram;
+  switch (event) {
+    case DMX_TRACE_EVENT_BREAK:
+      trace->break_ts = timestamp;
+      reference = timestamp;
+      histogram = -1;
+
+      // Each DMX break begins the profile of a new frame
+      ++trace->seq;
+      dmx_trace_frame_t *const frame =
+          &trace->frames[trace->seq & (DMX_TRACE_FRAME_COUNT - 1)];
+      frame->seq = trace->seq;
+      frame->stages = 1 << DMX_TRACE_STAGE_BREAK;
+      frame->break_ts = timestamp;
+      frame->offsets[DMX_TRACE_STAGE_BREAK] = 0;
+      break;
+    case DMX_TRACE_EVENT_NOTIFY:
+      trace->notify_ts = timestamp;
+      reference = trace->break_ts;
+      histogram = DMX_TRACE_HISTOGRAM_BREAK_TO_NOTIFY;
+      break;
+    case DMX_TRACE_EVENT_TASK_WAKE:
+      reference = trace->notify_ts;
+      histogram = DMX_TRACE_HISTOGRAM_NOTIFY_TO_WAKE;
+      dmx_trace_frame_add(trace, trace->seq, DMX_TRACE_STAGE_WAKE, timestamp);
+      break;
+    case DMX_TRACE_EVENT_RESPONSE:
+      reference = driver->dmx.controller_eop_timestamp;
+      histogram = DMX_TRACE_HISTOGRAM_TURNAROUND;
+      break;
+    default:
+      return;
+  }
+  const uint32_t value = timestamp > reference ? timestamp - reference : 0;
+  if (histogram >= 0) {
+    dmx_trace_histogram_add(driver, histogram, value);
+  }
+
+  // Write the event into the trace buffer
+  dmx_trace_entry_t *const entry =
+      &trace->entries[trace->head & (DMX_TRACE_BUFFER_SIZE - 1)];
+  entry->timestamp = timestamp;
+  entry->event = event;
+  entry->value = value;
+  ++trace->head;
+}
+
+void DMX_ISR_ATTR dmx_trace_record_slots(dmx_driver_t *driver,
+                                         int64_t timestamp, int head) {
+  struct dmx_driver_trace_t *const trace = &driver->trace;
+  if (head > 0) {
+    dmx_trace_histogram_add(driver, DMX_TRACE_HISTOGRAM_INTER_SLOT,
+                            timestamp - trace->slot_ts);
+  }
+  trace->slot_ts = timestamp;
+}
+
+void DMX_ISR_ATTR dmx_trace_record_stage(dmx_driver_t *driver, int stage,
+                                         int64_t timestamp) {
+  struct dmx_driver_trace_t *const trace = &driver->trace;
+
+  // Stages after the packet is latched belong to the latched packet
+  if (stage == DMX_TRACE_STAGE_LATCHED) {
+    trace->latched_seq = trace->seq;
+  }
+  const uint32_t seq =
+      stage >= DMX_TRACE_STAGE_LATCHED ? trace->latched_seq : trace->seq;
+  dmx_trace_frame_add(trace, seq, stage, timestamp);
+}
+
+void dmx_trace_record_send(dmx_driver_t *driver, int stage,
+                           int64_t timestamp) {
+  const dmx_port_t source_num = driver->trace.source;
+  dmx_driver_t *const source = dmx_driver[source_num];
+  if (source == NULL) {
+    return;
+  }
+
+  // Attribute the sent packet to the packet last received by the source
+  taskENTER_CRITICAL(DMX_SPINLOCK(source_num));
+  if (stage == DMX_TRACE_STAGE_SEND) {
+    driver->trace.send_seq = source->trace.latched_seq;
+  }
+  dmx_trace_frame_add(&source->trace, driver->trace.send_seq, stage,
+                      timestamp);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(source_num));
+}
+
+void DMX_ISR_ATTR dmx_trace_record_sent_from_isr(dmx_driver_t *driver,
+                                                 int64_t timestamp) {
+  const dmx_port_t source_num = driver->trace.source;
+  dmx_driver_t *const source = dmx_driver[source_num];
+  if (source == NULL) {
+    return;
+  }
+
+  taskENTER_CRITICAL_ISR(DMX_SPINLOCK(source_num));
+  dmx_trace_frame_add(&source->trace, driver->trace.send_seq,
+                      DMX_TRACE_STAGE_TX_DONE, timestamp);
+  taskEXIT_CRITICAL_ISR(DMX_SPINLOCK(source_num));
+}
+#endif
+
+size_t dmx_trace_read(dmx_port_t dmx_num, dmx_trace_entry_t *entries,
+                      size_t count) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(entries != NULL || count == 0, 0, "entries is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  struct dmx_driver_trace_t *const trace = &dmx_driver[dmx_num]->trace;
+
+  // Copy the newest entries without stopping the DMX driver
+  size_t copied = 0;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const uint32_t head = trace->head;
+  const uint32_t available =
+      head < DMX_TRACE_BUFFER_SIZE ? head : DMX_TRACE_BUFFER_SIZE;
+  if (count > available) {
+    count = available;
+  }
+  for (uint32_t i = head - count; i != head; ++i) {
+    entries[copied] = trace->entries[i & (DMX_TRACE_BUFFER_SIZE - 1)];
+    ++copied;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return copied;
+#else
+  DMX_CHECK(false, 0, "trace is not enabled");
+#endif
+}
+
+bool dmx_trace_get_histogram(dmx_port_t dmx_num, int histogram,
+                             uint32_t *buckets) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(histogram >= 0 && histogram < DMX_TRACE_HISTOGRAM_MAX, false,
+            "histogram error");
+  DMX_CHECK(buckets != NULL, false, "buckets is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  struct dmx_driver_trace_t *const trace = &dmx_driver[dmx_num]->trace;
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  memcpy(buckets, trace->histograms[histogram],
+         sizeof(trace->histograms[histogram]));
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+#else
+  DMX_CHECK(false, false, "trace is not enabled");
+#endif
+}
+
+size_t dmx_trace_read_frames(dmx_port_t dmx_num, dmx_trace_frame_t *frames,
+                             size_t count) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(frames != NULL || count == 0, 0, "frames is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  struct dmx_driver_trace_t *const trace = &dmx_driver[dmx_num]->trace;
+
+  size_t copied = 0;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const uint32_t seq = trace->seq;
+  const uint32_t available =
+      seq < DMX_TRACE_FRAME_COUNT ? seq : DMX_TRACE_FRAME_COUNT;
+  if (count > available) {
+    count = available;
+  }
+  for (uint32_t i = seq - count + 1; i != seq + 1; ++i) {
+    frames[copied] = trace->frames[i & (DMX_TRACE_FRAME_COUNT - 1)];
+    ++copied;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return copied;
+#else
+  DMX_CHECK(false, 0, "trace is not enabled");
+#endif
+}
+
+bool dmx_trace_get_latency(dmx_port_t dmx_num, int from, int to,
+                           dmx_trace_latency_t *latency) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(from >= 0 && from < DMX_TRACE_STAGE_MAX, false, "from error");
+  DMX_CHECK(to >= 0 && to < DMX_TRACE_STAGE_MAX, false, "to error");
+  DMX_CHECK(latency != NULL, false, "latency is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  struct dmx_driver_trace_t *const trace = &dmx_driver[dmx_num]->trace;
+
+  // Copy the latencies of the frames in which both stages were recorded
+  uint32_t values[DMX_TRACE_FRAME_COUNT];
+  uint32_t count = 0;
+  const uint32_t mask = (1 << from) | (1 << to);
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  for (int i = 0; i < DMX_TRACE_FRAME_COUNT; ++i) {
+    const dmx_trace_frame_t *const frame = &trace->frames[i];
+    if (frame->seq == 0 || (frame->stages & mask) != mask) {
+      continue;
+    }
+    const uint32_t start = frame->offsets[from];
+    const uint32_t end = frame->offsets[to];
+    values[count] = end > start ? end - start : 0;
+    ++count;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  memset(latency, 0, sizeof(*latency));
+  latency->count = count;
+  if (count == 0) {
+    return true;
+  }
+
+  // Sort the latencies and take nearest-rank percentiles
+  for (uint32_t i = 1; i < count; ++i) {
+    const uint32_t value = values[i];
+    uint32_t j = i;
+    for (; j > 0 && values[j - 1] > value; --j) {
+      values[j] = values[j - 1];
+    }
+    values[j] = value;
+  }
+  latency->min = values[0];
+  latency->p50 = values[(count * 50 + 99) / 100 - 1];
+  latency->p90 = values[(count * 90 + 99) / 100 - 1];
+  latency->p99 = values[(count * 99 + 99) / 100 - 1];
+  latency->max = values[count - 1];
+
+  return true;
+#else
+  DMX_CHECK(false, false, "trace is not enabled");
+#endif
+}
+
+bool dmx_trace_mark(dmx_port_t dmx_num, int stage) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(stage >= DMX_TRACE_STAGE_USER_0 && stage <= DMX_TRACE_STAGE_USER_3,
+            false, "stage error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  const int64_t now = dmx_timer_get_micros_since_boot();
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_trace_record_stage(driver, stage, now);
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+#else
+  DMX_CHECK(false, false, "trace is not enabled");
+#endif
+}
+
+bool dmx_trace_set_source(dmx_port_t dmx_num, dmx_port_t source_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(source_num < DMX_NUM_MAX, false, "source_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(dmx_driver_is_installed(source_num), false,
+            "source driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // The source may not be changed while a packet is being sent
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  dmx_wait_sent(dmx_num, portMAX_DELAY);
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  driver->trace.source = source_num;
+  driver->trace.send_seq = 0;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return true;
+#else
+  DMX_CHECK(false, false, "trace is not enabled");
+#endif
+}
+
+bool dmx_trace_reset(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+#ifdef CONFIG_DMX_TRACE_ENABLE
+  struct dmx_driver_trace_t *const trace = &dmx_driver[dmx_num]->trace;
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  trace->head = 0;
+  memset(trace->histograms, 0, sizeof(trace->histograms));
+  memset(trace->frames, 0, sizeof(trace->frames));
+  trace->seq = 0;
+  trace->latched_seq = 0;
+  trace->send_seq = 0;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return true;
+#else
+  DMX_CHECK(false, false, "trace is not enabled");
+#endif
+}
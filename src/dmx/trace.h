@@ -0,0 +1,227 @@
+/**
+ * @file dmx/trace.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains functions which allow for reading the DMX trace
+ * buffer, latency histograms, and frame profiles. Tracing must be enabled with
+ * CONFIG_DMX_TRACE_ENABLE. The trace buffer, histograms, and frame profiles
+ * may be read while the DMX driver is running.
+ */
+#pragma once
+
+#include "dmx/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The number of buckets in each DMX trace histogram. Bucket 0 counts
+ * values of 0 microseconds. Bucket n counts values from 2^(n-1) up to 2^n - 1
+ * microseconds. The last bucket also counts all larger values.*/
+#define DMX_TRACE_HISTOGRAM_BUCKETS 16
+
+/** @brief The events which are recorded in the DMX trace buffer.*/
+typedef enum dmx_trace_event_t {
+  /** @brief A DMX break was received. The value is 0.*/
+  DMX_TRACE_EVENT_BREAK = 0,
+  /** @brief The DMX ISR finished receiving a packet and notified the waiting
+     task. The value is the time in microseconds since the DMX break.*/
+  DMX_TRACE_EVENT_NOTIFY,
+  /** @brief A task woke in dmx_receive() after it was notified. The value is
+     the time in microseconds since the notification.*/
+  DMX_TRACE_EVENT_TASK_WAKE,
+  /** @brief The DMX bus was turned around to send an RDM response. The value
+     is the time in microseconds since the end of the RDM request.*/
+  DMX_TRACE_EVENT_RESPONSE,
+} dmx_trace_event_t;
+
+/** @brief The latency histograms which are recorded by the DMX driver.*/
+typedef enum dmx_trace_histogram_t {
+  /** @brief The time from a DMX break until the waiting task is notified.*/
+  DMX_TRACE_HISTOGRAM_BREAK_TO_NOTIFY = 0,
+  /** @brief The time from the notification until the task wakes.*/
+  DMX_TRACE_HISTOGRAM_NOTIFY_TO_WAKE,
+  /** @brief The time from the end of an RDM request until the response.*/
+  DMX_TRACE_HISTOGRAM_TURNAROUND,
+  /** @brief The time between reads of received slots from the UART. When the
+     UART RX FIFO threshold is 1, this is the inter-slot time.*/
+  DMX_TRACE_HISTOGRAM_INTER_SLOT,
+  /** @brief The number of DMX trace histograms.*/
+  DMX_TRACE_HISTOGRAM_MAX,
+} dmx_trace_histogram_t;
+
+/** @brief The stages of the path from a received DMX break to the output of
+ * its DMX packet which are recorded in the frame profile of each DMX packet.
+ * Stages which are not reached by a DMX packet are not recorded.*/
+typedef enum dmx_trace_stage_t {
+  /** @brief The DMX break of the packet was received by the DMX ISR. The
+     sequence number of the frame is assigned at this stage.*/
+  DMX_TRACE_STAGE_BREAK = 0,
+  /** @brief The DMX ISR finished receiving the packet and notified the task
+     which was waiting in dmx_receive().*/
+  DMX_TRACE_STAGE_NOTIFY,
+  /** @brief The task which was waiting in dmx_receive() woke.*/
+  DMX_TRACE_STAGE_WAKE,
+  /** @brief The DMX driver mutex was taken by dmx_receive() after the packet
+     had already been received. This is only recorded if dmx_receive() was
+     called late, in which case the mutex wait is on the path of the frame.*/
+  DMX_TRACE_STAGE_LOCKED,
+  /** @brief dmx_receive() latched the packet and is about to return.*/
+  DMX_TRACE_STAGE_LATCHED,
+  /** @brief The first call to dmx_read() after the packet was latched finished
+     copying the slots.*/
+  DMX_TRACE_STAGE_READ,
+  /** @brief The first user stage. User stages are recorded with
+     dmx_trace_mark().*/
+  DMX_TRACE_STAGE_USER_0,
+  /** @brief The second user stage.*/
+  DMX_TRACE_STAGE_USER_1,
+  /** @brief The third user stage.*/
+  DMX_TRACE_STAGE_USER_2,
+  /** @brief The fourth user stage.*/
+  DMX_TRACE_STAGE_USER_3,
+  /** @brief dmx_send() was called on a DMX port whose source is the receiving
+     DMX port. See dmx_trace_set_source().*/
+  DMX_TRACE_STAGE_SEND,
+  /** @brief dmx_send() finished waiting for the previous packet to be sent and
+     for the DMX timer, and started sending.*/
+  DMX_TRACE_STAGE_TX_START,
+  /** @brief The DMX ISR finished sending the packet.*/
+  DMX_TRACE_STAGE_TX_DONE,
+  /** @brief The number of DMX trace stages.*/
+  DMX_TRACE_STAGE_MAX,
+} dmx_trace_stage_t;
+
+/** @brief The profile of one received DMX packet.*/
+typedef struct dmx_trace_frame_t {
+  /** @brief The sequence number of the frame. It is incremented on each DMX
+     break, starting at 1.*/
+  uint32_t seq;
+  /** @brief A bitmask of the stages which were recorded. Bit n is set if
+     stage n of dmx_trace_stage_t was recorded.*/
+  uint32_t stages;
+  /** @brief The time of the DMX break in microseconds since boot.*/
+  int64_t break_ts;
+  /** @brief The time of each recorded stage in microseconds since the DMX
+     break.*/
+  uint32_t offsets[DMX_TRACE_STAGE_MAX];
+} dmx_trace_frame_t;
+
+/** @brief Percentiles of the latency between two stages over the recent frame
+ * profiles of a DMX port.*/
+typedef struct dmx_trace_latency_t {
+  /** @brief The number of frames in which both stages were recorded.*/
+  uint32_t count;
+  /** @brief The shortest latency in microseconds.*/
+  uint32_t min;
+  /** @brief The median latency in microseconds.*/
+  uint32_t p50;
+  /** @brief The 90th percentile latency in microseconds.*/
+  uint32_t p90;
+  /** @brief The 99th percentile latency in microseconds.*/
+  uint32_t p99;
+  /** @brief The longest latency in microseconds.*/
+  uint32_t max;
+} dmx_trace_latency_t;
+
+/** @brief An entry in the DMX trace buffer.*/
+typedef struct dmx_trace_entry_t {
+  /** @brief The time of the event in microseconds since boot.*/
+  int64_t timestamp;
+  /** @brief The event which was recorded, one of dmx_trace_event_t.*/
+  uint32_t event;
+  /** @brief The value of the event. Its meaning depends on the event.*/
+  uint32_t value;
+} dmx_trace_entry_t;
+
+/**
+ * @brief Copies the most recent entries of the DMX trace buffer, oldest first.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] entries An array into which to copy the trace entries.
+ * @param count The maximum number of entries to copy.
+ * @return The number of entries which were copied.
+ */
+size_t dmx_trace_read(dmx_port_t dmx_num, dmx_trace_entry_t *entries,
+                      size_t count);
+
+/**
+ * @brief Copies a DMX trace histogram.
+ *
+ * @param dmx_num The DMX port number.
+ * @param histogram The histogram to copy, one of dmx_trace_histogram_t.
+ * @param[out] buckets An array of DMX_TRACE_HISTOGRAM_BUCKETS counters into
+ * which to copy the histogram.
+ * @return true if the histogram was copied.
+ * @return false if the histogram was not copied.
+ */
+bool dmx_trace_get_histogram(dmx_port_t dmx_num, int histogram,
+                             uint32_t *buckets);
+
+/**
+ * @brief Copies the most recent frame profiles of a DMX port, oldest first.
+ * Frames which are still being received or sent may be copied.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] frames An array into which to copy the frame profiles.
+ * @param count The maximum number of frame profiles to copy.
+ * @return The number of frame profiles which were copied.
+ */
+size_t dmx_trace_read_frames(dmx_port_t dmx_num, dmx_trace_frame_t *frames,
+                             size_t count);
+
+/**
+ * @brief Computes percentiles of the latency between two stages over the
+ * recent frame profiles of a DMX port. Passing the previous stage of the path
+ * as the first stage measures the time spent in a single stage. Passing
+ * DMX_TRACE_STAGE_BREAK as the first stage measures the time since the DMX
+ * break.
+ *
+ * @param dmx_num The DMX port number.
+ * @param from The first stage, one of dmx_trace_stage_t.
+ * @param to The second stage, one of dmx_trace_stage_t.
+ * @param[out] latency A pointer into which to copy the percentiles.
+ * @return true if the percentiles were computed.
+ * @return false if they were not.
+ */
+bool dmx_trace_get_latency(dmx_port_t dmx_num, int from, int to,
+                           dmx_trace_latency_t *latency);
+
+/**
+ * @brief Records a user stage in the profile of the DMX packet which was most
+ * recently returned by dmx_receive(). Each stage is only recorded once per
+ * frame, so this function may be called on every iteration of a loop.
+ *
+ * @param dmx_num The DMX port number on which the packet was received.
+ * @param stage The stage to record, DMX_TRACE_STAGE_USER_0 through
+ * DMX_TRACE_STAGE_USER_3.
+ * @return true if the stage was recorded.
+ * @return false if it was not.
+ */
+bool dmx_trace_mark(dmx_port_t dmx_num, int stage);
+
+/**
+ * @brief Sets the DMX port whose frame profiles receive the send stages of a
+ * DMX port. Each call to dmx_send() records DMX_TRACE_STAGE_SEND,
+ * DMX_TRACE_STAGE_TX_START, and DMX_TRACE_STAGE_TX_DONE in the profile of the
+ * packet which was most recently returned by dmx_receive() on the source DMX
+ * port. By default, the source of each DMX port is itself.
+ *
+ * @param dmx_num The DMX port number which sends DMX.
+ * @param source_num The DMX port number which receives DMX.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_trace_set_source(dmx_port_t dmx_num, dmx_port_t source_num);
+
+/**
+ * @brief Clears the DMX trace buffer, histograms, and frame profiles.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool dmx_trace_reset(dmx_port_t dmx_num);
+
+#ifdef __cplusplus
+}
+#endif
@@ -45,17 +45,31 @@ extern "C" {
 #define DMX_INTR_FLAGS_DEFAULT (0)
 #endif
 
+#ifndef CONFIG_DMX_PROFILE_DMX_ONLY
+/** @brief The default number of parameters of the root device.*/
+#define DMX_ROOT_PARAMETER_COUNT (32)
+#else
+/** @brief The default number of parameters of the root device. Only the DMX
+ * parameters are registered when the RDM responder is not compiled.*/
+#define DMX_ROOT_PARAMETER_COUNT (8)
+#endif
+
 /** @brief The default configuration for the DMX driver.*/
 #define DMX_CONFIG_DEFAULT                                            \
   (dmx_config_t) {                                                    \
     DMX_INTR_FLAGS_DEFAULT,           /*interrupt_flags*/             \
-        32,                           /*root_device_parameter_count*/ \
+        DMX_ROOT_PARAMETER_COUNT,     /*root_device_parameter_count*/ \
         0,                            /*sub_device_parameter_count*/  \
         0,                            /*model_id*/                    \
         RDM_PRODUCT_CATEGORY_FIXTURE, /*product_category*/            \
         ESP_DMX_VERSION_ID,           /*software_version_id*/         \
         ESP_DMX_VERSION_LABEL,        /*software_version_label*/      \
         32,                           /*queue_size_max*/              \
+        0,                            /*dma_flags*/                   \
+        0,                            /*arena_size*/                  \
+        0,                            /*arena_caps*/                  \
+        DMX_ISR_CORE_DEFAULT,         /*isr_core*/                    \
+        0,                            /*isr_priority*/                \
   }
 
 #ifdef __cplusplus
@@ -0,0 +1,328 @@
+#include "include/cache.h"
+
+#include <string.h>
+
+#include "dmx/hal/include/nvs.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+#include "rdm/controller/include/discovery.h"
+#include "rdm/controller/include/product_info.h"
+#include "rdm/controller/include/utils.h"
+#include "rdm/include/uid.h"
+
+enum {
+  RDM_CACHE_NVS_PID = 0xfff0,    // A reserved PID which keys the cache in NVS.
+  RDM_CACHE_PROBE_ATTEMPTS = 2,  // Mute probes before a device is removed.
+};
+
+typedef struct rdm_cache_blob_t {
+  uint32_t version;             // The layout version of the stored cache.
+  uint32_t num_devices;         // The number of cached devices.
+  rdm_cache_entry_t devices[];  // The cached devices, sorted by UID.
+} rdm_cache_blob_t;
+
+typedef struct rdm_cache_t {
+  int max_devices;         // The number of devices which fit in the cache.
+  bool is_dirty;           // True if the cache changed since it was saved.
+  rdm_cache_blob_t *blob;  // The cache as it is stored in NVS.
+  bool is_verified[];      // Devices which responded since the cache loaded.
+} rdm_cache_t;
+
+static rdm_cache_t *rdm_cache_context[DMX_NUM_MAX] = {};
+
+static size_t rdm_cache_blob_size(int num_devices) {
+  return sizeof(rdm_cache_blob_t) + sizeof(rdm_cache_entry_t) * num_devices;
+}
+
+static bool rdm_cache_find(const rdm_cache_t *cache, const rdm_uid_t *uid,
+                           int *index) {
+  // Binary search the sorted devices for the UID or its insertion point
+  int low = 0;
+  int high = (int)cache->blob->num_devices - 1;
+  while (low <= high) {
+    const int mid = (low + high) / 2;
+    const rdm_uid_t *const mid_uid = &cache->blob->devices[mid].uid;
+    if (rdm_uid_is_lt(mid_uid, uid)) {
+      low = mid + 1;
+    } else if (rdm_uid_is_gt(mid_uid, uid)) {
+      high = mid - 1;
+    } else {
+      *index = mid;
+      return true;
+    }
+  }
+
+  *index = low;
+  return false;
+}
+
+static void rdm_cache_remove(rdm_cache_t *cache, int i) {
+  rdm_cache_blob_t *const blob = cache->blob;
+  const int num_moved = blob->num_devices - i - 1;
+  memmove(&blob->devices[i], &blob->devices[i + 1],
+          sizeof(rdm_cache_entry_t) * num_moved);
+  memmove(&cache->is_verified[i], &cache->is_verified[i + 1],
+          sizeof(bool) * num_moved);
+  --blob->num_devices;
+  cache->is_dirty = true;
+}
+
+int rdm_cache_init(dmx_port_t dmx_num, int max_devices) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(max_devices > 0, -1, "max_devices error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+  DMX_CHECK(!rdm_cache_is_initialized(dmx_num), -1,
+            "cache is already initialized");
+
+  // Allocate the cache and a blob large enough to hold every device
+  const size_t blob_size = rdm_cache_blob_size(max_devices);
+  rdm_cache_t *const cache = heap_caps_malloc(
+      sizeof(rdm_cache_t) + sizeof(bool) * max_devices, MALLOC_CAP_8BIT);
+  rdm_cache_blob_t *const blob = heap_caps_malloc(blob_size, MALLOC_CAP_8BIT);
+  if (cache == NULL || blob == NULL) {
+    heap_caps_free(cache);
+    heap_caps_free(blob);
+    DMX_CHECK(false, -1, "cache malloc error");
+  }
+  cache->max_devices = max_devices;
+  cache->is_dirty = false;
+  cache->blob = blob;
+  memset(cache->is_verified, 0, sizeof(bool) * max_devices);
+
+  // Load the saved cache and discard it if it has another layout
+  const size_t size = dmx_nvs_get(dmx_num, RDM_SUB_DEVICE_ROOT,
+                                  RDM_CACHE_NVS_PID, blob, blob_size);
+  if (size < sizeof(rdm_cache_blob_t) || blob->version != RDM_CACHE_VERSION ||
+      blob->num_devices > max_devices ||
+      size != rdm_cache_blob_size(blob->num_devices)) {
+    blob->version = RDM_CACHE_VERSION;
+    blob->num_devices = 0;
+  }
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_cache_context[dmx_num] = cache;
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return blob->num_devices;
+}
+
+bool rdm_cache_deinit(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(rdm_cache_is_initialized(dmx_num), false,
+            "cache is not initialized");
+
+  // Wait for any RDM requests which use the cache to finish
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_cache_t *const cache = rdm_cache_context[dmx_num];
+  rdm_cache_context[dmx_num] = NULL;
+  xSemaphoreGiveRecursive(driver->mux);
+
+  heap_caps_free(cache->blob);
+  heap_caps_free(cache);
+
+  return true;
+}
+
+bool rdm_cache_is_initialized(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && rdm_cache_context[dmx_num] != NULL;
+}
+
+int rdm_cache_get_uids(dmx_port_t dmx_num, rdm_uid_t *uids, int size) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(uids != NULL || size == 0, -1, "uids is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+  DMX_CHECK(rdm_cache_is_initialized(dmx_num), -1, "cache is not initialized");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  const rdm_cache_blob_t *const blob = rdm_cache_context[dmx_num]->blob;
+  const int num_devices = blob->num_devices;
+  for (int i = 0; i < num_devices && i < size; ++i) {
+    uids[i] = blob->devices[i].uid;
+  }
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return num_devices;
+}
+
+bool rdm_cache_get(dmx_port_t dmx_num, const rdm_uid_t *uid,
+                   rdm_cache_entry_t *entry) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(uid != NULL, false, "uid is null");
+  DMX_CHECK(entry != NULL, false, "entry is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(rdm_cache_is_initialized(dmx_num), false,
+            "cache is not initialized");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_cache_t *const cache = rdm_cache_context[dmx_num];
+
+  int i;
+  bool is_cached = rdm_cache_find(cache, uid, &i);
+  if (is_cached && !cache->is_verified[i]) {
+    // Probe the device the first time it is read after the cache was loaded
+    rdm_ack_t ack = {.type = RDM_RESPONSE_TYPE_NONE};
+    for (int attempts = 0; attempts < RDM_CACHE_PROBE_ATTEMPTS &&
+                           ack.type != RDM_RESPONSE_TYPE_ACK;
+         ++attempts) {
+      rdm_send_disc_mute(dmx_num, uid, NULL, &ack);
+    }
+    if (ack.type == RDM_RESPONSE_TYPE_ACK) {
+      rdm_send_disc_un_mute(dmx_num, uid, NULL, NULL);
+      cache->is_verified[i] = true;
+    } else {
+      rdm_cache_remove(cache, i);
+      is_cached = false;
+    }
+  }
+  if (is_cached) {
+    *entry = cache->blob->devices[i];
+  }
+
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return is_cached;
+}
+
+bool rdm_cache_update(dmx_port_t dmx_num, const rdm_uid_t *uid) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(uid != NULL, false, "uid is null");
+  DMX_CHECK(!rdm_uid_is_broadcast(uid), false, "uid error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(rdm_cache_is_initialized(dmx_num), false,
+            "cache is not initialized");
+
+  // Request the parameters of the device before the cache is modified
+  rdm_cache_entry_t entry = {.uid = *uid};
+  rdm_ack_t ack;
+  rdm_send_get_device_info(dmx_num, uid, RDM_SUB_DEVICE_ROOT,
+                           &entry.device_info, &ack);
+  if (ack.type != RDM_RESPONSE_TYPE_ACK) {
+    return false;
+  }
+  const rdm_request_t request = {.dest_uid = uid,
+                                 .sub_device = RDM_SUB_DEVICE_ROOT,
+                                 .cc = RDM_CC_GET_COMMAND,
+                                 .pid = RDM_PID_DEVICE_LABEL};
+  rdm_send_request(dmx_num, &request, "a$", entry.device_label,
+                   sizeof(entry.device_label), &ack);
+  if (ack.type != RDM_RESPONSE_TYPE_ACK) {
+    entry.device_label[0] = '\0';  // Device labels are optional
+  }
+  entry.device_label[sizeof(entry.device_label) - 1] = '\0';
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_cache_t *const cache = rdm_cache_context[dmx_num];
+
+  int i;
+  bool is_stored = true;
+  if (rdm_cache_find(cache, uid, &i)) {
+    if (memcmp(&cache->blob->devices[i], &entry, sizeof(entry)) != 0) {
+      cache->blob->devices[i] = entry;
+      cache->is_dirty = true;
+    }
+    cache->is_verified[i] = true;
+  } else if (cache->blob->num_devices < cache->max_devices) {
+    // Insert the device so that the cache remains sorted
+    rdm_cache_blob_t *const blob = cache->blob;
+    const int num_moved = blob->num_devices - i;
+    memmove(&blob->devices[i + 1], &blob->devices[i],
+            sizeof(rdm_cache_entry_t) * num_moved);
+    memmove(&cache->is_verified[i + 1], &cache->is_verified[i],
+            sizeof(bool) * num_moved);
+    blob->devices[i] = entry;
+    cache->is_verified[i] = true;
+    ++blob->num_devices;
+    cache->is_dirty = true;
+  } else {
+    is_stored = false;
+  }
+
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return is_stored;
+}
+
+int rdm_cache_refresh(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+  DMX_CHECK(rdm_cache_is_initialized(dmx_num), -1, "cache is not initialized");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_cache_t *const cache = rdm_cache_context[dmx_num];
+  rdm_cache_blob_t *const blob = cache->blob;
+
+  rdm_uid_t *const uids =
+      heap_caps_malloc(sizeof(rdm_uid_t) * cache->max_devices, MALLOC_CAP_8BIT);
+  if (uids == NULL) {
+    xSemaphoreGiveRecursive(driver->mux);
+    DMX_CHECK(false, -1, "uids malloc error");
+  }
+
+  // Verify the cached devices and find the devices which are not yet cached
+  for (int i = 0; i < blob->num_devices; ++i) {
+    uids[i] = blob->devices[i].uid;
+  }
+  const int num_found = rdm_discover_incremental(
+      dmx_num, uids, blob->num_devices, cache->max_devices, NULL, NULL);
+  if (num_found < 0) {
+    heap_caps_free(uids);
+    xSemaphoreGiveRecursive(driver->mux);
+    return -1;
+  }
+
+  // Remove the cached devices which were not found
+  for (int i = blob->num_devices - 1; i >= 0; --i) {
+    bool is_found = false;
+    for (int j = 0; j < num_found && !is_found; ++j) {
+      is_found = rdm_uid_is_eq(&blob->devices[i].uid, &uids[j]);
+    }
+    if (is_found) {
+      cache->is_verified[i] = true;
+    } else {
+      rdm_cache_remove(cache, i);
+    }
+  }
+
+  // Request the parameters of the new devices
+  for (int j = 0; j < num_found; ++j) {
+    int i;
+    if (!rdm_cache_find(cache, &uids[j], &i)) {
+      rdm_cache_update(dmx_num, &uids[j]);
+    }
+  }
+  heap_caps_free(uids);
+
+  const int num_devices = blob->num_devices;
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return num_devices;
+}
+
+bool rdm_cache_save(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(rdm_cache_is_initialized(dmx_num), false,
+            "cache is not initialized");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_cache_t *const cache = rdm_cache_context[dmx_num];
+  bool is_saved = true;
+  if (cache->is_dirty) {
+    is_saved = dmx_nvs_set(dmx_num, RDM_SUB_DEVICE_ROOT, RDM_CACHE_NVS_PID,
+                           cache->blob,
+                           rdm_cache_blob_size(cache->blob->num_devices));
+    cache->is_dirty = !is_saved;
+  }
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return is_saved;
+}
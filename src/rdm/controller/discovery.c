@@ -6,6 +6,29 @@
 #include "rdm/include/driver.h"
 #include "rdm/include/uid.h"
 
+enum {
+  RDM_DISC_TASK_STACK_SIZE = 4096,  // The stack of each port discovery task.
+  RDM_DISC_ATTEMPTS_DEFAULT = 3,  // Attempts before the loss is known.
+  RDM_DISC_ATTEMPTS_MAX = 5,      // Attempts when most requests are lost.
+  RDM_DISC_ANSWERED_MIN = 8,      // Answers needed to estimate the loss.
+  RDM_DISC_ANSWERED_HISTORY = 64,  // Answers after which history is halved.
+  RDM_DISC_COLLISION_SIZE_MIN = 17,  // The smallest DUB response size.
+};
+
+// Tracks how often answered discovery requests are lost on a port
+static struct rdm_disc_link_t {
+  uint16_t answered;  // The number of requests which received a response.
+  uint16_t lost;      // The number of those whose first attempt was lost.
+} rdm_disc_links[DMX_NUM_MAX] = {};
+
+struct rdm_disc_port_t {
+  dmx_port_t dmx_num;      // The DMX port which is discovered.
+  rdm_disc_cb_t cb;        // The callback which is called for new devices.
+  void *context;           // Context for the callback.
+  int num_found;           // The number of devices found on the DMX port.
+  SemaphoreHandle_t done;  // Is given when discovery of the port finishes.
+};
+
 bool rdm_send_disc_unique_branch(dmx_port_t dmx_num,
                                  const rdm_disc_unique_branch_t *branch,
                                  rdm_ack_t *ack) {
@@ -36,7 +59,7 @@ bool rdm_send_disc_mute(dmx_port_t dmx_num, const rdm_uid_t *dest_uid,
                                  .pid = RDM_PID_DISC_MUTE};
 
   const char *format = "wv";
-  return rdm_send_request(dmx_num, &request, format, &mute, sizeof(*mute), ack);
+  return rdm_send_request(dmx_num, &request, format, mute, sizeof(*mute), ack);
 }
 
 bool rdm_send_disc_un_mute(dmx_port_t dmx_num, const rdm_uid_t *dest_uid,
@@ -51,22 +74,98 @@ bool rdm_send_disc_un_mute(dmx_port_t dmx_num, const rdm_uid_t *dest_uid,
                                  .pid = RDM_PID_DISC_UN_MUTE};
 
   const char *format = "wv";
-  return rdm_send_request(dmx_num, &request, format, &mute, sizeof(*mute), ack);
+  return rdm_send_request(dmx_num, &request, format, mute, sizeof(*mute), ack);
 }
 
-int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
-                               void *context) {
-  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
-  DMX_CHECK(cb != NULL, 0, "cb is null");
-  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+static int rdm_disc_attempts_max(const struct rdm_disc_link_t *link) {
+  // Use the default until enough answers have been observed
+  if (link->answered < RDM_DISC_ANSWERED_MIN) {
+    return RDM_DISC_ATTEMPTS_DEFAULT;
+  }
+
+  // Retry less on clean buses and more on buses where requests are lost
+  const uint32_t loss_rate = (uint32_t)link->lost * 16 / link->answered;
+  if (loss_rate == 0) {
+    return 2;  // Less than 1 in 16 first attempts were lost
+  } else if (loss_rate < 4) {
+    return 3;  // Less than 1 in 4 first attempts were lost
+  } else if (loss_rate < 8) {
+    return 4;
+  }
+  return RDM_DISC_ATTEMPTS_MAX;
+}
+
+static void rdm_disc_record_answer(struct rdm_disc_link_t *link,
+                                   bool is_lost) {
+  ++link->answered;
+  link->lost += is_lost;
+  if (link->answered >= RDM_DISC_ANSWERED_HISTORY) {
+    // Age the history so that the estimate follows changes on the bus
+    link->answered /= 2;
+    link->lost /= 2;
+  }
+}
+
+static bool rdm_disc_is_noise(const rdm_ack_t *ack) {
+  /*
+  Responses from several devices which collide still span the length of a
+  discovery response, but typically fail their checksums. Shorter invalid
+  responses are more likely to be noise on the bus than a collision, so they
+  are retried instead of being branched.
+  */
+  return ack->type == RDM_RESPONSE_TYPE_INVALID &&
+         ack->size < RDM_DISC_COLLISION_SIZE_MIN;
+}
+
+static void rdm_disc_send_branch(dmx_port_t dmx_num,
+                                 const rdm_disc_unique_branch_t *branch,
+                                 rdm_ack_t *ack) {
+  struct rdm_disc_link_t *const link = &rdm_disc_links[dmx_num];
+  const int attempts_max = rdm_disc_attempts_max(link);
+  for (int attempts = 1;; ++attempts) {
+    rdm_send_disc_unique_branch(dmx_num, branch, ack);
+    const bool is_answered =
+        ack->type != RDM_RESPONSE_TYPE_NONE && !rdm_disc_is_noise(ack);
+    if (is_answered) {
+      // Most branches are empty, so only answered branches show whether
+      // requests are lost on the bus
+      rdm_disc_record_answer(link, attempts > 1);
+      break;
+    } else if (attempts >= attempts_max) {
+      break;
+    }
+  }
+}
 
+static void rdm_disc_send_mute(dmx_port_t dmx_num, const rdm_uid_t *dest_uid,
+                               rdm_disc_mute_t *mute, rdm_ack_t *ack) {
+  struct rdm_disc_link_t *const link = &rdm_disc_links[dmx_num];
+  const int attempts_max = rdm_disc_attempts_max(link);
+  for (int attempts = 1;; ++attempts) {
+    rdm_send_disc_mute(dmx_num, dest_uid, mute, ack);
+    // Only the addressed device responds, so invalid responses are noise
+    const bool is_answered = ack->type != RDM_RESPONSE_TYPE_NONE &&
+                             ack->type != RDM_RESPONSE_TYPE_INVALID;
+    if (is_answered) {
+      rdm_disc_record_answer(link, attempts > 1);
+      break;
+    } else if (attempts >= attempts_max) {
+      break;
+    }
+  }
+}
+
+static int rdm_discover_branches(dmx_port_t dmx_num, rdm_disc_cb_t cb,
+                                 void *context, int num_found) {
   // Allocate the instruction stack. The max binary tree depth is 49.
 #ifdef CONFIG_RDM_STATIC_DISCOVERY_INSTRUCTIONS
-  static rdm_disc_unique_branch_t stack[49]; 
+  // Each port has its own stack so that ports may be discovered concurrently
+  static rdm_disc_unique_branch_t stacks[DMX_NUM_MAX][49];
+  rdm_disc_unique_branch_t *const stack = stacks[dmx_num];
 #else
   rdm_disc_unique_branch_t *stack;
   stack = malloc(sizeof(rdm_disc_unique_branch_t) * 49);
-  DMX_CHECK(stack != NULL, 0, "discovery malloc error");
+  DMX_CHECK(stack != NULL, num_found, "discovery malloc error");
 #endif
 
   // Initialize the stack with the initial branch instruction
@@ -77,26 +176,18 @@ int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
   rdm_uid_t dest_uid;
   rdm_disc_mute_t mute;  // Mute parameters returned from devices.
   rdm_ack_t ack;         // Request response information.
-  int num_found = 0;
 
   dmx_driver_t *const driver = dmx_driver[dmx_num];
-  xSemaphoreTakeRecursive(driver->mux, 0);
-
-  // Un-mute all devices
-  dest_uid = RDM_UID_BROADCAST_ALL;
-  rdm_send_disc_un_mute(dmx_num, &dest_uid, NULL, NULL);
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
 
   while (stack_size > 0) {
     // Pop a DISC_UNIQUE_BRANCH instruction parameter from the stack
     const rdm_disc_unique_branch_t *branch = &stack[--stack_size];
 
-    size_t attempts = 0;
     if (rdm_uid_is_eq(&branch->lower_bound, &branch->upper_bound)) {
       // Can't branch further so attempt to mute the device
       dest_uid = branch->lower_bound;
-      do {
-        rdm_send_disc_mute(dmx_num, &dest_uid, &mute, &ack);
-      } while (ack.type != RDM_RESPONSE_TYPE_ACK && ++attempts < 3);
+      rdm_disc_send_mute(dmx_num, &dest_uid, &mute, &ack);
 
       // Call the callback function and report a device has been found
       if (ack.type == RDM_RESPONSE_TYPE_ACK) {
@@ -107,14 +198,11 @@ int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
       }
     } else {
       // Search the current branch in the RDM address space
-      do {
-        rdm_send_disc_unique_branch(dmx_num, branch, &ack);
-      } while (ack.type == RDM_RESPONSE_TYPE_NONE && ++attempts < 3);
+      rdm_disc_send_branch(dmx_num, branch, &ack);
       if (ack.type != RDM_RESPONSE_TYPE_NONE) {
         bool devices_remaining = true;
 
-#if false  // FIXME: This should temporarily allow discovery to work.
-// #ifndef CONFIG_RDM_DEBUG_DEVICE_DISCOVERY
+#ifndef CONFIG_RDM_DEBUG_DEVICE_DISCOVERY
         /*
         Stop the RDM controller from branching all the way down to the
         individual address if it is not necessary. When debugging, this code
@@ -124,27 +212,32 @@ int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
         this function.
         */
         if (ack.type == RDM_RESPONSE_TYPE_ACK) {
+          bool mute_failed = false;
           do {
             // Attempt to mute the device
-            attempts = 0;
             dest_uid = ack.src_uid;
-            do {
-              rdm_send_disc_mute(dmx_num, &dest_uid, &mute, &ack);
-            } while (ack.type == RDM_RESPONSE_TYPE_NONE && ++attempts < 3);
+            rdm_disc_send_mute(dmx_num, &dest_uid, &mute, &ack);
 
-            // Call the callback function and report a device has been found
-            if (ack.type == RDM_RESPONSE_TYPE_ACK) {
-              cb(dmx_num, ack.src_uid, num_found, &mute, context);
-              ++num_found;
+            // Fall back to branching if the response was not a real device
+            if (ack.type != RDM_RESPONSE_TYPE_ACK ||
+                !rdm_uid_is_eq(&ack.src_uid, &dest_uid)) {
+              mute_failed = true;
+              break;
             }
 
+            // Call the callback function and report a device has been found
+            xSemaphoreGiveRecursive(driver->mux);
+            cb(dmx_num, ack.src_uid, num_found, &mute, context);
+            xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+            ++num_found;
+
             // Check if there are more devices in this branch
-            attempts = 0;
-            do {
-              rdm_send_disc_unique_branch(dmx_num, branch, &ack);
-            } while (ack.type == RDM_RESPONSE_TYPE_NONE && ++attempts < 3);
+            rdm_disc_send_branch(dmx_num, branch, &ack);
           } while (ack.type == RDM_RESPONSE_TYPE_ACK);
-          devices_remaining = (ack.err && ack.err != DMX_ERR_TIMEOUT);
+
+          // A collision means that more than one device remains in the branch
+          devices_remaining =
+              mute_failed || ack.type != RDM_RESPONSE_TYPE_NONE;
         }
 #endif
 
@@ -183,6 +276,92 @@ int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
   return num_found;
 }
 
+int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
+                               void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(cb != NULL, 0, "cb is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+
+  // Un-mute all devices
+  const rdm_uid_t dest_uid = RDM_UID_BROADCAST_ALL;
+  rdm_send_disc_un_mute(dmx_num, &dest_uid, NULL, NULL);
+
+  const int num_found = rdm_discover_branches(dmx_num, cb, context, 0);
+
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return num_found;
+}
+
+struct rdm_disc_incremental_ctx {
+  rdm_uid_t *uids;
+  unsigned int num;
+  unsigned int max;
+  int num_new;
+  rdm_disc_cb_t cb;
+  void *context;
+};
+
+static void rdm_disc_incremental_cb(dmx_port_t dmx_num, rdm_uid_t uid,
+                                    int num_found, const rdm_disc_mute_t *mute,
+                                    void *context) {
+  struct rdm_disc_incremental_ctx *c =
+      (struct rdm_disc_incremental_ctx *)context;
+  if (c->num < c->max) {
+    c->uids[c->num] = uid;
+    ++c->num;
+  }
+  if (c->cb != NULL) {
+    c->cb(dmx_num, uid, c->num_new, mute, c->context);
+  }
+  ++c->num_new;
+}
+
+int rdm_discover_incremental(dmx_port_t dmx_num, rdm_uid_t *uids,
+                             unsigned int num, unsigned int max,
+                             rdm_disc_cb_t cb, void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, -1, "dmx_num error");
+  DMX_CHECK(uids != NULL, -1, "uids is null");
+  DMX_CHECK(num <= max, -1, "num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), -1, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+
+  // Un-mute all devices
+  rdm_uid_t dest_uid = RDM_UID_BROADCAST_ALL;
+  rdm_send_disc_un_mute(dmx_num, &dest_uid, NULL, NULL);
+
+  // Mute each known device and remove the devices that no longer respond
+  unsigned int num_verified = 0;
+  for (unsigned int i = 0; i < num; ++i) {
+    rdm_disc_mute_t mute;
+    rdm_ack_t ack;
+    dest_uid = uids[i];
+    rdm_disc_send_mute(dmx_num, &dest_uid, &mute, &ack);
+    if (ack.type == RDM_RESPONSE_TYPE_ACK) {
+      uids[num_verified] = dest_uid;
+      ++num_verified;
+    }
+  }
+
+  // Only devices which are not yet known will respond to discovery now
+  struct rdm_disc_incremental_ctx c = {.uids = uids,
+                                       .num = num_verified,
+                                       .max = max,
+                                       .num_new = 0,
+                                       .cb = cb,
+                                       .context = context};
+  rdm_discover_branches(dmx_num, &rdm_disc_incremental_cb, &c, num_verified);
+
+  xSemaphoreGiveRecursive(driver->mux);
+
+  return c.num;
+}
+
 struct rdm_disc_default_ctx {
   unsigned int num;
   rdm_uid_t *uids;
@@ -205,4 +384,62 @@ int rdm_discover_devices_simple(dmx_port_t dmx_num, rdm_uid_t *uids,
   int found = rdm_discover_with_callback(dmx_num, &rdm_disc_cb, &context);
 
   return found;
-}
\ No newline at end of file
+}
+
+static void rdm_disc_port_task(void *arg) {
+  struct rdm_disc_port_t *const port = arg;
+  port->num_found =
+      rdm_discover_with_callback(port->dmx_num, port->cb, port->context);
+  xSemaphoreGive(port->done);
+  vTaskDelete(NULL);
+}
+
+int rdm_discover_ports(const dmx_port_t *dmx_nums, int num_ports,
+                       rdm_disc_cb_t cb, void *context) {
+  DMX_CHECK(dmx_nums != NULL, -1, "dmx_nums is null");
+  DMX_CHECK(num_ports > 0 && num_ports <= DMX_NUM_MAX, -1, "num_ports error");
+  DMX_CHECK(cb != NULL, -1, "cb is null");
+  for (int i = 0; i < num_ports; ++i) {
+    DMX_CHECK(dmx_nums[i] < DMX_NUM_MAX, -1, "dmx_num error");
+    DMX_CHECK(dmx_driver_is_installed(dmx_nums[i]), -1,
+              "driver is not installed");
+    for (int j = 0; j < i; ++j) {
+      DMX_CHECK(dmx_nums[i] != dmx_nums[j], -1, "dmx_num is repeated");
+    }
+  }
+
+  SemaphoreHandle_t done = xSemaphoreCreateCounting(DMX_NUM_MAX, 0);
+  DMX_CHECK(done != NULL, -1, "discovery semaphore malloc error");
+
+  // Start a discovery task for each port except the last
+  struct rdm_disc_port_t ports[DMX_NUM_MAX];
+  int num_tasks = 0;
+  for (int i = 0; i < num_ports; ++i) {
+    ports[i] = (struct rdm_disc_port_t){.dmx_num = dmx_nums[i],
+                                        .cb = cb,
+                                        .context = context,
+                                        .num_found = 0,
+                                        .done = done};
+    if (i < num_ports - 1 &&
+        xTaskCreate(rdm_disc_port_task, "rdm_disc", RDM_DISC_TASK_STACK_SIZE,
+                    &ports[i], uxTaskPriorityGet(NULL), NULL)) {
+      ++num_tasks;
+    } else {
+      // Discover the port from this task while the other ports are discovered
+      ports[i].num_found = rdm_discover_with_callback(dmx_nums[i], cb, context);
+    }
+  }
+
+  // Wait for every discovery task to finish
+  for (int i = 0; i < num_tasks; ++i) {
+    xSemaphoreTake(done, portMAX_DELAY);
+  }
+  vSemaphoreDelete(done);
+
+  int num_found = 0;
+  for (int i = 0; i < num_ports; ++i) {
+    num_found += ports[i].num_found;
+  }
+
+  return num_found;
+}
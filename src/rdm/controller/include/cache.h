@@ -0,0 +1,135 @@
+/**
+ * @file rdm/controller/include/cache.h
+ * @author Mitch Weisbrod
+ * @brief This file contains the RDM device cache. The cache stores the UID,
+ * device info, and device label of each RDM responder on a DMX port, and is
+ * saved to non-volatile storage as a single blob per DMX port. After a reboot,
+ * the cached devices are available as soon as the cache is loaded, without
+ * running RDM discovery or requesting any parameters. Cached devices are
+ * verified lazily: the first time a cached device is read, it is probed with
+ * an RDM_PID_DISC_MUTE request and is removed from the cache if it does not
+ * respond.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+#include "rdm/controller.h"
+#include "rdm/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The version of the layout of the RDM device cache in non-volatile
+ * storage. Caches which were stored with a different version are discarded.*/
+#define RDM_CACHE_VERSION (1)
+
+/** @brief A device which is stored in the RDM device cache.*/
+typedef struct rdm_cache_entry_t {
+  /** @brief The UID of the device.*/
+  rdm_uid_t uid;
+  /** @brief The response of the device to GET RDM_PID_DEVICE_INFO.*/
+  rdm_device_info_t device_info;
+  /** @brief The response of the device to GET RDM_PID_DEVICE_LABEL. It is an
+   * empty string if the device does not support device labels.*/
+  char device_label[33];
+} rdm_cache_entry_t;
+
+/**
+ * @brief Initializes the RDM device cache on a DMX port and loads the devices
+ * which were saved to non-volatile storage. If no devices were saved, or the
+ * saved cache does not fit in the cache, the cache is initialized empty.
+ *
+ * @param dmx_num The DMX port number.
+ * @param max_devices The maximum number of devices that the cache can store.
+ * @return The number of devices which were loaded, or -1 on failure.
+ */
+int rdm_cache_init(dmx_port_t dmx_num, int max_devices);
+
+/**
+ * @brief Deinitializes the RDM device cache on a DMX port. Changes which have
+ * not been saved with rdm_cache_save() are discarded.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_cache_deinit(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the RDM device cache is initialized on a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the RDM device cache is initialized.
+ * @return false if it is not.
+ */
+bool rdm_cache_is_initialized(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the UIDs of the devices in the RDM device cache, sorted by UID.
+ * No RDM requests are sent, so the UIDs may include devices which have not yet
+ * been verified.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[out] uids An array into which to copy the UIDs, or NULL.
+ * @param size The number of UIDs which fit in the array.
+ * @return The number of devices in the cache, or -1 on failure.
+ */
+int rdm_cache_get_uids(dmx_port_t dmx_num, rdm_uid_t *uids, int size);
+
+/**
+ * @brief Gets a device from the RDM device cache. If the device has not been
+ * verified since the cache was loaded, it is probed with an RDM_PID_DISC_MUTE
+ * request which is followed by an RDM_PID_DISC_UN_MUTE request. Devices which
+ * do not respond to the probe are removed from the cache.
+ *
+ * @note Probing a device un-mutes it, so this function should not be called
+ * while RDM discovery is in progress on the DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] uid A pointer to the UID of the device.
+ * @param[out] entry A pointer into which to copy the cached device.
+ * @return true if the device is cached and has been verified.
+ * @return false if the device is not cached or did not respond to the probe.
+ */
+bool rdm_cache_get(dmx_port_t dmx_num, const rdm_uid_t *uid,
+                   rdm_cache_entry_t *entry);
+
+/**
+ * @brief Requests the device info and device label of a device and stores
+ * them in the RDM device cache. The device is added to the cache if it is not
+ * already cached.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] uid A pointer to the UID of the device.
+ * @return true if the device responded and was stored in the cache.
+ * @return false if the device did not respond or the cache is full.
+ */
+bool rdm_cache_update(dmx_port_t dmx_num, const rdm_uid_t *uid);
+
+/**
+ * @brief Refreshes the RDM device cache by performing incremental RDM
+ * discovery with the cached UIDs. Every cached device is verified, devices
+ * which do not respond are removed, and the device info and device label of
+ * each new device are requested and added to the cache.
+ *
+ * @param dmx_num The DMX port number.
+ * @return The number of devices in the cache, or -1 on failure.
+ */
+int rdm_cache_refresh(dmx_port_t dmx_num);
+
+/**
+ * @brief Saves the RDM device cache to non-volatile storage. Nothing is
+ * written if the cache has not changed since it was loaded or last saved.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_cache_save(dmx_port_t dmx_num);
+
+#ifdef __cplusplus
+}
+#endif
@@ -111,6 +111,13 @@ bool rdm_send_disc_un_mute(dmx_port_t dmx_num, const rdm_uid_t *dest_uid,
  * 588 bytes. By default, this is heap allocated but may be allocated on the
  * stack by configuring settings in this library's Kconfig.
  *
+ * @note Requests which receive no response are retried. The number of attempts
+ * adapts to the rate at which retries have received responses on the DMX port,
+ * so clean buses are retried less and lossy buses more. Short, invalid
+ * responses to RDM_PID_DISC_UNIQUE_BRANCH are treated as noise and retried,
+ * while full-length invalid responses are treated as collisions and branched
+ * immediately.
+ *
  * @param dmx_num The DMX port number.
  * @param cb A callback function which is called when a new device is found.
  * @param[inout] context Context which is passed to the callback function when a
@@ -120,6 +127,31 @@ bool rdm_send_disc_un_mute(dmx_port_t dmx_num, const rdm_uid_t *dest_uid,
 int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
                                void *context);
 
+/**
+ * @brief Performs incremental RDM device discovery using a table of previously
+ * discovered UIDs. Each known device is verified by muting it directly. Known
+ * devices which do not respond are removed from the table. The discovery
+ * algorithm is then performed with the known devices muted so that only
+ * branches of the RDM address space which contain new devices are searched.
+ * New devices are appended to the table and reported via the callback. This is
+ * significantly faster than rdm_discover_with_callback() when few devices have
+ * been added or removed since the table was last updated.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[inout] uids The table of known UIDs. It is updated to contain the UIDs
+ * of all devices which were found.
+ * @param num The number of known UIDs in the table.
+ * @param max The maximum number of UIDs that the table can store.
+ * @param cb A callback function which is called when a new device is found, or
+ * NULL.
+ * @param[inout] context Context which is passed to the callback function when a
+ * new device is found.
+ * @return The number of UIDs in the table, or -1 on failure.
+ */
+int rdm_discover_incremental(dmx_port_t dmx_num, rdm_uid_t *uids,
+                             unsigned int num, unsigned int max,
+                             rdm_disc_cb_t cb, void *context);
+
 /**
  * @brief Performs the RDM device discovery algorithm with a default callback
  * function to store the UIDs of found devices in an array.
@@ -141,6 +173,32 @@ int rdm_discover_with_callback(dmx_port_t dmx_num, rdm_disc_cb_t cb,
 int rdm_discover_devices_simple(dmx_port_t dmx_num, rdm_uid_t *uids,
                                 unsigned int num);
 
+/**
+ * @brief Performs the RDM device discovery algorithm on several DMX ports at
+ * once. A task is created for each DMX port but the last, which is discovered
+ * by the calling task, so that the total discovery time is that of the slowest
+ * DMX port rather than the sum of all of them. The discovery tasks are created
+ * with the priority of the calling task. If a task cannot be created, its DMX
+ * port is discovered by the calling task instead.
+ *
+ * @note The callback function is called from several tasks at once. It must be
+ * thread-safe, or must only access state which belongs to the DMX port which
+ * is passed to it.
+ *
+ * @note CONFIG_RDM_STATIC_DISCOVERY_INSTRUCTIONS allocates a separate
+ * discovery stack for each DMX port, so it may be used with this function.
+ *
+ * @param[in] dmx_nums An array of the DMX port numbers to discover. Each DMX
+ * port may only be included once.
+ * @param num_ports The number of DMX ports in the array.
+ * @param cb A callback function which is called when a new device is found.
+ * @param[inout] context Context which is passed to the callback function when a
+ * new device is found.
+ * @return The total number of devices found, or -1 on failure.
+ */
+int rdm_discover_ports(const dmx_port_t *dmx_nums, int num_ports,
+                       rdm_disc_cb_t cb, void *context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,108 @@
+/**
+ * @file rdm/controller/include/monitor.h
+ * @author Mitch Weisbrod
+ * @brief This file contains the RDM monitor. The monitor runs a FreeRTOS task
+ * which collects the queued messages of a set of RDM responders. Every RDM
+ * response includes a message count which is the number of messages that are
+ * waiting in the queue of the responder. The monitor records the message count
+ * of each response which is received by the RDM controller, and only sends
+ * RDM_PID_QUEUED_MESSAGE requests to responders which report that they have
+ * messages waiting. Responders which have not been heard from recently are
+ * probed with a GET RDM_PID_STATUS_MESSAGE request with a status type of
+ * RDM_STATUS_NONE, which returns their message count without any parameter
+ * data.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+#include "rdm/controller.h"
+#include "rdm/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief A callback function type which is called when the RDM monitor has
+ * received a response to an RDM_PID_QUEUED_MESSAGE request.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] uid A pointer to the UID of the responder.
+ * @param[in] ack A pointer to information about the RDM response. ack.pid is
+ * the PID of the queued message, or RDM_PID_STATUS_MESSAGE if the responder
+ * returned its status messages.
+ * @param[in] pd A pointer to the raw parameter data of the response. It is
+ * ack.pdl bytes long and may be read with the format of ack.pid.
+ * @param[inout] context A pointer to a user context.
+ */
+typedef void (*rdm_monitor_cb_t)(dmx_port_t dmx_num, const rdm_uid_t *uid,
+                                 const rdm_ack_t *ack, const void *pd,
+                                 void *context);
+
+/**
+ * @brief Starts the RDM monitor on a DMX port. A task is created which sends a
+ * GET RDM_PID_QUEUED_MESSAGE request to each responder which reported a
+ * message count greater than zero, and passes each response to the callback.
+ * The responders are served in turn so that a single responder with many
+ * messages cannot starve the others.
+ *
+ * @note The monitor task is created with the priority of the calling task. The
+ * monitor sends its requests with rdm_send_request(), so the DMX driver is
+ * shared with other RDM requests on the DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] uids An array of the UIDs to monitor, such as the UIDs found by
+ * RDM discovery. The array is copied.
+ * @param num_uids The number of UIDs in the array.
+ * @param status_type The status type which is requested with
+ * RDM_PID_QUEUED_MESSAGE. It must be RDM_STATUS_ADVISORY, RDM_STATUS_WARNING,
+ * or RDM_STATUS_ERROR.
+ * @param probe_period_ms The time in milliseconds after which a responder that
+ * has not responded to any RDM request is probed for its message count, or 0
+ * to never probe responders.
+ * @param cb The function which is called with each queued message.
+ * @param[inout] context Context which is passed to the callback function.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_monitor_start(dmx_port_t dmx_num, const rdm_uid_t *uids,
+                       int num_uids, uint8_t status_type,
+                       uint32_t probe_period_ms, rdm_monitor_cb_t cb,
+                       void *context);
+
+/**
+ * @brief Stops the RDM monitor on a DMX port. This function blocks until the
+ * monitor task has stopped.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_monitor_stop(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the RDM monitor is running on a DMX port.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the RDM monitor is running.
+ * @return false if it is not.
+ */
+bool rdm_monitor_is_running(dmx_port_t dmx_num);
+
+/**
+ * @brief Records the message count of an RDM response. This function is called
+ * by the RDM controller for every RDM response which it receives, so it only
+ * needs to be called for responses which were received by other means.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] uid A pointer to the UID of the responder.
+ * @param message_count The message count of the RDM response.
+ */
+void rdm_monitor_record(dmx_port_t dmx_num, const rdm_uid_t *uid,
+                        int message_count);
+
+#ifdef __cplusplus
+}
+#endif
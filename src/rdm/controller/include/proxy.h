@@ -0,0 +1,133 @@
+/**
+ * @file rdm/controller/include/proxy.h
+ * @author Mitch Weisbrod
+ * @brief This file contains the RDM proxy. The proxy receives RDM requests
+ * from the network over UDP, sends them on their DMX ports with the RDM
+ * scheduler, and returns each response to the address from which its request
+ * was received. Many requests may be pending at once, so a remote controller
+ * does not have to wait for each response before sending the next request.
+ * RDM_RESPONSE_TYPE_ACK_TIMER responses are collected by the RDM scheduler and
+ * RDM_RESPONSE_TYPE_ACK_OVERFLOW responses are reassembled before they are
+ * returned. The proxy is only available when CONFIG_RDM_PROXY_ENABLE is set.
+ *
+ * Every field of a datagram is sent in network byte order. A request datagram
+ * is made of the following fields:
+ * - tag, 4 bytes: A value chosen by the sender which is returned in the
+ *   response so that responses may be matched to requests.
+ * - dmx_num, 1 byte: The DMX port number on which to send the request.
+ * - cc, 1 byte: The command class of the request. It must be
+ *   RDM_CC_GET_COMMAND or RDM_CC_SET_COMMAND.
+ * - dest_uid, 6 bytes: The manufacturer ID and device ID of the destination.
+ * - sub_device, 2 bytes: The sub-device of the request.
+ * - pid, 2 bytes: The parameter ID of the request.
+ * - pdl, 1 byte: The length of the parameter data of the request.
+ * - pd, pdl bytes: The raw parameter data of the request.
+ *
+ * A response datagram is made of the following fields:
+ * - tag, 4 bytes: The tag of the request.
+ * - dmx_num, 1 byte: The DMX port number of the request.
+ * - type, 1 byte: The rdm_response_type_t of the response. It is
+ *   RDM_RESPONSE_TYPE_INVALID if the request could not be sent.
+ * - err, 1 byte: The dmx_err_t of the response.
+ * - src_uid, 6 bytes: The manufacturer ID and device ID of the responder.
+ * - pid, 2 bytes: The parameter ID of the response.
+ * - info, 2 bytes: The NACK reason of RDM_RESPONSE_TYPE_NACK_REASON responses,
+ *   or the timer in units of 100 milliseconds of RDM_RESPONSE_TYPE_ACK_TIMER
+ *   responses which could not be collected.
+ * - message_count, 1 byte: The message count of the response.
+ * - pdl, 2 bytes: The length of the parameter data of the response.
+ * - pd, pdl bytes: The raw parameter data of the response.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+#include "rdm/controller.h"
+#include "rdm/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The default UDP port on which the RDM proxy receives requests.*/
+#define RDM_PROXY_PORT_DEFAULT (5570)
+
+/** @brief The maximum number of RDM requests which may be pending on the RDM
+ * proxy at once. Requests which are received while this many requests are
+ * pending are answered with RDM_RESPONSE_TYPE_INVALID.*/
+#define RDM_PROXY_PENDING_MAX (8)
+
+/** @brief The maximum length of the parameter data of a response which is
+ * returned by the RDM proxy. Reassembled RDM_RESPONSE_TYPE_ACK_OVERFLOW
+ * responses which are longer are truncated.*/
+#define RDM_PROXY_PD_SIZE_MAX (1024)
+
+/** @brief Statistics of the requests received by the RDM proxy.*/
+typedef struct rdm_proxy_stats_t {
+  /** @brief The number of requests which were sent on a DMX port.*/
+  uint32_t requests;
+  /** @brief The number of requests which were answered with
+     RDM_RESPONSE_TYPE_INVALID because they were malformed, addressed to a DMX
+     port which is not proxied, or too many requests were pending.*/
+  uint32_t rejected;
+} rdm_proxy_stats_t;
+
+/**
+ * @brief Starts the RDM proxy. Two tasks are created: one which receives RDM
+ * requests from the network and queues them on the RDM scheduler, and one
+ * which returns their responses as they complete.
+ *
+ * @note The RDM scheduler must be running on every proxied DMX port. The tasks
+ * are created with the priority of the calling task.
+ *
+ * @param[in] dmx_nums An array of the DMX ports which may be addressed by
+ * requests.
+ * @param num_ports The number of DMX ports in the array.
+ * @param udp_port The UDP port on which to receive requests, typically
+ * RDM_PROXY_PORT_DEFAULT.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_proxy_start(const dmx_port_t *dmx_nums, int num_ports,
+                     uint16_t udp_port);
+
+/**
+ * @brief Stops the RDM proxy. This function blocks until every pending request
+ * has completed and the proxy tasks have stopped.
+ *
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_proxy_stop();
+
+/**
+ * @brief Checks if the RDM proxy is running.
+ *
+ * @return true if the RDM proxy is running.
+ * @return false if it is not.
+ */
+bool rdm_proxy_is_running();
+
+/**
+ * @brief Checks if a DMX port is one of the DMX ports of the RDM proxy.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the RDM proxy is running and proxies the DMX port.
+ * @return false if it does not.
+ */
+bool rdm_proxy_has_port(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the statistics of the requests received by the RDM proxy since
+ * it was started.
+ *
+ * @param[out] stats A pointer into which to copy the statistics.
+ * @return true on success.
+ * @return false if the RDM proxy is not running.
+ */
+bool rdm_proxy_get_stats(rdm_proxy_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+/**
+ * @file rdm/controller/include/scheduler.h
+ * @author Mitch Weisbrod
+ * @brief This file contains the RDM controller scheduler. The scheduler sends
+ * DMX packets at a guaranteed minimum refresh rate and interleaves queued RDM
+ * requests into the time remaining between DMX packets. This allows RDM
+ * requests to be sent without causing DMX dropouts on the DMX bus.
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+#include "freertos/queue.h"
+#include "rdm/controller.h"
+#include "rdm/controller/include/utils.h"
+#include "rdm/include/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The maximum number of RDM_PID_QUEUED_MESSAGE requests which are sent
+ * to collect the deferred response of an RDM request which was answered with
+ * RDM_RESPONSE_TYPE_ACK_TIMER.*/
+#define RDM_SCHEDULER_ACK_TIMER_RETRIES_MAX (8)
+
+/**
+ * @brief A callback function type which is called when an RDM request that was
+ * queued with the RDM scheduler has completed.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] ack A pointer to information about the RDM response. The contents
+ * of the ack are the same as the ack provided by rdm_send_request().
+ * @param[inout] context A pointer to a user context.
+ */
+typedef void (*rdm_scheduler_cb_t)(dmx_port_t dmx_num, const rdm_ack_t *ack,
+                                   void *context);
+
+/** @brief The result of an RDM request which was sent asynchronously. It is
+ * sent to the result queue provided to rdm_send_request_async().*/
+typedef struct rdm_async_result_t {
+  /** @brief The DMX port number on which the request was sent.*/
+  dmx_port_t dmx_num;
+  /** @brief Information about the RDM response.*/
+  rdm_ack_t ack;
+  /** @brief A pointer to the buffer which stores the response parameter
+     data.*/
+  void *pd;
+  /** @brief The user context which was provided with the request.*/
+  void *context;
+} rdm_async_result_t;
+
+/**
+ * @brief Starts the RDM scheduler. The scheduler runs a FreeRTOS task which
+ * sends a DMX packet at the start of every refresh period. Queued RDM requests
+ * are sent after the DMX packet only while it is estimated that the RDM
+ * transaction will complete before the next DMX packet must be sent. DMX data
+ * should be written using dmx_write() while the scheduler is running.
+ *
+ * @note The scheduler task is created with the priority of the calling task.
+ *
+ * @param dmx_num The DMX port number.
+ * @param refresh_rate The minimum DMX refresh rate in packets per second. If
+ * this value is 0, no DMX packets are sent and queued RDM requests are sent as
+ * soon as possible.
+ * @param size The size of the DMX packets to send. Sizes of 0 or greater than
+ * DMX_PACKET_SIZE_MAX send packets of DMX_PACKET_SIZE_MAX.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_scheduler_start(dmx_port_t dmx_num, uint32_t refresh_rate,
+                         size_t size);
+
+/**
+ * @brief Stops the RDM scheduler. RDM requests that are still queued are
+ * completed with an ack type of RDM_RESPONSE_TYPE_NONE and an error of
+ * DMX_ERR_TIMEOUT.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true on success.
+ * @return false on failure.
+ */
+bool rdm_scheduler_stop(dmx_port_t dmx_num);
+
+/**
+ * @brief Checks if the RDM scheduler is running.
+ *
+ * @param dmx_num The DMX port number.
+ * @return true if the RDM scheduler is running.
+ * @return false if the RDM scheduler is not running.
+ */
+bool rdm_scheduler_is_running(dmx_port_t dmx_num);
+
+/**
+ * @brief Queues an RDM request to be sent by the RDM scheduler. The request,
+ * the destination UID, the request parameter data, and the response parameter
+ * data buffer must remain valid until the callback is called.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] request A pointer to a request constructor.
+ * @param[in] format The RDM parameter format string for the response data.
+ * @param[out] pd A pointer to an array which will store the parameter data
+ * received in the response. This value may be NULL if no data is expected.
+ * @param size The size of the pd array.
+ * @param cb A callback function which is called when the request has
+ * completed, or NULL.
+ * @param[inout] context Context which is passed to the callback function.
+ * @return true if the request was queued.
+ * @return false if the request could not be queued.
+ */
+bool rdm_scheduler_queue_request(dmx_port_t dmx_num,
+                                 const rdm_request_t *request,
+                                 const char *format, void *pd, size_t size,
+                                 rdm_scheduler_cb_t cb, void *context);
+
+/**
+ * @brief Sends an RDM request without blocking the calling task. The request is
+ * queued on the RDM scheduler, which must be running, and is completed from the
+ * scheduler task. When the request completes, the callback is called and the
+ * result is sent to the result queue, if they are provided. The request, the
+ * destination UID, the request parameter data, and the response parameter data
+ * buffer must remain valid until the request has completed.
+ *
+ * If the responder answers with RDM_RESPONSE_TYPE_ACK_TIMER, the request is
+ * parked by the scheduler instead of completing. When the timer of the
+ * response has expired, the scheduler sends a GET RDM_PID_QUEUED_MESSAGE to
+ * the responder to collect the deferred response, and the request completes
+ * with that response. Other requests are sent while the request is parked, so
+ * many slow responders may be polled at once. The follow-up is sent again
+ * while the responder has not queued the response, at most
+ * RDM_SCHEDULER_ACK_TIMER_RETRIES_MAX times, after which the request completes
+ * with the last response which was received.
+ *
+ * @note The callback is called from within the scheduler task. It should return
+ * quickly so that DMX refresh and other queued requests are not delayed.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] request A pointer to a request constructor.
+ * @param[in] format The RDM parameter format string for the response data.
+ * @param[out] pd A pointer to an array which will store the parameter data
+ * received in the response. This value may be NULL if no data is expected.
+ * @param size The size of the pd array.
+ * @param cb A callback function which is called when the request has
+ * completed, or NULL.
+ * @param results A FreeRTOS queue of rdm_async_result_t to which the result is
+ * sent when the request has completed, or NULL.
+ * @param[inout] context Context which is passed to the callback function and
+ * is included in the result.
+ * @return true if the request was queued.
+ * @return false if the request could not be queued.
+ */
+bool rdm_send_request_async(dmx_port_t dmx_num, const rdm_request_t *request,
+                            const char *format, void *pd, size_t size,
+                            rdm_scheduler_cb_t cb, QueueHandle_t results,
+                            void *context);
+
+#ifdef __cplusplus
+}
+#endif
@@ -16,6 +16,10 @@
 extern "C" {
 #endif
 
+/** @brief The maximum number of RDM_RESPONSE_TYPE_ACK_OVERFLOW segments which
+ * are reassembled by rdm_send_request() before it fails.*/
+#define RDM_ACK_OVERFLOW_SEGMENTS_MAX (32)
+
 /**
  * @brief Type for constructing an RDM request. Contains all the necessary
  * information needed to address a request on the RDM bus.
@@ -30,6 +34,20 @@ typedef struct rdm_request_t {
   size_t pdl;      // The parameter data length of the request.
 } rdm_request_t;
 
+/**
+ * @brief Type for a single request in a batch of RDM GET requests sent with
+ * rdm_send_batch(). The response information is written back into the struct.
+ */
+typedef struct rdm_batch_request_t {
+  rdm_uid_t dest_uid;           // The destination UID of the request.
+  rdm_sub_device_t sub_device;  // The target sub-device of the request.
+  rdm_pid_t pid;                // The parameter ID.
+  const char *format;  // The format string for the response parameter data.
+  void *pd;     // A pointer to a buffer to store the response parameter data.
+  size_t size;  // The size of the response parameter data buffer.
+  rdm_ack_t ack;  // Information about the RDM response.
+} rdm_batch_request_t;
+
 /**
  * @brief Sends an RDM controller request and processes the response. This
  * function writes, sends, receives, and reads a request and response RDM
@@ -64,6 +82,15 @@ typedef struct rdm_request_t {
  * RDM_RESPONSE_TYPE_NACK_REASON, ack.nack_reason should be read to get the NACK
  * reason.
  *
+ * If the responder answers with RDM_RESPONSE_TYPE_ACK_OVERFLOW, the request is
+ * sent again until the final RDM_RESPONSE_TYPE_ACK segment is received. The
+ * DMX driver is held between segments and the parameter data of every segment
+ * is reassembled before it is decoded into pd, so ack.type is then
+ * RDM_RESPONSE_TYPE_ACK and ack.pdl is the total length of the reassembled
+ * parameter data. If a segment is not received, or if more than
+ * RDM_ACK_OVERFLOW_SEGMENTS_MAX segments are sent, ack describes the failed
+ * segment and 0 is returned.
+ *
  * @param dmx_num The DMX port number.
  * @param[in] request A pointer to a request constructor.
  * @param[in] format The RDM parameter format string for the response data. More
@@ -81,6 +108,22 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
                         const char *format, void *pd, size_t size,
                         rdm_ack_t *ack);
 
+/**
+ * @brief Sends a batch of RDM GET requests without parameter data back-to-back.
+ * The DMX driver is held for the duration of the batch and the request packet
+ * is encoded only once; only the destination UID, transaction number,
+ * sub-device, PID, and checksum are updated for each request. The results of
+ * each request are written to the ack of each request in the batch. The ack of
+ * each request is the same as the ack provided by rdm_send_request().
+ *
+ * @param dmx_num The DMX port number.
+ * @param[inout] requests An array of requests to send.
+ * @param num The number of requests in the array.
+ * @return The number of requests which received an RDM_RESPONSE_TYPE_ACK.
+ */
+size_t rdm_send_batch(dmx_port_t dmx_num, rdm_batch_request_t *requests,
+                      size_t num);
+
 /**
  * @brief Get the transaction number of the RDM controller. This number is
  * included in every RDM controller request. It is incremented after every RDM
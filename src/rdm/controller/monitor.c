@@ -0,0 +1,257 @@
+#include "include/monitor.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "rdm/controller/include/utils.h"
+#include "rdm/include/uid.h"
+
+enum {
+  RDM_MONITOR_TASK_STACK_SIZE = 4096,  // The monitor task stack in bytes.
+  RDM_MONITOR_IDLE_TICKS = dmx_ms_to_ticks(10),  // Polls for new messages.
+};
+
+typedef struct rdm_monitor_t {
+  SemaphoreHandle_t stopped;  // Is given by the monitor task when it stops.
+  portMUX_TYPE spinlock;      // Guards the message counts of the devices.
+  dmx_port_t dmx_num;         // The DMX port on which devices are monitored.
+  uint8_t status_type;        // The status type of RDM_PID_QUEUED_MESSAGE.
+  int64_t probe_period;       // Microseconds before silent devices are probed.
+  rdm_monitor_cb_t cb;        // The function which is called with messages.
+  void *context;              // Context for the callback.
+  volatile bool is_running;   // False when the monitor task should stop.
+  int next;                   // The device which is served first next time.
+  int num_devices;            // The number of monitored devices.
+  struct rdm_monitor_device_t {
+    rdm_uid_t uid;      // The UID of the device.
+    int message_count;  // The message count of its last response.
+    int64_t last_seen;  // The timestamp of its last response.
+  } devices[];  // The monitored devices, sorted by UID.
+} rdm_monitor_t;
+
+static rdm_monitor_t *rdm_monitor_context[DMX_NUM_MAX] = {};
+
+static int rdm_monitor_uid_compare(const void *a, const void *b) {
+  const rdm_uid_t *const uid_a = a;
+  const rdm_uid_t *const uid_b = b;
+  return rdm_uid_is_lt(uid_a, uid_b) ? -1 : rdm_uid_is_gt(uid_a, uid_b);
+}
+
+static int rdm_monitor_find(const rdm_monitor_t *monitor,
+                            const rdm_uid_t *uid) {
+  // Binary search the sorted devices for the UID
+  int low = 0;
+  int high = monitor->num_devices - 1;
+  while (low <= high) {
+    const int mid = (low + high) / 2;
+    const rdm_uid_t *const mid_uid = &monitor->devices[mid].uid;
+    if (rdm_uid_is_lt(mid_uid, uid)) {
+      low = mid + 1;
+    } else if (rdm_uid_is_gt(mid_uid, uid)) {
+      high = mid - 1;
+    } else {
+      return mid;
+    }
+  }
+
+  return -1;
+}
+
+static int rdm_monitor_next(rdm_monitor_t *monitor, int64_t now,
+                            bool *is_probe) {
+  int next = -1;
+  taskENTER_CRITICAL(&monitor->spinlock);
+
+  // Serve the devices with pending messages in turn
+  for (int n = 0; n < monitor->num_devices; ++n) {
+    const int i = (monitor->next + n) % monitor->num_devices;
+    if (monitor->devices[i].message_count > 0) {
+      next = i;
+      break;
+    }
+  }
+  *is_probe = false;
+
+  // Otherwise probe the device which has been silent for the longest
+  if (next < 0 && monitor->probe_period > 0) {
+    int64_t oldest = now - monitor->probe_period;
+    for (int i = 0; i < monitor->num_devices; ++i) {
+      if (monitor->devices[i].last_seen <= oldest) {
+        oldest = monitor->devices[i].last_seen;
+        next = i;
+      }
+    }
+    *is_probe = true;
+  }
+  if (next >= 0) {
+    monitor->next = (next + 1) % monitor->num_devices;
+  }
+
+  taskEXIT_CRITICAL(&monitor->spinlock);
+  return next;
+}
+
+static void rdm_monitor_task(void *arg) {
+  rdm_monitor_t *const monitor = arg;
+  const dmx_port_t dmx_num = monitor->dmx_num;
+  uint8_t pd[RDM_PD_SIZE_MAX];
+
+  while (monitor->is_running) {
+    // Wait until a device has messages or must be probed
+    const int64_t now = esp_timer_get_time();
+    bool is_probe;
+    const int i = rdm_monitor_next(monitor, now, &is_probe);
+    if (i < 0) {
+      vTaskDelay(RDM_MONITOR_IDLE_TICKS);
+      continue;
+    }
+    struct rdm_monitor_device_t *const device = &monitor->devices[i];
+
+    // Request a queued message, or only the message count when probing
+    const uint8_t status_type = is_probe ? RDM_STATUS_NONE
+                                         : monitor->status_type;
+    const rdm_request_t request = {
+        .dest_uid = &device->uid,
+        .sub_device = RDM_SUB_DEVICE_ROOT,
+        .cc = RDM_CC_GET_COMMAND,
+        .pid = is_probe ? RDM_PID_STATUS_MESSAGE : RDM_PID_QUEUED_MESSAGE,
+        .format = "b$",
+        .pd = &status_type,
+        .pdl = sizeof(status_type)};
+    rdm_ack_t ack;
+    rdm_send_request(dmx_num, &request, "b", pd, sizeof(pd), &ack);
+
+    // Stop polling devices which do not respond until they are heard from
+    if (ack.type == RDM_RESPONSE_TYPE_NONE ||
+        ack.type == RDM_RESPONSE_TYPE_INVALID) {
+      taskENTER_CRITICAL(&monitor->spinlock);
+      device->message_count = 0;
+      device->last_seen = now;
+      taskEXIT_CRITICAL(&monitor->spinlock);
+      continue;
+    }
+
+    if (!is_probe && ack.type == RDM_RESPONSE_TYPE_ACK) {
+      if (ack.pdl > sizeof(pd)) {
+        ack.pdl = sizeof(pd);
+      }
+      monitor->cb(dmx_num, &device->uid, &ack, pd, monitor->context);
+    }
+  }
+
+  xSemaphoreGive(monitor->stopped);
+  vTaskDelete(NULL);
+}
+
+bool rdm_monitor_start(dmx_port_t dmx_num, const rdm_uid_t *uids,
+                       int num_uids, uint8_t status_type,
+                       uint32_t probe_period_ms, rdm_monitor_cb_t cb,
+                       void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(uids != NULL || num_uids == 0, false, "uids is null");
+  DMX_CHECK(num_uids >= 0, false, "num_uids error");
+  DMX_CHECK(status_type >= RDM_STATUS_ADVISORY &&
+                status_type <= RDM_STATUS_ERROR,
+            false, "status_type error");
+  DMX_CHECK(cb != NULL, false, "cb is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!rdm_monitor_is_running(dmx_num), false,
+            "monitor is already running");
+
+  // Allocate the monitor and sort its devices so that they may be searched
+  const size_t size =
+      sizeof(rdm_monitor_t) + sizeof(struct rdm_monitor_device_t) * num_uids;
+  rdm_monitor_t *const monitor = heap_caps_malloc(size, MALLOC_CAP_8BIT);
+  DMX_CHECK(monitor != NULL, false, "monitor malloc error");
+  memset(monitor, 0, size);
+  monitor->stopped = xSemaphoreCreateBinary();
+  if (monitor->stopped == NULL) {
+    heap_caps_free(monitor);
+    DMX_CHECK(false, false, "monitor semaphore malloc error");
+  }
+  portMUX_INITIALIZE(&monitor->spinlock);
+  monitor->dmx_num = dmx_num;
+  monitor->status_type = status_type;
+  monitor->probe_period = (int64_t)probe_period_ms * 1000;
+  monitor->cb = cb;
+  monitor->context = context;
+  monitor->is_running = true;
+  const int64_t now = esp_timer_get_time();
+  for (int i = 0; i < num_uids; ++i) {
+    monitor->devices[i].uid = uids[i];
+    monitor->devices[i].last_seen = now;
+  }
+  qsort(monitor->devices, num_uids, sizeof(struct rdm_monitor_device_t),
+        rdm_monitor_uid_compare);
+  monitor->num_devices = num_uids;
+
+  // Let the RDM controller record message counts before the task starts
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_monitor_context[dmx_num] = monitor;
+  xSemaphoreGiveRecursive(driver->mux);
+
+  if (!xTaskCreate(rdm_monitor_task, "rdm_monitor",
+                   RDM_MONITOR_TASK_STACK_SIZE, monitor,
+                   uxTaskPriorityGet(NULL), NULL)) {
+    xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+    rdm_monitor_context[dmx_num] = NULL;
+    xSemaphoreGiveRecursive(driver->mux);
+    vSemaphoreDelete(monitor->stopped);
+    heap_caps_free(monitor);
+    DMX_CHECK(false, false, "monitor task create error");
+  }
+
+  return true;
+}
+
+bool rdm_monitor_stop(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(rdm_monitor_is_running(dmx_num), false, "monitor is not running");
+
+  rdm_monitor_t *const monitor = rdm_monitor_context[dmx_num];
+
+  // Wait for the monitor task to finish its current request
+  monitor->is_running = false;
+  xSemaphoreTake(monitor->stopped, portMAX_DELAY);
+
+  // Message counts are recorded while the DMX driver mutex is held
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_monitor_context[dmx_num] = NULL;
+  xSemaphoreGiveRecursive(driver->mux);
+
+  vSemaphoreDelete(monitor->stopped);
+  heap_caps_free(monitor);
+
+  return true;
+}
+
+bool rdm_monitor_is_running(dmx_port_t dmx_num) {
+  return dmx_num < DMX_NUM_MAX && rdm_monitor_context[dmx_num] != NULL;
+}
+
+void rdm_monitor_record(dmx_port_t dmx_num, const rdm_uid_t *uid,
+                        int message_count) {
+  if (!rdm_monitor_is_running(dmx_num) || uid == NULL ||
+      !dmx_driver_is_installed(dmx_num)) {
+    return;
+  }
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY);
+  rdm_monitor_t *const monitor = rdm_monitor_context[dmx_num];
+  const int i = monitor != NULL ? rdm_monitor_find(monitor, uid) : -1;
+  if (i >= 0) {
+    const int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&monitor->spinlock);
+    monitor->devices[i].message_count = message_count;
+    monitor->devices[i].last_seen = now;
+    taskEXIT_CRITICAL(&monitor->spinlock);
+  }
+  xSemaphoreGiveRecursive(driver->mux);
+}
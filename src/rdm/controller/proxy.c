@@ -0,0 +1,332 @@
+#include "include/proxy.h"
+
+#include <string.h>
+
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_heap_caps.h"
+#include "lwip/api.h"
+#include "lwip/pbuf.h"
+#include "rdm/controller/include/scheduler.h"
+
+enum {
+  RDM_PROXY_TASK_STACK_SIZE = 3072,  // The stack of each proxy task in bytes.
+  RDM_PROXY_RECV_TIMEOUT_MS = 100,   // Polls whether the proxy should stop.
+  RDM_PROXY_REQUEST_HEADER_SIZE = 17,   // The size of a request header.
+  RDM_PROXY_RESPONSE_HEADER_SIZE = 20,  // The size of a response header.
+};
+
+typedef struct rdm_proxy_slot_t {
+  bool is_pending;     // True while the request has not completed.
+  uint32_t tag;        // The tag which is returned with the response.
+  ip_addr_t addr;      // The address which sent the request.
+  uint16_t port;       // The UDP port which sent the request.
+  rdm_uid_t dest_uid;  // The destination UID of the request.
+  uint8_t request_pd[RDM_PD_SIZE_MAX];  // The parameter data of the request.
+  uint8_t pd[RDM_PROXY_PD_SIZE_MAX];    // The parameter data of the response.
+} rdm_proxy_slot_t;
+
+typedef struct rdm_proxy_t {
+  SemaphoreHandle_t stopped;  // Is given by each proxy task when it stops.
+  QueueHandle_t results;      // The queue of completed requests.
+  portMUX_TYPE spinlock;      // Guards the pending requests and statistics.
+  struct netconn *conn;       // The UDP connection which receives requests.
+  volatile bool is_running;   // False when the proxy tasks should stop.
+  uint32_t ports;             // A bitmask of the proxied DMX ports.
+  int num_pending;            // The number of requests which are pending.
+  rdm_proxy_stats_t stats;    // The statistics of the received requests.
+  rdm_proxy_slot_t slots[RDM_PROXY_PENDING_MAX];  // The pending requests.
+} rdm_proxy_t;
+
+static rdm_proxy_t *rdm_proxy_context = NULL;
+
+static inline uint16_t rdm_proxy_get_u16(const uint8_t *data) {
+  return (data[0] << 8) | data[1];
+}
+
+static inline uint32_t rdm_proxy_get_u32(const uint8_t *data) {
+  return ((uint32_t)rdm_proxy_get_u16(data) << 16) |
+         rdm_proxy_get_u16(data + 2);
+}
+
+static inline void rdm_proxy_set_u16(uint8_t *data, uint16_t value) {
+  data[0] = value >> 8;
+  data[1] = value;
+}
+
+static inline void rdm_proxy_set_u32(uint8_t *data, uint32_t value) {
+  rdm_proxy_set_u16(data, value >> 16);
+  rdm_proxy_set_u16(data + 2, value);
+}
+
+static void rdm_proxy_respond(rdm_proxy_t *proxy, uint32_t tag,
+                              dmx_port_t dmx_num, const ip_addr_t *addr,
+                              uint16_t port, const rdm_ack_t *ack,
+                              const void *pd) {
+  uint16_t info = 0;
+  size_t pdl = 0;
+  if (ack->type == RDM_RESPONSE_TYPE_ACK && pd != NULL) {
+    pdl = ack->pdl < RDM_PROXY_PD_SIZE_MAX ? ack->pdl : RDM_PROXY_PD_SIZE_MAX;
+  } else if (ack->type == RDM_RESPONSE_TYPE_NACK_REASON) {
+    info = ack->nack_reason;
+  } else if (ack->type == RDM_RESPONSE_TYPE_ACK_TIMER) {
+    info = (uint32_t)ack->timer * 10 / configTICK_RATE_HZ;
+  }
+
+  // Write the response directly into the packet buffer which is sent
+  struct netbuf *const buf = netbuf_new();
+  if (buf == NULL) {
+    return;
+  }
+  uint8_t *const data = netbuf_alloc(buf, RDM_PROXY_RESPONSE_HEADER_SIZE + pdl);
+  if (data != NULL) {
+    rdm_proxy_set_u32(&data[0], tag);
+    data[4] = dmx_num;
+    data[5] = ack->type;
+    data[6] = ack->err;
+    rdm_proxy_set_u16(&data[7], ack->src_uid.man_id);
+    rdm_proxy_set_u32(&data[9], ack->src_uid.dev_id);
+    rdm_proxy_set_u16(&data[13], ack->pid);
+    rdm_proxy_set_u16(&data[15], info);
+    data[17] = ack->message_count;
+    rdm_proxy_set_u16(&data[18], pdl);
+    if (pdl > 0) {
+      memcpy(&data[RDM_PROXY_RESPONSE_HEADER_SIZE], pd, pdl);
+    }
+    netconn_sendto(proxy->conn, buf, addr, port);
+  }
+  netbuf_delete(buf);
+}
+
+static rdm_proxy_slot_t *rdm_proxy_alloc(rdm_proxy_t *proxy) {
+  rdm_proxy_slot_t *slot = NULL;
+  taskENTER_CRITICAL(&proxy->spinlock);
+  for (int i = 0; i < RDM_PROXY_PENDING_MAX; ++i) {
+    if (!proxy->slots[i].is_pending) {
+      slot = &proxy->slots[i];
+      slot->is_pending = true;
+      ++proxy->num_pending;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL(&proxy->spinlock);
+
+  return slot;
+}
+
+static void rdm_proxy_free(rdm_proxy_t *proxy, rdm_proxy_slot_t *slot) {
+  taskENTER_CRITICAL(&proxy->spinlock);
+  slot->is_pending = false;
+  --proxy->num_pending;
+  taskEXIT_CRITICAL(&proxy->spinlock);
+}
+
+static bool rdm_proxy_queue(rdm_proxy_t *proxy, struct netbuf *buf,
+                            const uint8_t *header) {
+  const dmx_port_t dmx_num = header[4];
+  const rdm_cc_t cc = header[5];
+  const uint8_t pdl = header[16];
+  if (dmx_num >= DMX_NUM_MAX || !(proxy->ports & (1 << dmx_num)) ||
+      (cc != RDM_CC_GET_COMMAND && cc != RDM_CC_SET_COMMAND) ||
+      pdl >= RDM_PD_SIZE_MAX ||
+      buf->p->tot_len < RDM_PROXY_REQUEST_HEADER_SIZE + pdl) {
+    return false;
+  }
+  rdm_proxy_slot_t *const slot = rdm_proxy_alloc(proxy);
+  if (slot == NULL) {
+    return false;  // Too many requests are pending
+  }
+
+  // Copy the parameter data from the packet buffer into the pending request
+  slot->tag = rdm_proxy_get_u32(&header[0]);
+  ip_addr_copy(slot->addr, *netbuf_fromaddr(buf));
+  slot->port = netbuf_fromport(buf);
+  slot->dest_uid.man_id = rdm_proxy_get_u16(&header[6]);
+  slot->dest_uid.dev_id = rdm_proxy_get_u32(&header[8]);
+  pbuf_copy_partial(buf->p, slot->request_pd, pdl,
+                    RDM_PROXY_REQUEST_HEADER_SIZE);
+  const rdm_request_t request = {.dest_uid = &slot->dest_uid,
+                                 .sub_device = rdm_proxy_get_u16(&header[12]),
+                                 .cc = cc,
+                                 .pid = rdm_proxy_get_u16(&header[14]),
+                                 .format = pdl > 0 ? "b" : NULL,
+                                 .pd = pdl > 0 ? slot->request_pd : NULL,
+                                 .pdl = pdl};
+
+  // Responses are returned in the order in which their requests complete
+  if (!rdm_send_request_async(dmx_num, &request, "b", slot->pd,
+                              sizeof(slot->pd), NULL, proxy->results, slot)) {
+    rdm_proxy_free(proxy, slot);
+    return false;
+  }
+
+  return true;
+}
+
+static void rdm_proxy_rx_task(void *arg) {
+  rdm_proxy_t *const proxy = arg;
+
+  while (proxy->is_running) {
+    struct netbuf *buf;
+    if (netconn_recv(proxy->conn, &buf) != ERR_OK) {
+      continue;  // Timed out, check if the proxy should stop
+    }
+
+    uint8_t header[RDM_PROXY_REQUEST_HEADER_SIZE];
+    if (pbuf_copy_partial(buf->p, header, sizeof(header), 0) ==
+        sizeof(header)) {
+      const bool is_queued = rdm_proxy_queue(proxy, buf, header);
+      taskENTER_CRITICAL(&proxy->spinlock);
+      if (is_queued) {
+        ++proxy->stats.requests;
+      } else {
+        ++proxy->stats.rejected;
+      }
+      taskEXIT_CRITICAL(&proxy->spinlock);
+      if (!is_queued) {
+        const rdm_ack_t ack = {.err = DMX_OK,
+                               .type = RDM_RESPONSE_TYPE_INVALID};
+        rdm_proxy_respond(proxy, rdm_proxy_get_u32(&header[0]), header[4],
+                          netbuf_fromaddr(buf), netbuf_fromport(buf), &ack,
+                          NULL);
+      }
+    }
+    netbuf_delete(buf);
+  }
+
+  xSemaphoreGive(proxy->stopped);
+  vTaskDelete(NULL);
+}
+
+static void rdm_proxy_tx_task(void *arg) {
+  rdm_proxy_t *const proxy = arg;
+
+  while (true) {
+    // A result without a context wakes the task when the proxy is stopped
+    rdm_async_result_t result;
+    xQueueReceive(proxy->results, &result, portMAX_DELAY);
+    rdm_proxy_slot_t *const slot = result.context;
+    if (slot != NULL) {
+      rdm_proxy_respond(proxy, slot->tag, result.dmx_num, &slot->addr,
+                        slot->port, &result.ack, slot->pd);
+      rdm_proxy_free(proxy, slot);
+    }
+
+    // Stop once every pending request has completed
+    taskENTER_CRITICAL(&proxy->spinlock);
+    const bool is_done = !proxy->is_running && proxy->num_pending == 0;
+    taskEXIT_CRITICAL(&proxy->spinlock);
+    if (is_done) {
+      break;
+    }
+  }
+
+  xSemaphoreGive(proxy->stopped);
+  vTaskDelete(NULL);
+}
+
+bool rdm_proxy_start(const dmx_port_t *dmx_nums, int num_ports,
+                     uint16_t udp_port) {
+  DMX_CHECK(dmx_nums != NULL, false, "dmx_nums is null");
+  DMX_CHECK(num_ports > 0 && num_ports <= DMX_NUM_MAX, false,
+            "num_ports error");
+  DMX_CHECK(udp_port > 0, false, "udp_port error");
+  DMX_CHECK(!rdm_proxy_is_running(), false, "proxy is already running");
+  uint32_t ports = 0;
+  for (int i = 0; i < num_ports; ++i) {
+    DMX_CHECK(dmx_nums[i] < DMX_NUM_MAX, false, "dmx_num error");
+    DMX_CHECK(rdm_scheduler_is_running(dmx_nums[i]), false,
+              "scheduler is not running");
+    ports |= 1 << dmx_nums[i];
+  }
+
+  // Allocate the proxy and its queue of completed requests
+  rdm_proxy_t *const proxy = heap_caps_malloc(sizeof(*proxy), MALLOC_CAP_8BIT);
+  DMX_CHECK(proxy != NULL, false, "proxy malloc error");
+  memset(proxy, 0, sizeof(*proxy));
+  proxy->stopped = xSemaphoreCreateCounting(2, 0);
+  proxy->results =
+      xQueueCreate(RDM_PROXY_PENDING_MAX + 1, sizeof(rdm_async_result_t));
+  proxy->conn = netconn_new(NETCONN_UDP);
+  if (proxy->stopped == NULL || proxy->results == NULL || proxy->conn == NULL ||
+      netconn_bind(proxy->conn, IP4_ADDR_ANY, udp_port) != ERR_OK) {
+    if (proxy->conn != NULL) {
+      netconn_delete(proxy->conn);
+    }
+    if (proxy->results != NULL) {
+      vQueueDelete(proxy->results);
+    }
+    if (proxy->stopped != NULL) {
+      vSemaphoreDelete(proxy->stopped);
+    }
+    heap_caps_free(proxy);
+    DMX_CHECK(false, false, "proxy connection error");
+  }
+  netconn_set_recvtimeout(proxy->conn, RDM_PROXY_RECV_TIMEOUT_MS);
+  portMUX_INITIALIZE(&proxy->spinlock);
+  proxy->is_running = true;
+  proxy->ports = ports;
+
+  // Responses are sent by their own task so that requests are never delayed
+  if (!xTaskCreate(rdm_proxy_tx_task, "rdm_proxy_tx",
+                   RDM_PROXY_TASK_STACK_SIZE, proxy, uxTaskPriorityGet(NULL),
+                   NULL)) {
+    netconn_delete(proxy->conn);
+    vQueueDelete(proxy->results);
+    vSemaphoreDelete(proxy->stopped);
+    heap_caps_free(proxy);
+    DMX_CHECK(false, false, "proxy task create error");
+  }
+  rdm_proxy_context = proxy;
+  if (!xTaskCreate(rdm_proxy_rx_task, "rdm_proxy_rx",
+                   RDM_PROXY_TASK_STACK_SIZE, proxy, uxTaskPriorityGet(NULL),
+                   NULL)) {
+    // Give the stopped semaphore on behalf of the rx task
+    xSemaphoreGive(proxy->stopped);
+    rdm_proxy_stop();
+    DMX_CHECK(false, false, "proxy task create error");
+  }
+
+  return true;
+}
+
+bool rdm_proxy_stop() {
+  DMX_CHECK(rdm_proxy_is_running(), false, "proxy is not running");
+
+  rdm_proxy_t *const proxy = rdm_proxy_context;
+  rdm_proxy_context = NULL;
+
+  // Stop receiving requests and wait for the pending requests to complete
+  proxy->is_running = false;
+  xSemaphoreTake(proxy->stopped, portMAX_DELAY);
+  const rdm_async_result_t wake = {.context = NULL};
+  xQueueSend(proxy->results, &wake, portMAX_DELAY);
+  xSemaphoreTake(proxy->stopped, portMAX_DELAY);
+
+  netconn_delete(proxy->conn);
+  vQueueDelete(proxy->results);
+  vSemaphoreDelete(proxy->stopped);
+  heap_caps_free(proxy);
+
+  return true;
+}
+
+bool rdm_proxy_is_running() { return rdm_proxy_context != NULL; }
+
+bool rdm_proxy_has_port(dmx_port_t dmx_num) {
+  const rdm_proxy_t *const proxy = rdm_proxy_context;
+  return proxy != NULL && dmx_num < DMX_NUM_MAX &&
+         (proxy->ports & (1u << dmx_num));
+}
+
+bool rdm_proxy_get_stats(rdm_proxy_stats_t *stats) {
+  DMX_CHECK(stats != NULL, false, "stats is null");
+  DMX_CHECK(rdm_proxy_is_running(), false, "proxy is not running");
+
+  rdm_proxy_t *const proxy = rdm_proxy_context;
+  taskENTER_CRITICAL(&proxy->spinlock);
+  *stats = proxy->stats;
+  taskEXIT_CRITICAL(&proxy->spinlock);
+
+  return true;
+}
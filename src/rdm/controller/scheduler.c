@@ -0,0 +1,449 @@
+#include "include/scheduler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "dmx/hal/include/timer.h"
+#include "dmx/include/driver.h"
+#include "dmx/include/service.h"
+#include "esp_timer.h"
+#include "rdm/include/driver.h"
+#include "rdm/include/uid.h"
+
+#ifdef CONFIG_RDM_SCHEDULER_QUEUE_SIZE
+/** @brief The number of RDM requests which may be queued on the scheduler.*/
+#define RDM_SCHEDULER_QUEUE_SIZE CONFIG_RDM_SCHEDULER_QUEUE_SIZE
+#else
+/** @brief The number of RDM requests which may be queued on the scheduler.*/
+#define RDM_SCHEDULER_QUEUE_SIZE 16
+#endif
+
+enum {
+  RDM_SCHEDULER_SLOT_LEN_US = 44,  // The length of one slot at 250k baud.
+  RDM_SCHEDULER_TASK_STACK_SIZE = 4096,  // The scheduler task stack in bytes.
+  RDM_SCHEDULER_IDLE_TICKS = dmx_ms_to_ticks(100),  // Polls for a stop.
+  RDM_SCHEDULER_RETRY_US = 100000,  // The wait before re-polling a responder.
+};
+
+typedef struct rdm_scheduler_transaction_t {
+  rdm_request_t request;  // The request to send.
+  rdm_uid_t dest_uid;     // A copy of the destination UID of the request.
+  const char *format;     // The format string of the response data.
+  void *pd;               // The buffer in which to store the response data.
+  size_t size;            // The size of the response data buffer.
+  rdm_scheduler_cb_t cb;  // The callback to call when the request completes.
+  QueueHandle_t results;  // The queue to which the result is sent, or NULL.
+  void *context;          // The context passed to the callback.
+  int64_t deadline;       // When a parked request may be followed up.
+  int retries;            // The number of RDM_PID_QUEUED_MESSAGE follow-ups.
+} rdm_scheduler_transaction_t;
+
+static struct rdm_scheduler_t {
+  TaskHandle_t task;           // The handle of the scheduler task.
+  QueueHandle_t queue;         // The queue of pending RDM requests.
+  rdm_scheduler_transaction_t *parked;  // Requests which got an ACK_TIMER.
+  int num_parked;              // The number of parked requests.
+  esp_timer_handle_t timer;    // The timer which starts each refresh period.
+  SemaphoreHandle_t tick;      // Is given at the start of each refresh period.
+  SemaphoreHandle_t done;      // Is given when the task or last sender exits.
+  int senders;                 // The number of tasks queueing a request.
+  bool is_stopping;            // True while a stop waits for the senders.
+  uint32_t period;             // The refresh period in microseconds.
+  size_t size;                 // The size of the DMX packets to send.
+  volatile bool is_running;    // True while the scheduler task should run.
+} rdm_scheduler[DMX_NUM_MAX] = {};
+
+static void rdm_scheduler_timer_cb(void *arg) {
+  // Task notifications are used by the DMX driver while the task is blocked
+  xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+
+static int64_t rdm_scheduler_get_duration(
+    dmx_port_t dmx_num, const rdm_scheduler_transaction_t *transaction) {
+  const dmx_driver_t *driver = dmx_driver[dmx_num];
+  const rdm_request_t *request = &transaction->request;
+
+  // The length of the request packet including the RDM checksum
+  int64_t duration = RDM_TIMING_CONTROLLER_REQUEST_TO_REQUEST_MIN +
+                     driver->break_len + driver->mab_len +
+                     (24 + request->pdl + 2) * RDM_SCHEDULER_SLOT_LEN_US;
+
+  // The worst-case length of the response and the following request spacing
+  if (!rdm_uid_is_broadcast(&transaction->dest_uid) ||
+      request->pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+    duration += RDM_TIMING_CONTROLLER_REQUEST_TO_RESPONSE_MAX +
+                RDM_BREAK_LEN_MAX_US + RDM_MAB_LEN_MAX_US +
+                (24 + transaction->size + 2) * RDM_SCHEDULER_SLOT_LEN_US +
+                RDM_TIMING_CONTROLLER_RESPONSE_LOST_MIN;
+  } else {
+    duration += RDM_TIMING_CONTROLLER_REQUEST_TO_REQUEST_MIN;
+  }
+
+  return duration;
+}
+
+static bool rdm_scheduler_park(struct rdm_scheduler_t *scheduler,
+                               const rdm_scheduler_transaction_t *transaction,
+                               int64_t deadline) {
+  if (scheduler->num_parked == RDM_SCHEDULER_QUEUE_SIZE ||
+      transaction->retries == RDM_SCHEDULER_ACK_TIMER_RETRIES_MAX) {
+    return false;
+  }
+  rdm_scheduler_transaction_t *const parked =
+      &scheduler->parked[scheduler->num_parked];
+  *parked = *transaction;
+  parked->deadline = deadline;
+  ++parked->retries;
+  ++scheduler->num_parked;
+
+  return true;
+}
+
+static int rdm_scheduler_find_parked(const struct rdm_scheduler_t *scheduler,
+                                     int64_t now) {
+  // Find the parked request whose deadline expired first
+  int next = -1;
+  for (int i = 0; i < scheduler->num_parked; ++i) {
+    if (scheduler->parked[i].deadline <= now &&
+        (next < 0 ||
+         scheduler->parked[i].deadline < scheduler->parked[next].deadline)) {
+      next = i;
+    }
+  }
+
+  return next;
+}
+
+static void rdm_scheduler_unpark(struct rdm_scheduler_t *scheduler, int i,
+                                 rdm_scheduler_transaction_t *transaction) {
+  // Move the last parked request into the gap that is left behind
+  *transaction = scheduler->parked[i];
+  --scheduler->num_parked;
+  scheduler->parked[i] = scheduler->parked[scheduler->num_parked];
+}
+
+static TickType_t rdm_scheduler_get_wait_ticks(
+    const struct rdm_scheduler_t *scheduler, int64_t now) {
+  // Wake when the earliest parked request may be followed up
+  TickType_t wait_ticks = RDM_SCHEDULER_IDLE_TICKS;
+  for (int i = 0; i < scheduler->num_parked; ++i) {
+    const int64_t remaining = scheduler->parked[i].deadline - now;
+    const TickType_t ticks =
+        remaining > 0 ? dmx_ms_to_ticks((remaining + 999) / 1000) : 0;
+    if (ticks < wait_ticks) {
+      wait_ticks = ticks;
+    }
+  }
+
+  return wait_ticks;
+}
+
+static void rdm_scheduler_complete(dmx_port_t dmx_num,
+                                   rdm_scheduler_transaction_t *transaction,
+                                   bool send) {
+  rdm_ack_t ack = {.err = DMX_ERR_TIMEOUT, .type = RDM_RESPONSE_TYPE_NONE};
+  if (send) {
+    transaction->request.dest_uid = &transaction->dest_uid;
+    if (transaction->retries == 0) {
+      rdm_send_request(dmx_num, &transaction->request, transaction->format,
+                       transaction->pd, transaction->size, &ack);
+    } else {
+      // Collect the deferred response from the queue of the responder
+      const uint8_t status_type = RDM_STATUS_ERROR;
+      const rdm_request_t request = {.dest_uid = &transaction->dest_uid,
+                                     .sub_device = RDM_SUB_DEVICE_ROOT,
+                                     .cc = RDM_CC_GET_COMMAND,
+                                     .pid = RDM_PID_QUEUED_MESSAGE,
+                                     .format = "b$",
+                                     .pd = &status_type,
+                                     .pdl = sizeof(status_type)};
+      rdm_send_request(dmx_num, &request, transaction->format,
+                       transaction->pd, transaction->size, &ack);
+    }
+
+    // Park the request until the responder is expected to be ready
+    struct rdm_scheduler_t *const scheduler = &rdm_scheduler[dmx_num];
+    const int64_t now = esp_timer_get_time();
+    if (ack.type == RDM_RESPONSE_TYPE_ACK_TIMER) {
+      const int64_t timer = (int64_t)ack.timer * 1000000 / configTICK_RATE_HZ;
+      if (rdm_scheduler_park(scheduler, transaction, now + timer)) {
+        return;
+      }
+    } else if (transaction->retries > 0 && !ack.err &&
+               ack.type == RDM_RESPONSE_TYPE_ACK &&
+               ack.pid != transaction->request.pid) {
+      // The responder sent another queued message or its status messages
+      if (rdm_scheduler_park(scheduler, transaction,
+                             now + RDM_SCHEDULER_RETRY_US)) {
+        return;
+      }
+    }
+  }
+  if (transaction->cb != NULL) {
+    transaction->cb(dmx_num, &ack, transaction->context);
+  }
+  if (transaction->results != NULL) {
+    const rdm_async_result_t result = {.dmx_num = dmx_num,
+                                       .ack = ack,
+                                       .pd = transaction->pd,
+                                       .context = transaction->context};
+    xQueueSend(transaction->results, &result, 0);
+  }
+}
+
+static void rdm_scheduler_task(void *arg) {
+  const dmx_port_t dmx_num = (dmx_port_t)(intptr_t)arg;
+  struct rdm_scheduler_t *const scheduler = &rdm_scheduler[dmx_num];
+  rdm_scheduler_transaction_t transaction;
+
+  while (scheduler->is_running) {
+    // Send RDM requests as soon as they are queued if DMX is not refreshed
+    if (scheduler->period == 0) {
+      const int64_t now = esp_timer_get_time();
+      const int parked = rdm_scheduler_find_parked(scheduler, now);
+      if (parked >= 0) {
+        rdm_scheduler_unpark(scheduler, parked, &transaction);
+        rdm_scheduler_complete(dmx_num, &transaction, scheduler->is_running);
+      } else if (xQueueReceive(scheduler->queue, &transaction,
+                               rdm_scheduler_get_wait_ticks(scheduler, now))) {
+        rdm_scheduler_complete(dmx_num, &transaction, scheduler->is_running);
+      }
+      continue;
+    }
+
+    // Wait for the start of the next refresh period
+    xSemaphoreTake(scheduler->tick, portMAX_DELAY);
+    if (!scheduler->is_running) {
+      break;
+    }
+    const int64_t period_start = esp_timer_get_time();
+
+    // Send the DMX packet first so that DMX refresh is never stalled
+    dmx_send_num(dmx_num, scheduler->size);
+    dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23));
+
+    // Follow up parked requests before the queued requests are sent
+    while (true) {
+      const int64_t now = esp_timer_get_time();
+      const int parked = rdm_scheduler_find_parked(scheduler, now);
+      if (parked >= 0) {
+        transaction = scheduler->parked[parked];
+      } else if (!xQueuePeek(scheduler->queue, &transaction, 0)) {
+        break;
+      }
+
+      // Interleave RDM requests while they fit before the next DMX packet
+      const int64_t elapsed = now - period_start;
+      const int64_t duration = rdm_scheduler_get_duration(dmx_num,
+                                                          &transaction);
+      if (elapsed + duration > scheduler->period) {
+        break;  // The RDM request must wait for the next gap
+      }
+      if (parked >= 0) {
+        rdm_scheduler_unpark(scheduler, parked, &transaction);
+      } else {
+        xQueueReceive(scheduler->queue, &transaction, 0);
+      }
+      rdm_scheduler_complete(dmx_num, &transaction, true);
+    }
+  }
+
+  // Complete any remaining requests without sending them
+  while (scheduler->num_parked > 0) {
+    rdm_scheduler_unpark(scheduler, 0, &transaction);
+    rdm_scheduler_complete(dmx_num, &transaction, false);
+  }
+  while (xQueueReceive(scheduler->queue, &transaction, 0)) {
+    rdm_scheduler_complete(dmx_num, &transaction, false);
+  }
+
+  scheduler->task = NULL;
+  xSemaphoreGive(scheduler->done);
+  vTaskDelete(NULL);
+}
+
+bool rdm_scheduler_start(dmx_port_t dmx_num, uint32_t refresh_rate,
+                         size_t size) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(!dmx_auto_refresh_is_enabled(dmx_num), false,
+            "driver is auto-refreshing");
+  DMX_CHECK(!rdm_scheduler_is_running(dmx_num), false,
+            "scheduler is already running");
+
+  struct rdm_scheduler_t *const scheduler = &rdm_scheduler[dmx_num];
+
+  // Clamp size to the maximum DMX packet size
+  if (size == 0 || size > DMX_PACKET_SIZE_MAX) {
+    size = DMX_PACKET_SIZE_MAX;
+  }
+  scheduler->period = refresh_rate > 0 ? 1000000 / refresh_rate : 0;
+  scheduler->size = size;
+
+  // Allocate the request queue
+  scheduler->queue = xQueueCreate(RDM_SCHEDULER_QUEUE_SIZE,
+                                  sizeof(rdm_scheduler_transaction_t));
+  DMX_CHECK(scheduler->queue != NULL, false, "scheduler queue malloc error");
+  scheduler->parked =
+      malloc(sizeof(rdm_scheduler_transaction_t) * RDM_SCHEDULER_QUEUE_SIZE);
+  if (scheduler->parked == NULL) {
+    vQueueDelete(scheduler->queue);
+    DMX_CHECK(false, false, "scheduler malloc error");
+  }
+  scheduler->num_parked = 0;
+  scheduler->senders = 0;
+  scheduler->is_stopping = false;
+  scheduler->tick = xSemaphoreCreateBinary();
+  scheduler->done = xSemaphoreCreateBinary();
+  if (scheduler->tick == NULL || scheduler->done == NULL) {
+    if (scheduler->tick != NULL) {
+      vSemaphoreDelete(scheduler->tick);
+    }
+    if (scheduler->done != NULL) {
+      vSemaphoreDelete(scheduler->done);
+    }
+    vQueueDelete(scheduler->queue);
+    free(scheduler->parked);
+    DMX_CHECK(false, false, "scheduler semaphore malloc error");
+  }
+
+  // Create the scheduler task
+  scheduler->is_running = true;
+  if (!xTaskCreate(rdm_scheduler_task, "rdm_scheduler",
+                   RDM_SCHEDULER_TASK_STACK_SIZE, (void *)(intptr_t)dmx_num,
+                   uxTaskPriorityGet(NULL), &scheduler->task)) {
+    scheduler->is_running = false;
+    vSemaphoreDelete(scheduler->tick);
+    vSemaphoreDelete(scheduler->done);
+    vQueueDelete(scheduler->queue);
+    free(scheduler->parked);
+    DMX_CHECK(false, false, "scheduler task create error");
+  }
+
+  // Start the refresh period timer if DMX packets are to be sent
+  if (scheduler->period == 0) {
+    scheduler->timer = NULL;
+    return true;
+  }
+  const esp_timer_create_args_t timer_args = {
+      .callback = rdm_scheduler_timer_cb,
+      .arg = scheduler->tick,
+      .name = "rdm_scheduler"};
+  if (esp_timer_create(&timer_args, &scheduler->timer) != ESP_OK) {
+    scheduler->is_running = false;
+    xSemaphoreGive(scheduler->tick);
+    xSemaphoreTake(scheduler->done, portMAX_DELAY);
+    vSemaphoreDelete(scheduler->tick);
+    vSemaphoreDelete(scheduler->done);
+    vQueueDelete(scheduler->queue);
+    free(scheduler->parked);
+    DMX_CHECK(false, false, "scheduler timer create error");
+  }
+  esp_timer_start_periodic(scheduler->timer, scheduler->period);
+  xSemaphoreGive(scheduler->tick);  // Send the first DMX packet immediately
+
+  return true;
+}
+
+bool rdm_scheduler_stop(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+  DMX_CHECK(rdm_scheduler_is_running(dmx_num), false,
+            "scheduler is not running");
+
+  struct rdm_scheduler_t *const scheduler = &rdm_scheduler[dmx_num];
+
+  // Stop the timer and wait for the scheduler task to finish
+  if (scheduler->timer != NULL) {
+    esp_timer_stop(scheduler->timer);
+    esp_timer_delete(scheduler->timer);
+  }
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  scheduler->is_running = false;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  xSemaphoreGive(scheduler->tick);
+  xSemaphoreTake(scheduler->done, portMAX_DELAY);
+
+  // Wait for requests which are being queued before deleting the queue
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const bool is_sending = scheduler->senders > 0;
+  scheduler->is_stopping = is_sending;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (is_sending) {
+    xSemaphoreTake(scheduler->done, portMAX_DELAY);
+  }
+  rdm_scheduler_transaction_t transaction;
+  while (xQueueReceive(scheduler->queue, &transaction, 0)) {
+    rdm_scheduler_complete(dmx_num, &transaction, false);
+  }
+  vQueueDelete(scheduler->queue);
+  scheduler->queue = NULL;
+  vSemaphoreDelete(scheduler->tick);
+  scheduler->tick = NULL;
+  vSemaphoreDelete(scheduler->done);
+  scheduler->done = NULL;
+  free(scheduler->parked);
+  scheduler->parked = NULL;
+
+  return true;
+}
+
+bool rdm_scheduler_is_running(dmx_port_t dmx_num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+
+  return rdm_scheduler[dmx_num].is_running;
+}
+
+bool rdm_scheduler_queue_request(dmx_port_t dmx_num,
+                                 const rdm_request_t *request,
+                                 const char *format, void *pd, size_t size,
+                                 rdm_scheduler_cb_t cb, void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(request != NULL, false, "request is null");
+
+  return rdm_send_request_async(dmx_num, request, format, pd, size, cb, NULL,
+                                context);
+}
+
+bool rdm_send_request_async(dmx_port_t dmx_num, const rdm_request_t *request,
+                            const char *format, void *pd, size_t size,
+                            rdm_scheduler_cb_t cb, QueueHandle_t results,
+                            void *context) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
+  DMX_CHECK(request != NULL, false, "request is null");
+  DMX_CHECK(request->dest_uid != NULL, false, "dest_uid is null");
+  DMX_CHECK(rdm_cc_is_request(request->cc), false, "cc error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
+
+  // Prevent rdm_scheduler_stop() from deleting the queue until it is sent
+  struct rdm_scheduler_t *const scheduler = &rdm_scheduler[dmx_num];
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const bool is_running = scheduler->is_running;
+  if (is_running) {
+    ++scheduler->senders;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  DMX_CHECK(is_running, false, "scheduler is not running");
+
+  rdm_scheduler_transaction_t transaction = {.request = *request,
+                                             .dest_uid = *request->dest_uid,
+                                             .format = format,
+                                             .pd = pd,
+                                             .size = size,
+                                             .cb = cb,
+                                             .results = results,
+                                             .context = context};
+
+  const bool is_queued = xQueueSend(scheduler->queue, &transaction, 0);
+
+  // Wake rdm_scheduler_stop() if it is waiting for the last sender
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  --scheduler->senders;
+  const bool is_last = scheduler->senders == 0 && scheduler->is_stopping;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (is_last) {
+    xSemaphoreGive(scheduler->done);
+  }
+
+  return is_queued;
+}
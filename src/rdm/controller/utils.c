@@ -1,66 +1,54 @@
 #include "rdm/controller/include/utils.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 #include "dmx/include/driver.h"
 #include "dmx/include/service.h"
+#include "endian.h"
+#include "rdm/controller/include/monitor.h"
 #include "rdm/include/driver.h"
+#include "rdm/include/format.h"
 #include "rdm/include/uid.h"
 
-size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
-                        const char *format, void *pd, size_t size,
-                        rdm_ack_t *ack) {
-  assert(dmx_num < DMX_NUM_MAX);
-  assert(request != NULL);
-  assert(request->dest_uid != NULL);
-  assert(request->sub_device < RDM_SUB_DEVICE_MAX ||
-         request->sub_device == RDM_SUB_DEVICE_ALL);
-  assert(request->pid > 0);
-  assert(rdm_cc_is_valid(request->cc) && rdm_cc_is_request(request->cc));
-  assert(request->sub_device != RDM_SUB_DEVICE_ALL ||
-         request->cc == RDM_CC_SET_COMMAND);
-  assert(rdm_format_is_valid(request->format));
-  assert(request->format != NULL || request->pd == NULL);
-  assert(request->pd != NULL || request->pdl == 0);
-  assert(request->pdl < RDM_PD_SIZE_MAX);
-  assert(rdm_format_is_valid(format));
-  assert(dmx_driver_is_installed(dmx_num));
-
-  dmx_driver_t *const driver = dmx_driver[dmx_num];
-
-  // Attempt to take the mutex and wait until the driver is done sending
-  if (!xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY)) {
-    return 0;
-  }
-  if (!dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23))) {
-    xSemaphoreGiveRecursive(driver->mux);
-    return 0;
+static void rdm_controller_save_slots(dmx_driver_t *driver) {
+  // Receiving a response may swap the data buffer or overwrite any slot
+  if (driver->rdm.controller_depth++ > 0) {
+    return;  // The outermost transaction has already saved the slots
   }
+  const size_t size = dmx_packet_size_max(driver);
 
-  // Construct the header using the default arguments and the caller's arguments
-  rdm_header_t header = {
-      .message_len = 24 + request->pdl,
-      .tn = rdm_get_transaction_num(dmx_num),
-      .port_id = dmx_num + 1,
-      .message_count = 0,
-      .sub_device = request->sub_device,
-      .cc = request->cc,
-      .pid = request->pid,
-      .pdl = request->pdl,
-  };
-  memcpy(&header.dest_uid, request->dest_uid, sizeof(header.dest_uid));
-  memcpy(&header.src_uid, rdm_uid_get(dmx_num), sizeof(header.src_uid));
+  // Pin the data buffer so that it can be copied outside of the spinlock
+  const uint8_t *data;
+  bool was_acquired;
+  taskENTER_CRITICAL(DMX_SPINLOCK(driver->dmx_num));
+  was_acquired = driver->dmx.data_is_acquired;
+  driver->dmx.data_is_acquired = true;
+  data = driver->dmx.data;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(driver->dmx_num));
+  memcpy(driver->rdm.controller_slots, data, size);
+  if (!was_acquired) {
+    taskENTER_CRITICAL(DMX_SPINLOCK(driver->dmx_num));
+    driver->dmx.data_is_acquired = false;
+    taskEXIT_CRITICAL(DMX_SPINLOCK(driver->dmx_num));
+  }
+}
 
-  // Copy the old data in the DMX buffer to a temporary buffer
-  uint8_t old_data[257];
-  const size_t packet_size = header.message_len + 2; 
-  dmx_read(dmx_num, old_data, packet_size);
+static void rdm_controller_restore_slots(dmx_driver_t *driver) {
+  if (--driver->rdm.controller_depth > 0) {
+    return;
+  }
+  dmx_write(driver->dmx_num, driver->rdm.controller_slots,
+            dmx_packet_size_max(driver));
+}
 
-  // Write and send the RDM request
-  rdm_write(dmx_num, &header, request->format, request->pd);
+static size_t rdm_send_and_receive(dmx_port_t dmx_num,
+                                   const rdm_uid_t *dest_uid, rdm_pid_t pid,
+                                   const char *format, void *pd, size_t size,
+                                   rdm_ack_t *ack) {
+  // Send the RDM request which has been written to the DMX driver buffer
+  rdm_header_t header;
   if (!dmx_send(dmx_num)) {
-    dmx_write(dmx_num, old_data, packet_size);  // Write old data back
-    xSemaphoreGiveRecursive(driver->mux);
     if (ack != NULL) {
       ack->err = DMX_OK;
       ack->size = 0;
@@ -74,11 +62,8 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
   }
 
   // Return early if no response is expected
-  if (rdm_uid_is_broadcast(request->dest_uid) &&
-      request->pid != RDM_PID_DISC_UNIQUE_BRANCH) {
+  if (rdm_uid_is_broadcast(dest_uid) && pid != RDM_PID_DISC_UNIQUE_BRANCH) {
     dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23));
-    dmx_write(dmx_num, old_data, packet_size);  // Write old data back
-    xSemaphoreGiveRecursive(driver->mux);
     if (ack != NULL) {
       ack->err = DMX_OK;
       ack->size = 0;
@@ -101,8 +86,6 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
 
   // Return early if no response was received
   if (packet.size == 0) {
-    dmx_write(dmx_num, old_data, packet_size);  // Write old data back
-    xSemaphoreGiveRecursive(driver->mux);
     if (ack != NULL) {
       ack->src_uid = (rdm_uid_t){0, 0};
       ack->pid = 0;
@@ -115,8 +98,6 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
 
   // Return early if the response checksum was invalid
   if (!rdm_read_header(dmx_num, &header)) {
-    dmx_write(dmx_num, old_data, packet_size);  // Write old data back
-    xSemaphoreGiveRecursive(driver->mux);
     if (ack != NULL) {
       ack->src_uid = (rdm_uid_t){0, 0};
       ack->pid = 0;
@@ -127,6 +108,11 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
     return 0;
   }
 
+  // Let the RDM monitor know if the responder has queued messages
+  if (header.pid != RDM_PID_DISC_UNIQUE_BRANCH) {
+    rdm_monitor_record(dmx_num, &header.src_uid, header.message_count);
+  }
+
   // Copy the parameter data into the output
   if (header.response_type == RDM_RESPONSE_TYPE_ACK &&
       header.pid != RDM_PID_DISC_UNIQUE_BRANCH) {
@@ -161,11 +147,7 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
     ack->message_count = header.message_count;
   }
 
-  // Write the old data from before the request back into the DMX driver
-  dmx_write(dmx_num, old_data, packet_size);
-
-  // Give the mutex back and return the PDL or true on success
-  xSemaphoreGiveRecursive(driver->mux);
+  // Return the PDL or true on success
   if (header.response_type == RDM_RESPONSE_TYPE_ACK) {
     if (header.pdl == 0) {
       return 1;
@@ -173,9 +155,213 @@ size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
       return header.pdl;
     }
   } else {
+    return 0;
+  }
+}
 
+static size_t rdm_send_overflow(dmx_port_t dmx_num, rdm_header_t *header,
+                                const rdm_request_t *request,
+                                const char *format, void *pd, size_t size,
+                                rdm_ack_t *ack) {
+  // Copy the raw parameter data of each segment so that it is decoded once
+  uint8_t *raw = NULL;
+  if (pd != NULL && format != NULL && size > 0) {
+    raw = malloc(size);
+    if (raw == NULL) {
+      return 0;
+    }
+  }
+
+  size_t pdl = 0;
+  for (int i = 0; i < RDM_ACK_OVERFLOW_SEGMENTS_MAX; ++i) {
+    if (raw != NULL && pdl < size) {
+      const size_t len = ack->pdl < size - pdl ? ack->pdl : size - pdl;
+      dmx_read_offset(dmx_num, 24, &raw[pdl], len);
+    }
+    pdl += ack->pdl;
+    if (ack->type == RDM_RESPONSE_TYPE_ACK) {
+      break;
+    }
+
+    // Request the next segment while the DMX driver is still held
+    header->tn = rdm_get_transaction_num(dmx_num);
+    rdm_write(dmx_num, header, request->format, request->pd);
+    rdm_send_and_receive(dmx_num, request->dest_uid, request->pid, NULL, NULL,
+                         0, ack);
+    if (ack->err || ack->pid != request->pid ||
+        (ack->type != RDM_RESPONSE_TYPE_ACK &&
+         ack->type != RDM_RESPONSE_TYPE_ACK_OVERFLOW)) {
+      free(raw);
+      return 0;
+    }
+  }
+
+  // Fail if the responder sent more segments than are allowed
+  if (ack->type != RDM_RESPONSE_TYPE_ACK) {
+    free(raw);
     return 0;
   }
+
+  // Decode the reassembled parameter data into the caller's buffer
+  if (raw != NULL) {
+    uint8_t ops[RDM_FORMAT_OPS_MAX];
+    rdm_format_to_ops(ops, format);
+    const bool encode_nulls = true;
+    rdm_format_encode(pd, ops, raw, pdl < size ? pdl : size, encode_nulls);
+    free(raw);
+  }
+  ack->pdl = pdl;
+
+  return pdl == 0 ? 1 : pdl;
+}
+
+size_t rdm_send_request(dmx_port_t dmx_num, const rdm_request_t *request,
+                        const char *format, void *pd, size_t size,
+                        rdm_ack_t *ack) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(request != NULL);
+  assert(request->dest_uid != NULL);
+  assert(request->sub_device < RDM_SUB_DEVICE_MAX ||
+         request->sub_device == RDM_SUB_DEVICE_ALL);
+  assert(request->pid > 0);
+  assert(rdm_cc_is_valid(request->cc) && rdm_cc_is_request(request->cc));
+  assert(request->sub_device != RDM_SUB_DEVICE_ALL ||
+         request->cc == RDM_CC_SET_COMMAND);
+  assert(rdm_format_is_valid(request->format));
+  assert(request->format != NULL || request->pd == NULL);
+  assert(request->pd != NULL || request->pdl == 0);
+  assert(request->pdl < RDM_PD_SIZE_MAX);
+  assert(rdm_format_is_valid(format));
+  assert(dmx_driver_is_installed(dmx_num));
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Attempt to take the mutex and wait until the driver is done sending
+  if (!xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY)) {
+    return 0;
+  }
+  if (!dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23))) {
+    xSemaphoreGiveRecursive(driver->mux);
+    return 0;
+  }
+
+  // Construct the header using the default arguments and the caller's arguments
+  rdm_header_t header = {
+      .message_len = 24 + request->pdl,
+      .tn = rdm_get_transaction_num(dmx_num),
+      .port_id = dmx_num + 1,
+      .message_count = 0,
+      .sub_device = request->sub_device,
+      .cc = request->cc,
+      .pid = request->pid,
+      .pdl = request->pdl,
+  };
+  memcpy(&header.dest_uid, request->dest_uid, sizeof(header.dest_uid));
+  memcpy(&header.src_uid, rdm_uid_get(dmx_num), sizeof(header.src_uid));
+
+  // Save the DMX slots so that they can be restored after the response
+  rdm_controller_save_slots(driver);
+
+  // Write and send the RDM request
+  rdm_ack_t overflow_ack;
+  if (ack == NULL) {
+    ack = &overflow_ack;
+  }
+  rdm_write(dmx_num, &header, request->format, request->pd);
+  size_t ret = rdm_send_and_receive(dmx_num, request->dest_uid, request->pid,
+                                    format, pd, size, ack);
+
+  // Collect the remaining segments if the response overflowed
+  if (!ack->err && ack->type == RDM_RESPONSE_TYPE_ACK_OVERFLOW &&
+      ack->pid == request->pid) {
+    ret = rdm_send_overflow(dmx_num, &header, request, format, pd, size, ack);
+  }
+
+  // Write the DMX slots from before the request back into the DMX driver
+  rdm_controller_restore_slots(driver);
+
+  // Give the mutex back and return the PDL or true on success
+  xSemaphoreGiveRecursive(driver->mux);
+  return ret;
+}
+
+size_t rdm_send_batch(dmx_port_t dmx_num, rdm_batch_request_t *requests,
+                      size_t num) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(requests != NULL || num == 0, 0, "requests is null");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Attempt to take the mutex and wait until the driver is done sending
+  if (!xSemaphoreTakeRecursive(driver->mux, portMAX_DELAY)) {
+    return 0;
+  }
+  if (!dmx_wait_sent(dmx_num, dmx_ms_to_ticks(23))) {
+    xSemaphoreGiveRecursive(driver->mux);
+    return 0;
+  }
+
+  // Save the DMX slots so that they can be restored after the responses
+  rdm_controller_save_slots(driver);
+
+  // Encode a request template once so that only a few fields must be patched
+  rdm_header_t header = {.message_len = 24,
+                         .port_id = dmx_num + 1,
+                         .sub_device = RDM_SUB_DEVICE_ROOT,
+                         .cc = RDM_CC_GET_COMMAND,
+                         .pid = 0,
+                         .pdl = 0};
+  memcpy(&header.src_uid, rdm_uid_get(dmx_num), sizeof(header.src_uid));
+  rdm_write(dmx_num, &header, NULL, NULL);
+  uint8_t packet[26];
+  dmx_read(dmx_num, packet, sizeof(packet));
+
+  // The packet checksum skips the dest UID, TN, sub-device, and PID fields
+  uint16_t packet_checksum = 0;
+  for (int i = 0; i < 24; ++i) {
+    packet_checksum += packet[i];
+  }
+
+  size_t num_acked = 0;
+  for (size_t i = 0; i < num; ++i) {
+    rdm_batch_request_t *const request = &requests[i];
+
+    // Patch the dest UID, TN, sub-device, and PID into the packet
+    const uint16_t man_id = bswap16(request->dest_uid.man_id);
+    const uint32_t dev_id = bswap32(request->dest_uid.dev_id);
+    const uint16_t sub_device = bswap16(request->sub_device);
+    const uint16_t pid = bswap16(request->pid);
+    memcpy(&packet[3], &man_id, sizeof(man_id));
+    memcpy(&packet[5], &dev_id, sizeof(dev_id));
+    packet[15] = rdm_get_transaction_num(dmx_num);
+    memcpy(&packet[18], &sub_device, sizeof(sub_device));
+    memcpy(&packet[21], &pid, sizeof(pid));
+
+    // Update the checksum using only the patched fields
+    uint16_t checksum = packet_checksum;
+    for (int j = 3; j < 9; ++j) {
+      checksum += packet[j];
+    }
+    checksum +=
+        packet[15] + packet[18] + packet[19] + packet[21] + packet[22];
+    checksum = bswap16(checksum);
+    memcpy(&packet[24], &checksum, sizeof(checksum));
+
+    // Send the request and read the response
+    dmx_write(dmx_num, packet, sizeof(packet));
+    if (rdm_send_and_receive(dmx_num, &request->dest_uid, request->pid,
+                             request->format, request->pd, request->size,
+                             &request->ack)) {
+      ++num_acked;
+    }
+  }
+
+  // Write the DMX slots from before the requests back into the DMX driver
+  rdm_controller_restore_slots(driver);
+
+  xSemaphoreGiveRecursive(driver->mux);
+  return num_acked;
 }
 
 uint32_t rdm_get_transaction_num(dmx_port_t dmx_num) {
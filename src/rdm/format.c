@@ -0,0 +1,440 @@
+#include "rdm/include/format.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "endian.h"
+#include "rdm/include/uid.h"
+
+size_t rdm_format_to_ops(uint8_t *ops, const char *format) {
+  assert(ops != NULL);
+  assert(format != NULL);
+
+  size_t num_ops = 0;
+  for (char c = *format; c != '\0'; c = *(++format)) {
+    switch (c) {
+      case ' ':
+        continue;  // Skip whitespaces
+      case 'b':
+      case 'B':
+        ops[num_ops++] = RDM_FORMAT_OP_BYTE;
+        break;
+      case 'w':
+      case 'W':
+        ops[num_ops++] = RDM_FORMAT_OP_WORD;
+        break;
+      case 'd':
+      case 'D':
+        ops[num_ops++] = RDM_FORMAT_OP_DWORD;
+        break;
+      case 'u':
+      case 'U':
+        ops[num_ops++] = RDM_FORMAT_OP_UID;
+        break;
+      case 'v':
+      case 'V':
+        ops[num_ops++] = RDM_FORMAT_OP_OPT_UID;
+        break;
+      case 'a':
+      case 'A':
+        ops[num_ops++] = RDM_FORMAT_OP_ASCII;
+        break;
+      case 'x':
+      case 'X': {
+        // Copy the hex literal format string to a null-terminated string
+        char str[3];
+        str[2] = '\0';
+        memcpy(str, (format + 1), 2);
+        ops[num_ops++] = RDM_FORMAT_OP_LITERAL;
+        ops[num_ops++] = (uint8_t)strtol(str, NULL, 16);
+        format += 2;  // Skip to the next token
+        break;
+      }
+      case '$':
+        ops[num_ops++] = RDM_FORMAT_OP_TERMINATE;
+        break;
+      default:
+        __unreachable();  // Unknown symbol
+    }
+  }
+  ops[num_ops++] = RDM_FORMAT_OP_END;
+
+  return num_ops;
+}
+
+size_t RDM_FORMAT_ISR_ATTR rdm_format_encode(void *restrict dest,
+                                             const uint8_t *restrict ops,
+                                             const void *restrict src,
+                                             size_t src_size,
+                                             bool encode_nulls) {
+  assert(dest != NULL);
+  assert(ops != NULL);
+  assert(src != NULL);
+
+  // Fields are copied without function calls so that this is IRAM-safe
+  uint8_t *d = dest;
+  const uint8_t *s = src;
+  size_t encoded = 0;
+  while (src_size > 0) {
+    for (const uint8_t *op = ops; *op != RDM_FORMAT_OP_END; ++op) {
+      // Copy the token to the destination buffer
+      size_t token_size;
+      switch (*op) {
+        case RDM_FORMAT_OP_BYTE:
+          token_size = sizeof(uint8_t);
+          if (token_size > src_size) {
+            return encoded;
+          }
+          d[0] = s[0];
+          break;
+        case RDM_FORMAT_OP_WORD:
+          token_size = sizeof(uint16_t);
+          if (token_size > src_size) {
+            return encoded;
+          }
+          d[0] = s[1];
+          d[1] = s[0];
+          break;
+        case RDM_FORMAT_OP_DWORD:
+          token_size = sizeof(uint32_t);
+          if (token_size > src_size) {
+            return encoded;
+          }
+          d[0] = s[3];
+          d[1] = s[2];
+          d[2] = s[1];
+          d[3] = s[0];
+          break;
+        case RDM_FORMAT_OP_UID:
+        case RDM_FORMAT_OP_OPT_UID: {
+          token_size = sizeof(rdm_uid_t);
+          if (*op == RDM_FORMAT_OP_OPT_UID &&
+              (src_size < token_size ||
+               (s[0] | s[1] | s[2] | s[3] | s[4] | s[5]) == 0)) {
+            // Handle condition where an optional UID was not provided
+            if (encode_nulls) {
+              for (size_t i = 0; i < token_size; ++i) {
+                d[i] = 0;
+              }
+              encoded += token_size;
+            }
+            return encoded;
+          } else if (token_size > src_size) {
+            return encoded;
+          }
+          // The manufacturer ID and device ID are swapped separately
+          d[0] = s[1];
+          d[1] = s[0];
+          d[2] = s[5];
+          d[3] = s[4];
+          d[4] = s[3];
+          d[5] = s[2];
+          if (*op == RDM_FORMAT_OP_OPT_UID) {
+            return encoded + token_size;
+          }
+          break;
+        }
+        case RDM_FORMAT_OP_ASCII: {
+          const size_t max_size = src_size < 32 ? src_size : 32;
+          for (token_size = 0; token_size < max_size && s[token_size] != '\0';
+               ++token_size) {
+            d[token_size] = s[token_size];
+          }
+          if (encode_nulls) {
+            // Only null-terminate the string if desired by the caller
+            d[token_size] = '\0';
+            token_size += 1;
+          }
+          return encoded + token_size;
+        }
+        case RDM_FORMAT_OP_LITERAL:
+          // Don't need to swap endianness on single byte
+          token_size = sizeof(uint8_t);
+          if (token_size > src_size) {
+            return encoded;
+          }
+          d[0] = *(++op);
+          break;
+        case RDM_FORMAT_OP_TERMINATE:
+          return encoded;
+        default:
+          __unreachable();  // Unknown opcode
+      }
+
+      // Update cursor
+      encoded += token_size;
+      d += token_size;
+      s += token_size;
+      src_size -= token_size;
+    }
+  }
+
+  return encoded;
+}
+
+void RDM_FORMAT_ISR_ATTR rdm_header_encode(
+    uint8_t *restrict data, const rdm_header_t *restrict header) {
+  // The header is packed so it can be copied and then swapped in place
+  for (size_t i = 0; i < sizeof(*header); ++i) {
+    data[i] = ((const uint8_t *)header)[i];
+  }
+  data[0] = RDM_SC;
+  data[1] = RDM_SUB_SC;
+  rdm_header_t *const h = (rdm_header_t *)data;
+  h->dest_uid.man_id = bswap16(h->dest_uid.man_id);
+  h->dest_uid.dev_id = bswap32(h->dest_uid.dev_id);
+  h->src_uid.man_id = bswap16(h->src_uid.man_id);
+  h->src_uid.dev_id = bswap32(h->src_uid.dev_id);
+  h->sub_device = bswap16(h->sub_device);
+  h->pid = bswap16(h->pid);
+}
+
+void RDM_FORMAT_ISR_ATTR rdm_decode_header(const uint8_t *data,
+                                           rdm_header_t *header) {
+  // Copy the header without function calls for IRAM ISR
+  for (size_t i = 0; i < sizeof(rdm_header_t); ++i) {
+    ((uint8_t *)header)[i] = data[i];
+  }
+  header->dest_uid.man_id = bswap16(header->dest_uid.man_id);
+  header->dest_uid.dev_id = bswap32(header->dest_uid.dev_id);
+  header->src_uid.man_id = bswap16(header->src_uid.man_id);
+  header->src_uid.dev_id = bswap32(header->src_uid.dev_id);
+  header->sub_device = bswap16(header->sub_device);
+  header->pid = bswap16(header->pid);
+}
+
+bool RDM_FORMAT_ISR_ATTR rdm_read_header_from_buffer(const uint8_t *data,
+                                                     rdm_header_t *header) {
+  uint16_t checksum = 0;
+
+  // Check if packet is standard RDM packet or RDM discovery response packet
+  if (*(uint16_t *)data == (RDM_SC | (RDM_SUB_SC << 8))) {
+    // Verify checksum
+    const uint8_t message_len = data[2];
+    for (int i = 0; i < message_len; ++i) {
+      checksum += data[i];
+    }
+    if (checksum != bswap16(*(uint16_t *)(data + message_len))) {
+      return false;
+    }
+
+    if (header != NULL) {
+      rdm_decode_header(data, header);
+    }
+
+    return true;
+  } else if (*data == RDM_PREAMBLE || *data == RDM_DELIMITER) {
+    // Get and verify the preamble length (must be <= 7 bytes)
+    int preamble_len = 0;
+    for (; preamble_len <= 7; ++preamble_len) {
+      if (data[preamble_len] == RDM_DELIMITER) break;
+    }
+    if (preamble_len > 7) {
+      return false;
+    }
+    data += preamble_len + 1;
+
+    // Verify checksum
+    for (int i = 0; i < 12; ++i) {
+      checksum += data[i];
+    }
+    if (checksum != (((data[12] & data[13]) << 8) | (data[14] & data[15]))) {
+      return false;
+    }
+
+    // Copy the header without function calls for IRAM ISR
+    if (header != NULL) {
+      // Decode the EUID
+      uint8_t euid_buf[6];
+      for (size_t i = 0, j = 0; i < sizeof(euid_buf); ++i, j += 2) {
+        euid_buf[i] = data[j] & data[j + 1];
+      }
+
+      for (size_t i = 0; i < sizeof(rdm_uid_t); ++i) {
+        ((uint8_t *)&header->src_uid)[i] = euid_buf[i];
+      }
+      header->message_len = preamble_len + 17;
+      header->dest_uid.man_id = RDM_UID_BROADCAST_ALL.man_id;
+      header->dest_uid.dev_id = RDM_UID_BROADCAST_ALL.dev_id;
+      header->src_uid.man_id = bswap16(header->src_uid.man_id);
+      header->src_uid.dev_id = bswap32(header->src_uid.dev_id);
+      header->tn = 0;
+      header->response_type = RDM_RESPONSE_TYPE_ACK;
+      header->message_count = 0;
+      header->sub_device = RDM_SUB_DEVICE_ROOT;
+      header->cc = RDM_CC_DISC_COMMAND_RESPONSE;
+      header->pid = RDM_PID_DISC_UNIQUE_BRANCH;
+      header->pdl = 0;
+    }
+
+    return true;
+  }
+
+  return false;
+}
+
+size_t RDM_FORMAT_ISR_ATTR rdm_packet_encode(uint8_t *data,
+                                             const rdm_header_t *header,
+                                             const char *format,
+                                             const uint8_t *ops,
+                                             const void *pd) {
+  // Encode a standard RDM packet or a RDM_CC_DISC_COMMAND_RESPONSE packet
+  size_t written;
+  const bool encode_nulls = false;
+  if (header->cc == RDM_CC_DISC_COMMAND_RESPONSE &&
+      header->pid == RDM_PID_DISC_UNIQUE_BRANCH) {
+    // Encode the preamble bytes
+    const size_t preamble_len = 7;
+    for (size_t i = 0; i < preamble_len; ++i) {
+      data[i] = RDM_PREAMBLE;
+    }
+    data[preamble_len] = RDM_DELIMITER;
+    uint8_t *euid = &data[preamble_len + 1];
+
+    // Encode the UID and calculate the checksum
+    uint8_t uid[6];
+    ((rdm_uid_t *)uid)->man_id = bswap16(header->src_uid.man_id);
+    ((rdm_uid_t *)uid)->dev_id = bswap32(header->src_uid.dev_id);
+    uint16_t checksum = 0;
+    for (size_t i = 0, j = 0; j < sizeof(rdm_uid_t); i += 2, ++j) {
+      euid[i] = uid[j] | 0xaa;
+      euid[i + 1] = uid[j] | 0x55;
+      checksum += uid[j] + (0xaa | 0x55);
+    }
+
+    // Encode the checksum
+    const int cs_offset = sizeof(rdm_uid_t) * 2;
+    euid[cs_offset + 0] = (uint8_t)(checksum >> 8) | 0xaa;
+    euid[cs_offset + 1] = (uint8_t)(checksum >> 8) | 0x55;
+    euid[cs_offset + 2] = (uint8_t)(checksum) | 0xaa;
+    euid[cs_offset + 3] = (uint8_t)(checksum) | 0x55;
+
+    // Update written size
+    written = preamble_len + 1 + 16;
+  } else {
+    // Serialize the header and pd into the buffer
+    rdm_header_encode(data, header);
+    size_t message_len;
+    uint8_t *cursor = &data[24];
+    if (pd != NULL && header->pdl > 0) {
+      uint8_t format_ops[RDM_FORMAT_OPS_MAX];
+      if (ops == NULL) {
+        // Compiling the format is not IRAM-safe
+        rdm_format_to_ops(format_ops, format);
+        ops = format_ops;
+      }
+      size_t pdl =
+          rdm_format_encode(cursor, ops, pd, header->pdl, encode_nulls);
+      if (header->pdl != pdl) {
+        message_len = 24 + pdl;
+        data[2] = message_len;  // Encode updated message_len
+        data[23] = pdl;         // Encode updated pdl
+      } else {
+        message_len = header->message_len;
+      }
+      cursor += pdl;
+    } else {
+      message_len = sizeof(rdm_header_t);
+    }
+
+    // Calculate and serialize the checksum
+    uint16_t checksum = RDM_SC + RDM_SUB_SC;
+    for (size_t i = 2; i < message_len; ++i) {
+      checksum += data[i];
+    }
+    cursor[0] = checksum >> 8;
+    cursor[1] = checksum & 0xff;
+
+    written = message_len + 2;
+  }
+
+  return written;
+}
+
+bool rdm_format_is_valid(const char *format) {
+  if (format == NULL) {
+    return true;
+  }
+
+  size_t parameter_size = 0;
+
+  bool format_is_terminated = false;
+  for (char c = *format; c != '\0'; c = *(++format)) {
+    // Skip spaces
+    if (c == ' ') {
+      continue;
+    }
+
+    // Get the size of the current token
+    size_t token_size;
+    switch (c) {
+      case 'b':
+      case 'B':
+        token_size = sizeof(uint8_t);
+        break;
+      case 'w':
+      case 'W':
+        token_size = sizeof(uint16_t);
+        break;
+      case 'd':
+      case 'D':
+        token_size = sizeof(uint32_t);
+        break;
+      case 'u':
+      case 'U':
+        token_size = sizeof(rdm_uid_t);
+        break;
+      case 'v':
+      case 'V':
+        token_size = sizeof(rdm_uid_t);
+        format_is_terminated = true;
+        break;
+      case 'x':
+      case 'X':
+        token_size = sizeof(uint8_t);
+        for (int i = 0; i < 2; ++i) {
+          c = *(++format);
+          if (!isxdigit(c)) {
+            return false;  // Hex literals must be 2 characters wide
+          }
+        }
+        break;
+      case 'a':
+      case 'A':
+        token_size = 32;  // ASCII fields can be up to 32 bytes
+        format_is_terminated = true;
+        break;
+      case '$':
+        token_size = 0;
+        format_is_terminated = true;
+        break;
+      default:
+        return false;  // Unknown symbol
+    }
+
+    // Update the parameter size with the new token
+    parameter_size += token_size;
+    if (parameter_size > 231) {
+      return false;  // Parameter size is too big
+    }
+
+    // End loop if parameter is terminated
+    if (format_is_terminated) {
+      break;
+    }
+  }
+
+  if (format_is_terminated) {
+    ++format;
+    if (*format != '\0' && *format != '$') {
+      return false;  // Invalid token after terminator
+    }
+  } else {
+    // Get the maximum possible size if parameter is unterminated
+    parameter_size = 231 - (231 % parameter_size);
+  }
+
+  return parameter_size > 0;
+}
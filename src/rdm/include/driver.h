@@ -124,6 +124,23 @@ size_t rdm_read_pd(dmx_port_t dmx_num, const char *format, void *destination,
 size_t rdm_write(dmx_port_t dmx_num, const rdm_header_t *header,
                  const char *format, const void *pd);
 
+/**
+ * @brief Writes an RDM packet whose parameter data has already been encoded
+ * into the DMX driver buffer. The parameter data is copied as-is and its sum is
+ * provided by the caller so that only the header must be summed to calculate
+ * the packet checksum. This function cannot write
+ * RDM_CC_DISC_COMMAND_RESPONSE packets.
+ *
+ * @param dmx_num The DMX port number.
+ * @param[in] header A pointer which stores RDM header information.
+ * @param[in] pd A pointer to the encoded parameter data, which is header->pdl
+ * bytes long.
+ * @param pd_sum The sum of the bytes of the encoded parameter data.
+ * @return The size of the RDM packet that was written or 0 on error.
+ */
+size_t rdm_write_encoded(dmx_port_t dmx_num, const rdm_header_t *header,
+                         const void *pd, uint16_t pd_sum);
+
 /**
  * @brief Returns true if the RDM format string is valid.
  *
@@ -131,4 +148,17 @@ size_t rdm_write(dmx_port_t dmx_num, const rdm_header_t *header,
  * @return true if the RDM format string is valid.
  * @return false if it is not valid.
  */
-bool rdm_format_is_valid(const char *format);
\ No newline at end of file
+bool rdm_format_is_valid(const char *format);
+
+/**
+ * @brief Compiles an RDM format string so that it does not need to be parsed
+ * each time it is used to read or write parameter data. Compiled formats are
+ * found by the address of the format string, so the format string must not be
+ * modified or freed after it is compiled. Format strings which have not been
+ * compiled may still be used but are parsed each time they are used.
+ *
+ * @param format The RDM format string.
+ * @return true if the format was compiled or if the format is NULL.
+ * @return false if the format is invalid or if memory could not be allocated.
+ */
+bool rdm_format_compile(const char *format);
\ No newline at end of file
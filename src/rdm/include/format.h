@@ -0,0 +1,141 @@
+/**
+ * @file rdm/include/format.h
+ * @author Mitch Weisbrod (mitch@theweisbrods.com)
+ * @brief This file contains the RDM protocol codec. It contains functions which
+ * encode and decode RDM packets and parameter data. These functions only
+ * manipulate bytes in a buffer and do not depend on the DMX driver, its
+ * spinlocks, or the DMX hardware abstraction layer. The type headers which are
+ * included here still require the FreeRTOS headers, so this file is only built
+ * as part of the DMX component. This file is not considered part of the API
+ * and should not be included by the user.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "dmx/include/types.h"
+#include "rdm/include/types.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#include "esp_idf_version.h"
+#include "sdkconfig.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(ESP_PLATFORM) && \
+    (defined(CONFIG_DMX_ISR_IN_IRAM) || ESP_IDF_VERSION_MAJOR < 5)
+/** @brief This macro places the codec functions which are called from within
+ * DMX interrupt handlers in IRAM. It is equivalent to DMX_ISR_ATTR.*/
+#define RDM_FORMAT_ISR_ATTR IRAM_ATTR
+#else
+/** @brief This macro places the codec functions which are called from within
+ * DMX interrupt handlers in IRAM. It is equivalent to DMX_ISR_ATTR.*/
+#define RDM_FORMAT_ISR_ATTR
+#endif
+
+/** @brief The maximum size of a compiled format. Each token compiles to a
+ * single opcode except for hex literals which also store their value.*/
+#define RDM_FORMAT_OPS_MAX (RDM_PD_SIZE_MAX * 2 + 1)
+
+/** @brief The opcodes of a compiled RDM format string.*/
+enum rdm_format_op_t {
+  RDM_FORMAT_OP_END = 0,  // The end of the format, which repeats.
+  RDM_FORMAT_OP_BYTE,     // An 8-bit byte of data, 'b'.
+  RDM_FORMAT_OP_WORD,     // A 16-bit word of data, 'w'.
+  RDM_FORMAT_OP_DWORD,    // A 32-bit dword of data, 'd'.
+  RDM_FORMAT_OP_UID,      // A 48-bit UID, 'u'.
+  RDM_FORMAT_OP_OPT_UID,  // An optional 48-bit UID which ends the format, 'v'.
+  RDM_FORMAT_OP_ASCII,    // An ASCII string which ends the format, 'a'.
+  RDM_FORMAT_OP_LITERAL,  // A hex literal whose value is the next opcode, 'x'.
+  RDM_FORMAT_OP_TERMINATE,  // A terminator which ends the format, '$'.
+};
+
+/**
+ * @brief Compiles an RDM format string into opcodes. The format string must
+ * have been verified with rdm_format_is_valid() before calling this function.
+ *
+ * @param[out] ops A buffer of at least RDM_FORMAT_OPS_MAX opcodes.
+ * @param[in] format The format string to compile.
+ * @return The number of opcodes which were written, including the end opcode.
+ */
+size_t rdm_format_to_ops(uint8_t *ops, const char *format);
+
+/**
+ * @brief Copies parameter data between a native buffer and an RDM buffer,
+ * swapping the endianness of each field as directed by the compiled format.
+ * Because swapping endianness is symmetric, this function is used for both
+ * encoding and decoding parameter data. This function is IRAM-safe so that it
+ * may be called while the flash cache is disabled.
+ *
+ * @param[out] dest The destination buffer.
+ * @param[in] ops The compiled format of the parameter data.
+ * @param[in] src The source buffer.
+ * @param src_size The size of the source buffer.
+ * @param encode_nulls True to null-terminate ASCII strings and to write null
+ * optional UIDs.
+ * @return The number of bytes which were written to the destination buffer.
+ */
+size_t rdm_format_encode(void *restrict dest, const uint8_t *restrict ops,
+                         const void *restrict src, size_t src_size,
+                         bool encode_nulls);
+
+/**
+ * @brief Encodes the header of a standard RDM packet, including the RDM start
+ * code and sub-start code. The checksum is not encoded. This function is
+ * IRAM-safe so that it may be called while the flash cache is disabled.
+ *
+ * @param[out] data A buffer of at least sizeof(rdm_header_t) bytes.
+ * @param[in] header A pointer to the header to encode.
+ */
+void rdm_header_encode(uint8_t *restrict data,
+                       const rdm_header_t *restrict header);
+
+/**
+ * @brief Reads and verifies an RDM header from a DMX packet buffer. This is
+ * the implementation of rdm_read_header() and is used by the DMX ISR to verify
+ * packets in the receive buffer before they are made available to the user.
+ *
+ * @param[in] data A pointer to the DMX packet buffer.
+ * @param[out] header A pointer to an RDM header to store the result, or NULL.
+ * @return true if the buffer contains a valid RDM packet.
+ * @return false if the buffer does not contain a valid RDM packet.
+ */
+bool rdm_read_header_from_buffer(const uint8_t *data, rdm_header_t *header);
+
+/**
+ * @brief Decodes the header of a standard RDM packet without verifying its
+ * checksum. This is used by the DMX ISR, which verifies the checksum as slots
+ * are received.
+ *
+ * @param[in] data A pointer to the DMX packet buffer.
+ * @param[out] header A pointer to an RDM header to store the result.
+ */
+void rdm_decode_header(const uint8_t *data, rdm_header_t *header);
+
+/**
+ * @brief Encodes a standard RDM packet or an RDM_PID_DISC_UNIQUE_BRANCH
+ * response, including its checksum. The header and format must have been
+ * verified before calling this function. This function is IRAM-safe when the
+ * compiled format is provided, so that responses may be encoded while the
+ * flash cache is disabled.
+ *
+ * @param[out] data A buffer which is large enough for the packet.
+ * @param[in] header A pointer to the header of the RDM packet.
+ * @param[in] format The format string of the parameter data, or NULL.
+ * @param[in] ops The compiled format string, or NULL to compile the format.
+ * @param[in] pd A pointer to the parameter data, or NULL.
+ * @return The size of the encoded RDM packet.
+ */
+size_t rdm_packet_encode(uint8_t *data, const rdm_header_t *header,
+                         const char *format, const uint8_t *ops,
+                         const void *pd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -41,6 +41,11 @@ extern "C" {
 /** @brief The maximum size for RDM parameter data.*/
 #define RDM_PD_SIZE_MAX (232)
 
+/** @brief The maximum size of an RDM_PID_DISC_UNIQUE_BRANCH response: a
+ * preamble of up to 7 bytes, the delimiter, the encoded UID, and the encoded
+ * checksum.*/
+#define RDM_DISC_RESPONSE_SIZE_MAX (24)
+
 /** @brief The maximum RDM sensor number.*/
 #define RDM_SENSOR_NUM_MAX (0xff)
 
@@ -9,6 +9,97 @@
 #include "rdm/include/types.h"
 #include "rdm/include/uid.h"
 
+static size_t rdm_get_cacheable_response(dmx_port_t dmx_num,
+                                         const rdm_parameter_definition_t *def,
+                                         const rdm_header_t *header) {
+  assert(header->cc == RDM_CC_GET_COMMAND);
+  assert(def->get_is_cacheable);
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+
+  // Only responses to requests with small parameter data can be cached
+  dmx_parameter_t *const entry =
+      dmx_parameter_get_entry(dmx_num, header->sub_device, header->pid);
+  uint8_t request_pd[sizeof(((dmx_parameter_response_t *)0)->request_pd)];
+  if (entry == NULL || header->pdl > sizeof(request_pd)) {
+    return def->get.handler(dmx_num, def, header);
+  }
+  memcpy(request_pd, &driver->dmx.data[24], header->pdl);
+
+  // Write the cached response if it is still valid
+  const dmx_device_t *const device =
+      dmx_device_get(dmx_num, header->sub_device);
+  uint32_t generation;
+  uint32_t device_generation;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  generation = driver->device.generation;
+  device_generation = device->generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_parameter_response_t *response = entry->response;
+  if (response != NULL && response->generation == generation &&
+      response->device_generation == device_generation &&
+      response->request_pdl == header->pdl &&
+      memcmp(response->request_pd, request_pd, header->pdl) == 0) {
+    const rdm_header_t response_header = {
+        .message_len = 24 + response->pdl,
+        .dest_uid = header->src_uid,
+        .src_uid = *rdm_uid_get(dmx_num),
+        .tn = header->tn,
+        .response_type = RDM_RESPONSE_TYPE_ACK,
+        .message_count = rdm_queue_size(dmx_num),
+        .sub_device = header->sub_device,
+        .cc = RDM_CC_GET_COMMAND_RESPONSE,
+        .pid = header->pid,
+        .pdl = response->pdl};
+    return rdm_write_encoded(dmx_num, &response_header, response->pd,
+                             response->pd_sum);
+  }
+
+  // Call the response handler and cache the response if it is an ACK
+  const size_t packet_size = def->get.handler(dmx_num, def, header);
+  const uint8_t *data = driver->dmx.data;
+  if (packet_size == 0 || data[16] != RDM_RESPONSE_TYPE_ACK ||
+      data[20] != RDM_CC_GET_COMMAND_RESPONSE) {
+    return packet_size;
+  }
+  const uint8_t pdl = data[23];
+  // Invalidate the response so that the DMX ISR can't send it while it is
+  // being written
+  const bool must_grow = response == NULL || response->capacity < pdl;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (must_grow) {
+    entry->response = NULL;
+  } else {
+    response->generation = generation - 1;
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (must_grow) {
+    // Round the capacity up so that growing responses rarely reallocate
+    dmx_free(dmx_num, response);
+    const size_t capacity = pdl <= 224 ? (pdl + 31) & ~31 : 231;
+    response = dmx_alloc(dmx_num, sizeof(*response) + capacity);
+    if (response == NULL) {
+      return packet_size;
+    }
+    response->capacity = capacity;
+  }
+  response->request_pdl = header->pdl;
+  memcpy(response->request_pd, request_pd, header->pdl);
+  response->pdl = pdl;
+  response->pd_sum = 0;
+  for (int i = 0; i < pdl; ++i) {
+    response->pd[i] = data[24 + i];
+    response->pd_sum += data[24 + i];
+  }
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  response->generation = generation;
+  response->device_generation = device_generation;
+  entry->response = response;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  return packet_size;
+}
+
 bool rdm_send_response(dmx_port_t dmx_num) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
@@ -19,6 +110,9 @@ bool rdm_send_response(dmx_port_t dmx_num) {
     return false;
   }
 
+  // Re-encode the discovery responses of the DMX ISR if they are stale
+  rdm_disc_isr_update(dmx_num);
+
   // Get the RDM header information and update miscellaneous RDM driver fields
   bool is_rdm;
   rdm_header_t header;
@@ -49,10 +143,14 @@ bool rdm_send_response(dmx_port_t dmx_num) {
   // Update PID of the last request to target this device
   driver->dmx.last_request_pid = header.pid;
 
-  // Get parameter definition
+  // Get parameter definition, which is shared by every sub-device
   size_t packet_size;  // Size of the response packet
-  const rdm_parameter_definition_t *def =
-      rdm_definition_get(dmx_num, header.sub_device, header.pid);
+  const rdm_sub_device_t def_sub_device =
+      header.sub_device < RDM_SUB_DEVICE_MAX ? header.sub_device
+                                             : RDM_SUB_DEVICE_ROOT;
+  rdm_dispatch_t dispatch;
+  rdm_dispatch_get(dmx_num, def_sub_device, header.pid, &dispatch);
+  const rdm_parameter_definition_t *def = dispatch.definition;
   if (def == NULL) {
     // Unknown PID
     packet_size = rdm_write_nack_reason(dmx_num, &header, RDM_NR_UNKNOWN_PID);
@@ -64,23 +162,24 @@ bool rdm_send_response(dmx_port_t dmx_num) {
   } else {
     // Request is valid, handle the response
 
-    // Validate the header against definition information
-    const rdm_pid_cc_t pid_cc = def->pid_cc;
-    if (pid_cc == RDM_CC_DISC && header.cc != RDM_CC_DISC_COMMAND) {
+    // Look up the handler of the command class
+    const struct rdm_command_t *const command =
+        rdm_cc_is_request(header.cc)
+            ? dispatch.commands[rdm_dispatch_index(header.cc)]
+            : NULL;
+    if (def->pid_cc == RDM_CC_DISC && header.cc != RDM_CC_DISC_COMMAND) {
       packet_size = 0;  // Cannot send NACK to RDM_CC_DISC_COMMAND
-    } else if ((pid_cc == RDM_CC_GET_SET && header.cc == RDM_CC_DISC_COMMAND) ||
-               (pid_cc == RDM_CC_GET && header.cc != RDM_CC_GET_COMMAND) ||
-               (pid_cc == RDM_CC_SET && header.cc != RDM_CC_SET_COMMAND)) {
+    } else if (command == NULL) {
       // Unsupported command class
       packet_size = rdm_write_nack_reason(dmx_num, &header,
                                           RDM_NR_UNSUPPORTED_COMMAND_CLASS);
     } else {
       // Call the response handler for the parameter
-      if (header.cc == RDM_CC_SET_COMMAND) {
-        packet_size = def->set.handler(dmx_num, def, &header);
+      if (header.cc == RDM_CC_GET_COMMAND && def->get_is_cacheable &&
+          header.sub_device < RDM_SUB_DEVICE_MAX) {
+        packet_size = rdm_get_cacheable_response(dmx_num, def, &header);
       } else {
-        // RDM_CC_DISC_COMMAND uses get.handler()
-        packet_size = def->get.handler(dmx_num, def, &header);
+        packet_size = command->handler(dmx_num, def, &header);
       }
 
       // Validate the response
@@ -110,6 +209,9 @@ bool rdm_send_response(dmx_port_t dmx_num) {
   if (packet_size > 0) {
     if (!dmx_send_num(dmx_num, packet_size)) {
       rdm_set_boot_loader(dmx_num);
+      taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+      ++driver->stats.counters.rdm_responses_missed;
+      taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
       // Generate information for the warning message if a response wasn't sent
       const int64_t micros_elapsed = dmx_timer_get_micros_since_boot() -
                                      driver->dmx.controller_eop_timestamp;
@@ -131,7 +233,7 @@ bool rdm_send_response(dmx_port_t dmx_num) {
 
   // Call the after-response callback
   const dmx_parameter_t *parameter =
-      dmx_parameter_get_entry(dmx_num, header.sub_device, header.pid);
+      dmx_parameter_get_entry(dmx_num, def_sub_device, header.pid);
   if (parameter != NULL && parameter->callback != NULL) {
     rdm_header_t response_header;
     if (!rdm_read_header(dmx_num, &response_header)) {
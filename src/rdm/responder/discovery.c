@@ -4,10 +4,37 @@
 
 #include "dmx/include/driver.h"
 #include "dmx/include/service.h"
+#include "include/queue_status.h"
 #include "include/utils.h"
 #include "rdm/include/driver.h"
 #include "rdm/include/uid.h"
 
+static void rdm_disc_mute_get(dmx_port_t dmx_num, rdm_disc_mute_t *mute) {
+  // Get the binding UID of this device
+  int num_ports = 0;
+  for (int i = 0; i < DMX_NUM_MAX; ++i) {
+    if (dmx_driver_is_installed(i)) {
+      ++num_ports;
+    }
+  }
+  if (num_ports == 1) {
+    mute->binding_uid = (rdm_uid_t){0, 0};  // Don't report a binding UID
+  } else {
+    for (int i = 0; i < DMX_NUM_MAX; ++i) {
+      if (dmx_driver_is_installed(i)) {
+        memcpy(&mute->binding_uid, rdm_uid_get(i), sizeof(mute->binding_uid));
+        break;
+      }
+    }
+  }
+
+  // Get the mute control field of this port
+  mute->managed_proxy = 0;  // TODO: managed proxy flag
+  mute->sub_device = dmx_sub_device_get_count(dmx_num) > 0 ? 1 : 0;
+  mute->boot_loader = rdm_get_boot_loader(dmx_num);
+  mute->proxied_device = 0;  // TODO: proxied device flag
+}
+
 static size_t rdm_rhd_discovery(dmx_port_t dmx_num,
                                 const rdm_parameter_definition_t *definition,
                                 const rdm_header_t *header) {
@@ -46,30 +73,9 @@ static size_t rdm_rhd_discovery(dmx_port_t dmx_num,
     dmx_parameter_set(dmx_num, RDM_SUB_DEVICE_ROOT, header->pid, &set_mute,
                       sizeof(set_mute));
 
-    // Get the binding UID of this device
-    int num_ports = 0;
+    // Get the mute control field and binding UID of this device
     rdm_disc_mute_t mute;
-    for (int i = 0; i < DMX_NUM_MAX; ++i) {
-      if (dmx_driver_is_installed(i)) {
-        ++num_ports;
-      }
-    }
-    if (num_ports == 1) {
-      mute.binding_uid = (rdm_uid_t){0, 0};  // Don't report a binding UID
-    } else {
-      for (int i = 0; i < DMX_NUM_MAX; ++i) {
-        if (dmx_driver_is_installed(i)) {
-          memcpy(&mute.binding_uid, rdm_uid_get(i), sizeof(mute.binding_uid));
-          break;
-        }
-      }
-    }
-
-    // Get the mute control field of this port
-    mute.managed_proxy = 0;  // TODO: managed proxy flag
-    mute.sub_device = dmx_sub_device_get_count(dmx_num) > 0 ? 1 : 0;
-    mute.boot_loader = rdm_get_boot_loader(dmx_num);
-    mute.proxied_device = 0;  // TODO: proxied device flag
+    rdm_disc_mute_get(dmx_num, &mute);
 
     return rdm_write_ack(dmx_num, header, definition->get.response.format,
                          &mute, sizeof(mute));
@@ -193,4 +199,83 @@ bool rdm_register_disc_un_mute(dmx_port_t dmx_num, rdm_callback_t cb,
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
-}
\ No newline at end of file
+}
+
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+static bool rdm_disc_is_default(dmx_port_t dmx_num, rdm_pid_t pid) {
+  const dmx_parameter_t *entry =
+      dmx_parameter_get_entry(dmx_num, RDM_SUB_DEVICE_ROOT, pid);
+  return entry != NULL && entry->definition != NULL &&
+         entry->definition->get.handler == rdm_rhd_discovery &&
+         entry->callback == NULL;
+}
+#endif
+
+void rdm_disc_isr_update(dmx_port_t dmx_num) {
+#ifdef CONFIG_RDM_RESPONDER_DISCOVERY_IN_ISR
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  dmx_driver_t *const driver = dmx_driver[dmx_num];
+  struct dmx_driver_rdm_disc_t *const rdm_disc = &driver->rdm_disc;
+
+  // Return early if the encoded responses are up to date
+  uint32_t generation;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  generation = driver->device.generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (rdm_disc->generation == generation) {
+    return;
+  }
+
+  // The DMX ISR only responds to parameters which use the default handler
+  const bool dub_is_enabled =
+      rdm_disc_is_default(dmx_num, RDM_PID_DISC_UNIQUE_BRANCH);
+  uint8_t *is_muted = NULL;
+  if (rdm_disc_is_default(dmx_num, RDM_PID_DISC_MUTE) &&
+      rdm_disc_is_default(dmx_num, RDM_PID_DISC_UN_MUTE)) {
+    is_muted = dmx_parameter_get_data(dmx_num, RDM_SUB_DEVICE_ROOT,
+                                      RDM_PID_DISC_MUTE);
+  }
+
+  // Encode the RDM_PID_DISC_UNIQUE_BRANCH response
+  const rdm_uid_t *this_uid = rdm_uid_get(dmx_num);
+  uint8_t dub_response[sizeof(rdm_disc->dub_response)];
+  rdm_header_t header = {.message_len = 24,
+                         .src_uid = *this_uid,
+                         .cc = RDM_CC_DISC_COMMAND_RESPONSE,
+                         .pid = RDM_PID_DISC_UNIQUE_BRANCH,
+                         .pdl = 0};
+  rdm_encode_packet(dub_response, &header, NULL, NULL);
+
+  // Encode the RDM_PID_DISC_MUTE response without its destination UID
+  rdm_disc_mute_t mute;
+  rdm_disc_mute_get(dmx_num, &mute);
+  uint8_t mute_response[sizeof(rdm_disc->mute_response)];
+  header = (rdm_header_t){.message_len = 24 + sizeof(mute),
+                          .dest_uid = {0, 0},
+                          .src_uid = *this_uid,
+                          .tn = 0,
+                          .response_type = RDM_RESPONSE_TYPE_ACK,
+                          .message_count = rdm_queue_size(dmx_num),
+                          .sub_device = RDM_SUB_DEVICE_ROOT,
+                          .cc = RDM_CC_DISC_COMMAND_RESPONSE,
+                          .pid = RDM_PID_DISC_MUTE,
+                          .pdl = sizeof(mute)};
+  const size_t mute_response_len =
+      rdm_encode_packet(mute_response, &header, "wv", &mute);
+
+  // Publish the encoded responses to the DMX ISR
+  const uint64_t uid = ((uint64_t)this_uid->man_id << 32) | this_uid->dev_id;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  memcpy(rdm_disc->dub_response, dub_response, sizeof(dub_response));
+  memcpy(rdm_disc->mute_response, mute_response, mute_response_len);
+  rdm_disc->mute_response_len = mute_response_len;
+  rdm_disc->message_count = header.message_count;
+  rdm_disc->uid = uid;
+  rdm_disc->is_muted = is_muted;
+  rdm_disc->dub_is_enabled = dub_is_enabled;
+  rdm_disc->generation = generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+#endif
+}
@@ -222,7 +222,8 @@ bool rdm_register_dmx_personality_description(
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
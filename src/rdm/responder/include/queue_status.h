@@ -25,7 +25,7 @@ extern "C" {
  *
  * @param dmx_num The DMX port number.
  * @param max_count The maximum number of elements that can be stored in the RDM
- * queue.
+ * queue. It is rounded up to a power of two and may be at most 32768.
  * @param cb A callback which is called after receiving a request for this
  * parameter.
  * @param[inout] context A pointer to context which is used in the user
@@ -37,11 +37,14 @@ bool rdm_register_queued_message(dmx_port_t dmx_num, uint32_t max_count,
                                  rdm_callback_t cb, void *context);
 
 /**
- * @brief Push a parameter ID to the RDM queue, if it has been instantiated.
+ * @brief Push a parameter ID to the RDM queue, if it has been instantiated. A
+ * PID which is already in the RDM queue is not pushed again, so that a
+ * parameter which changes rapidly does not fill the RDM queue and a controller
+ * collects each changed parameter only once.
  *
  * @param dmx_num The DMX port number.
  * @param pid The parameter ID to push to the RDM queue.
- * @return true if the PID was pushed to the queue.
+ * @return true if the PID was pushed to the queue or was already queued.
  * @return false on failure.
  */
 bool rdm_queue_push(dmx_port_t dmx_num, rdm_pid_t pid);
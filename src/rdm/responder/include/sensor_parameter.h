@@ -109,6 +109,27 @@ size_t rdm_sensor_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 bool rdm_sensor_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
                     uint8_t sensor_num, int16_t value);
 
+/**
+ * @brief Sets the values of a range of sensors at once. Unlike
+ * rdm_sensor_set(), this function also tracks the lowest and highest value of
+ * each sensor since it was last reset and may record each value. Every sensor
+ * is updated within a single critical section. If any sensor value changed,
+ * RDM_PID_SENSOR_VALUE is pushed to the RDM queue once so that RDM controllers
+ * may collect the new values.
+ *
+ * @param dmx_num The DMX port number.
+ * @param sub_device The sub-device number.
+ * @param first The sensor number of the first value.
+ * @param[in] values An array of the values to write to the sensors, starting
+ * with sensor number first.
+ * @param num The number of values in the array.
+ * @param record True to also record each value as with rdm_sensor_record().
+ * @return The number of sensors whose value changed, or 0 on failure.
+ */
+int rdm_sensor_set_bulk(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
+                        uint8_t first, const int16_t *values, int num,
+                        bool record);
+
 /**
  * @brief Records the current value set in a specified sensor. The value
  * recorded on the sensor is the last value that was set using rdm_sensor_set().
@@ -54,8 +54,30 @@ typedef struct rdm_parameter_definition_t {
   uint8_t prefix;
   /** @brief The ASCII description of the parameter.*/
   const char *description;
+  /** @brief True if GET responses to this parameter depend only on DMX
+     parameter data and on the parameter data of the request. The RDM responder
+     caches these responses until any DMX parameter is added or set.*/
+  bool get_is_cacheable;
 } rdm_parameter_definition_t;
 
+/** @brief The RDM commands of a parameter indexed by the command class of the
+ * request which they handle, so that RDM requests may be dispatched without
+ * comparing their command class to the command class of the parameter.*/
+typedef struct rdm_dispatch_t {
+  /** @brief The RDM definition of the parameter, or NULL if the parameter does
+     not have an RDM definition.*/
+  const rdm_parameter_definition_t *definition;
+  /** @brief The RDM command which handles each request command class, indexed
+     with rdm_dispatch_index(). The commands of command classes which are not
+     supported by the parameter are NULL.*/
+  const struct rdm_command_t *commands[3];
+} rdm_dispatch_t;
+
+/** @brief Evaluates to the index of the RDM command in an rdm_dispatch_t which
+ * handles the request command class. The command class must be
+ * RDM_CC_DISC_COMMAND, RDM_CC_GET_COMMAND, or RDM_CC_SET_COMMAND.*/
+#define rdm_dispatch_index(cc) (((cc) >> 4) - 1)
+
 /**
  * @brief Writes an ACK packet response to a RDM request packet. This function
  * uses the header of an RDM request packet to write a response. The header for
@@ -155,6 +177,50 @@ bool rdm_definition_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 const rdm_parameter_definition_t *rdm_definition_get(
     dmx_port_t dmx_num, rdm_sub_device_t sub_device, rdm_pid_t pid);
 
+/**
+ * @brief Allocates the RDM dispatch table of the DMX driver. The table is
+ * sized for every parameter which may be added to the DMX driver, so it must
+ * be allocated before any RDM definitions are set. If the table cannot be
+ * allocated, RDM requests are dispatched with rdm_definition_get().
+ *
+ * @param dmx_num The DMX port number.
+ */
+void rdm_dispatch_init(dmx_port_t dmx_num);
+
+/**
+ * @brief Gets the size in bytes of the RDM dispatch table which is allocated
+ * for a number of parameters.
+ *
+ * @param pid_count The number of parameters which may be added.
+ * @return The size of the RDM dispatch table in bytes.
+ */
+size_t rdm_dispatch_get_table_size(uint32_t pid_count);
+
+/**
+ * @brief Gets the size in bytes of the parameter data of an RDM queue.
+ *
+ * @param max_count The maximum number of queued messages.
+ * @return The size of the RDM queue in bytes.
+ */
+size_t rdm_queue_get_size(uint32_t max_count);
+
+/**
+ * @brief Gets the RDM dispatch of the desired DMX parameter. The dispatch is
+ * found in the RDM dispatch table, which is built as RDM definitions are set,
+ * so that the parameters of the sub-device needn't be searched. Parameters
+ * which cannot be dispatched from the table, such as parameters whose RDM
+ * definitions differ between sub-devices, are found with rdm_definition_get().
+ *
+ * @param dmx_num The DMX port number.
+ * @param sub_device The sub-device number.
+ * @param pid The parameter ID of the desired parameter.
+ * @param[out] dispatch A pointer into which to copy the RDM dispatch.
+ * @return true if the parameter has an RDM definition.
+ * @return false if it does not.
+ */
+bool rdm_dispatch_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
+                      rdm_pid_t pid, rdm_dispatch_t *dispatch);
+
 /**
  * @brief Sets the callback function and context for requests to the desired
  * sub-device and parameter ID. The callback function is handled after a
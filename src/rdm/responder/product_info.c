@@ -90,7 +90,8 @@ bool rdm_register_device_info(dmx_port_t dmx_num, uint16_t model_id,
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
@@ -169,7 +170,8 @@ bool rdm_register_device_label(dmx_port_t dmx_num, const char *device_label,
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
@@ -238,7 +240,8 @@ bool rdm_register_software_version_label(dmx_port_t dmx_num,
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
@@ -293,7 +296,8 @@ bool rdm_register_manufacturer_label(dmx_port_t dmx_num,
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
@@ -349,7 +353,8 @@ bool rdm_register_device_model_description(dmx_port_t dmx_num,
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
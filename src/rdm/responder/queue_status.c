@@ -5,19 +5,30 @@
 #include "rdm/include/driver.h"
 #include "rdm/responder/include/utils.h"
 
+/** @brief The number of buckets in the filter of PIDs which are in the RDM
+ * queue. Must be a power of two.*/
+#define RDM_QUEUE_FILTER_SIZE (32)
+
 /**
  * @brief The implementation for the RDM queue. The RDM queue is implemented
- * using a deque with an additional field to recall the previous PID which was
- * popped from the deque.
+ * using a ring buffer whose size is a power of two, with an additional field to
+ * recall the previous PID which was popped from the ring buffer. A counting
+ * filter of the queued PIDs allows most pushes to skip the search for a PID
+ * which is already queued.
  */
 typedef struct rdm_queue_t {
-  uint16_t head;       // The head of the deque.
-  uint16_t tail;       // The tail of the deque.
+  uint16_t head;       // The number of PIDs which have been pushed.
+  uint16_t tail;       // The number of PIDs which have been popped.
   rdm_pid_t previous;  // The PID that was previously popped from the RDM queue.
-  uint16_t max_size;   // The maximum size of the RDM queue.
+  uint16_t mask;       // The size of the ring buffer minus one.
+  uint16_t filter[RDM_QUEUE_FILTER_SIZE];  // The count of PIDs in each bucket.
   rdm_pid_t data[];    // The buffer containing the RDM queue information.
 } rdm_queue_t;
 
+static inline int rdm_queue_hash(rdm_pid_t pid) {
+  return (pid ^ (pid >> 5)) & (RDM_QUEUE_FILTER_SIZE - 1);
+}
+
 static rdm_queue_t *rdm_get_queue(dmx_port_t dmx_num) {
   return dmx_parameter_get_data(dmx_num, RDM_SUB_DEVICE_ROOT,
                            RDM_PID_QUEUED_MESSAGE);
@@ -65,23 +76,33 @@ static size_t rdm_rhd_get_queued_message(
                                           &response_header);
 }
 
+size_t rdm_queue_get_size(uint32_t max_count) {
+  // Round the ring buffer up to a power of two so that it can be masked
+  uint32_t capacity = 1;
+  while (capacity < max_count) {
+    capacity <<= 1;
+  }
+
+  return sizeof(rdm_queue_t) + (sizeof(rdm_pid_t) * capacity);
+}
+
 bool rdm_register_queued_message(dmx_port_t dmx_num, uint32_t max_count,
                                  rdm_callback_t cb, void *context) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
-  DMX_CHECK(max_count > 0, false, "max_count error");
+  DMX_CHECK(max_count > 0 && max_count <= 0x8000, false, "max_count error");
   DMX_CHECK(dmx_driver_is_installed(dmx_num), false, "driver is not installed");
 
   const rdm_pid_t pid = RDM_PID_QUEUED_MESSAGE;
 
   // Add the parameter
-  const size_t size = sizeof(rdm_queue_t) + (sizeof(rdm_pid_t) * max_count);
+  const size_t size = rdm_queue_get_size(max_count);
   if (!dmx_parameter_add(dmx_num, RDM_SUB_DEVICE_ROOT, pid,
                          DMX_PARAMETER_TYPE_DYNAMIC, NULL, size)) {
     return false;
   }
   rdm_queue_t *queue = rdm_get_queue(dmx_num);
   assert(queue != NULL);
-  queue->max_size = max_count;
+  queue->mask = (size - sizeof(rdm_queue_t)) / sizeof(rdm_pid_t) - 1;
 
   // Define the parameter
   static const rdm_parameter_definition_t definition = {
@@ -113,27 +134,24 @@ bool rdm_queue_push(dmx_port_t dmx_num, rdm_pid_t pid) {
   }
 
   bool success = false;
-  bool already_queued = false;
+  const int bucket = rdm_queue_hash(pid);
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  // Iterate the queue to ensure that the PID isn't already queued
-  for (int i = queue->tail; i != queue->head; ++i) {
-    if (i == queue->max_size) {
-      i = 0;
-    }
-    if (queue->data[i] == pid) {
-      already_queued = true;
-      success = true;
-      break;
+  // Coalesce the PID if it is already queued
+  if (queue->filter[bucket] > 0) {
+    for (uint16_t i = queue->tail; i != queue->head; ++i) {
+      if (queue->data[i & queue->mask] == pid) {
+        success = true;
+        break;
+      }
     }
   }
 
   // Push the new PID and increment the queue head
-  if (!already_queued && (queue->head + 1) % queue->max_size != queue->tail) {
-    queue->data[queue->head] = pid;
+  if (!success && (uint16_t)(queue->head - queue->tail) <= queue->mask) {
+    queue->data[queue->head & queue->mask] = pid;
     ++queue->head;
-    if (queue->head == queue->max_size) {
-      queue->head = 0;
-    }
+    ++queue->filter[bucket];
+    ++dmx_driver[dmx_num]->device.generation;  // The message count changed
     success = true;
   }
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
@@ -150,12 +168,11 @@ rdm_pid_t rdm_queue_pop(dmx_port_t dmx_num) {
     rdm_queue_t *queue = rdm_get_queue(dmx_num);
     assert(queue != NULL);
     taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-    pid = queue->data[queue->tail];
+    pid = queue->data[queue->tail & queue->mask];
     ++queue->tail;
-    if (queue->tail == queue->max_size) {
-      queue->tail = 0;
-    }
+    --queue->filter[rdm_queue_hash(pid)];
     queue->previous = pid;
+    ++dmx_driver[dmx_num]->device.generation;  // The message count changed
     taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
   } else {
     pid = 0;
@@ -180,10 +197,7 @@ uint8_t rdm_queue_size(dmx_port_t dmx_num) {
   head = queue->head;
   tail = queue->tail;
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
-  int32_t size = -tail + head;
-  if (size < 0) {
-    size += queue->max_size;
-  }
+  int32_t size = (uint16_t)(head - tail);
 
   // Clamp the queue size to 255
   if (size > 255) {
@@ -114,7 +114,8 @@ bool rdm_register_supported_parameters(dmx_port_t dmx_num, rdm_callback_t cb,
       .min_value = 0,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
@@ -189,7 +190,8 @@ bool rdm_register_parameter_description(dmx_port_t dmx_num, rdm_callback_t cb,
       .min_value = RDM_PID_MANUFACTURER_SPECIFIC_BEGIN,
       .units = RDM_UNITS_NONE,
       .prefix = RDM_PREFIX_NONE,
-      .description = NULL};
+      .description = NULL,
+      .get_is_cacheable = true};
   rdm_definition_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, &definition);
 
   return rdm_callback_set(dmx_num, RDM_SUB_DEVICE_ROOT, pid, cb, context);
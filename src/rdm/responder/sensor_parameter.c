@@ -9,9 +9,23 @@
 #include "rdm/include/driver.h"
 #include "rdm/responder/include/utils.h"
 
+enum {
+  RDM_SENSOR_PRESENT = 0,  // The present value of each sensor.
+  RDM_SENSOR_LOWEST,       // The lowest value of each sensor since reset.
+  RDM_SENSOR_HIGHEST,      // The highest value of each sensor since reset.
+  RDM_SENSOR_RECORDED,     // The recorded value of each sensor.
+  RDM_SENSOR_FIELDS,       // The number of values which each sensor has.
+};
+
+/**
+ * @brief The values of the RDM sensors. The values are stored as a structure
+ * of arrays so that updating many sensors at once touches contiguous memory.
+ * Each field of values is sensor_count values long.
+ */
 typedef struct rdm_sensors_t {
-  uint8_t sensor_count;
-  rdm_sensor_value_t sensor_value[];
+  uint8_t sensor_count;    // The number of sensors.
+  uint32_t is_tracked[8];  // Sensors whose lowest and highest values are set.
+  int16_t values[];        // The values of the sensors, by field then sensor.
 } rdm_sensors_t;
 
 static rdm_sensors_t *rdm_get_sensors(dmx_port_t dmx_num,
@@ -19,6 +33,26 @@ static rdm_sensors_t *rdm_get_sensors(dmx_port_t dmx_num,
   return dmx_parameter_get_data(dmx_num, sub_device, RDM_PID_SENSOR_VALUE);
 }
 
+static inline int16_t *rdm_sensor_field(rdm_sensors_t *sensors, int field) {
+  return &sensors->values[field * sensors->sensor_count];
+}
+
+static void rdm_sensor_copy(rdm_sensors_t *sensors, int i,
+                            rdm_sensor_value_t *value) {
+  value->sensor_num = i;
+  value->present_value = rdm_sensor_field(sensors, RDM_SENSOR_PRESENT)[i];
+  value->lowest_value = rdm_sensor_field(sensors, RDM_SENSOR_LOWEST)[i];
+  value->highest_value = rdm_sensor_field(sensors, RDM_SENSOR_HIGHEST)[i];
+  value->recorded_value = rdm_sensor_field(sensors, RDM_SENSOR_RECORDED)[i];
+}
+
+static void rdm_sensor_clear(rdm_sensors_t *sensors, int i) {
+  for (int field = 0; field < RDM_SENSOR_FIELDS; ++field) {
+    rdm_sensor_field(sensors, field)[i] = 0;
+  }
+  sensors->is_tracked[i / 32] &= ~(1u << (i % 32));
+}
+
 static size_t rdm_rhd_get_set_sensor_value(
     dmx_port_t dmx_num, const rdm_parameter_definition_t *definition,
     const rdm_header_t *header) {
@@ -36,13 +70,13 @@ static size_t rdm_rhd_get_set_sensor_value(
                    sizeof(sensor_num))) {
     return rdm_write_nack_reason(dmx_num, header, RDM_NR_FORMAT_ERROR);
   }
-  if (sensor_num > rdm_sensor_get_count(dmx_num, header->sub_device) &&
+  if (sensor_num >= rdm_sensor_get_count(dmx_num, header->sub_device) &&
       sensor_num != RDM_SENSOR_NUM_MAX) {
     return rdm_write_nack_reason(dmx_num, header, RDM_NR_DATA_OUT_OF_RANGE);
   }
 
   rdm_sensors_t *sensors = rdm_get_sensors(dmx_num, header->sub_device);
-  rdm_sensor_value_t *value;
+  rdm_sensor_value_t value;
   assert(sensors != NULL);
 
   if (header->cc == RDM_CC_GET_COMMAND) {
@@ -53,32 +87,27 @@ static size_t rdm_rhd_get_set_sensor_value(
     }
 
     // Get the requested sensor value
-    value = &sensors->sensor_value[sensor_num];
-    assert(value != NULL);
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+    rdm_sensor_copy(sensors, sensor_num, &value);
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
   } else {
+    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
     if (sensor_num == RDM_SENSOR_NUM_MAX) {
       // Reset all the sensors
       for (int i = 0; i < sensors->sensor_count; ++i) {
-        sensors->sensor_value[i].present_value = 0;
-        sensors->sensor_value[i].lowest_value = 0;
-        sensors->sensor_value[i].highest_value = 0;
-        sensors->sensor_value[i].recorded_value = 0;
+        rdm_sensor_clear(sensors, i);
       }
-      value = &sensors->sensor_value[0];
-      assert(value != NULL);
+      rdm_sensor_copy(sensors, 0, &value);
     } else {
       // Get the requested sensor value and reset it
-      value = &sensors->sensor_value[sensor_num];
-      assert(value != NULL);
-      value->present_value = 0;
-      value->lowest_value = 0;
-      value->highest_value = 0;
-      value->recorded_value = 0;
+      rdm_sensor_clear(sensors, sensor_num);
+      rdm_sensor_copy(sensors, sensor_num, &value);
     }
+    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
   }
 
-  return rdm_write_ack(dmx_num, header, command->response.format, value,
-                       sizeof(*value));
+  return rdm_write_ack(dmx_num, header, command->response.format, &value,
+                       sizeof(value));
 }
 
 static size_t rdm_rhd_set_record_sensors(
@@ -90,7 +119,7 @@ static size_t rdm_rhd_set_record_sensors(
                    sizeof(sensor_num))) {
     return rdm_write_nack_reason(dmx_num, header, RDM_NR_FORMAT_ERROR);
   }
-  if (sensor_num > rdm_sensor_get_count(dmx_num, header->sub_device) &&
+  if (sensor_num >= rdm_sensor_get_count(dmx_num, header->sub_device) &&
       sensor_num != RDM_SENSOR_NUM_MAX) {
     return rdm_write_nack_reason(dmx_num, header, RDM_NR_DATA_OUT_OF_RANGE);
   }
@@ -112,7 +141,7 @@ static size_t rdm_rhd_get_sensor_definition(
                    sizeof(sensor_num))) {
     return rdm_write_nack_reason(dmx_num, header, RDM_NR_FORMAT_ERROR);
   }
-  if (sensor_num > rdm_sensor_get_count(dmx_num, header->sub_device) &&
+  if (sensor_num >= rdm_sensor_get_count(dmx_num, header->sub_device) &&
       sensor_num != RDM_SENSOR_NUM_MAX) {
     return rdm_write_nack_reason(dmx_num, header, RDM_NR_DATA_OUT_OF_RANGE);
   }
@@ -187,8 +216,8 @@ bool rdm_register_sensor_value(dmx_port_t dmx_num, uint8_t sensor_count,
   const rdm_pid_t pid = RDM_PID_SENSOR_VALUE;
 
   // Add the parameter
-  size_t size =
-      sizeof(rdm_sensors_t) + (sizeof(rdm_sensor_value_t) * sensor_count);
+  size_t size = sizeof(rdm_sensors_t) +
+                (sizeof(int16_t) * RDM_SENSOR_FIELDS * sensor_count);
   if (!dmx_parameter_add(dmx_num, RDM_SUB_DEVICE_ROOT, pid,
                          DMX_PARAMETER_TYPE_DYNAMIC, NULL, size)) {
     return false;
@@ -196,9 +225,6 @@ bool rdm_register_sensor_value(dmx_port_t dmx_num, uint8_t sensor_count,
   rdm_sensors_t *sensors = rdm_get_sensors(dmx_num, RDM_SUB_DEVICE_ROOT);
   assert(sensors != NULL);
   sensors->sensor_count = sensor_count;
-  for (int i = 0; i < sensor_count; ++i) {
-    sensors->sensor_value[i].sensor_num = i;
-  }
 
   // Define the parameter
   static const rdm_parameter_definition_t definition = {
@@ -281,7 +307,7 @@ size_t rdm_sensor_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
   }
 
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-  *sensor_value = sensors->sensor_value[sensor_num];
+  rdm_sensor_copy(sensors, sensor_num, sensor_value);
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
   return sizeof(*sensor_value);
@@ -296,27 +322,79 @@ bool rdm_sensor_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 
   // Validate the sensor_num
   rdm_sensors_t *sensors = rdm_get_sensors(dmx_num, sub_device);
-  if (sensors == NULL || (sensor_num > sensors->sensor_count &&
+  if (sensors == NULL || (sensor_num >= sensors->sensor_count &&
                           sensor_num != RDM_SENSOR_NUM_MAX)) {
     return false;
   }
 
   // Set the sensor value
+  int16_t *const present = rdm_sensor_field(sensors, RDM_SENSOR_PRESENT);
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   if (sensor_num != RDM_SENSOR_NUM_MAX) {
-    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-    sensors->sensor_value[sensor_num].present_value = value;
-    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    present[sensor_num] = value;
   } else {
     for (int i = 0; i < sensors->sensor_count; ++i) {
-      taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-      sensors->sensor_value[i].present_value = value;
-      taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+      present[i] = value;
     }
   }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
   return true;
 }
 
+int rdm_sensor_set_bulk(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
+                        uint8_t first, const int16_t *values, int num,
+                        bool record) {
+  DMX_CHECK(dmx_num < DMX_NUM_MAX, 0, "dmx_num error");
+  DMX_CHECK(sub_device < RDM_SUB_DEVICE_MAX || sub_device == RDM_SUB_DEVICE_ALL,
+            0, "sub_device error");
+  DMX_CHECK(values != NULL || num == 0, 0, "values is null");
+  DMX_CHECK(num >= 0, 0, "num error");
+  DMX_CHECK(dmx_driver_is_installed(dmx_num), 0, "driver is not installed");
+
+  // Validate the range of sensors
+  rdm_sensors_t *sensors = rdm_get_sensors(dmx_num, sub_device);
+  if (sensors == NULL || first + num > sensors->sensor_count) {
+    return 0;
+  }
+
+  int16_t *const present = rdm_sensor_field(sensors, RDM_SENSOR_PRESENT);
+  int16_t *const lowest = rdm_sensor_field(sensors, RDM_SENSOR_LOWEST);
+  int16_t *const highest = rdm_sensor_field(sensors, RDM_SENSOR_HIGHEST);
+  int16_t *const recorded = rdm_sensor_field(sensors, RDM_SENSOR_RECORDED);
+
+  // Update every sensor and its lowest and highest values at once
+  int num_changed = 0;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  for (int n = 0; n < num; ++n) {
+    const int i = first + n;
+    const int16_t value = values[n];
+    const uint32_t bit = 1u << (i % 32);
+    if (!(sensors->is_tracked[i / 32] & bit)) {
+      sensors->is_tracked[i / 32] |= bit;
+      lowest[i] = value;
+      highest[i] = value;
+    } else if (value < lowest[i]) {
+      lowest[i] = value;
+    } else if (value > highest[i]) {
+      highest[i] = value;
+    }
+    num_changed += (present[i] != value);
+    present[i] = value;
+    if (record) {
+      recorded[i] = value;
+    }
+  }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+
+  // Let RDM controllers know that the sensor values have changed
+  if (num_changed > 0) {
+    rdm_queue_push(dmx_num, RDM_PID_SENSOR_VALUE);
+  }
+
+  return num_changed;
+}
+
 bool rdm_sensor_record(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
                        uint8_t sensor_num) {
   DMX_CHECK(dmx_num < DMX_NUM_MAX, false, "dmx_num error");
@@ -326,24 +404,20 @@ bool rdm_sensor_record(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 
   // Validate the sensor_num
   rdm_sensors_t *sensors = rdm_get_sensors(dmx_num, sub_device);
-  if (sensors == NULL || (sensor_num > sensors->sensor_count &&
+  if (sensors == NULL || (sensor_num >= sensors->sensor_count &&
                           sensor_num != RDM_SENSOR_NUM_MAX)) {
     return false;
   }
 
-  if (sensor_num == 0xff) {
-    for (int i = sensors->sensor_count; i >= 0; --i) {
-      rdm_sensor_value_t *sensor = &sensors->sensor_value[i];
-      taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-      sensor->recorded_value = sensor->present_value;
-      taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
-    }
+  const int16_t *const present = rdm_sensor_field(sensors, RDM_SENSOR_PRESENT);
+  int16_t *const recorded = rdm_sensor_field(sensors, RDM_SENSOR_RECORDED);
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (sensor_num == RDM_SENSOR_NUM_MAX) {
+    memcpy(recorded, present, sizeof(int16_t) * sensors->sensor_count);
   } else {
-    rdm_sensor_value_t *sensor = &sensors->sensor_value[sensor_num];
-    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-    sensor->recorded_value = sensor->present_value;
-    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    recorded[sensor_num] = present[sensor_num];
   }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
   return true;
 }
@@ -357,30 +431,20 @@ bool rdm_sensor_reset(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
 
   // Validate the sensor_num
   rdm_sensors_t *sensors = rdm_get_sensors(dmx_num, sub_device);
-  if (sensors == NULL || (sensor_num > sensors->sensor_count &&
+  if (sensors == NULL || (sensor_num >= sensors->sensor_count &&
                           sensor_num != RDM_SENSOR_NUM_MAX)) {
     return false;
   }
 
-  if (sensor_num == 0xff) {
-    for (int i = sensors->sensor_count; i >= 0; --i) {
-      rdm_sensor_value_t *sensor = &sensors->sensor_value[i];
-      taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-      sensor->present_value = 0;
-      sensor->lowest_value = 0;
-      sensor->highest_value = 0;
-      sensor->recorded_value = 0;
-      taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  if (sensor_num == RDM_SENSOR_NUM_MAX) {
+    for (int i = 0; i < sensors->sensor_count; ++i) {
+      rdm_sensor_clear(sensors, i);
     }
   } else {
-    rdm_sensor_value_t *sensor = &sensors->sensor_value[sensor_num];
-    taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
-    sensor->present_value = 0;
-    sensor->lowest_value = 0;
-    sensor->highest_value = 0;
-    sensor->recorded_value = 0;
-    taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+    rdm_sensor_clear(sensors, sensor_num);
   }
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
   return true;
 }
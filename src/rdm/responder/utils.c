@@ -88,6 +88,7 @@ void rdm_set_boot_loader(dmx_port_t dmx_num) {
 
   taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   dmx_driver[dmx_num]->rdm.boot_loader = true;
+  ++dmx_driver[dmx_num]->device.generation;
   taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 }
 
@@ -133,17 +134,67 @@ size_t rdm_simple_response_handler(dmx_port_t dmx_num,
                                    RDM_NR_SUB_DEVICE_OUT_OF_RANGE);
     }
 
-    // Iterate through all sub-devices and update the parameter
+    // Update the parameter of every sub-device in a single pass
     uint8_t pd[231];
     format = definition->set.request.format;
     size_t size = rdm_read_pd(dmx_num, format, pd, header->pdl);
-    for (int i = RDM_SUB_DEVICE_ROOT; i < RDM_SUB_DEVICE_MAX; ++i) {
-      dmx_parameter_set(dmx_num, i, header->pid, pd, size);
-    }
+    dmx_parameter_set_all(dmx_num, header->pid, pd, size);
     return rdm_write_ack(dmx_num, header, NULL, NULL, 0);
   }
 }
 
+enum rdm_dispatch_constants_t {
+  RDM_DISPATCH_ENTRIES_PER_PID = 2,  // Keeps the table at most half full.
+  RDM_DISPATCH_ENTRIES_MIN = 16,  // The minimum size of the dispatch table.
+};
+
+static void rdm_dispatch_build(const rdm_parameter_definition_t *definition,
+                               rdm_dispatch_t *dispatch) {
+  dispatch->definition = definition;
+  memset(dispatch->commands, 0, sizeof(dispatch->commands));
+  if (definition == NULL) {
+    return;
+  }
+
+  const rdm_pid_cc_t pid_cc = definition->pid_cc;
+  if (pid_cc == RDM_CC_DISC) {
+    // RDM_CC_DISC_COMMAND uses get.handler()
+    dispatch->commands[rdm_dispatch_index(RDM_CC_DISC_COMMAND)] =
+        &definition->get;
+  }
+  if (pid_cc == RDM_CC_GET || pid_cc == RDM_CC_GET_SET) {
+    dispatch->commands[rdm_dispatch_index(RDM_CC_GET_COMMAND)] =
+        &definition->get;
+  }
+  if (pid_cc == RDM_CC_SET || pid_cc == RDM_CC_GET_SET) {
+    dispatch->commands[rdm_dispatch_index(RDM_CC_SET_COMMAND)] =
+        &definition->set;
+  }
+}
+
+static struct rdm_dispatch_entry_t *rdm_dispatch_find(dmx_port_t dmx_num,
+                                                      rdm_pid_t pid,
+                                                      bool is_insert) {
+  const struct dmx_driver_device_t *const device = &dmx_driver[dmx_num]->device;
+  if (device->dispatch == NULL) {
+    return NULL;
+  }
+
+  // Fold the high byte so that manufacturer-specific PIDs are spread evenly
+  const uint32_t mask = device->dispatch_mask;
+  uint32_t i = (pid ^ (pid >> 8)) & mask;
+  for (uint32_t probes = 0; probes <= mask; ++probes, i = (i + 1) & mask) {
+    struct rdm_dispatch_entry_t *const entry = &device->dispatch[i];
+    if (entry->pid == pid) {
+      return entry;
+    } else if (entry->pid == 0) {
+      return is_insert ? entry : NULL;  // PID is not in the table
+    }
+  }
+
+  return NULL;  // Table is full
+}
+
 bool rdm_definition_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
                         rdm_pid_t pid,
                         const rdm_parameter_definition_t *definition) {
@@ -175,8 +226,44 @@ bool rdm_definition_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
     return false;
   }
 
+  // Compile the format strings so they needn't be parsed for each response
+  rdm_format_compile(definition->get.request.format);
+  rdm_format_compile(definition->get.response.format);
+  rdm_format_compile(definition->set.request.format);
+  rdm_format_compile(definition->set.response.format);
+
+  struct dmx_driver_device_t *const device = &dmx_driver[dmx_num]->device;
+  struct rdm_dispatch_entry_t *overflow = NULL;
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  const rdm_parameter_definition_t *const previous = entry->definition;
   entry->definition = definition;
 
+  // Add the definition to the dispatch table
+  struct rdm_dispatch_entry_t *dispatch =
+      rdm_dispatch_find(dmx_num, pid, true);
+  if (dispatch != NULL) {
+    dispatch->pid = pid;
+    if (sub_device == RDM_SUB_DEVICE_ROOT) {
+      rdm_dispatch_build(definition, &dispatch->root);
+    } else {
+      if (previous == NULL) {
+        ++dispatch->sub_device_definitions;
+      }
+      if (dispatch->sub_device.definition == NULL) {
+        rdm_dispatch_build(definition, &dispatch->sub_device);
+      } else if (dispatch->sub_device.definition != definition) {
+        dispatch->sub_device_is_ambiguous = true;
+      }
+    }
+  } else if (device->dispatch != NULL) {
+    // The table is full so every request must use rdm_definition_get()
+    overflow = device->dispatch;
+    device->dispatch = NULL;
+  }
+  ++device->generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+  dmx_free(dmx_num, overflow);
+
   return true;
 }
 
@@ -192,6 +279,69 @@ const rdm_parameter_definition_t *rdm_definition_get(
   return entry->definition;
 }
 
+size_t rdm_dispatch_get_table_size(uint32_t pid_count) {
+  uint32_t size = RDM_DISPATCH_ENTRIES_MIN;
+  while (size < pid_count * RDM_DISPATCH_ENTRIES_PER_PID) {
+    size <<= 1;
+  }
+
+  return sizeof(struct rdm_dispatch_entry_t) * size;
+}
+
+void rdm_dispatch_init(dmx_port_t dmx_num) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  struct dmx_driver_device_t *const device = &dmx_driver[dmx_num]->device;
+
+  // Size the table for every PID which may be registered
+  const uint32_t pid_count =
+      device->parameter_count.root + device->parameter_count.sub_devices;
+  const size_t table_size = rdm_dispatch_get_table_size(pid_count);
+  const uint32_t size = table_size / sizeof(struct rdm_dispatch_entry_t);
+  struct rdm_dispatch_entry_t *dispatch = dmx_alloc(dmx_num, table_size);
+  if (dispatch == NULL) {
+    return;  // Requests are dispatched with rdm_definition_get()
+  }
+  memset(dispatch, 0, table_size);
+
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
+  device->dispatch = dispatch;
+  device->dispatch_mask = size - 1;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
+}
+
+bool rdm_dispatch_get(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
+                      rdm_pid_t pid, rdm_dispatch_t *dispatch) {
+  assert(dmx_num < DMX_NUM_MAX);
+  assert(sub_device < RDM_SUB_DEVICE_MAX);
+  assert(pid > 0);
+  assert(dispatch != NULL);
+  assert(dmx_driver_is_installed(dmx_num));
+
+  const struct dmx_driver_device_t *const device = &dmx_driver[dmx_num]->device;
+  const struct rdm_dispatch_entry_t *entry = rdm_dispatch_find(dmx_num, pid,
+                                                               false);
+  if (entry == NULL && device->dispatch != NULL) {
+    // Every definition is in the table, so the PID has no definition
+    rdm_dispatch_build(NULL, dispatch);
+    return false;
+  } else if (entry != NULL && sub_device == RDM_SUB_DEVICE_ROOT) {
+    *dispatch = entry->root;
+    return dispatch->definition != NULL;
+  } else if (entry != NULL && !entry->sub_device_is_ambiguous &&
+             entry->sub_device_definitions == device->sub_device_count &&
+             dmx_device_get(dmx_num, sub_device) != NULL) {
+    // Every sub-device shares a single definition for the PID
+    *dispatch = entry->sub_device;
+    return dispatch->definition != NULL;
+  }
+
+  // The table is not allocated or is ambiguous for this sub-device
+  rdm_dispatch_build(rdm_definition_get(dmx_num, sub_device, pid), dispatch);
+  return dispatch->definition != NULL;
+}
+
 bool rdm_callback_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
                       rdm_pid_t pid, rdm_callback_t callback, void *context) {
   assert(pid > 0);
@@ -201,8 +351,11 @@ bool rdm_callback_set(dmx_port_t dmx_num, rdm_sub_device_t sub_device,
     return false;
   }
 
+  taskENTER_CRITICAL(DMX_SPINLOCK(dmx_num));
   entry->callback = callback;
   entry->context = context;
+  ++dmx_driver[dmx_num]->device.generation;
+  taskEXIT_CRITICAL(DMX_SPINLOCK(dmx_num));
 
   return true;
 }